@@ -69,8 +69,11 @@ FBApplication::FBApplication ()
 {
 	NS_LOG_FUNCTION (this);
 
-	srand (time (0));
-	RngSeedManager::SetSeed (time (0));
+	// one seed for the whole process, as in fb-vanet-3d: the applications
+	// of the same run start from the same random numbers
+	static const uint32_t seed = time (0);
+	srand (seed + RngSeedManager::GetRun ());
+	RngSeedManager::SetSeed (seed);
 }
 
 FBApplication::~FBApplication ()
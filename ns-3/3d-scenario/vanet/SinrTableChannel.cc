@@ -0,0 +1,370 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 Università di Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ */
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/string.h"
+#include "ns3/node.h"
+#include "ns3/mobility-model.h"
+#include "ns3/dsss-error-rate-model.h"
+
+#include "SinrTableChannel.h"
+#include "SinrTableNetDevice.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SinrTableChannel");
+
+NS_OBJECT_ENSURE_REGISTERED (SinrTableChannel);
+
+TypeId
+SinrTableChannel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SinrTableChannel")
+    .SetParent<Channel> ()
+    .SetGroupName ("Network")
+    .AddConstructor<SinrTableChannel> ()
+    .AddAttribute ("DataRate",
+                   "The rate of the payload of the frames (1, 2, 5.5 or 11 Mbps, "
+                   "for the error rate model of the default table).",
+                   DataRateValue (DataRate ("11Mbps")),
+                   MakeDataRateAccessor (&SinrTableChannel::m_dataRate),
+                   MakeDataRateChecker ())
+    .AddAttribute ("PreambleDuration",
+                   "The airtime of the preamble and of the PLCP header "
+                   "(192 us for the long preamble of 802.11b).",
+                   TimeValue (MicroSeconds (192)),
+                   MakeTimeAccessor (&SinrTableChannel::m_preamble),
+                   MakeTimeChecker ())
+    .AddAttribute ("MacOverhead",
+                   "The bytes added to each packet on air: MAC header, "
+                   "LLC/SNAP header and FCS of a data frame.",
+                   UintegerValue (36),
+                   MakeUintegerAccessor (&SinrTableChannel::m_overhead),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("NoiseFigure",
+                   "The noise figure of the receivers (dB), as in the YansWifiPhy.",
+                   DoubleValue (7),
+                   MakeDoubleAccessor (&SinrTableChannel::m_noiseFigure),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("Bandwidth",
+                   "The bandwidth of the channel (Hz).",
+                   DoubleValue (22e6),
+                   MakeDoubleAccessor (&SinrTableChannel::m_bandwidth),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("EnergyDetectionThreshold",
+                   "The power (dBm) below which a frame is not received, "
+                   "as in the YansWifiPhy.",
+                   DoubleValue (-96),
+                   MakeDoubleAccessor (&SinrTableChannel::m_edThreshold),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("CcaThreshold",
+                   "The power (dBm) of the frames on air, together, above which "
+                   "the medium is busy, as the CcaMode1Threshold of the YansWifiPhy.",
+                   DoubleValue (-99),
+                   MakeDoubleAccessor (&SinrTableChannel::m_ccaThreshold),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("InterferenceThreshold",
+                   "The power (dBm) below which a frame is not delivered at all, "
+                   "not even as interference: lower it to account for more weak "
+                   "frames, at the cost of more events.",
+                   DoubleValue (-99),
+                   MakeDoubleAccessor (&SinrTableChannel::m_interferenceThreshold),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("TableFrameSize",
+                   "The size (bytes, on air) of the frames of the PER table.",
+                   UintegerValue (128),
+                   MakeUintegerAccessor (&SinrTableChannel::m_tableFrameSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("TableFile",
+                   "The file the PER table is read from (see LoadPerTable); "
+                   "empty to sample the DSSS error rate model.",
+                   StringValue (""),
+                   MakeStringAccessor (&SinrTableChannel::m_tableFile),
+                   MakeStringChecker ());
+
+  return tid;
+}
+
+SinrTableChannel::SinrTableChannel ()
+	:	m_overhead (36),
+		m_noiseFigure (7),
+		m_bandwidth (22e6),
+		m_edThreshold (-96),
+		m_ccaThreshold (-99),
+		m_interferenceThreshold (-99),
+		m_tableFrameSize (128)
+{
+	NS_LOG_FUNCTION (this);
+
+	m_random = CreateObject<UniformRandomVariable> ();
+}
+
+SinrTableChannel::~SinrTableChannel ()
+{
+	NS_LOG_FUNCTION (this);
+}
+
+void
+SinrTableChannel::DoInitialize (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (m_tablePer.empty ())
+	{
+		if (m_tableFile.empty ())
+			MakePerTable ();
+		else if (!LoadPerTable (m_tableFile))
+			NS_FATAL_ERROR ("Could not read the PER table file \"" << m_tableFile << "\".");
+	}
+
+	Channel::DoInitialize ();
+}
+
+void
+SinrTableChannel::DoDispose (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	m_devices.clear ();
+	m_loss = 0;
+	m_delay = 0;
+	m_random = 0;
+
+	Channel::DoDispose ();
+}
+
+std::size_t
+SinrTableChannel::GetNDevices (void) const
+{
+	return m_devices.size ();
+}
+
+Ptr<NetDevice>
+SinrTableChannel::GetDevice (std::size_t i) const
+{
+	return m_devices.at (i);
+}
+
+void
+SinrTableChannel::Add (Ptr<SinrTableNetDevice> device)
+{
+	NS_LOG_FUNCTION (this << device);
+
+	m_devices.push_back (device);
+}
+
+void
+SinrTableChannel::SetPropagationLossModel (Ptr<PropagationLossModel> loss)
+{
+	NS_LOG_FUNCTION (this << loss);
+
+	m_loss = loss;
+}
+
+void
+SinrTableChannel::SetPropagationDelayModel (Ptr<PropagationDelayModel> delay)
+{
+	NS_LOG_FUNCTION (this << delay);
+
+	m_delay = delay;
+}
+
+void
+SinrTableChannel::Send (Ptr<SinrTableNetDevice> sender, Ptr<const Packet> packet, uint16_t protocol,
+												double txPowerDbm, Time duration) const
+{
+	NS_LOG_FUNCTION (this << sender << packet << protocol << txPowerDbm << duration);
+	NS_ASSERT (m_loss != 0 && m_delay != 0);
+
+	Ptr<MobilityModel> senderMobility = sender->GetNode ()->GetObject<MobilityModel> ();
+	NS_ASSERT (senderMobility != 0);
+
+	for (std::vector<Ptr<SinrTableNetDevice> >::const_iterator i = m_devices.begin (); i != m_devices.end (); ++i)
+	{
+		if (*i == sender)
+			continue;
+
+		Ptr<MobilityModel> receiverMobility = (*i)->GetNode ()->GetObject<MobilityModel> ();
+		double rxPowerDbm = m_loss->CalcRxPower (txPowerDbm, senderMobility, receiverMobility);
+
+		// neither received nor sensed
+		if (rxPowerDbm < m_interferenceThreshold)
+			continue;
+
+		Time delay = m_delay->GetDelay (senderMobility, receiverMobility);
+		Simulator::ScheduleWithContext ((*i)->GetNode ()->GetId (), delay, &SinrTableNetDevice::StartReceive, *i,
+																		packet->Copy (), protocol, Mac48Address::ConvertFrom (sender->GetAddress ()),
+																		rxPowerDbm, duration);
+	}
+}
+
+uint32_t
+SinrTableChannel::GetFrameSize (uint32_t size) const
+{
+	return size + m_overhead;
+}
+
+Time
+SinrTableChannel::GetAirtime (uint32_t size) const
+{
+	double bits = GetFrameSize (size) * 8.0;
+
+	return m_preamble + MicroSeconds ((int64_t) std::ceil (bits * 1e6 / m_dataRate.GetBitRate ()));
+}
+
+double
+SinrTableChannel::GetPer (double sinrDb, uint32_t frameSize) const
+{
+	NS_ASSERT (!m_tableSinr.empty ());
+
+	double per;
+	if (sinrDb <= m_tableSinr.front ())
+		per = m_tablePer.front ();
+	else if (sinrDb >= m_tableSinr.back ())
+		per = m_tablePer.back ();
+	else
+	{
+		// linear interpolation between the two nearest samples
+		std::size_t j = std::upper_bound (m_tableSinr.begin (), m_tableSinr.end (), sinrDb) - m_tableSinr.begin ();
+		double t = (sinrDb - m_tableSinr[j - 1]) / (m_tableSinr[j] - m_tableSinr[j - 1]);
+		per = m_tablePer[j - 1] + t * (m_tablePer[j] - m_tablePer[j - 1]);
+	}
+
+	// errors independent along the frame: scale the success rate with the size
+	if (frameSize != m_tableFrameSize && per < 1)
+		per = 1 - std::pow (1 - per, frameSize / (double) m_tableFrameSize);
+
+	return per;
+}
+
+double
+SinrTableChannel::GetNoiseW (void) const
+{
+	// thermal noise at 290 K, as in the YansWifiPhy
+	return 1.3803e-23 * 290 * m_bandwidth * std::pow (10.0, m_noiseFigure / 10.0);
+}
+
+double
+SinrTableChannel::GetEnergyDetectionThreshold (void) const
+{
+	return m_edThreshold;
+}
+
+double
+SinrTableChannel::GetCcaThreshold (void) const
+{
+	return m_ccaThreshold;
+}
+
+double
+SinrTableChannel::GetUniform (void) const
+{
+	return m_random->GetValue ();
+}
+
+void
+SinrTableChannel::MakePerTable (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	uint64_t rate = m_dataRate.GetBitRate ();
+	uint64_t bits = m_tableFrameSize * 8;
+
+	m_tableSinr.clear ();
+	m_tablePer.clear ();
+	for (double sinrDb = -10; sinrDb <= 30; sinrDb += 0.25)
+	{
+		double sinr = std::pow (10.0, sinrDb / 10.0);
+
+		// the PLCP header is always sent at 1 Mbps
+		double success = DsssErrorRateModel::GetDsssDbpskSuccessRate (sinr, 48);
+		if (rate <= 1000000)
+			success *= DsssErrorRateModel::GetDsssDbpskSuccessRate (sinr, bits);
+		else if (rate <= 2000000)
+			success *= DsssErrorRateModel::GetDsssDqpskSuccessRate (sinr, bits);
+		else if (rate <= 5500000)
+			success *= DsssErrorRateModel::GetDsssDqpskCck5_5SuccessRate (sinr, bits);
+		else
+			success *= DsssErrorRateModel::GetDsssDqpskCck11SuccessRate (sinr, bits);
+
+		m_tableSinr.push_back (sinrDb);
+		m_tablePer.push_back (1 - success);
+	}
+
+	NS_LOG_INFO ("PER table of " << m_tableSinr.size () << " samples from the DSSS error rate model at "
+							 << rate << " bps.");
+}
+
+bool
+SinrTableChannel::LoadPerTable (std::string filename)
+{
+	NS_LOG_FUNCTION (this << filename);
+
+	std::ifstream in (filename.c_str ());
+	if (!in.is_open ())
+		return false;
+
+	std::vector<double> sinrs, pers;
+	std::string line;
+	while (std::getline (in, line))
+	{
+		if (line.empty () || line[0] == '#')
+			continue;
+
+		std::istringstream fields (line);
+		double sinrDb, per;
+		if (!(fields >> sinrDb >> per) || per < 0 || per > 1
+				|| (!sinrs.empty () && sinrDb <= sinrs.back ()))
+		{
+			NS_LOG_WARN ("Invalid line in the PER table \"" << filename << "\": " << line);
+			return false;
+		}
+
+		sinrs.push_back (sinrDb);
+		pers.push_back (per);
+	}
+
+	if (sinrs.empty ())
+		return false;
+
+	m_tableSinr.swap (sinrs);
+	m_tablePer.swap (pers);
+
+	NS_LOG_INFO ("PER table of " << m_tableSinr.size () << " samples read from \"" << filename << "\".");
+
+	return true;
+}
+
+void
+SinrTableChannel::PrintPerTable (std::ostream &os) const
+{
+	os << "# SINR (dB)  PER, frames of " << m_tableFrameSize << " bytes" << std::endl;
+	for (std::size_t i = 0; i < m_tableSinr.size (); i++)
+		os << m_tableSinr[i] << " " << m_tablePer[i] << std::endl;
+}
+
+} // namespace ns3
@@ -0,0 +1,211 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 Università di Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ */
+
+#ifndef SINRTABLECHANNEL_H
+#define SINRTABLECHANNEL_H
+
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/channel.h"
+#include "ns3/packet.h"
+#include "ns3/mac48-address.h"
+#include "ns3/data-rate.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/propagation-delay-model.h"
+
+
+namespace ns3 {
+
+class SinrTableNetDevice;
+
+/**
+ * \ingroup network
+ * \brief A broadcast channel that replaces the 802.11b PHY with a table of
+ * the packet error rate as a function of the SINR.
+ *
+ * The received power is computed with the same propagation loss and delay
+ * models of a YansWifiChannel, and each receiver decides whether a frame is
+ * received by drawing against the PER of its SINR (see SinrTableNetDevice).
+ * The default table is sampled once from the DSSS error rate model of the
+ * DataRate, for frames of TableFrameSize bytes, and can be replaced by a
+ * table read from a file (e.g. measured with the full PHY).
+ */
+class SinrTableChannel : public Channel
+{
+public:
+	static TypeId GetTypeId (void);
+
+	/**
+	 * \brief Constructor
+	 * \return none
+	 */
+	SinrTableChannel ();
+
+	/**
+	 * \brief Destructor
+	 * \return none
+	 */
+	virtual ~SinrTableChannel ();
+
+	// inherited from Channel
+	virtual std::size_t GetNDevices (void) const;
+	virtual Ptr<NetDevice> GetDevice (std::size_t i) const;
+
+	/**
+	 * \brief Attach a device to this channel
+	 * \param device the device
+	 * \return none
+	 */
+	void Add (Ptr<SinrTableNetDevice> device);
+
+	/**
+	 * \brief Set the propagation loss model (e.g. the chain of a YansWifiChannel)
+	 * \param loss the propagation loss model
+	 * \return none
+	 */
+	void SetPropagationLossModel (Ptr<PropagationLossModel> loss);
+
+	/**
+	 * \brief Set the propagation delay model
+	 * \param delay the propagation delay model
+	 * \return none
+	 */
+	void SetPropagationDelayModel (Ptr<PropagationDelayModel> delay);
+
+	/**
+	 * \brief Start the transmission of a frame: schedule its arrival at
+	 * each other device that receives it above the interference threshold
+	 * \param sender the transmitting device
+	 * \param packet the packet
+	 * \param protocol the protocol number of the packet
+	 * \param txPowerDbm the transmission power (dBm)
+	 * \param duration the airtime of the frame
+	 * \return none
+	 */
+	void Send (Ptr<SinrTableNetDevice> sender, Ptr<const Packet> packet, uint16_t protocol,
+						 double txPowerDbm, Time duration) const;
+
+	/**
+	 * \brief Get the airtime of a frame: preamble and PLCP header, then the
+	 * MAC overhead and the packet at the data rate, rounded up to the
+	 * microsecond as the 802.11b PHY does
+	 * \param size the size of the packet (bytes)
+	 * \return the airtime
+	 */
+	Time GetAirtime (uint32_t size) const;
+
+	/**
+	 * \brief Get the size on air of a frame
+	 * \param size the size of the packet (bytes)
+	 * \return the size of the frame, with the MAC overhead (bytes)
+	 */
+	uint32_t GetFrameSize (uint32_t size) const;
+
+	/**
+	 * \brief Get the packet error rate of a frame
+	 * \param sinrDb the SINR of the frame (dB)
+	 * \param frameSize the size of the frame (bytes)
+	 * \return the packet error rate
+	 */
+	double GetPer (double sinrDb, uint32_t frameSize) const;
+
+	/**
+	 * \brief Get the noise power at the receivers
+	 * \return the noise power (W)
+	 */
+	double GetNoiseW (void) const;
+
+	/**
+	 * \brief Get the power below which a frame is not received
+	 * \return the energy detection threshold (dBm)
+	 */
+	double GetEnergyDetectionThreshold (void) const;
+
+	/**
+	 * \brief Get the power of the frames on air above which the medium
+	 * is busy
+	 * \return the CCA threshold (dBm)
+	 */
+	double GetCcaThreshold (void) const;
+
+	/**
+	 * \brief Draw a uniform number in [0, 1), for the reception of a frame
+	 * and the backoff of a transmission
+	 * \return the number drawn
+	 */
+	double GetUniform (void) const;
+
+	/**
+	 * \brief Read the PER table from a file: one "SINR (dB) PER" pair per
+	 * line, in increasing SINR, for frames of TableFrameSize bytes; the
+	 * lines starting with '#' are comments
+	 * \param filename the name of the file
+	 * \return false if the file could not be read
+	 */
+	bool LoadPerTable (std::string filename);
+
+	/**
+	 * \brief Write the PER table in the format of LoadPerTable
+	 * \param os the output stream
+	 * \return none
+	 */
+	void PrintPerTable (std::ostream &os) const;
+
+private:
+	/**
+	 * \brief Sample the PER table from the DSSS error rate model of the
+	 * data rate: PLCP header at 1 Mbps, frame of TableFrameSize bytes
+	 * \return none
+	 */
+	void MakePerTable (void);
+
+	// inherited from Object
+	virtual void DoInitialize (void);
+	virtual void DoDispose (void);
+
+	std::vector<Ptr<SinrTableNetDevice> >	m_devices;
+	Ptr<PropagationLossModel>	m_loss;
+	Ptr<PropagationDelayModel>	m_delay;
+	Ptr<UniformRandomVariable>	m_random;
+
+	// frame format and rate
+	DataRate	m_dataRate;
+	Time	m_preamble;
+	uint32_t	m_overhead;
+
+	// receivers
+	double	m_noiseFigure;
+	double	m_bandwidth;
+	double	m_edThreshold;
+	double	m_ccaThreshold;
+	double	m_interferenceThreshold;
+
+	// PER of a frame of m_tableFrameSize bytes, sampled at increasing SINR (dB)
+	std::string	m_tableFile;
+	uint32_t	m_tableFrameSize;
+	std::vector<double>	m_tableSinr;
+	std::vector<double>	m_tablePer;
+};
+
+} // namespace ns3
+
+#endif /* SINRTABLECHANNEL_H */
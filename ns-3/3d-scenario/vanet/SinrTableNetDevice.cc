@@ -0,0 +1,540 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 Università di Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+
+#include "SinrTableNetDevice.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SinrTableNetDevice");
+
+NS_OBJECT_ENSURE_REGISTERED (SinrTableNetDevice);
+
+TypeId
+SinrTableNetDevice::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::SinrTableNetDevice")
+    .SetParent<NetDevice> ()
+    .SetGroupName ("Network")
+    .AddConstructor<SinrTableNetDevice> ()
+    .AddAttribute ("TxPower",
+                   "The transmission power (dBm).",
+                   DoubleValue (16.0206),
+                   MakeDoubleAccessor (&SinrTableNetDevice::m_txPowerDbm),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("Collisions",
+                   "Enable the collision model: interference, half duplex and "
+                   "carrier sense.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&SinrTableNetDevice::m_collisions),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Slot",
+                   "The duration of a backoff slot.",
+                   TimeValue (MicroSeconds (20)),
+                   MakeTimeAccessor (&SinrTableNetDevice::m_slot),
+                   MakeTimeChecker ())
+    .AddAttribute ("Difs",
+                   "The time the medium must be idle before a transmission.",
+                   TimeValue (MicroSeconds (50)),
+                   MakeTimeAccessor (&SinrTableNetDevice::m_difs),
+                   MakeTimeChecker ())
+    .AddAttribute ("ContentionWindow",
+                   "The backoff, in slots, is drawn in [0, ContentionWindow].",
+                   UintegerValue (31),
+                   MakeUintegerAccessor (&SinrTableNetDevice::m_cw),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxQueueSize",
+                   "The number of packets that can wait for the medium.",
+                   UintegerValue (500),
+                   MakeUintegerAccessor (&SinrTableNetDevice::m_maxQueue),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("Mtu",
+                   "The MAC-level Maximum Transmission Unit.",
+                   UintegerValue (2296),
+                   MakeUintegerAccessor (&SinrTableNetDevice::SetMtu,
+                                         &SinrTableNetDevice::GetMtu),
+                   MakeUintegerChecker<uint16_t> (1));
+
+  return tid;
+}
+
+SinrTableNetDevice::SinrTableNetDevice ()
+	:	m_ifIndex (0),
+		m_mtu (2296),
+		m_txPowerDbm (16.0206),
+		m_collisions (true),
+		m_cw (31),
+		m_maxQueue (500),
+		m_backoffPending (false),
+		m_backoffSlots (0),
+		m_counting (false),
+		m_receiving (false),
+		m_rxProtocol (0),
+		m_rxPowerW (0),
+		m_rxInterferenceW (0),
+		m_nReceived (0),
+		m_nErrors (0),
+		m_nCollisions (0)
+{
+	NS_LOG_FUNCTION (this);
+}
+
+SinrTableNetDevice::~SinrTableNetDevice ()
+{
+	NS_LOG_FUNCTION (this);
+}
+
+void
+SinrTableNetDevice::DoDispose (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	m_accessEvent.Cancel ();
+	m_rxEvent.Cancel ();
+	m_queue.clear ();
+	m_rxPacket = 0;
+	m_channel = 0;
+	m_node = 0;
+
+	NetDevice::DoDispose ();
+}
+
+void
+SinrTableNetDevice::SetChannel (Ptr<SinrTableChannel> channel)
+{
+	NS_LOG_FUNCTION (this << channel);
+
+	m_channel = channel;
+	m_channel->Add (this);
+}
+
+void
+SinrTableNetDevice::StartReceive (Ptr<Packet> packet, uint16_t protocol, Mac48Address from,
+																	double rxPowerDbm, Time duration)
+{
+	NS_LOG_FUNCTION (this << packet << protocol << from << rxPowerDbm << duration);
+
+	Time now = Simulator::Now ();
+	double powerW = std::pow (10.0, (rxPowerDbm - 30) / 10.0);
+	bool detected = (rxPowerDbm >= m_channel->GetEnergyDetectionThreshold ());
+
+	if (!m_collisions)
+	{
+		if (detected)
+		{
+			double sinrDb = 10 * std::log10 (powerW / m_channel->GetNoiseW ());
+			Simulator::Schedule (duration, &SinrTableNetDevice::Deliver, this, packet, protocol, from, sinrDb);
+		}
+		return;
+	}
+
+	// frames on air, before this one (the ended ones are forgotten)
+	GetBusyEnd ();
+	double interferenceW = 0;
+	for (std::vector<Signal>::const_iterator i = m_signals.begin (); i != m_signals.end (); ++i)
+		interferenceW += i->powerW;
+
+	Signal signal;
+	signal.end = now + duration;
+	signal.powerW = powerW;
+	m_signals.push_back (signal);
+
+	if (m_receiving)
+	{
+		// interferes with the frame being received
+		m_rxInterferenceW += powerW;
+		if (detected)
+			m_nCollisions++;
+	}
+	else if (detected && now < m_txEnd)
+	{
+		// half duplex
+		m_nCollisions++;
+	}
+	else if (detected)
+	{
+		m_receiving = true;
+		m_rxEnd = signal.end;
+		m_rxPacket = packet;
+		m_rxProtocol = protocol;
+		m_rxFrom = from;
+		m_rxPowerW = powerW;
+		m_rxInterferenceW = interferenceW;
+		m_rxEvent = Simulator::Schedule (duration, &SinrTableNetDevice::EndReceive, this);
+	}
+
+	// the medium may have become busy
+	if (GetBusyEnd () > now && m_counting)
+		FreezeAccess ();
+}
+
+void
+SinrTableNetDevice::EndReceive (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<Packet> packet = m_rxPacket;
+	m_receiving = false;
+	m_rxPacket = 0;
+
+	double sinrDb = 10 * std::log10 (m_rxPowerW / (m_channel->GetNoiseW () + m_rxInterferenceW));
+	Deliver (packet, m_rxProtocol, m_rxFrom, sinrDb);
+}
+
+void
+SinrTableNetDevice::Deliver (Ptr<Packet> packet, uint16_t protocol, Mac48Address from, double sinrDb)
+{
+	NS_LOG_FUNCTION (this << packet << protocol << from << sinrDb);
+
+	double per = m_channel->GetPer (sinrDb, m_channel->GetFrameSize (packet->GetSize ()));
+	if (m_channel->GetUniform () < per)
+	{
+		NS_LOG_DEBUG ("Frame from " << from << " lost, SINR " << sinrDb << " dB, PER " << per << ".");
+		m_nErrors++;
+		return;
+	}
+
+	m_nReceived++;
+
+	if (!m_promiscCallback.IsNull ())
+		m_promiscCallback (this, packet, protocol, from, GetBroadcast (), NetDevice::PACKET_BROADCAST);
+	m_rxCallback (this, packet, protocol, from);
+}
+
+Time
+SinrTableNetDevice::GetBusyEnd (void)
+{
+	Time now = Simulator::Now ();
+	Time busyEnd = std::max (now, m_txEnd);
+	if (!m_collisions)
+		return busyEnd;
+
+	std::vector<Signal>::iterator end = std::remove_if (m_signals.begin (), m_signals.end (),
+																											[now] (const Signal &s) { return s.end <= now; });
+	m_signals.erase (end, m_signals.end ());
+
+	if (m_receiving)
+		busyEnd = std::max (busyEnd, m_rxEnd);
+
+	// the frames on air keep the medium busy until their power, together,
+	// falls below the CCA threshold
+	std::vector<Signal> signals (m_signals);
+	std::sort (signals.begin (), signals.end (), [] (const Signal &a, const Signal &b) { return a.end < b.end; });
+	double ccaW = std::pow (10.0, (m_channel->GetCcaThreshold () - 30) / 10.0);
+	double totalW = 0;
+	for (std::vector<Signal>::const_iterator i = signals.begin (); i != signals.end (); ++i)
+		totalW += i->powerW;
+	for (std::vector<Signal>::const_iterator i = signals.begin (); i != signals.end () && totalW >= ccaW; ++i)
+	{
+		busyEnd = std::max (busyEnd, i->end);
+		totalW -= i->powerW;
+	}
+
+	if (busyEnd > now)
+		m_idleStart = busyEnd;
+
+	return busyEnd;
+}
+
+void
+SinrTableNetDevice::DrawBackoff (void)
+{
+	m_backoffSlots = (uint32_t) std::floor (m_channel->GetUniform () * (m_cw + 1));
+	m_backoffPending = true;
+}
+
+void
+SinrTableNetDevice::StartAccess (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	Time now = Simulator::Now ();
+	m_counting = false;
+
+	// without the collision model, only the own transmission delays the next one
+	if (!m_collisions)
+	{
+		m_accessEvent = Simulator::Schedule (GetBusyEnd () - now, &SinrTableNetDevice::Access, this);
+		return;
+	}
+
+	// busy: a backoff, if none is pending, counted down once the medium is idle
+	Time busyEnd = GetBusyEnd ();
+	if (busyEnd > now)
+	{
+		if (!m_backoffPending)
+			DrawBackoff ();
+		m_accessEvent = Simulator::Schedule (busyEnd - now, &SinrTableNetDevice::StartAccess, this);
+		return;
+	}
+
+	// idle: the slots left are counted down after a DIFS of idle medium
+	m_counting = true;
+	m_countdownStart = std::max (m_idleStart + m_difs, now);
+	uint32_t slots = m_backoffPending ? m_backoffSlots : 0;
+	Time wait = m_countdownStart - now + NanoSeconds (m_slot.GetNanoSeconds () * (int64_t) slots);
+	m_accessEvent = Simulator::Schedule (wait, &SinrTableNetDevice::Access, this);
+}
+
+void
+SinrTableNetDevice::FreezeAccess (void)
+{
+	NS_LOG_FUNCTION (this);
+	NS_ASSERT (m_counting);
+
+	// the slots that went by before the medium got busy
+	Time now = Simulator::Now ();
+	if (m_backoffPending && now > m_countdownStart)
+	{
+		uint32_t elapsed = (uint32_t) ((now - m_countdownStart).GetNanoSeconds () / m_slot.GetNanoSeconds ());
+		m_backoffSlots -= std::min (elapsed, m_backoffSlots);
+	}
+
+	m_accessEvent.Cancel ();
+	StartAccess ();
+}
+
+void
+SinrTableNetDevice::Access (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	m_counting = false;
+	m_backoffPending = false;
+
+	// the post-transmission backoff is over, nothing to send
+	if (m_queue.empty ())
+		return;
+
+	Ptr<Packet> packet = m_queue.front ().first;
+	uint16_t protocol = m_queue.front ().second;
+	m_queue.pop_front ();
+
+	Time duration = m_channel->GetAirtime (packet->GetSize ());
+	m_txEnd = Simulator::Now () + duration;
+	m_idleStart = std::max (m_idleStart, m_txEnd);
+
+	m_channel->Send (this, packet, protocol, m_txPowerDbm, duration);
+	Simulator::Schedule (duration, &SinrTableNetDevice::EndTransmit, this);
+}
+
+void
+SinrTableNetDevice::EndTransmit (void)
+{
+	NS_LOG_FUNCTION (this);
+
+	if (m_collisions)
+	{
+		// the backoff that follows every transmission
+		DrawBackoff ();
+		StartAccess ();
+	}
+	else if (!m_queue.empty ())
+		StartAccess ();
+}
+
+uint64_t
+SinrTableNetDevice::GetNReceived (void) const
+{
+	return m_nReceived;
+}
+
+uint64_t
+SinrTableNetDevice::GetNErrors (void) const
+{
+	return m_nErrors;
+}
+
+uint64_t
+SinrTableNetDevice::GetNCollisions (void) const
+{
+	return m_nCollisions;
+}
+
+void
+SinrTableNetDevice::SetIfIndex (const uint32_t index)
+{
+	m_ifIndex = index;
+}
+
+uint32_t
+SinrTableNetDevice::GetIfIndex (void) const
+{
+	return m_ifIndex;
+}
+
+Ptr<Channel>
+SinrTableNetDevice::GetChannel (void) const
+{
+	return m_channel;
+}
+
+void
+SinrTableNetDevice::SetAddress (Address address)
+{
+	m_address = Mac48Address::ConvertFrom (address);
+}
+
+Address
+SinrTableNetDevice::GetAddress (void) const
+{
+	return m_address;
+}
+
+bool
+SinrTableNetDevice::SetMtu (const uint16_t mtu)
+{
+	m_mtu = mtu;
+	return true;
+}
+
+uint16_t
+SinrTableNetDevice::GetMtu (void) const
+{
+	return m_mtu;
+}
+
+bool
+SinrTableNetDevice::IsLinkUp (void) const
+{
+	return m_channel != 0;
+}
+
+void
+SinrTableNetDevice::AddLinkChangeCallback (Callback<void> callback)
+{
+	// the link never changes
+}
+
+bool
+SinrTableNetDevice::IsBroadcast (void) const
+{
+	return true;
+}
+
+Address
+SinrTableNetDevice::GetBroadcast (void) const
+{
+	return Mac48Address::GetBroadcast ();
+}
+
+bool
+SinrTableNetDevice::IsMulticast (void) const
+{
+	return true;
+}
+
+Address
+SinrTableNetDevice::GetMulticast (Ipv4Address multicastGroup) const
+{
+	return Mac48Address::GetMulticast (multicastGroup);
+}
+
+Address
+SinrTableNetDevice::GetMulticast (Ipv6Address addr) const
+{
+	return Mac48Address::GetMulticast (addr);
+}
+
+bool
+SinrTableNetDevice::IsBridge (void) const
+{
+	return false;
+}
+
+bool
+SinrTableNetDevice::IsPointToPoint (void) const
+{
+	return false;
+}
+
+bool
+SinrTableNetDevice::Send (Ptr<Packet> packet, const Address& dest, uint16_t protocolNumber)
+{
+	NS_LOG_FUNCTION (this << packet << dest << protocolNumber);
+	NS_ASSERT (m_channel != 0);
+
+	if (m_queue.size () >= m_maxQueue)
+	{
+		NS_LOG_DEBUG ("Queue full, packet dropped.");
+		return false;
+	}
+
+	m_queue.push_back (std::make_pair (packet, protocolNumber));
+
+	// otherwise, the queue is served at the end of the transmission or of the wait
+	if (!m_accessEvent.IsRunning () && Simulator::Now () >= m_txEnd)
+		StartAccess ();
+
+	return true;
+}
+
+bool
+SinrTableNetDevice::SendFrom (Ptr<Packet> packet, const Address& source, const Address& dest, uint16_t protocolNumber)
+{
+	NS_FATAL_ERROR ("SinrTableNetDevice does not support SendFrom.");
+	return false;
+}
+
+Ptr<Node>
+SinrTableNetDevice::GetNode (void) const
+{
+	return m_node;
+}
+
+void
+SinrTableNetDevice::SetNode (Ptr<Node> node)
+{
+	m_node = node;
+}
+
+bool
+SinrTableNetDevice::NeedsArp (void) const
+{
+	// every frame is a broadcast
+	return false;
+}
+
+void
+SinrTableNetDevice::SetReceiveCallback (NetDevice::ReceiveCallback cb)
+{
+	m_rxCallback = cb;
+}
+
+void
+SinrTableNetDevice::SetPromiscReceiveCallback (PromiscReceiveCallback cb)
+{
+	m_promiscCallback = cb;
+}
+
+bool
+SinrTableNetDevice::SupportsSendFrom (void) const
+{
+	return false;
+}
+
+} // namespace ns3
@@ -0,0 +1,256 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 Università di Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ */
+
+#ifndef SINRTABLENETDEVICE_H
+#define SINRTABLENETDEVICE_H
+
+#include <deque>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/net-device.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/mac48-address.h"
+
+#include "SinrTableChannel.h"
+
+
+namespace ns3 {
+
+/**
+ * \ingroup network
+ * \brief A broadcast device, cheaper than the 802.11b PHY and MAC, for the
+ * experiments that sweep many parameters: every frame is sent to all the
+ * devices of the channel.
+ *
+ * A frame is received when its power is above the energy detection
+ * threshold and a draw against the PER of its SINR succeeds (see
+ * SinrTableChannel). With the collision model, a frame is lost when it
+ * arrives while the device is transmitting or receiving another one, the
+ * interference is the power of every frame on air during the reception
+ * (their sum, so an upper bound), and the medium is busy while the device
+ * transmits or receives, or the frames on air exceed the CCA threshold
+ * together. The transmissions follow the DCF for broadcasts: a frame
+ * finding the medium idle for a DIFS is sent at once, otherwise after a
+ * random backoff, counted down only while the medium has been idle for a
+ * DIFS and frozen while it is busy; each transmission is followed by a
+ * new backoff. Without it, the SINR is the SNR and a device only waits
+ * for the end of its own transmission.
+ */
+class SinrTableNetDevice : public NetDevice
+{
+public:
+	static TypeId GetTypeId (void);
+
+	/**
+	 * \brief Constructor
+	 * \return none
+	 */
+	SinrTableNetDevice ();
+
+	/**
+	 * \brief Destructor
+	 * \return none
+	 */
+	virtual ~SinrTableNetDevice ();
+
+	/**
+	 * \brief Attach this device to a channel
+	 * \param channel the channel
+	 * \return none
+	 */
+	void SetChannel (Ptr<SinrTableChannel> channel);
+
+	/**
+	 * \brief Start the reception of a frame (called by the channel)
+	 * \param packet the packet
+	 * \param protocol the protocol number of the packet
+	 * \param from the address of the transmitter
+	 * \param rxPowerDbm the received power (dBm)
+	 * \param duration the airtime of the frame
+	 * \return none
+	 */
+	void StartReceive (Ptr<Packet> packet, uint16_t protocol, Mac48Address from,
+										 double rxPowerDbm, Time duration);
+
+	/**
+	 * \brief Get the number of frames received
+	 * \return the number of frames
+	 */
+	uint64_t GetNReceived (void) const;
+
+	/**
+	 * \brief Get the number of frames lost because of the draw against the PER
+	 * \return the number of frames
+	 */
+	uint64_t GetNErrors (void) const;
+
+	/**
+	 * \brief Get the number of frames lost because they arrived while this
+	 * device was transmitting or receiving another frame
+	 * \return the number of frames
+	 */
+	uint64_t GetNCollisions (void) const;
+
+	// inherited from NetDevice
+	virtual void SetIfIndex (const uint32_t index);
+	virtual uint32_t GetIfIndex (void) const;
+	virtual Ptr<Channel> GetChannel (void) const;
+	virtual void SetAddress (Address address);
+	virtual Address GetAddress (void) const;
+	virtual bool SetMtu (const uint16_t mtu);
+	virtual uint16_t GetMtu (void) const;
+	virtual bool IsLinkUp (void) const;
+	virtual void AddLinkChangeCallback (Callback<void> callback);
+	virtual bool IsBroadcast (void) const;
+	virtual Address GetBroadcast (void) const;
+	virtual bool IsMulticast (void) const;
+	virtual Address GetMulticast (Ipv4Address multicastGroup) const;
+	virtual Address GetMulticast (Ipv6Address addr) const;
+	virtual bool IsBridge (void) const;
+	virtual bool IsPointToPoint (void) const;
+	virtual bool Send (Ptr<Packet> packet, const Address& dest, uint16_t protocolNumber);
+	virtual bool SendFrom (Ptr<Packet> packet, const Address& source, const Address& dest, uint16_t protocolNumber);
+	virtual Ptr<Node> GetNode (void) const;
+	virtual void SetNode (Ptr<Node> node);
+	virtual bool NeedsArp (void) const;
+	virtual void SetReceiveCallback (NetDevice::ReceiveCallback cb);
+	virtual void SetPromiscReceiveCallback (PromiscReceiveCallback cb);
+	virtual bool SupportsSendFrom (void) const;
+
+private:
+	/**
+	 * \brief A frame on air at this device
+	 */
+	struct Signal
+	{
+		Time	end;
+		double	powerW;
+	};
+
+	/**
+	 * \brief End the reception of the current frame (with the collision model)
+	 * \return none
+	 */
+	void EndReceive (void);
+
+	/**
+	 * \brief Draw against the PER of a frame, and forward it up if received
+	 * \param packet the packet
+	 * \param protocol the protocol number of the packet
+	 * \param from the address of the transmitter
+	 * \param sinrDb the SINR of the frame (dB)
+	 * \return none
+	 */
+	void Deliver (Ptr<Packet> packet, uint16_t protocol, Mac48Address from, double sinrDb);
+
+	/**
+	 * \brief Wait for the medium to be idle for a DIFS, then count down the
+	 * pending backoff (none if the medium was idle when the access started)
+	 * \return none
+	 */
+	void StartAccess (void);
+
+	/**
+	 * \brief Freeze the countdown of the backoff, the medium being busy, and
+	 * resume the access once it is idle again
+	 * \return none
+	 */
+	void FreezeAccess (void);
+
+	/**
+	 * \brief Draw the slots of a new backoff in [0, ContentionWindow]
+	 * \return none
+	 */
+	void DrawBackoff (void);
+
+	/**
+	 * \brief End the countdown: transmit the first queued packet, if any
+	 * (the countdown of a post-transmission backoff may end with none)
+	 * \return none
+	 */
+	void Access (void);
+
+	/**
+	 * \brief End the current transmission, and start the post-transmission
+	 * backoff
+	 * \return none
+	 */
+	void EndTransmit (void);
+
+	/**
+	 * \brief Get the time at which the medium becomes idle, as sensed by
+	 * this device with the frames on air now; forget the frames ended, and
+	 * keep the time in m_idleStart
+	 * \return the time (now if idle)
+	 */
+	Time GetBusyEnd (void);
+
+	// inherited from Object
+	virtual void DoDispose (void);
+
+	Ptr<SinrTableChannel>	m_channel;
+	Ptr<Node>	m_node;
+	Mac48Address	m_address;
+	uint32_t	m_ifIndex;
+	uint16_t	m_mtu;
+	NetDevice::ReceiveCallback	m_rxCallback;
+	NetDevice::PromiscReceiveCallback	m_promiscCallback;
+
+	double	m_txPowerDbm;
+	bool	m_collisions;
+	Time	m_slot;
+	Time	m_difs;
+	uint32_t	m_cw;
+
+	// packets waiting for the medium, with their protocol numbers
+	uint32_t	m_maxQueue;
+	std::deque<std::pair<Ptr<Packet>, uint16_t> >	m_queue;
+	EventId	m_accessEvent;
+	Time	m_txEnd;
+
+	// backoff: slots left, whether they are being counted down (from
+	// m_countdownStart), and when the medium last became idle
+	bool	m_backoffPending;
+	uint32_t	m_backoffSlots;
+	bool	m_counting;
+	Time	m_countdownStart;
+	Time	m_idleStart;
+
+	// frames on air (with the collision model) and frame being received
+	std::vector<Signal>	m_signals;
+	bool	m_receiving;
+	Time	m_rxEnd;
+	EventId	m_rxEvent;
+	Ptr<Packet>	m_rxPacket;
+	uint16_t	m_rxProtocol;
+	Mac48Address	m_rxFrom;
+	double	m_rxPowerW;
+	double	m_rxInterferenceW;
+
+	uint64_t	m_nReceived;
+	uint64_t	m_nErrors;
+	uint64_t	m_nCollisions;
+};
+
+} // namespace ns3
+
+#endif /* SINRTABLENETDEVICE_H */
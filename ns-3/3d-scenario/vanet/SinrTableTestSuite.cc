@@ -0,0 +1,164 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 Università di Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ */
+
+#include <cmath>
+#include <fstream>
+
+#include "ns3/test.h"
+#include "ns3/data-rate.h"
+#include "ns3/dsss-error-rate-model.h"
+
+#include "SinrTableChannel.h"
+
+// the tests of the SINR table are built with fb-vanet-3d, and run with
+// fb-vanet-3d --test (see main)
+using namespace ns3;
+
+/**
+ * \brief The airtime of the frames, as the 802.11b PHY with the long preamble
+ */
+class SinrTableAirtimeTestCase : public TestCase
+{
+public:
+	SinrTableAirtimeTestCase ();
+	virtual ~SinrTableAirtimeTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+SinrTableAirtimeTestCase::SinrTableAirtimeTestCase ()
+	: TestCase ("Airtime of the frames of the SINR table channel")
+{
+}
+
+SinrTableAirtimeTestCase::~SinrTableAirtimeTestCase ()
+{
+}
+
+void
+SinrTableAirtimeTestCase::DoRun (void)
+{
+	Ptr<SinrTableChannel> channel = CreateObject<SinrTableChannel> ();
+	NS_TEST_ASSERT_MSG_EQ (channel->GetFrameSize (100), 136, "Wrong MAC overhead");
+
+	// 192 us of preamble and PLCP header, then 1088 bits at 11 Mbps
+	NS_TEST_ASSERT_MSG_EQ (channel->GetAirtime (100), MicroSeconds (192 + 99), "Wrong airtime at 11 Mbps");
+	NS_TEST_ASSERT_MSG_EQ (channel->GetAirtime (0), MicroSeconds (192 + 27), "Wrong airtime of an empty packet");
+
+	channel->SetAttribute ("DataRate", DataRateValue (DataRate ("1Mbps")));
+	NS_TEST_ASSERT_MSG_EQ (channel->GetAirtime (100), MicroSeconds (192 + 1088), "Wrong airtime at 1 Mbps");
+
+	channel->SetAttribute ("DataRate", DataRateValue (DataRate ("5.5Mbps")));
+	NS_TEST_ASSERT_MSG_EQ (channel->GetAirtime (1000), MicroSeconds (192 + 1507), "Wrong airtime at 5.5 Mbps");
+}
+
+/**
+ * \brief The PER of the table, read from a file or sampled from the DSSS
+ * error rate model
+ */
+class SinrTablePerTestCase : public TestCase
+{
+public:
+	SinrTablePerTestCase ();
+	virtual ~SinrTablePerTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+SinrTablePerTestCase::SinrTablePerTestCase ()
+	: TestCase ("PER of the SINR table channel")
+{
+}
+
+SinrTablePerTestCase::~SinrTablePerTestCase ()
+{
+}
+
+void
+SinrTablePerTestCase::DoRun (void)
+{
+	// a table read from a file: interpolated, clamped at the ends, and
+	// scaled with the size of the frame
+	std::string filename = CreateTempDirFilename ("per.txt");
+	std::ofstream table (filename.c_str ());
+	table << "# SINR (dB)  PER" << std::endl << "0 1" << std::endl << "10 0.5" << std::endl << "20 0" << std::endl;
+	table.close ();
+
+	Ptr<SinrTableChannel> channel = CreateObject<SinrTableChannel> ();
+	channel->SetAttribute ("TableFile", StringValue (filename));
+	channel->Initialize ();
+	NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetPer (5, 128), 0.75, 1e-12, "Wrong interpolation");
+	NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetPer (-5, 128), 1, 1e-12, "Wrong PER below the table");
+	NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetPer (25, 128), 0, 1e-12, "Wrong PER above the table");
+	NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetPer (10, 256), 0.75, 1e-12, "Wrong PER of a frame twice as long");
+	NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetPer (10, 64), 1 - std::sqrt (0.5), 1e-12, "Wrong PER of a frame half as long");
+
+	// invalid tables are rejected
+	table.open (filename.c_str ());
+	table << "0 1" << std::endl << "10 0.5" << std::endl << "5 0" << std::endl;
+	table.close ();
+	NS_TEST_ASSERT_MSG_EQ (channel->LoadPerTable (filename), false, "Table with decreasing SINR accepted");
+	table.open (filename.c_str ());
+	table << "0 1.5" << std::endl;
+	table.close ();
+	NS_TEST_ASSERT_MSG_EQ (channel->LoadPerTable (filename), false, "Table with a PER above 1 accepted");
+	NS_TEST_ASSERT_MSG_EQ_TOL (channel->GetPer (5, 128), 0.75, 1e-12, "Table changed by an invalid file");
+
+	// the default table: the DSSS error rate model at its samples, PLCP
+	// header at 1 Mbps and frame at 11 Mbps, decreasing with the SINR
+	Ptr<SinrTableChannel> dsss = CreateObject<SinrTableChannel> ();
+	dsss->Initialize ();
+	for (double sinrDb = -10; sinrDb <= 30; sinrDb += 2.5)
+		{
+			double sinr = std::pow (10.0, sinrDb / 10.0);
+			double success = DsssErrorRateModel::GetDsssDbpskSuccessRate (sinr, 48)
+				* DsssErrorRateModel::GetDsssDqpskCck11SuccessRate (sinr, 128 * 8);
+			NS_TEST_ASSERT_MSG_EQ_TOL (dsss->GetPer (sinrDb, 128), 1 - success, 1e-9, "Wrong PER at " << sinrDb << " dB");
+		}
+	double previous = 1;
+	for (double sinrDb = -10; sinrDb <= 30; sinrDb += 0.1)
+		{
+			double per = dsss->GetPer (sinrDb, 128);
+			NS_TEST_ASSERT_MSG_EQ ((per <= previous + 1e-12), true, "PER increasing at " << sinrDb << " dB");
+			previous = per;
+		}
+	NS_TEST_ASSERT_MSG_GT (dsss->GetPer (0, 128), 0.99, "Frames received at 0 dB");
+	NS_TEST_ASSERT_MSG_LT (dsss->GetPer (20, 128), 0.01, "Frames lost at 20 dB");
+}
+
+/**
+ * \brief The tests of the SINR table channel
+ */
+class SinrTableTestSuite : public TestSuite
+{
+public:
+	SinrTableTestSuite ();
+};
+
+SinrTableTestSuite::SinrTableTestSuite ()
+	: TestSuite ("sinr-table", UNIT)
+{
+	AddTestCase (new SinrTableAirtimeTestCase, TestCase::QUICK);
+	AddTestCase (new SinrTablePerTestCase, TestCase::QUICK);
+}
+
+static SinrTableTestSuite sinrTableTestSuite;
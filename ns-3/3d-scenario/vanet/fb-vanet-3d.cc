@@ -24,8 +24,10 @@
 * ------------------------------------------------------------------------------
 */
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <sys/time.h>
 
 #include "ns3/core-module.h"
@@ -36,10 +38,12 @@
 #include "ns3/wifi-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/topology.h"
+#include "ns3/obstacle-tile-store.h"
 #include "ns3/wifi-80211p-helper.h"
 #include "ns3/wave-mac-helper.h"
 
 #include "FBApplication.h"
+#include "SinrTableNetDevice.h"
 
 using namespace ns3;
 
@@ -241,6 +245,66 @@ CSVManager::CloseRow (void)
 
 CSVManager			g_csvData; // CSV file manager
 
+// link layers of the adhoc devices
+static const uint32_t LINK_WIFI = 0;					// 802.11b PHY and MAC
+static const uint32_t LINK_SINR_TABLE = 1;		// SinrTableNetDevice
+
+/**
+ * \brief Outputs of the runs of a link layer, compared at the end of a
+ * calibration
+ */
+struct CalibrationData
+{
+	uint32_t	runs;
+	double	coverage;			// sum of the fractions of the enabled vehicles reached
+	uint32_t	circRuns;		// runs that reached vehicles on the circumference
+	double	circCoverage;	// sum of the fractions of the vehicles on the circumference reached
+	double	latency;			// sum of the mean times (us) of the alert on the circumference
+	double	hops;					// sum of the mean hops of the alert on the circumference
+	double	wallTime;			// sum of the (wall clock) durations of the simulations (s)
+};
+
+std::map<uint32_t, CalibrationData>	g_calibrationData;	// by link layer
+
+/**
+ * \brief Print the mean outputs of the two link layers of a calibration,
+ * and the difference of those of the SINR table
+ * \param os the output stream
+ * \return none
+ */
+void
+PrintCalibration (std::ostream &os)
+{
+	if (g_calibrationData.count (LINK_WIFI) == 0 || g_calibrationData.count (LINK_SINR_TABLE) == 0)
+		return;
+
+	const CalibrationData &wifi = g_calibrationData[LINK_WIFI];
+	const CalibrationData &table = g_calibrationData[LINK_SINR_TABLE];
+	const char *names[] = { "Total vehicles coverage", "Vehicles coverage on circ",
+													"Alert received mean time (us)", "Mean hops", "Simulation time (s)" };
+	double means[2][5];
+	const CalibrationData *data[] = { &wifi, &table };
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		means[i][0] = data[i]->coverage / data[i]->runs;
+		means[i][1] = data[i]->circCoverage / data[i]->runs;
+		means[i][2] = (data[i]->circRuns > 0) ? data[i]->latency / data[i]->circRuns : 0;
+		means[i][3] = (data[i]->circRuns > 0) ? data[i]->hops / data[i]->circRuns : 0;
+		means[i][4] = data[i]->wallTime / data[i]->runs;
+	}
+
+	os << "Calibration of the SINR table over " << table.runs << " runs (802.11b, SINR table, difference):" << std::endl;
+	for (uint32_t j = 0; j < 5; j++)
+	{
+		os << "  " << names[j] << ": " << means[0][j] << ", " << means[1][j] << ", ";
+		if (means[0][j] != 0)
+			os << 100 * (means[1][j] - means[0][j]) / means[0][j] << "%";
+		else
+			os << "-";
+		os << std::endl;
+	}
+}
+
 /**
  * \ingroup obstacle
  * \brief The VanetRoutingExperiment class implements an application that
@@ -281,6 +345,28 @@ public:
 	 */
 	void ProcessOutputs ();
 
+	/**
+	 * \brief Choose the link layer of the adhoc devices, overriding the
+	 * command line (see the calibration)
+	 * \param linkLayer the link layer: LINK_WIFI or LINK_SINR_TABLE
+	 * \return none
+	 */
+	void SetLinkLayer (uint32_t linkLayer);
+
+	/**
+	 * \brief Check whether this experiment is run with both link layers
+	 * \return true in calibration mode
+	 */
+	bool IsCalibration (void) const;
+
+	/**
+	 * \brief Check whether the link layer is written in the CSV rows: only
+	 * in calibration mode or with the SINR table, so the default output
+	 * keeps its columns
+	 * \return true if the rows have the link layer column
+	 */
+	bool HasLinkLayerColumn (void) const;
+
 protected:
 	/**
 	 * \brief Process command line arguments
@@ -320,6 +406,13 @@ protected:
 	 */
 	void SetupAdhocDevices ();
 
+	/**
+	 * \brief Set up the adhoc devices as SinrTableNetDevices, on the
+	 * propagation models of the wifi channel
+	 * \return none
+	 */
+	void SetupSinrTableDevices ();
+
 	/**
 	 * \brief Configure connections
 	 * \return none
@@ -398,6 +491,8 @@ private:
 	uint32_t 													m_nSensors;
 	NodeContainer											m_adhocNodes;
 	NetDeviceContainer								m_adhocDevices;
+	Ptr<YansWifiChannel>							m_channel;
+	Ptr<SinrTableChannel>							m_sinrChannel;
 	Ipv4InterfaceContainer						m_adhocInterfaces;
 	std::vector <Ptr<Socket>>					m_adhocSources;
 	std::vector <Ptr<Socket>>					m_adhocSinks;
@@ -414,8 +509,29 @@ private:
 	uint32_t													m_areaOfInterest;
 	uint32_t													m_vehiclesDistance;
 	uint32_t													m_loadBuildings;
+	uint32_t													m_obstacleIndex;
+	uint32_t													m_engine;
+	double														m_simplify;
+	double														m_raster;
+	uint32_t													m_rasterValidation;
+	std::string												m_typeRulesFile;
+	uint32_t													m_precompute;
+	std::string												m_staticLossDir;
+	uint32_t													m_movements;
+	double														m_movementThreshold;
 	std::string												m_traceFile;
 	std::string												m_bldgFile;
+	std::string												m_compiledBldgFile;
+	uint32_t													m_tileBudget;
+	uint32_t													m_fixedSensors;
+	uint32_t													m_skipWeak;
+	uint32_t													m_staticGraph;
+	uint32_t													m_batchThreads;
+	uint32_t													m_linkLayer;
+	uint32_t													m_collisions;
+	std::string												m_perTableFile;
+	uint32_t													m_calibration;
+	double														m_wallTime;
 	uint32_t													m_nDisabled;
 	uint32_t													m_enableSensors;
 	double														m_TotalSimTime;
@@ -447,17 +563,42 @@ FBVanetExperiment::FBVanetExperiment ()
 		m_areaOfInterest (1000),
 		m_vehiclesDistance (250),
 		m_loadBuildings (0),
+		m_obstacleIndex (0),
+		m_engine (0),
+		m_simplify (0),
+		m_raster (0),
+		m_rasterValidation (0),
+		m_typeRulesFile (""),
+		m_precompute (0),
+		m_staticLossDir (""),
+		m_movements (0),
+		m_movementThreshold (0),
 		m_traceFile (""),
 		m_bldgFile (""),
+		m_compiledBldgFile (""),
+		m_tileBudget (512),
+		m_fixedSensors (0),
+		m_skipWeak (0),
+		m_staticGraph (0),
+		m_batchThreads (1),
+		m_linkLayer (LINK_WIFI),
+		m_collisions (1),
+		m_perTableFile (""),
+		m_calibration (0),
+		m_wallTime (0),
 		m_nDisabled (0),
 		m_enableSensors (0),
 		m_TotalSimTime (30),
 		m_sensorsMsgSent (0),
 		m_sensorsMsgRecv (0)
 {
-	srand (time (0));
+	// one seed for the whole process: the runs differ by their run number,
+	// and in calibration mode the two link layers of a run start from the
+	// same random numbers
+	static const uint32_t seed = time (0);
+	srand (seed + RngSeedManager::GetRun ());
 
-	RngSeedManager::SetSeed (time (0));
+	RngSeedManager::SetSeed (seed);
 }
 
 FBVanetExperiment::~FBVanetExperiment ()
@@ -486,7 +627,31 @@ FBVanetExperiment::Simulate ()
 	ConfigureApplications ();
 
 	// Run simulation and print some results
+	struct timeval start, end;
+	gettimeofday (&start, NULL);
 	RunSimulation ();
+	gettimeofday (&end, NULL);
+	m_wallTime = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+}
+
+void
+FBVanetExperiment::SetLinkLayer (uint32_t linkLayer)
+{
+	NS_LOG_FUNCTION (this << linkLayer);
+
+	m_linkLayer = linkLayer;
+}
+
+bool
+FBVanetExperiment::IsCalibration (void) const
+{
+	return m_calibration != 0;
+}
+
+bool
+FBVanetExperiment::HasLinkLayerColumn (void) const
+{
+	return m_calibration != 0 || m_linkLayer != LINK_WIFI;
 }
 
 void
@@ -536,11 +701,25 @@ FBVanetExperiment::ConfigureMobility ()
 	NS_LOG_INFO ("Loading vehicle (ns2) mobility file \"" << m_traceFile << "\".");
 
 	// Disable node movements
-	ns2.DisableNodeMovements ();
+	if (m_movements == 0)
+		ns2.DisableNodeMovements ();
 
 	// configure movements for all nodes
 	ns2.Install (ns3::NodeList::Begin(), ns3::NodeList::End());
 
+	// sensors never move: sort the obstacles around each of them
+	// once, for the radius of the obstacle shadowing model (the first
+	// run registers them, the others find them registered)
+	if (m_loadBuildings != 0 && m_fixedSensors != 0)
+	{
+		for (uint32_t id = m_nVehicles; id < m_nNodes; id++)
+		{
+			Ptr<MobilityModel> mobility = m_adhocNodes.Get (id)->GetObject<MobilityModel> ();
+			Topology::GetTopology ()->AddFixedPoint (mobility->GetPosition (), 200);
+		}
+		NS_LOG_INFO (Topology::GetTopology ()->GetNFixedPoints () << " sensors registered as fixed points.");
+	}
+
 	// Configure callback for logging
 	std::ofstream m_os;
 	Config::Connect ("/NodeList/*/$ns3::MobilityModel/CourseChange",
@@ -564,9 +743,39 @@ FBVanetExperiment::SetupAdhocDevices ()
 	wifiChannel.AddPropagationLoss ("ns3::TwoRayGroundPropagationLossModel", "Frequency", DoubleValue (freq), "HeightAboveZ", DoubleValue (1.5));
 	if (m_loadBuildings != 0)
 	{
-		wifiChannel.AddPropagationLoss ("ns3::ObstacleShadowingPropagationLossModel", "Radius", DoubleValue (200));
+		// below the lower of the energy detection and CCA thresholds, with
+		// the rx gain, a signal is neither received nor makes the medium
+		// busy (as in BuildStaticGraph); the phy keeps the defaults of all three
+		double sensitivity = -std::numeric_limits<double>::infinity ();
+		TypeId phy = TypeId::LookupByName ("ns3::YansWifiPhy");
+		TypeId::AttributeInformation ed, cca, rxGain;
+		if (m_skipWeak != 0
+				&& phy.LookupAttributeByName ("EnergyDetectionThreshold", &ed)
+				&& phy.LookupAttributeByName ("CcaMode1Threshold", &cca)
+				&& phy.LookupAttributeByName ("RxGain", &rxGain))
+			sensitivity = std::min (DynamicCast<const DoubleValue> (ed.initialValue)->Get (),
+															DynamicCast<const DoubleValue> (cca.initialValue)->Get ())
+				- DynamicCast<const DoubleValue> (rxGain.initialValue)->Get ();
+
+		Topology::Engine engine = (m_engine == 1) ? Topology::ENGINE_DOUBLE : Topology::ENGINE_EXACT;
+		if (m_raster > 0)
+			engine = Topology::ENGINE_RASTER;
+
+		// the losses between two nodes are reused only with a movement threshold
+		Config::SetDefault ("ns3::ObstacleShadowingPropagationLossModel::NodeCacheCapacity",
+												UintegerValue ((m_movementThreshold > 0) ? 65536 : 0));
+		Config::SetDefault ("ns3::ObstacleShadowingPropagationLossModel::MovementThreshold", DoubleValue (m_movementThreshold));
+
+		wifiChannel.AddPropagationLoss ("ns3::ObstacleShadowingPropagationLossModel", "Radius", DoubleValue (200),
+																		"Engine", EnumValue (engine),
+																		"PrecomputeStatic", BooleanValue (m_precompute != 0 || (m_staticGraph != 0 && m_movements == 0)),
+																		"StaticLossDirectory", StringValue (m_staticLossDir),
+																		"Sensitivity", DoubleValue (sensitivity),
+																		"BatchPerTransmission", BooleanValue (m_batchThreads != 1),
+																		"BatchThreads", UintegerValue (m_batchThreads));
 	}
-	wifiPhy.SetChannel (wifiChannel.Create ());
+	m_channel = wifiChannel.Create ();
+	wifiPhy.SetChannel (m_channel);
 	wifiPhy.SetPcapDataLinkType (YansWifiPhyHelper::DLT_IEEE802_11);
 
 	// Set Tx Power
@@ -575,6 +784,12 @@ FBVanetExperiment::SetupAdhocDevices ()
 	else if (m_actualRange == 500)
 		m_txp = 13.4;
 
+	if (m_linkLayer == LINK_SINR_TABLE)
+	{
+		SetupSinrTableDevices ();
+		return;
+	}
+
 	WifiMacHelper wifiMac;
 	wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager",
 																"DataMode",StringValue (m_phyMode),
@@ -585,6 +800,46 @@ FBVanetExperiment::SetupAdhocDevices ()
 	wifiMac.SetType ("ns3::AdhocWifiMac");
 
 	m_adhocDevices = wifi.Install (wifiPhy, wifiMac, m_adhocNodes);
+
+	// nodes never move: compute the neighbors of each node once
+	// (BuildStaticGraph is part of the Yans Wifi Channel patch, required
+	// to build the scenario)
+	if (m_staticGraph != 0 && m_movements == 0)
+	{
+		m_channel->BuildStaticGraph (m_txp);
+		NS_LOG_INFO ("Static graph: " << m_channel->GetNGraphEdges () << " links.");
+	}
+}
+
+void
+FBVanetExperiment::SetupSinrTableDevices ()
+{
+	NS_LOG_FUNCTION (this);
+	NS_LOG_INFO ("Configure SINR table devices.");
+
+	// same received powers as the wifi phys
+	PointerValue loss, delay;
+	m_channel->GetAttribute ("PropagationLossModel", loss);
+	m_channel->GetAttribute ("PropagationDelayModel", delay);
+
+	m_sinrChannel = CreateObject<SinrTableChannel> ();
+	m_sinrChannel->SetPropagationLossModel (loss.Get<PropagationLossModel> ());
+	m_sinrChannel->SetPropagationDelayModel (delay.Get<PropagationDelayModel> ());
+	m_sinrChannel->SetAttribute ("DataRate", DataRateValue (DataRate (WifiMode (m_phyMode).GetDataRate (22))));
+	m_sinrChannel->SetAttribute ("TableFile", StringValue (m_perTableFile));
+	m_sinrChannel->Initialize ();
+
+	for (uint32_t i = 0; i < m_nNodes; i++)
+	{
+		Ptr<Node> node = m_adhocNodes.Get (i);
+		Ptr<SinrTableNetDevice> device = CreateObject<SinrTableNetDevice> ();
+		device->SetAttribute ("TxPower", DoubleValue (m_txp));
+		device->SetAttribute ("Collisions", BooleanValue (m_collisions != 0));
+		device->SetAddress (Mac48Address::Allocate ());
+		device->SetChannel (m_sinrChannel);
+		node->AddDevice (device);
+		m_adhocDevices.Add (device);
+	}
 }
 
 void
@@ -726,6 +981,26 @@ FBVanetExperiment::CommandSetup (int argc, char **argv)
 	cmd.AddValue ("alertGeneration", "Time at which the first Alert Message should be generated.", m_alertGeneration);
 	cmd.AddValue ("area", "Radius of the area of interest", m_areaOfInterest);
 	cmd.AddValue ("buildings", "Load building (obstacles)", m_loadBuildings);
+	cmd.AddValue ("compiledBuildings", "Compiled buildings file, or index of a tile store (see obstacle-compile), loaded instead of the poly file", m_compiledBldgFile);
+	cmd.AddValue ("tileBudget", "Memory budget (MB) of the tiles loaded from a tile store", m_tileBudget);
+	cmd.AddValue ("skipWeak", "Skip the obstacles of the signals already below the energy detection and CCA thresholds of the receivers", m_skipWeak);
+	cmd.AddValue ("fixedSensors", "Precompute the obstacles seen by each sensor (sensors never move)", m_fixedSensors);
+	cmd.AddValue ("obstacleIndex", "Obstacle index: 0=range tree, 1=uniform grid", m_obstacleIndex);
+	cmd.AddValue ("engine", "Obstructed loss engine: 0=exact, 1=double (with obstacleIndex=1, the threads of precompute and batchThreads run concurrently), overridden by raster", m_engine);
+	cmd.AddValue ("typeRules", "Obstacle type rules file: which polygon types are buildings, and their attenuation", m_typeRulesFile);
+	cmd.AddValue ("simplify", "Tolerance of the simplification of the buildings (meters, 0 to keep them as they are)", m_simplify);
+	cmd.AddValue ("raster", "Resolution (meters) of the raster engine for the obstructed loss (approximate), 0 for the exact engine", m_raster);
+	cmd.AddValue ("rasterValidation", "Number of random segments on which the raster engine is compared with the exact one", m_rasterValidation);
+	cmd.AddValue ("precompute", "Precompute the obstructed loss between all the (static) nodes", m_precompute);
+	cmd.AddValue ("movements", "Move the vehicles as in the mobility trace (0 to keep them where they start)", m_movements);
+	cmd.AddValue ("batchThreads", "Threads computing the obstructed losses of a transmission together (0 for one per core, 1 to compute them one by one)", m_batchThreads);
+	cmd.AddValue ("staticGraph", "Deliver from neighbor lists computed once (only when vehicles do not move)", m_staticGraph);
+	cmd.AddValue ("linkLayer", "Link layer: 0=802.11b PHY and MAC, 1=SINR table (faster, for sweeps)", m_linkLayer);
+	cmd.AddValue ("collisions", "Collision model of the SINR table: interference, half duplex and carrier sense", m_collisions);
+	cmd.AddValue ("perTable", "PER table file of the SINR table (SINR in dB and PER on each line), instead of the DSSS error rate model", m_perTableFile);
+	cmd.AddValue ("calibration", "Run each run with both link layers, and compare their coverage, hops and latency", m_calibration);
+	cmd.AddValue ("movementThreshold", "Displacement (meters) within which the obstructed loss between two nodes is reused (0 to compute it at each reception)", m_movementThreshold);
+	cmd.AddValue ("lossCacheDir", "Directory where precomputed losses are saved and reused across runs", m_staticLossDir);
 	cmd.AddValue ("totalTime", "Simulation end time", m_TotalSimTime);
 
 	cmd.Parse (argc, argv);
@@ -743,7 +1018,7 @@ FBVanetExperiment::SetupScenario ()
 	m_alertGeneration = 9;	// 10 -1 (start time of the application)
 	m_TotalSimTime = 990000.0;
 	m_areaOfInterest = 400;	// meters, radius
-	m_bldgFile = "LA-1x1.3Dpoly.xml";
+	m_bldgFile = m_compiledBldgFile.empty () ? "LA-1x1.3Dpoly.xml" : m_compiledBldgFile;
 
 	m_traceFile = "LA-1x1.ns2mobility.xml";
 	m_vehiclesDistance = 50;
@@ -754,10 +1029,30 @@ FBVanetExperiment::SetupScenario ()
 
 	m_nNodes = m_nVehicles + m_nSensors;
 
-	if (m_loadBuildings != 0)
+	// the buildings are loaded by the first run, and kept by the others
+	if (m_loadBuildings != 0 && !Topology::GetTopology ()->HasObstacles ())
 	{
 		NS_LOG_INFO ("Loading buildings file \"" << m_bldgFile << "\".");
+		Topology::GetTopology ()->SetIndexType ((m_obstacleIndex == 1) ? Topology::INDEX_GRID : Topology::INDEX_RANGE_TREE);
+		if (!m_typeRulesFile.empty ())
+		{
+			ObstacleTypeRules rules;
+			if (!rules.Load (m_typeRulesFile))
+				NS_FATAL_ERROR ("Could not read the obstacle type rules file \"" << m_typeRulesFile << "\".");
+			Topology::GetTopology ()->SetTypeRules (rules);
+		}
+		Topology::GetTopology ()->SetSimplifyTolerance (m_simplify);
+		Topology::GetTopology ()->SetTileMemoryBudget ((uint64_t) m_tileBudget * 1024 * 1024);
 		Topology::LoadBuildings (m_bldgFile);
+		if (m_simplify > 0)
+			Topology::GetTopology ()->GetSimplificationReport ().Print (std::cout);
+		// the obstacles of a tile store are not rasterized
+		if (m_raster > 0 && Topology::GetTopology ()->GetTileStore () == 0)
+		{
+			Topology::GetTopology ()->MakeRaster (m_raster);
+			if (m_rasterValidation > 0)
+				Topology::GetTopology ()->ValidateRaster (m_rasterValidation, 200).Print (std::cout);
+		}
 	}
 }
 
@@ -779,6 +1074,9 @@ FBVanetExperiment::ProcessOutputs ()
 	std::stringstream dataStream;
 	m_fbApplication->PrintStats (dataStream);
 
+	if (Topology::GetTopology ()->GetTileStore () != 0)
+		Topology::GetTopology ()->GetTileStore ()->PrintStatistics (std::cout);
+
 	g_csvData.AddValue((int) RngSeedManager::GetRun ());
 	g_csvData.AddValue((int) m_actualRange);
 	g_csvData.AddValue((int) m_staticProtocol);
@@ -790,7 +1088,46 @@ FBVanetExperiment::ProcessOutputs ()
 	g_csvData.AddMultipleValues(dataStream);
 	g_csvData.AddValue((int) m_sensorsMsgSent);
 	g_csvData.AddValue((int) m_sensorsMsgRecv);
+	if (HasLinkLayerColumn ())
+		g_csvData.AddValue((int) m_linkLayer);
 	g_csvData.CloseRow ();
+
+	if (m_sinrChannel)
+	{
+		uint64_t received = 0, errors = 0, collisions = 0;
+		for (std::size_t i = 0; i < m_sinrChannel->GetNDevices (); i++)
+		{
+			Ptr<SinrTableNetDevice> device = DynamicCast<SinrTableNetDevice> (m_sinrChannel->GetDevice (i));
+			received += device->GetNReceived ();
+			errors += device->GetNErrors ();
+			collisions += device->GetNCollisions ();
+		}
+		NS_LOG_INFO ("SINR table: " << received << " frames received, " << errors << " lost (PER), "
+								 << collisions << " lost (collisions).");
+	}
+
+	if (m_calibration != 0)
+	{
+		// circCont, cover, circ, time, hops, ... (see FBApplication::PrintStats)
+		std::vector<double> values;
+		std::string value;
+		std::stringstream stats (dataStream.str ());
+		while (std::getline (stats, value, ','))
+			values.push_back (std::strtod (value.c_str (), NULL));
+		NS_ASSERT (values.size () >= 5);
+
+		CalibrationData &data = g_calibrationData[m_linkLayer];
+		data.runs++;
+		data.coverage += (m_nVehiclesEnabled > 0) ? values[1] / m_nVehiclesEnabled : 0;
+		data.circCoverage += (values[0] > 0) ? values[2] / values[0] : 0;
+		if (values[2] > 0)
+		{
+			data.circRuns++;
+			data.latency += values[3];
+			data.hops += values[4];
+		}
+		data.wallTime += m_wallTime;
+	}
 }
 
 void
@@ -890,6 +1227,13 @@ FBVanetExperiment::DummyForwarding (Ptr<Socket> socket)
 
 int main (int argc, char *argv[])
 {
+	// the tests built with the experiment (e.g. of the SINR table), with
+	// the options of the test-runner: fb-vanet-3d --test --suite=sinr-table
+	if ((argc > 1) && (std::string (argv[1]) == "--test"))
+	{
+		return TestRunner::Run (argc - 1, argv + 1);
+	}
+
 	NS_LOG_UNCOND ("FB Vanet Experiment.");
 
 	uint32_t maxRun = RngSeedManager::GetRun ();
@@ -897,7 +1241,7 @@ int main (int argc, char *argv[])
 	// Manage data storage
 	// g_csvData.EnableAlternativeFilename ("/home/mromanel/ns-3/data/fb-vanet-3d");	// cluster
 	g_csvData.EnableAlternativeFilename ("fb-vanet-3d");
-	g_csvData.WriteHeader ("\"id\",\
+	std::string header ("\"id\",\
 \"Actual Range\",\
 \"Protocol\",\
 \"Buildings\",\
@@ -920,11 +1264,25 @@ int main (int argc, char *argv[])
 	{
 		RngSeedManager::SetRun (runId);
 
+		// in calibration mode, once with each link layer
+		for (uint32_t linkLayer = LINK_WIFI; linkLayer <= LINK_SINR_TABLE; linkLayer++)
 		{
+			// the random variables of each experiment get the same streams
+			RngSeedManager::ResetNextStreamIndex ();
+
 			FBVanetExperiment experiment;
 			experiment.Configure (argc, argv);
+			if (experiment.IsCalibration ())
+				experiment.SetLinkLayer (linkLayer);
+			if (runId == 1 && linkLayer == LINK_WIFI)
+				g_csvData.WriteHeader (experiment.HasLinkLayerColumn () ? header + ",\"Link layer\"" : header);
 			experiment.Simulate ();
 			experiment.ProcessOutputs ();
+
+			if (!experiment.IsCalibration ())
+				break;
 		}
 	}
+
+	PrintCalibration (std::cout);
 }
@@ -0,0 +1,146 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+/*
+ * Compile a poly XML buildings file into the binary format that
+ * Topology::LoadBuildings maps in memory instead of parsing, e.g.
+ *
+ *   ./waf --run "obstacle-compile --input=LA-1x1.3Dpoly.xml --output=LA-1x1.3Dpoly.bin"
+ *
+ * The compiled file can then be given wherever the poly XML file was.
+ */
+
+#include <iostream>
+#include <sys/time.h>
+
+#include "ns3/core-module.h"
+#include "ns3/topology.h"
+#include "ns3/obstacle-tile-store.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("obstacle-compile");
+
+static double
+GetTime (void)
+{
+	struct timeval t;
+	gettimeofday (&t, 0);
+	return t.tv_sec + t.tv_usec * 1e-6;
+}
+
+int
+main (int argc, char *argv[])
+{
+	std::string input = "";
+	std::string output = "";
+	double cellSize = 50.0;
+	double simplify = 0.0;
+	std::string typeRules = "";
+	bool memory = false;
+	std::string tiles = "";
+	double tileSize = 500.0;
+
+	CommandLine cmd;
+	cmd.AddValue ("input", "Buildings file (poly XML) to compile", input);
+	cmd.AddValue ("output", "Compiled buildings file to write (default: input with .bin extension)", output);
+	cmd.AddValue ("cellSize", "Side of the cells of the obstacle grid index (meters)", cellSize);
+	cmd.AddValue ("typeRules", "Obstacle type rules file (see ObstacleTypeRules), default: building and unknown polygons", typeRules);
+	cmd.AddValue ("simplify", "Tolerance of the simplification of the buildings (meters, 0 to keep them as they are)", simplify);
+	cmd.AddValue ("tiles", "Directory of a tile store to write from the compiled file (empty for none)", tiles);
+	cmd.AddValue ("tileSize", "Side of the tiles of the tile store (meters)", tileSize);
+	cmd.AddValue ("memory", "Print the memory used by the buildings, parsed and loaded from the compiled file", memory);
+	cmd.Parse (argc, argv);
+
+	if (input.empty ())
+		{
+			std::cerr << "Usage: obstacle-compile --input=<file.poly.xml> [--output=<file.bin>] [--cellSize=<meters>] [--simplify=<meters>] [--typeRules=<file>] [--memory=1] [--tiles=<directory> [--tileSize=<meters>]]" << std::endl;
+			return 1;
+		}
+	if (output.empty ())
+		{
+			size_t pos = input.rfind (".xml");
+			output = ((pos != std::string::npos) ? input.substr (0, pos) : input) + ".bin";
+		}
+
+	double start = GetTime ();
+	{
+		Topology source;
+		source.SetIndexType (Topology::INDEX_GRID);
+		source.SetGridCellSize (cellSize);
+		source.SetSimplifyTolerance (simplify);
+		if (!typeRules.empty ())
+			{
+				ObstacleTypeRules rules;
+				if (!rules.Load (typeRules))
+					{
+						std::cerr << "Could not read the obstacle type rules in " << typeRules << std::endl;
+						return 1;
+					}
+				source.SetTypeRules (rules);
+			}
+		source.Load (input);
+		if (simplify > 0)
+			{
+				source.GetSimplificationReport ().Print (std::cout);
+			}
+		if (memory)
+			{
+				source.GetMemoryReport ().Print (std::cout);
+			}
+		if (!source.SaveCompiled (output))
+			{
+				std::cerr << "Could not compile " << input << " into " << output << std::endl;
+				return 1;
+			}
+	}
+	double compiled = GetTime ();
+
+	// load it back, as a simulation would
+	Topology topology;
+	topology.SetIndexType (Topology::INDEX_GRID);
+	topology.SetGridCellSize (cellSize);
+	topology.Load (output);
+	double loaded = GetTime ();
+
+	std::cout << input << " -> " << output << ": " << topology.GetNObstacles () << " obstacles" << std::endl
+						<< "compile time: " << compiled - start << " s, load time: " << loaded - compiled << " s" << std::endl;
+	if (memory)
+		{
+			topology.GetMemoryReport ().Print (std::cout);
+		}
+
+	// split the compiled file in tiles
+	if (!tiles.empty ())
+		{
+			if (!Topology::CompileTiles (output, tiles, tileSize, cellSize))
+				{
+					std::cerr << "Could not write the tile store " << tiles << std::endl;
+					return 1;
+				}
+			Topology tiled;
+			tiled.Load (ObstacleTileStore::GetIndexFilename (tiles));
+			std::cout << output << " -> " << tiles << ": " << tiled.GetTileStore ()->GetNObstacles () << " obstacles in "
+								<< tiled.GetTileStore ()->GetNTiles () << " tiles of " << tileSize << " m" << std::endl;
+		}
+
+	return 0;
+}
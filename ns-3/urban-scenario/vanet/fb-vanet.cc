@@ -391,6 +391,7 @@ private:
 	NodeContainer											m_adhocNodes;
 	Ptr<ListPositionAllocator> 				m_adhocPositionAllocator;
 	NetDeviceContainer								m_adhocDevices;
+	Ptr<YansWifiChannel>							m_channel;
 	Ipv4InterfaceContainer						m_adhocInterfaces;
 	std::vector <Ptr<Socket>>					m_adhocSources;
 	std::vector <Ptr<Socket>>					m_adhocSinks;
@@ -408,6 +409,8 @@ private:
 	uint32_t													m_vehiclesDistance;
 	uint32_t													m_scenario;
 	uint32_t													m_loadBuildings;
+	double														m_interferenceRange;
+	uint32_t													m_staticGraph;
 	std::string												m_traceFile;
 	std::string												m_bldgFile;
 	double														m_TotalSimTime;
@@ -434,6 +437,8 @@ FBVanetExperiment::FBVanetExperiment ()
 		m_vehiclesDistance (250),
 		m_scenario (1),
 		m_loadBuildings (0),
+		m_interferenceRange (0),
+		m_staticGraph (0),
 		m_traceFile (""),
 		m_bldgFile (""),
 		m_TotalSimTime (30)
@@ -545,9 +550,24 @@ FBVanetExperiment::SetupAdhocDevices ()
 	wifiChannel.AddPropagationLoss ("ns3::TwoRayGroundPropagationLossModel", "Frequency", DoubleValue (freq), "HeightAboveZ", DoubleValue (1.5));
 	if (m_loadBuildings != 0)
 	{
-		wifiChannel.AddPropagationLoss ("ns3::ObstacleShadowingPropagationLossModel", "Radius", DoubleValue (200));
+		// with the static graph, the obstructed losses between the (fixed)
+		// nodes are computed at once, on all cores (3D Obstacle Model patch)
+		TypeId::AttributeInformation info;
+		if (m_staticGraph != 0
+				&& TypeId::LookupByName ("ns3::ObstacleShadowingPropagationLossModel").LookupAttributeByName ("PrecomputeStatic", &info))
+			wifiChannel.AddPropagationLoss ("ns3::ObstacleShadowingPropagationLossModel", "Radius", DoubleValue (200),
+																			"PrecomputeStatic", BooleanValue (true));
+		else
+			wifiChannel.AddPropagationLoss ("ns3::ObstacleShadowingPropagationLossModel", "Radius", DoubleValue (200));
 	}
-	wifiPhy.SetChannel (wifiChannel.Create ());
+	m_channel = wifiChannel.Create ();
+	if (m_interferenceRange > 0)
+	{
+		// deliver transmissions only to the receivers within this distance
+		// (needs the Yans Wifi Channel patch)
+		m_channel->SetAttribute ("MaxInterferenceDistance", DoubleValue (m_interferenceRange));
+	}
+	wifiPhy.SetChannel (m_channel);
 	wifiPhy.SetPcapDataLinkType (YansWifiPhyHelper::DLT_IEEE802_11);
 
 	// Set Tx Power
@@ -566,6 +586,15 @@ FBVanetExperiment::SetupAdhocDevices ()
 	wifiMac.SetType ("ns3::AdhocWifiMac");
 
 	m_adhocDevices = wifi.Install (wifiPhy, wifiMac, m_adhocNodes);
+
+	// nodes never move (fixed ns2 mobility): compute the neighbors of
+	// each node once (BuildStaticGraph is part of the Yans Wifi Channel
+	// patch, required to build the scenario)
+	if (m_staticGraph != 0)
+	{
+		m_channel->BuildStaticGraph (m_txp);
+		NS_LOG_INFO ("Static graph: " << m_channel->GetNGraphEdges () << " links.");
+	}
 }
 
 void
@@ -659,6 +688,8 @@ FBVanetExperiment::CommandSetup (int argc, char **argv)
 	cmd.AddValue ("area", "Radius of the area of interest", m_areaOfInterest);
 	cmd.AddValue ("scenario", "1=Padova, 2=Los Angeles", m_scenario);
 	cmd.AddValue ("buildings", "Load building (obstacles)", m_loadBuildings);
+	cmd.AddValue ("staticGraph", "Deliver from neighbor lists computed once (nodes do not move)", m_staticGraph);
+	cmd.AddValue ("interferenceRange", "Maximum distance of a receiver from the sender (meters, 0=no limit)", m_interferenceRange);
 	cmd.AddValue ("trace", "Vehicles trace file (ns2mobility format)", m_traceFile);
 	cmd.AddValue ("totalTime", "Simulation end time", m_TotalSimTime);
 
@@ -707,7 +738,8 @@ FBVanetExperiment::SetupScenario ()
 	else
 		NS_LOG_ERROR ("Invalid scenario specified. Values must be [1-2].");
 
-	if (m_loadBuildings != 0)
+	// the buildings are loaded by the first run, and kept by the others
+	if (m_loadBuildings != 0 && !Topology::GetTopology ()->HasObstacles ())
 	{
 		NS_LOG_INFO ("Loading buildings file \"" << m_bldgFile << "\".");
 		Topology::LoadBuildings (m_bldgFile);
@@ -740,6 +772,12 @@ FBVanetExperiment::ProcessOutputs ()
 	g_csvData.AddValue((int) m_nNodes);
 	g_csvData.AddMultipleValues(dataStream);
 	g_csvData.CloseRow ();
+
+	// counters of the Yans Wifi Channel patch, which the scenario requires
+	NS_LOG_INFO ("Channel: " << m_channel->GetNTransmissions () << " transmissions, "
+							<< m_channel->GetNCandidates () << " candidate receivers, "
+							<< m_channel->GetNCulled () << " culled, "
+							<< m_channel->GetNDelivered () << " delivered.");
 }
 
 void
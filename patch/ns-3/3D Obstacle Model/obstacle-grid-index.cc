@@ -0,0 +1,406 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include "obstacle-grid-index.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("ObstacleGridIndex");
+
+// Liang-Barsky clipping step: restrict [t0, t1] to p * t <= q
+static bool
+ClipSegment (double p, double q, double &t0, double &t1)
+{
+	if (p == 0)
+		return q >= 0;
+
+	double t = q / p;
+	if (p < 0)
+		t0 = std::max (t0, t);
+	else
+		t1 = std::min (t1, t);
+
+	return t0 <= t1;
+}
+
+ObstacleGridIndex::ObstacleGridIndex ()
+	:	m_cellSize (0),
+		m_minX (0),
+		m_minY (0),
+		m_nx (0),
+		m_ny (0),
+		m_nItems (0),
+		m_cellStart (0),
+		m_items (0),
+		m_cellMaxHeight (0)
+{
+	NS_LOG_FUNCTION (this);
+}
+
+void
+ObstacleGridIndex::Build (std::vector<Obstacle> &obstacles, double cellSize)
+{
+	NS_LOG_FUNCTION (this << cellSize);
+	NS_ASSERT (cellSize > 0);
+
+	m_cellSize = cellSize;
+	m_nx = 0;
+	m_ny = 0;
+	m_nItems = 0;
+	m_cellStart = 0;
+	m_items = 0;
+	m_cellMaxHeight = 0;
+	m_cellStartStorage.clear ();
+	m_itemsStorage.clear ();
+	m_cellMaxHeightStorage.clear ();
+
+	if (obstacles.empty ())
+		return;
+
+	// footprint boxes, slightly enlarged so that an obstacle touching a cell
+	// border is stored on both sides (the DDA may skip a cell when the segment
+	// goes exactly through a corner)
+	std::vector<double> box (4 * obstacles.size ());
+	double minX = std::numeric_limits<double>::max ();
+	double minY = std::numeric_limits<double>::max ();
+	double maxX = -std::numeric_limits<double>::max ();
+	double maxY = -std::numeric_limits<double>::max ();
+	double eps = 1e-6 * cellSize;
+
+	for (uint32_t i = 0; i < obstacles.size (); i++)
+	{
+		const VertexList &vertices = obstacles[i].GetVertices ();
+		double bMinX = std::numeric_limits<double>::max ();
+		double bMinY = std::numeric_limits<double>::max ();
+		double bMaxX = -std::numeric_limits<double>::max ();
+		double bMaxY = -std::numeric_limits<double>::max ();
+		for (uint32_t v = 0; v < vertices.size (); v++)
+		{
+			bMinX = std::min (bMinX, vertices[v].x);
+			bMinY = std::min (bMinY, vertices[v].y);
+			bMaxX = std::max (bMaxX, vertices[v].x);
+			bMaxY = std::max (bMaxY, vertices[v].y);
+		}
+		box[4 * i] = bMinX - eps;
+		box[4 * i + 1] = bMinY - eps;
+		box[4 * i + 2] = bMaxX + eps;
+		box[4 * i + 3] = bMaxY + eps;
+
+		minX = std::min (minX, box[4 * i]);
+		minY = std::min (minY, box[4 * i + 1]);
+		maxX = std::max (maxX, box[4 * i + 2]);
+		maxY = std::max (maxY, box[4 * i + 3]);
+	}
+
+	m_minX = minX;
+	m_minY = minY;
+	m_nx = std::max (1, (int32_t) std::ceil ((maxX - minX) / cellSize));
+	m_ny = std::max (1, (int32_t) std::ceil ((maxY - minY) / cellSize));
+
+	// two passes: count the obstacles of each cell, then fill
+	std::vector<uint32_t> &cellStart = m_cellStartStorage;
+	std::vector<uint32_t> &items = m_itemsStorage;
+	std::vector<double> &cellMaxHeight = m_cellMaxHeightStorage;
+	cellStart.assign (m_nx * m_ny + 1, 0);
+	cellMaxHeight.assign (m_nx * m_ny, -std::numeric_limits<double>::infinity ());
+	for (uint32_t pass = 0; pass < 2; pass++)
+	{
+		std::vector<uint32_t> next;
+		if (pass == 1)
+		{
+			for (uint32_t c = 0; c < (uint32_t) (m_nx * m_ny); c++)
+				cellStart[c + 1] += cellStart[c];
+			items.resize (cellStart.back ());
+			next.assign (cellStart.begin (), cellStart.end () - 1);
+		}
+
+		for (uint32_t i = 0; i < obstacles.size (); i++)
+		{
+			int32_t c0 = GetColumn (box[4 * i]);
+			int32_t r0 = GetRow (box[4 * i + 1]);
+			int32_t c1 = GetColumn (box[4 * i + 2]);
+			int32_t r1 = GetRow (box[4 * i + 3]);
+			double height = (obstacles[i].GetHeight () > 0) ? obstacles[i].GetHeight ()
+				: std::numeric_limits<double>::infinity ();
+			for (int32_t r = r0; r <= r1; r++)
+			{
+				for (int32_t c = c0; c <= c1; c++)
+				{
+					uint32_t cell = r * m_nx + c;
+					if (pass == 0)
+					{
+						cellStart[cell + 1]++;
+						cellMaxHeight[cell] = std::max (cellMaxHeight[cell], height);
+					}
+					else
+						items[next[cell]++] = i;
+				}
+			}
+		}
+	}
+
+	m_nItems = items.size ();
+	m_cellStart = &cellStart[0];
+	m_items = items.empty () ? 0 : &items[0];
+	m_cellMaxHeight = &cellMaxHeight[0];
+
+	NS_LOG_INFO ("Obstacle grid: " << m_nx << "x" << m_ny << " cells of " << cellSize
+							 << " m, " << m_nItems << " entries for " << obstacles.size () << " obstacles.");
+}
+
+bool
+ObstacleGridIndex::IsBuilt () const
+{
+	return m_nx > 0;
+}
+
+double
+ObstacleGridIndex::GetCellSize () const
+{
+	return m_cellSize;
+}
+
+uint32_t
+ObstacleGridIndex::GetNCells () const
+{
+	return m_nx * m_ny;
+}
+
+int32_t
+ObstacleGridIndex::GetColumn (double x) const
+{
+	int32_t c = (int32_t) std::floor ((x - m_minX) / m_cellSize);
+	return std::min (std::max (c, 0), m_nx - 1);
+}
+
+int32_t
+ObstacleGridIndex::GetRow (double y) const
+{
+	int32_t r = (int32_t) std::floor ((y - m_minY) / m_cellSize);
+	return std::min (std::max (r, 0), m_ny - 1);
+}
+
+void
+ObstacleGridIndex::Query (double x1, double y1, double x2, double y2, std::vector<uint32_t> &out,
+													double minHeight) const
+{
+	out.clear ();
+
+	if (m_nx == 0)
+		return;
+
+	// clip the segment to the grid
+	double dx = x2 - x1;
+	double dy = y2 - y1;
+	double t0 = 0.0;
+	double t1 = 1.0;
+	double maxX = m_minX + m_nx * m_cellSize;
+	double maxY = m_minY + m_ny * m_cellSize;
+	if (!ClipSegment (-dx, x1 - m_minX, t0, t1)
+			|| !ClipSegment (dx, maxX - x1, t0, t1)
+			|| !ClipSegment (-dy, y1 - m_minY, t0, t1)
+			|| !ClipSegment (dy, maxY - y1, t0, t1))
+		return;
+
+	int32_t c = GetColumn (x1 + t0 * dx);
+	int32_t r = GetRow (y1 + t0 * dy);
+
+	// parameter of the next vertical (X) and horizontal (Y) cell border
+	const double inf = std::numeric_limits<double>::infinity ();
+	int32_t stepC = (dx > 0) ? 1 : ((dx < 0) ? -1 : 0);
+	int32_t stepR = (dy > 0) ? 1 : ((dy < 0) ? -1 : 0);
+	double tMaxX = (stepC > 0) ? (m_minX + (c + 1) * m_cellSize - x1) / dx
+		: ((stepC < 0) ? (m_minX + c * m_cellSize - x1) / dx : inf);
+	double tMaxY = (stepR > 0) ? (m_minY + (r + 1) * m_cellSize - y1) / dy
+		: ((stepR < 0) ? (m_minY + r * m_cellSize - y1) / dy : inf);
+	double tDeltaX = (stepC != 0) ? m_cellSize / std::abs (dx) : inf;
+	double tDeltaY = (stepR != 0) ? m_cellSize / std::abs (dy) : inf;
+
+	while (true)
+	{
+		uint32_t cell = r * m_nx + c;
+		if (m_cellMaxHeight[cell] > minHeight)
+			out.insert (out.end (), m_items + m_cellStart[cell], m_items + m_cellStart[cell + 1]);
+
+		// step to the next cell crossed by the segment, if any
+		if (tMaxX < tMaxY)
+		{
+			if (tMaxX > t1)
+				break;
+			c += stepC;
+			tMaxX += tDeltaX;
+		}
+		else
+		{
+			if (tMaxY > t1)
+				break;
+			r += stepR;
+			tMaxY += tDeltaY;
+		}
+
+		if (c < 0 || c >= m_nx || r < 0 || r >= m_ny)
+			break;
+	}
+
+	// an obstacle spans several cells
+	std::sort (out.begin (), out.end ());
+	out.erase (std::unique (out.begin (), out.end ()), out.end ());
+}
+
+void
+ObstacleGridIndex::QueryBox (double xmin, double ymin, double xmax, double ymax, std::vector<uint32_t> &out) const
+{
+	out.clear ();
+
+	if (m_nx == 0 || xmax < m_minX || ymax < m_minY
+			|| xmin > m_minX + m_nx * m_cellSize || ymin > m_minY + m_ny * m_cellSize)
+		return;
+
+	int32_t c0 = GetColumn (xmin);
+	int32_t r0 = GetRow (ymin);
+	int32_t c1 = GetColumn (xmax);
+	int32_t r1 = GetRow (ymax);
+	for (int32_t r = r0; r <= r1; r++)
+	{
+		for (int32_t c = c0; c <= c1; c++)
+		{
+			uint32_t cell = r * m_nx + c;
+			out.insert (out.end (), m_items + m_cellStart[cell], m_items + m_cellStart[cell + 1]);
+		}
+	}
+
+	// an obstacle spans several cells
+	std::sort (out.begin (), out.end ());
+	out.erase (std::unique (out.begin (), out.end ()), out.end ());
+}
+
+// layout of a written grid: the header, then the cell starts
+// (nx * ny + 1) and the items, each padded to 8 bytes, then the
+// maximum height of each cell (nx * ny)
+struct GridHeader
+{
+	double		cellSize;
+	double		minX;
+	double		minY;
+	int32_t		nx;
+	int32_t		ny;
+	uint32_t	nItems;
+	uint32_t	reserved;
+};
+
+static uint64_t
+PaddedSize (uint64_t n)
+{
+	return (n * sizeof (uint32_t) + 7) & ~((uint64_t) 7);
+}
+
+void
+ObstacleGridIndex::Write (std::ostream &os) const
+{
+	NS_LOG_FUNCTION (this);
+
+	GridHeader header;
+	header.cellSize = m_cellSize;
+	header.minX = m_minX;
+	header.minY = m_minY;
+	header.nx = m_nx;
+	header.ny = m_ny;
+	header.nItems = m_nItems;
+	header.reserved = 0;
+	os.write ((const char *) &header, sizeof (header));
+	if (m_nx == 0)
+		return;
+
+	const char zero[8] = {0};
+	uint64_t nCellStart = (uint64_t) m_nx * m_ny + 1;
+	os.write ((const char *) m_cellStart, nCellStart * sizeof (uint32_t));
+	os.write (zero, PaddedSize (nCellStart) - nCellStart * sizeof (uint32_t));
+	os.write ((const char *) m_items, (uint64_t) m_nItems * sizeof (uint32_t));
+	os.write (zero, PaddedSize (m_nItems) - m_nItems * sizeof (uint32_t));
+	os.write ((const char *) m_cellMaxHeight, (nCellStart - 1) * sizeof (double));
+}
+
+uint64_t
+ObstacleGridIndex::Attach (const uint8_t *data, uint64_t size, uint32_t nObstacles)
+{
+	NS_LOG_FUNCTION (this << size << nObstacles);
+
+	GridHeader header;
+	if (size < sizeof (header))
+		return 0;
+	memcpy (&header, data, sizeof (header));
+	if (header.nx < 0 || header.ny < 0 || (header.nx == 0) != (header.ny == 0)
+			|| (header.nx > 0 && !(header.cellSize > 0)))
+		return 0;
+
+	// the number of cells must fit in the data before the size of the
+	// grid is computed from it (the size could overflow)
+	uint64_t nCellStart = (header.nx == 0) ? 0 : (uint64_t) header.nx * header.ny + 1;
+	uint64_t nCells = (header.nx == 0) ? 0 : nCellStart - 1;
+	if (nCells > size / sizeof (double))
+		return 0;
+	uint64_t used = sizeof (header) + PaddedSize (nCellStart) + PaddedSize (header.nItems)
+		+ nCells * sizeof (double);
+	if (used > size)
+		return 0;
+
+	const uint32_t *cellStart = (const uint32_t *) (data + sizeof (header));
+	const uint32_t *items = (const uint32_t *) (data + sizeof (header) + PaddedSize (nCellStart));
+	const double *cellMaxHeight = (const double *) (data + sizeof (header) + PaddedSize (nCellStart)
+																									+ PaddedSize (header.nItems));
+	// the items of each cell follow those of the previous one, the last
+	// end with the items, and every item is an obstacle
+	if (nCellStart > 0 && (cellStart[0] != 0 || cellStart[nCellStart - 1] != header.nItems))
+		return 0;
+	for (uint64_t c = 0; c < nCells; c++)
+		{
+			if (cellStart[c] > cellStart[c + 1])
+				return 0;
+		}
+	for (uint32_t i = 0; i < header.nItems; i++)
+		{
+			if (items[i] >= nObstacles)
+				return 0;
+		}
+
+	m_cellStartStorage.clear ();
+	m_itemsStorage.clear ();
+	m_cellMaxHeightStorage.clear ();
+	m_cellSize = header.cellSize;
+	m_minX = header.minX;
+	m_minY = header.minY;
+	m_nx = header.nx;
+	m_ny = header.ny;
+	m_nItems = header.nItems;
+	m_cellStart = (nCellStart > 0) ? cellStart : 0;
+	m_items = (header.nItems > 0) ? items : 0;
+	m_cellMaxHeight = (nCells > 0) ? cellMaxHeight : 0;
+
+	NS_LOG_INFO ("Obstacle grid attached: " << m_nx << "x" << m_ny << " cells of " << m_cellSize
+							 << " m, " << m_nItems << " entries.");
+
+	return used;
+}
+
+} // namespace ns3
@@ -0,0 +1,167 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#ifndef OBSTACLE_GRID_INDEX_H
+#define OBSTACLE_GRID_INDEX_H
+
+#include <vector>
+#include <ostream>
+#include <limits>
+#include <stdint.h>
+#include "obstacle.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief A uniform grid over the obstacles of a topology.
+ *
+ * Each obstacle is stored in every cell covered by the bounding box of
+ * its footprint. A query walks the cells crossed by a segment
+ * (Amanatides-Woo DDA), so only the obstacles near the segment are
+ * returned, regardless of its length and direction. Each cell also
+ * keeps the height of its tallest obstacle, so that a segment passing
+ * above every roof of a cell skips it.
+ * Once built, the grid is never modified by the queries.
+ *
+ * The grid can be written to a stream and attached back, without any
+ * copy, to memory holding what was written (e.g. a mapped file).
+ */
+class ObstacleGridIndex
+{
+public:
+	/**
+	 * \brief Constructor, an empty grid
+	 */
+	ObstacleGridIndex ();
+
+	/**
+	 * \brief Build the grid
+	 * \param obstacles the obstacles, referred to by their index
+	 * \param cellSize side of a cell in meters
+	 * \return none
+	 */
+	void Build (std::vector<Obstacle> &obstacles, double cellSize);
+
+	/**
+	 * \brief Check if the grid has been built
+	 * \return true if Build has been called on at least one obstacle
+	 */
+	bool IsBuilt () const;
+
+	/**
+	 * \brief Get the side of a cell
+	 * \return the side of a cell in meters
+	 */
+	double GetCellSize () const;
+
+	/**
+	 * \brief Get the number of cells of the grid
+	 * \return the number of cells
+	 */
+	uint32_t GetNCells () const;
+
+	/**
+	 * \brief Find the obstacles whose footprint box shares
+	 * a cell with the segment from (x1,y1) to (x2,y2). The cells whose
+	 * obstacles are all not taller than minHeight are skipped: a segment
+	 * that is above minHeight passes over them
+	 * \param x1 x of the first point
+	 * \param y1 y of the first point
+	 * \param x2 x of the second point
+	 * \param y2 y of the second point
+	 * \param out indices of the obstacles found, sorted and without duplicates
+	 * \param minHeight lowest height of the segment
+	 * \return none
+	 */
+	void Query (double x1, double y1, double x2, double y2, std::vector<uint32_t> &out,
+							double minHeight = -std::numeric_limits<double>::infinity ()) const;
+
+	/**
+	 * \brief Find the obstacles whose footprint box shares a cell
+	 * with the box from (xmin,ymin) to (xmax,ymax)
+	 * \param xmin minimum x of the box
+	 * \param ymin minimum y of the box
+	 * \param xmax maximum x of the box
+	 * \param ymax maximum y of the box
+	 * \param out indices of the obstacles found, sorted and without duplicates
+	 * \return none
+	 */
+	void QueryBox (double xmin, double ymin, double xmax, double ymax, std::vector<uint32_t> &out) const;
+
+	/**
+	 * \brief Write the grid to a stream, see Attach. The size written is
+	 * a multiple of 8 bytes
+	 * \param os the output stream
+	 * \return none
+	 */
+	void Write (std::ostream &os) const;
+
+	/**
+	 * \brief Use a grid written by Write, in place: the memory must be
+	 * 8 bytes aligned and must outlive the grid (or the next Build)
+	 * \param data the memory holding the grid
+	 * \param size the bytes available at data
+	 * \param nObstacles the number of obstacles the grid refers to
+	 * \return the number of bytes used, 0 if data does not hold a valid grid
+	 */
+	uint64_t Attach (const uint8_t *data, uint64_t size, uint32_t nObstacles);
+
+private:
+	// not copyable, it may point to its own storage
+	ObstacleGridIndex (const ObstacleGridIndex &);
+	ObstacleGridIndex &operator= (const ObstacleGridIndex &);
+
+	/**
+	 * \brief Get the column of the cell containing x, clamped to the grid
+	 * \param x the coordinate
+	 * \return the column
+	 */
+	int32_t GetColumn (double x) const;
+
+	/**
+	 * \brief Get the row of the cell containing y, clamped to the grid
+	 * \param y the coordinate
+	 * \return the row
+	 */
+	int32_t GetRow (double y) const;
+
+	double								m_cellSize;
+	double								m_minX;
+	double								m_minY;
+	int32_t								m_nx;
+	int32_t								m_ny;
+	uint32_t							m_nItems;
+	// obstacles of cell i are m_items[m_cellStart[i]] .. m_items[m_cellStart[i + 1] - 1],
+	// in the storage vectors or in the attached memory
+	const uint32_t				*m_cellStart;
+	const uint32_t				*m_items;
+	// height of the tallest obstacle of each cell (infinity if an
+	// obstacle has no height, as it is never skipped, see Topology)
+	const double					*m_cellMaxHeight;
+	std::vector<uint32_t>	m_cellStartStorage;
+	std::vector<uint32_t>	m_itemsStorage;
+	std::vector<double>		m_cellMaxHeightStorage;
+};
+
+} // namespace ns3
+
+#endif /* OBSTACLE_GRID_INDEX_H */
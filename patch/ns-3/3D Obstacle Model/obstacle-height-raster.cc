@@ -0,0 +1,342 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include "ns3/log.h"
+#include "obstacle-height-raster.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("ObstacleHeightRaster");
+
+// Liang-Barsky clipping step: restrict [t0, t1] to p * t <= q
+static bool
+ClipSegment (double p, double q, double &t0, double &t1)
+{
+	if (p == 0)
+		return q >= 0;
+
+	double t = q / p;
+	if (p < 0)
+		t0 = std::max (t0, t);
+	else
+		t1 = std::min (t1, t);
+
+	return t0 <= t1;
+}
+
+ObstacleHeightRaster::ObstacleHeightRaster ()
+	:	m_resolution (0),
+		m_minX (0),
+		m_minY (0),
+		m_nx (0),
+		m_ny (0)
+{
+	NS_LOG_FUNCTION (this);
+}
+
+void
+ObstacleHeightRaster::Build (const std::vector<Obstacle> &obstacles, double resolution)
+{
+	NS_LOG_FUNCTION (this << resolution);
+	NS_ASSERT (resolution > 0);
+
+	Clear ();
+	m_resolution = resolution;
+
+	if (obstacles.empty ())
+		return;
+
+	double minX = std::numeric_limits<double>::max ();
+	double minY = std::numeric_limits<double>::max ();
+	double maxX = -std::numeric_limits<double>::max ();
+	double maxY = -std::numeric_limits<double>::max ();
+	for (uint32_t i = 0; i < obstacles.size (); i++)
+	{
+		const VertexList &vertices = obstacles[i].GetVertices ();
+		for (uint32_t v = 0; v < vertices.size (); v++)
+		{
+			minX = std::min (minX, vertices[v].x);
+			minY = std::min (minY, vertices[v].y);
+			maxX = std::max (maxX, vertices[v].x);
+			maxY = std::max (maxY, vertices[v].y);
+		}
+	}
+
+	m_minX = minX;
+	m_minY = minY;
+	m_nx = std::max (1, (int32_t) std::ceil ((maxX - minX) / resolution));
+	m_ny = std::max (1, (int32_t) std::ceil ((maxY - minY) / resolution));
+	m_cells.assign ((uint64_t) m_nx * m_ny, 0);
+
+	for (uint32_t i = 0; i < obstacles.size (); i++)
+	{
+		const Obstacle &obstacle = obstacles[i];
+
+		// an obstacle without height is never crossed (see IntersectWall)
+		if (obstacle.GetHeight () <= 0)
+			continue;
+
+		const VertexList &vertices = obstacle.GetVertices ();
+		double bMinX = std::numeric_limits<double>::max ();
+		double bMinY = std::numeric_limits<double>::max ();
+		double bMaxX = -std::numeric_limits<double>::max ();
+		double bMaxY = -std::numeric_limits<double>::max ();
+		for (uint32_t v = 0; v < vertices.size (); v++)
+		{
+			bMinX = std::min (bMinX, vertices[v].x);
+			bMinY = std::min (bMinY, vertices[v].y);
+			bMaxX = std::max (bMaxX, vertices[v].x);
+			bMaxY = std::max (bMaxY, vertices[v].y);
+		}
+
+		int32_t c0 = std::max (0, (int32_t) std::floor ((bMinX - m_minX) / resolution));
+		int32_t r0 = std::max (0, (int32_t) std::floor ((bMinY - m_minY) / resolution));
+		int32_t c1 = std::min (m_nx - 1, (int32_t) std::floor ((bMaxX - m_minX) / resolution));
+		int32_t r1 = std::min (m_ny - 1, (int32_t) std::floor ((bMaxY - m_minY) / resolution));
+		for (int32_t r = r0; r <= r1; r++)
+		{
+			double y = m_minY + (r + 0.5) * resolution;
+			for (int32_t c = c0; c <= c1; c++)
+			{
+				double x = m_minX + (c + 0.5) * resolution;
+				// a center on the border belongs to the obstacle
+				if (obstacle.GetFootprint ().Contains (x, y) == WALL_MISS)
+					continue;
+
+				uint32_t &cell = m_cells[(uint64_t) r * m_nx + c];
+				if (cell == 0 || obstacles[cell - 1].GetHeight () < obstacle.GetHeight ())
+					cell = i + 1;
+			}
+		}
+	}
+
+	NS_LOG_INFO ("Obstacle raster: " << m_nx << "x" << m_ny << " cells of " << resolution
+							 << " m for " << obstacles.size () << " obstacles.");
+}
+
+void
+ObstacleHeightRaster::Clear ()
+{
+	m_nx = 0;
+	m_ny = 0;
+	m_cells.clear ();
+}
+
+bool
+ObstacleHeightRaster::IsBuilt () const
+{
+	return m_nx > 0;
+}
+
+double
+ObstacleHeightRaster::GetResolution () const
+{
+	return m_resolution;
+}
+
+uint64_t
+ObstacleHeightRaster::GetNCells () const
+{
+	return m_cells.size ();
+}
+
+void
+ObstacleHeightRaster::AddCrossing (uint32_t index, double t, bool entry, double maxGap, std::vector<RasterCrossing> &crossings)
+{
+	// a segment crosses few obstacles
+	for (uint32_t k = 0; k < crossings.size (); k++)
+	{
+		RasterCrossing &crossing = crossings[k];
+		if (crossing.index == index)
+		{
+			if (entry && (t - crossing.last) <= maxGap)
+			{
+				// back in just after leaving: drop the exit
+				crossing.crossings--;
+			}
+			else
+			{
+				crossing.crossings++;
+			}
+			crossing.last = t;
+			return;
+		}
+	}
+
+	RasterCrossing crossing;
+	crossing.index = index;
+	crossing.crossings = 1;
+	crossing.first = t;
+	crossing.last = t;
+	crossings.push_back (crossing);
+}
+
+double
+ObstacleHeightRaster::GetLoss (const std::vector<Obstacle> &obstacles, const Vector &p1, const Vector &p2,
+															 double r, std::vector<RasterCrossing> &crossings) const
+{
+	crossings.clear ();
+
+	if (m_nx == 0)
+		return 0.0;
+
+	// clip the segment to the raster
+	double dx = p2.x - p1.x;
+	double dy = p2.y - p1.y;
+	double dz = p2.z - p1.z;
+	double t0 = 0.0;
+	double t1 = 1.0;
+	double maxX = m_minX + m_nx * m_resolution;
+	double maxY = m_minY + m_ny * m_resolution;
+	if (!ClipSegment (-dx, p1.x - m_minX, t0, t1)
+			|| !ClipSegment (dx, maxX - p1.x, t0, t1)
+			|| !ClipSegment (-dy, p1.y - m_minY, t0, t1)
+			|| !ClipSegment (dy, maxY - p1.y, t0, t1))
+		return 0.0;
+
+	int32_t col = std::min (std::max ((int32_t) std::floor ((p1.x + t0 * dx - m_minX) / m_resolution), 0), m_nx - 1);
+	int32_t row = std::min (std::max ((int32_t) std::floor ((p1.y + t0 * dy - m_minY) / m_resolution), 0), m_ny - 1);
+
+	// parameter of the next vertical (X) and horizontal (Y) cell border
+	const double inf = std::numeric_limits<double>::infinity ();
+	int32_t stepC = (dx > 0) ? 1 : ((dx < 0) ? -1 : 0);
+	int32_t stepR = (dy > 0) ? 1 : ((dy < 0) ? -1 : 0);
+	double tMaxX = (stepC > 0) ? (m_minX + (col + 1) * m_resolution - p1.x) / dx
+		: ((stepC < 0) ? (m_minX + col * m_resolution - p1.x) / dx : inf);
+	double tMaxY = (stepR > 0) ? (m_minY + (row + 1) * m_resolution - p1.y) / dy
+		: ((stepR < 0) ? (m_minY + row * m_resolution - p1.y) / dy : inf);
+	double tDeltaX = (stepC != 0) ? m_resolution / std::abs (dx) : inf;
+	double tDeltaY = (stepR != 0) ? m_resolution / std::abs (dy) : inf;
+
+	// a cell, as a fraction of the (horizontal) segment
+	double maxGap = 1.5 * m_resolution / std::sqrt (dx * dx + dy * dy);
+
+	// the obstacle the segment is inside of, plus one (0 for none): an
+	// endpoint inside an obstacle is not a crossing
+	uint32_t inside = 0;
+	double t = t0;
+	while (true)
+	{
+		double tNext = std::min (std::min (tMaxX, tMaxY), t1);
+
+		uint32_t cell = m_cells[(uint64_t) row * m_nx + col];
+		uint32_t state = 0;
+		if (cell != 0 && p1.z + 0.5 * (t + tNext) * dz <= obstacles[cell - 1].GetHeight ())
+			state = cell;
+
+		if (state != inside)
+		{
+			if (inside != 0)
+				AddCrossing (inside - 1, t, false, maxGap, crossings);
+			if (state != 0 && t > 0)
+				AddCrossing (state - 1, t, true, maxGap, crossings);
+			inside = state;
+		}
+
+		if (tNext >= t1)
+			break;
+
+		// step to the next cell crossed by the segment
+		if (tMaxX < tMaxY)
+		{
+			col += stepC;
+			tMaxX += tDeltaX;
+		}
+		else
+		{
+			row += stepR;
+			tMaxY += tDeltaY;
+		}
+		t = tNext;
+
+		if (col < 0 || col >= m_nx || row < 0 || row >= m_ny)
+			break;
+	}
+
+	// leaving the raster inside an obstacle
+	if (inside != 0 && t1 < 1)
+		AddCrossing (inside - 1, t1, false, maxGap, crossings);
+
+	// same selection and formula of the geometry engines
+	double rSq = r * r;
+	double length = std::sqrt (dx * dx + dy * dy + dz * dz);
+	double minz = std::min (p1.z, p2.z);
+	double obstructedLoss = 0.0;
+	int64_t lossIndex = -1;
+	for (uint32_t k = 0; k < crossings.size (); k++)
+	{
+		const RasterCrossing &crossing = crossings[k];
+		const Obstacle &obstacle = obstacles[crossing.index];
+		const Vector2D &center = obstacle.GetCenterVector ();
+
+		double dx1 = center.x - p1.x;
+		double dy1 = center.y - p1.y;
+		double dx2 = center.x - p2.x;
+		double dy2 = center.y - p2.y;
+		if (!(((dx1 * dx1 + dy1 * dy1 - rSq) < 0) && ((dx2 * dx2 + dy2 * dy2 - rSq) < 0)))
+			continue;
+		if (minz >= obstacle.GetHeight ())
+			continue;
+
+		double obstructedDistance = (crossing.last - crossing.first) * length;
+		if ((obstructedDistance > 0.0) && (crossing.crossings > 1)
+				&& ((int64_t) crossing.index > lossIndex))
+		{
+			obstructedLoss = obstacle.GetBeta () * (double) crossing.crossings + obstacle.GetGamma () * obstructedDistance;
+			lossIndex = crossing.index;
+		}
+	}
+
+	return obstructedLoss;
+}
+
+RasterValidationReport::RasterValidationReport ()
+	:	resolution (0),
+		nCells (0),
+		nSamples (0),
+		referenceTime (0),
+		rasterTime (0),
+		nObstructed (0),
+		nDisagree (0),
+		meanError (0),
+		p50Error (0),
+		p95Error (0),
+		p99Error (0),
+		maxError (0)
+{
+}
+
+void
+RasterValidationReport::Print (std::ostream &os) const
+{
+	os << "Obstacle raster (" << resolution << " m, " << nCells << " cells): "
+		 << nSamples << " random segments in " << rasterTime << " s, "
+		 << referenceTime << " s with the reference engine ("
+		 << ((rasterTime > 0) ? referenceTime / rasterTime : 0.0) << "x)" << std::endl;
+	os << "Loss error on " << nObstructed << " obstructed segments ("
+		 << nDisagree << " obstructed for one engine only): mean " << meanError << " dB, median " << p50Error
+		 << " dB, 95% " << p95Error << " dB, 99% " << p99Error << " dB, max " << maxError << " dB" << std::endl;
+}
+
+} // namespace ns3
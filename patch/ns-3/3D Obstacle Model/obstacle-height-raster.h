@@ -0,0 +1,174 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#ifndef OBSTACLE_HEIGHT_RASTER_H
+#define OBSTACLE_HEIGHT_RASTER_H
+
+#include <vector>
+#include <ostream>
+#include <stdint.h>
+#include "obstacle.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief The crossings of an obstacle along a segment walked through
+ * an ObstacleHeightRaster (positions as fractions of the segment)
+ */
+struct RasterCrossing
+{
+	uint32_t	index;			// index of the obstacle
+	int				crossings;	// times the segment enters or leaves it
+	double		first;			// first crossing
+	double		last;				// last crossing
+};
+
+/**
+ * \ingroup obstacle
+ * \brief A 2.5D raster of the obstacles: a uniform grid of square cells,
+ * each holding the obstacle that covers its center (the tallest one,
+ * where obstacles overlap).
+ *
+ * The obstructed loss of a segment is approximated walking it through
+ * the cells (Amanatides-Woo DDA): the segment is inside an obstacle in a
+ * cell of the obstacle where it is not above its height (at the middle
+ * of the cell). Every change of the obstacle the segment is inside is a
+ * wall (or roof) crossing, and the obstructed distance of an obstacle
+ * runs from its first to its last crossing, as for the geometry engines.
+ * The error on the position of a wall is within the cell size.
+ */
+class ObstacleHeightRaster
+{
+public:
+	/**
+	 * \brief Constructor, an empty raster
+	 */
+	ObstacleHeightRaster ();
+
+	/**
+	 * \brief Rasterize the obstacles
+	 * \param obstacles the obstacles, referred to by their index
+	 * \param resolution side of a cell in meters
+	 * \return none
+	 */
+	void Build (const std::vector<Obstacle> &obstacles, double resolution);
+
+	/**
+	 * \brief Drop the raster
+	 * \return none
+	 */
+	void Clear ();
+
+	/**
+	 * \brief Check if the raster has been built
+	 * \return true if Build has been called on at least one obstacle
+	 */
+	bool IsBuilt () const;
+
+	/**
+	 * \brief Get the side of a cell
+	 * \return the side of a cell in meters
+	 */
+	double GetResolution () const;
+
+	/**
+	 * \brief Get the number of cells of the raster
+	 * \return the number of cells
+	 */
+	uint64_t GetNCells () const;
+
+	/**
+	 * \brief Get the approximate obstructed loss between two points.
+	 * Same rules of Topology::GetObstructedLossBetween: only the obstacles
+	 * whose center is within r of both points are considered, and the loss
+	 * is the one of the obstructing obstacle with the largest index
+	 * \param obstacles the obstacles the raster was built on
+	 * \param p1 point1
+	 * \param p2 point2
+	 * \param r limiting radius for obstacles between p1 and p2
+	 * \param crossings scratch space for the crossings of the segment
+	 * \return the obstructed loss in dB
+	 */
+	double GetLoss (const std::vector<Obstacle> &obstacles, const Vector &p1, const Vector &p2,
+									double r, std::vector<RasterCrossing> &crossings) const;
+
+private:
+	/**
+	 * \brief Record a crossing of an obstacle. Leaving an obstacle and
+	 * entering it again within a gap of a cell is a crossing of a cell
+	 * border along a wall (or a corner), not of the obstacle: both
+	 * crossings are dropped
+	 * \param index the index of the obstacle
+	 * \param t position of the crossing along the segment
+	 * \param entry true if the segment enters the obstacle, false if it leaves it
+	 * \param maxGap the length of a cell, as a fraction of the segment
+	 * \param crossings the crossings of the segment
+	 * \return none
+	 */
+	static void AddCrossing (uint32_t index, double t, bool entry, double maxGap, std::vector<RasterCrossing> &crossings);
+
+	double								m_resolution;
+	double								m_minX;
+	double								m_minY;
+	int32_t								m_nx;
+	int32_t								m_ny;
+
+	// obstacle of each cell plus one (0 for no obstacle), row by row
+	std::vector<uint32_t>	m_cells;
+};
+
+/**
+ * \ingroup obstacle
+ * \brief Deviation of the obstructed loss of the raster engine from a
+ * reference engine, on random segments
+ */
+struct RasterValidationReport
+{
+	RasterValidationReport ();
+
+	/**
+	 * \brief Print the report
+	 * \param os the output stream
+	 * \return none
+	 */
+	void Print (std::ostream &os) const;
+
+	double		resolution;			// side of a cell in meters
+	uint64_t	nCells;					// cells of the raster
+	uint32_t	nSamples;				// segments evaluated
+	double		referenceTime;	// seconds spent by the reference engine
+	double		rasterTime;			// seconds spent by the raster engine
+
+	// absolute difference of the obstructed loss (dB), on the segments
+	// obstructed for either engine
+	uint32_t	nObstructed;		// segments obstructed for either engine
+	uint32_t	nDisagree;			// obstructed for one engine only
+	double		meanError;
+	double		p50Error;
+	double		p95Error;
+	double		p99Error;
+	double		maxError;
+};
+
+} // namespace ns3
+
+#endif /* OBSTACLE_HEIGHT_RASTER_H */
@@ -22,8 +22,16 @@
 #include "ns3/log.h"
 #include "ns3/double.h"
 #include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/string.h"
+#include "ns3/node.h"
+#include "ns3/node-list.h"
 #include "ns3/mobility-model.h"
+#include "ns3/simulator.h"
 #include <cmath>
+#include <limits>
+#include <sstream>
 #include "ns3/topology.h"
 
 #include "obstacle-shadowing-propagation-loss-model.h"
@@ -46,13 +54,103 @@ ObstacleShadowingPropagationLossModel::GetTypeId (void)
 								 "Radius used for optimization (meters)",
 								 DoubleValue (200),
 								 MakeDoubleAccessor (&ObstacleShadowingPropagationLossModel::m_radius),
+								 MakeDoubleChecker<double> ())
+	.AddAttribute ("Engine",
+								 "Geometry engine for the obstacle intersections: "
+								 "Exact (CGAL exact kernel), Double (double precision, "
+								 "the exact kernel is used only for degenerate cases) or Raster "
+								 "(approximate, walk of a raster of the obstacles, see RasterResolution)",
+								 EnumValue (Topology::ENGINE_EXACT),
+								 MakeEnumAccessor (&ObstacleShadowingPropagationLossModel::m_engine),
+								 MakeEnumChecker (Topology::ENGINE_EXACT, "Exact",
+																	Topology::ENGINE_DOUBLE, "Double",
+																	Topology::ENGINE_RASTER, "Raster"))
+	.AddAttribute ("RasterResolution",
+								 "Side of a cell of the raster of the obstacles used by the Raster "
+								 "engine (meters), if the topology has not been rasterized yet",
+								 DoubleValue (1.0),
+								 MakeDoubleAccessor (&ObstacleShadowingPropagationLossModel::m_rasterResolution),
+								 MakeDoubleChecker<double> (0.01))
+	.AddAttribute ("CacheCapacity",
+								 "Maximum number of obstructed loss values cached by this model "
+								 "(0 disables the cache)",
+								 UintegerValue (65536),
+								 MakeUintegerAccessor (&ObstacleShadowingPropagationLossModel::SetCacheCapacity,
+																			 &ObstacleShadowingPropagationLossModel::GetCacheCapacity),
+								 MakeUintegerChecker<uint32_t> ())
+	.AddAttribute ("PrecomputeStatic",
+								 "Compute the obstructed loss between all the nodes at the first "
+								 "evaluation, for scenarios where nodes do not move",
+								 BooleanValue (false),
+								 MakeBooleanAccessor (&ObstacleShadowingPropagationLossModel::m_precompute),
+								 MakeBooleanChecker ())
+	.AddAttribute ("PrecomputeThreads",
+								 "Number of threads used by PrecomputeStatic (0 for one per core). "
+								 "They run concurrently only with the Double engine and the grid index, "
+								 "or with the Raster engine (see Topology::IsLockFree)",
+								 UintegerValue (0),
+								 MakeUintegerAccessor (&ObstacleShadowingPropagationLossModel::m_precomputeThreads),
+								 MakeUintegerChecker<uint32_t> ())
+	.AddAttribute ("StaticLossDirectory",
+								 "Directory where the losses computed by PrecomputeStatic are saved, "
+								 "and reused by the runs with the same obstacles, node positions "
+								 "and parameters (empty to disable)",
+								 StringValue (""),
+								 MakeStringAccessor (&ObstacleShadowingPropagationLossModel::m_staticLossDirectory),
+								 MakeStringChecker ())
+	.AddAttribute ("NodeCacheCapacity",
+								 "Maximum number of node pairs whose last obstructed loss is kept "
+								 "by this model, see MovementThreshold (0, the default, disables the "
+								 "cache: the losses it returns are approximate)",
+								 UintegerValue (0),
+								 MakeUintegerAccessor (&ObstacleShadowingPropagationLossModel::SetNodeCacheCapacity,
+																			 &ObstacleShadowingPropagationLossModel::GetNodeCacheCapacity),
+								 MakeUintegerChecker<uint32_t> ())
+	.AddAttribute ("MovementThreshold",
+								 "The last obstructed loss between two nodes is reused while "
+								 "neither node has moved farther than this from where it was "
+								 "computed (meters)",
+								 DoubleValue (0.1),
+								 MakeDoubleAccessor (&ObstacleShadowingPropagationLossModel::m_movementThreshold),
+								 MakeDoubleChecker<double> (0.0))
+	.AddAttribute ("BatchPerTransmission",
+								 "At the first evaluation of a transmission, compute the obstructed "
+								 "loss from the transmitter to all the nodes with one batch query, "
+								 "which searches the obstacles around the transmitter only once. "
+								 "The batch covers every node within twice the Radius, also those "
+								 "the channel does not ask for (e.g. beyond its interference distance "
+								 "or below the Sensitivity), so it pays off only when most of them are",
+								 BooleanValue (false),
+								 MakeBooleanAccessor (&ObstacleShadowingPropagationLossModel::m_batch),
+								 MakeBooleanChecker ())
+	.AddAttribute ("BatchThreads",
+								 "Number of threads that share the receivers of a BatchPerTransmission "
+								 "query (0 for one per core, 1 to compute them in the simulation thread). "
+								 "The losses are the same with any number of threads, which run "
+								 "concurrently only with the Double engine and the grid index "
+								 "(see Topology::IsLockFree)",
+								 UintegerValue (1),
+								 MakeUintegerAccessor (&ObstacleShadowingPropagationLossModel::m_batchThreads),
+								 MakeUintegerChecker<uint32_t> ())
+	.AddAttribute ("Sensitivity",
+								 "Received power (dBm), before the obstacle loss, below which the "
+								 "obstacles are not evaluated: the obstacle loss would only lower it "
+								 "further, so the reception fails anyway. Such signals add to the "
+								 "interference without the obstacle loss, so it should be the lower of "
+								 "the EnergyDetectionThreshold and CcaMode1Threshold of the receivers, "
+								 "minus their RxGain",
+								 DoubleValue (-std::numeric_limits<double>::infinity ()),
+								 MakeDoubleAccessor (&ObstacleShadowingPropagationLossModel::m_sensitivity),
 								 MakeDoubleChecker<double> ());
 
   return tid;
 }
 
 ObstacleShadowingPropagationLossModel::ObstacleShadowingPropagationLossModel ()
-  : PropagationLossModel ()
+  : PropagationLossModel (),
+		m_nodeCacheMoved (0),
+		m_skippedWeak (0),
+		m_skippedFar (0)
 {
 }
 
@@ -75,6 +173,13 @@ ObstacleShadowingPropagationLossModel::GetLoss (Ptr<MobilityModel> a, Ptr<Mobili
 
   if (topology->HasObstacles() == true)
     {
+			// rasterize the obstacles at the first evaluation (those of a
+			// tile store are not, the double engine is used instead)
+			if ((m_engine == Topology::ENGINE_RASTER) && !topology->HasRaster () && (topology->GetTileStore () == 0))
+				{
+					topology->MakeRaster (m_rasterResolution);
+				}
+
       // additional loss for obstacles
       double p1_x = a->GetPosition ().x;
       double p1_y = a->GetPosition ().y;
@@ -82,23 +187,283 @@ ObstacleShadowingPropagationLossModel::GetLoss (Ptr<MobilityModel> a, Ptr<Mobili
       double p2_x = b->GetPosition ().x;
       double p2_y = b->GetPosition ().y;
 			double p2_z = b->GetPosition ().z;
+
+			// farther than 2r no obstacle is within r of both nodes, see
+			// Topology::GetObstructedLossBetween (same test): no caches,
+			// no precomputed losses, no batch involved
+			double dx = p2_x - p1_x;
+			double dy = p2_y - p1_y;
+			if ((dx * dx + dy * dy) >= 4.0 * (m_radius * m_radius))
+				{
+					m_skippedFar++;
+					return 0.0;
+				}
+
+      Ptr<Node> nodeA = a->GetObject<Node> ();
+      Ptr<Node> nodeB = b->GetObject<Node> ();
+
+			// nodes that have not moved since the precomputation
+			if (m_precompute)
+				{
+					if (!m_staticLosses.IsBuilt ())
+						{
+							PrecomputeStaticLosses ();
+						}
+
+					if ((nodeA != 0) && (nodeB != 0)
+							&& m_staticLosses.Lookup (nodeA->GetId (), Vector (p1_x, p1_y, p1_z),
+																				nodeB->GetId (), Vector (p2_x, p2_y, p2_z), L_obs))
+						{
+							return L_obs;
+						}
+				}
+
       // for two points, p1 and p2
-      Point_3 p1(p1_x, p1_y, p1_z);
-      Point_3 p2(p2_x, p2_y, p2_z);
+      Vector p1(p1_x, p1_y, p1_z);
+      Vector p2(p2_x, p2_y, p2_z);
 
-      // and testing for obstacles within m_radius=200m
-      // get the obstructed loss, from the topology class
-      L_obs = topology->GetObstructedLossBetween(p1, p2, m_radius);
+			// the last loss between the same two nodes, if neither
+			// has moved farther than the threshold since then
+			bool byNode = (nodeA != 0) && (nodeB != 0) && (m_nodeCache.GetCapacity () > 0);
+			bool swap = byNode && (nodeA->GetId () > nodeB->GetId ());
+			NodePairKey nodeKey;
+			if (byNode)
+				{
+					nodeKey = NodePairKey (nodeA->GetId (), nodeB->GetId ());
+					NodePairLoss entry;
+					if (m_nodeCache.Lookup (nodeKey, entry))
+						{
+							if (entry.IsValid (swap ? p2 : p1, swap ? p1 : p2, m_movementThreshold * m_movementThreshold))
+								{
+									return entry.m_loss;
+								}
+							m_nodeCacheMoved++;
+						}
+				}
+
+			// the losses of the current transmission, computed together
+			if (!(m_batch && GetTransmissionLoss (a, p1, b, p2, L_obs)))
+				{
+		      // and testing for obstacles within m_radius=200m
+		      // get the obstructed loss, from the topology class
+		      L_obs = topology->GetObstructedLossBetween(p1, p2, m_radius, m_engine, m_context);
+				}
+
+			if (byNode)
+				{
+					NodePairLoss entry;
+					entry.m_loss = L_obs;
+					entry.m_pa = swap ? p2 : p1;
+					entry.m_pb = swap ? p1 : p2;
+					m_nodeCache.Insert (nodeKey, entry);
+				}
     }
 
   return L_obs;
 }
 
+void
+ObstacleShadowingPropagationLossModel::SetCacheCapacity (uint32_t capacity)
+{
+	NS_LOG_FUNCTION (this << capacity);
+
+	m_context.GetCache ().SetCapacity (capacity);
+}
+
+uint32_t
+ObstacleShadowingPropagationLossModel::GetCacheCapacity (void) const
+{
+	return m_context.GetCache ().GetCapacity ();
+}
+
+void
+ObstacleShadowingPropagationLossModel::SetNodeCacheCapacity (uint32_t capacity)
+{
+	NS_LOG_FUNCTION (this << capacity);
+
+	m_nodeCache.SetCapacity (capacity);
+}
+
+uint32_t
+ObstacleShadowingPropagationLossModel::GetNodeCacheCapacity (void) const
+{
+	return m_nodeCache.GetCapacity ();
+}
+
+void
+ObstacleShadowingPropagationLossModel::PrintCacheStatistics (std::ostream &os) const
+{
+	m_context.PrintCacheStatistics (os);
+
+	// hits are the entries found, including those of nodes that moved too far
+	uint64_t lookups = m_nodeCache.GetHits () + m_nodeCache.GetMisses ();
+	uint64_t reused = m_nodeCache.GetHits () - m_nodeCacheMoved;
+	os << "Node pair loss cache: "
+		 << m_nodeCache.GetSize () << "/" << m_nodeCache.GetCapacity () << " entries, "
+		 << reused << " reused, "
+		 << m_nodeCacheMoved << " moved, "
+		 << m_nodeCache.GetMisses () << " misses ("
+		 << ((lookups > 0) ? 100.0 * reused / lookups : 0.0) << "% reuse rate), "
+		 << m_nodeCache.GetEvictions () << " evictions" << std::endl;
+	os << "Obstacles skipped: "
+		 << m_skippedWeak << " evaluations below the sensitivity, "
+		 << m_skippedFar << " beyond twice the radius" << std::endl;
+}
+
+void
+ObstacleShadowingPropagationLossModel::PrecomputeStaticLosses (void) const
+{
+	NS_LOG_FUNCTION (this);
+
+	std::vector<Vector> positions (NodeList::GetNNodes ());
+	std::vector<bool> valid (NodeList::GetNNodes (), false);
+	for (uint32_t id = 0; id < NodeList::GetNNodes (); id++)
+		{
+			Ptr<MobilityModel> mobility = NodeList::GetNode (id)->GetObject<MobilityModel> ();
+			if (mobility != 0)
+				{
+					positions[id] = mobility->GetPosition ();
+					valid[id] = true;
+				}
+		}
+
+	Topology * topology = Topology::GetTopology ();
+
+	// reuse the losses saved by a previous run with the same inputs: the
+	// buildings files and their parameters, the positions of the nodes
+	// (from the mobility trace) and the parameters of the model
+	std::string filename;
+	uint64_t key = 0;
+	if (!m_staticLossDirectory.empty ())
+		{
+			uint64_t sourceHash = topology->GetSourceHash ();
+			if (m_engine == Topology::ENGINE_RASTER)
+				{
+					double resolution = topology->GetRasterResolution ();
+					sourceHash = HashBytes (&resolution, sizeof (resolution), sourceHash);
+				}
+			key = StaticLossMatrix::GetKey (sourceHash, positions, valid, m_radius, m_engine);
+			std::ostringstream name;
+			name << m_staticLossDirectory << "/static-loss-" << std::hex << key << ".bin";
+			filename = name.str ();
+			if (m_staticLosses.Load (filename, key))
+				{
+					return;
+				}
+		}
+
+	if ((m_precomputeThreads != 1) && !topology->IsLockFree (m_engine))
+		{
+			NS_LOG_WARN ("PrecomputeThreads: the threads wait for each other with this engine and index, "
+									 "use the Double engine and the grid index (see Topology::IsLockFree).");
+		}
+	m_staticLosses.Build (*topology, positions, valid, m_radius, m_engine, m_precomputeThreads);
+	if (!filename.empty ())
+		{
+			m_staticLosses.Save (filename, key);
+		}
+	NS_LOG_INFO ("Precomputed obstructed losses of " << m_staticLosses.GetNNodes () << " nodes, "
+							 << m_staticLosses.GetNEntries () << " obstructed pairs.");
+}
+
+bool
+ObstacleShadowingPropagationLossModel::GetTransmissionLoss (Ptr<MobilityModel> a, const Vector &pa,
+																														 Ptr<MobilityModel> b, const Vector &pb, double &loss) const
+{
+	NS_LOG_FUNCTION (this);
+
+	Ptr<Node> nodeB = b->GetObject<Node> ();
+	if (nodeB == 0)
+		{
+			return false;
+		}
+
+	// a new transmission
+	if ((a != m_transmitter) || (Simulator::Now () != m_transmissionTime)
+			|| (pa.x != m_transmitterPosition.x) || (pa.y != m_transmitterPosition.y)
+			|| (pa.z != m_transmitterPosition.z))
+		{
+			m_transmitter = a;
+			m_transmitterPosition = pa;
+			m_transmissionTime = Simulator::Now ();
+
+			uint32_t nNodes = NodeList::GetNNodes ();
+			m_receiverPositions.assign (nNodes, Vector ());
+			m_receiverValid.assign (nNodes, false);
+			std::vector<Vector> receivers;
+			std::vector<uint32_t> ids;
+			double x4rSq = 4.0 * (m_radius * m_radius);
+			for (uint32_t id = 0; id < nNodes; id++)
+				{
+					Ptr<MobilityModel> mobility = NodeList::GetNode (id)->GetObject<MobilityModel> ();
+					if (mobility != 0)
+						{
+							m_receiverPositions[id] = mobility->GetPosition ();
+							m_receiverValid[id] = true;
+							// the nodes farther than 2r have no loss, and would only fill the cache
+							double dx = m_receiverPositions[id].x - pa.x;
+							double dy = m_receiverPositions[id].y - pa.y;
+							if ((dx * dx + dy * dy) < x4rSq)
+								{
+									receivers.push_back (m_receiverPositions[id]);
+									ids.push_back (id);
+								}
+						}
+				}
+
+			std::vector<double> losses;
+			if ((m_batchThreads != 1) && (receivers.size () > 1))
+				{
+					// the threads are started at the first transmission
+					if (!m_batchPool)
+						{
+							if (!Topology::GetTopology ()->IsLockFree (m_engine))
+								{
+									NS_LOG_WARN ("BatchThreads: the threads wait for each other with this engine and index, "
+															 "use the Double engine and the grid index (see Topology::IsLockFree).");
+								}
+							m_batchPool.reset (new ObstacleWorkerPool (m_batchThreads));
+							m_batchContexts.assign (m_batchPool->GetNThreads (), TopologyQueryContext (0));
+						}
+					Topology::GetTopology ()->GetObstructedLossBatch (pa, receivers, m_radius, m_engine, losses, m_context,
+																														*m_batchPool, m_batchContexts);
+				}
+			else
+				{
+					Topology::GetTopology ()->GetObstructedLossBatch (pa, receivers, m_radius, m_engine, losses, m_context);
+				}
+			m_receiverLosses.assign (nNodes, 0.0);
+			for (uint32_t i = 0; i < ids.size (); i++)
+				{
+					m_receiverLosses[ids[i]] = losses[i];
+				}
+		}
+
+	uint32_t id = nodeB->GetId ();
+	if ((id >= m_receiverValid.size ()) || !m_receiverValid[id]
+			|| (pb.x != m_receiverPositions[id].x) || (pb.y != m_receiverPositions[id].y)
+			|| (pb.z != m_receiverPositions[id].z))
+		{
+			return false;
+		}
+
+	loss = m_receiverLosses[id];
+	return true;
+}
+
 double
 ObstacleShadowingPropagationLossModel::DoCalcRxPower (double txPowerDbm,
 						Ptr<MobilityModel> a,
 						Ptr<MobilityModel> b) const
 {
+	// the obstacle loss cannot bring a signal that is already
+	// too weak back above the sensitivity
+	if (txPowerDbm < m_sensitivity)
+		{
+			m_skippedWeak++;
+			return txPowerDbm;
+		}
+
   double retVal = 0.0;
   double loss = GetLoss (a, b);
   retVal = txPowerDbm - loss;
@@ -23,6 +23,9 @@
 #define OBSTACLE_SHADOWING_PROPAGATION_LOSS_MODEL_H
 
 #include "ns3/propagation-loss-model.h"
+#include "ns3/nstime.h"
+#include "ns3/topology.h"
+#include "ns3/static-loss-matrix.h"
 
 namespace ns3 {
 
@@ -65,8 +68,71 @@ public:
    */
   double GetLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const;
 
+	/**
+	 * \brief Set the capacity of the obstructed loss cache of this model
+	 * \param capacity the number of entries
+	 * \return none
+	 */
+	void SetCacheCapacity (uint32_t capacity);
+
+	/**
+	 * \brief Get the capacity of the obstructed loss cache of this model
+	 * \return the number of entries
+	 */
+	uint32_t GetCacheCapacity (void) const;
+
+	/**
+	 * \brief Set the capacity of the node pair loss cache of this model
+	 * \param capacity the number of node pairs
+	 * \return none
+	 */
+	void SetNodeCacheCapacity (uint32_t capacity);
+
+	/**
+	 * \brief Get the capacity of the node pair loss cache of this model
+	 * \return the number of node pairs
+	 */
+	uint32_t GetNodeCacheCapacity (void) const;
+
+	/**
+	 * \brief Print size, hits, misses and evictions of the obstructed loss
+	 * cache and of the node pair loss cache of this model, and the
+	 * evaluations that skipped the obstacles (see Sensitivity)
+	 * \param os the output stream
+	 * \return none
+	 */
+	void PrintCacheStatistics (std::ostream &os) const;
+
+	/**
+	 * \brief Compute the obstructed loss between every pair of nodes of
+	 * the NodeList, at their current positions, so that the following
+	 * evaluations are lookups. Called at the first evaluation when the
+	 * PrecomputeStatic attribute is set; a pair with a node that has moved
+	 * since then is evaluated as usual. If StaticLossDirectory is set, the
+	 * losses are loaded from there when available, and saved otherwise
+	 * \return none
+	 */
+	void PrecomputeStaticLosses (void) const;
+
 private:
 
+	/**
+	 * \brief Search for the loss between two nodes in the losses of the
+	 * current transmission. A transmission is identified by its
+	 * transmitter, the position of the transmitter and the time: at the
+	 * first evaluation of a new one, the losses from the transmitter to
+	 * every node of the NodeList are computed with a single batch query
+	 * \param a the mobility model of the transmitter
+	 * \param pa the position of the transmitter
+	 * \param b the mobility model of the receiver
+	 * \param pb the position of the receiver
+	 * \param loss set to the obstructed loss, if found
+	 * \return false if the receiver is not a node, or is not where it
+	 * was at the batch query
+	 */
+	bool GetTransmissionLoss (Ptr<MobilityModel> a, const Vector &pa,
+														Ptr<MobilityModel> b, const Vector &pb, double &loss) const;
+
   // inherited from PropagationLossModel
   virtual double DoCalcRxPower (double txPowerDbm,
                                 Ptr<MobilityModel> a,
@@ -74,6 +140,44 @@ private:
   virtual int64_t DoAssignStreams (int64_t stream);
 
 	double	m_radius;
+	Topology::Engine	m_engine;
+	double	m_rasterResolution;
+
+	// scratch space and cache of the topology queries of this model
+	// (the topology itself is shared, and not modified by the queries)
+	mutable TopologyQueryContext	m_context;
+
+	// last loss between two nodes, with their positions, reused while
+	// neither has moved farther than m_movementThreshold
+	mutable NodePairLossCache	m_nodeCache;
+	double	m_movementThreshold;
+	mutable uint64_t	m_nodeCacheMoved;
+
+	// received power below which the obstacles are not evaluated,
+	// and the evaluations skipped (below it, or nodes farther than 2r)
+	double	m_sensitivity;
+	mutable uint64_t	m_skippedWeak;
+	mutable uint64_t	m_skippedFar;
+
+	// precomputed losses, for nodes that do not move
+	bool	m_precompute;
+	uint32_t	m_precomputeThreads;
+	std::string	m_staticLossDirectory;
+	mutable StaticLossMatrix	m_staticLosses;
+
+	// losses from the transmitter of the current transmission to the
+	// nodes, indexed by node id, with the positions they were computed at
+	// (computed by the threads of m_batchPool, if any, each with its scratch space)
+	bool	m_batch;
+	uint32_t	m_batchThreads;
+	mutable std::unique_ptr<ObstacleWorkerPool>	m_batchPool;
+	mutable std::vector<TopologyQueryContext>	m_batchContexts;
+	mutable Ptr<MobilityModel>	m_transmitter;
+	mutable Vector	m_transmitterPosition;
+	mutable Time	m_transmissionTime;
+	mutable std::vector<Vector>	m_receiverPositions;
+	mutable std::vector<bool>	m_receiverValid;
+	mutable std::vector<double>	m_receiverLosses;
 };
 
 } // namespace ns3
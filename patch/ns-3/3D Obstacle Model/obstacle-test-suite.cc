@@ -0,0 +1,1688 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 Università di Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Authors: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "ns3/test.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/node.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/obstacle-grid-index.h"
+#include "ns3/obstacle-shadowing-propagation-loss-model.h"
+#include "ns3/obstacle-tile-store.h"
+#include "ns3/obstacle-type-rules.h"
+#include "ns3/obstacle-worker-pool.h"
+#include "ns3/obstructed-loss-cache.h"
+#include "ns3/polygon-simplification.h"
+#include "ns3/static-loss-matrix.h"
+#include "ns3/topology.h"
+
+// Do not put your test classes in namespace ns3.  You may find it useful
+// to use the using directive to access the ns3 namespace directly
+using namespace ns3;
+
+// limiting radius of the queries
+static const double g_radius = 300.0;
+
+/**
+ * \brief Write a small city in the SUMO polygon format: a grid of blocks,
+ * two buildings of different heights each, an L-shaped one every third
+ * block
+ * \param filename the name of the file
+ * \param nBlocks number of blocks on each side
+ * \return none
+ */
+static void
+WriteCity (std::string filename, uint32_t nBlocks = 8)
+{
+	std::ofstream file (filename.c_str ());
+	file << "<?xml version=\"1.0\"?>\n<additional>\n";
+	for (uint32_t i = 0; i < nBlocks; i++)
+		{
+			for (uint32_t j = 0; j < nBlocks; j++)
+				{
+					double x = 20 + 60 * i;
+					double y = 20 + 60 * j;
+					double height = 5 + (7 * i + 3 * j) % 25;
+					file << "\t<poly id=\"b" << i << "_" << j << "a\" type=\"building\" height=\"" << height
+							 << "\" shape=\"" << x << "," << y << " " << x + 40 << "," << y << " "
+							 << x + 40 << "," << y + 18 << " " << x << "," << y + 18 << " " << x << "," << y << "\"/>\n";
+					if ((i + j) % 3 == 0)
+						{
+							file << "\t<poly id=\"b" << i << "_" << j << "b\" type=\"building\" height=\"" << height + 8
+									 << "\" shape=\"" << x << "," << y + 22 << " " << x + 40 << "," << y + 22 << " "
+									 << x + 40 << "," << y + 30 << " " << x + 15 << "," << y + 30 << " "
+									 << x + 15 << "," << y + 40 << " " << x << "," << y + 40 << " " << x << "," << y + 22 << "\"/>\n";
+						}
+					else
+						{
+							file << "\t<poly id=\"b" << i << "_" << j << "b\" type=\"building\" height=\"" << height + 8
+									 << "\" shape=\"" << x << "," << y + 22 << " " << x + 40 << "," << y + 22 << " "
+									 << x + 40 << "," << y + 40 << " " << x << "," << y + 40 << " " << x << "," << y + 22 << "\"/>\n";
+						}
+				}
+		}
+	file << "</additional>\n";
+}
+
+/**
+ * \brief Draw the endpoints of the test links: pseudo-random points of the
+ * city, at the height of a vehicle, and a few above every building
+ * \param n number of links
+ * \param from set to the first endpoints
+ * \param to set to the second endpoints
+ * \return none
+ */
+static void
+MakeLinks (uint32_t n, std::vector<Vector> &from, std::vector<Vector> &to)
+{
+	uint32_t state = 12345;
+	from.clear ();
+	to.clear ();
+	for (uint32_t i = 0; i < 2 * n; i++)
+		{
+			double c[2];
+			for (uint32_t k = 0; k < 2; k++)
+				{
+					state = state * 1103515245 + 12345;
+					c[k] = 500.0 * ((state >> 8) & 0xffff) / 65536.0;
+				}
+			double z = (i % 17 == 0) ? 60.0 : 1.5;
+			if (i % 2 == 0)
+				from.push_back (Vector (c[0], c[1], z));
+			else
+				to.push_back (Vector (c[0], c[1], z));
+		}
+}
+
+/**
+ * \brief Compute the obstructed loss of the links, without the cache
+ * \param topology the topology
+ * \param engine the geometry engine
+ * \param from the first endpoints
+ * \param to the second endpoints
+ * \param losses set to the loss of each link (dB)
+ * \return none
+ */
+static void
+ComputeLosses (const Topology &topology, Topology::Engine engine, const std::vector<Vector> &from,
+							 const std::vector<Vector> &to, std::vector<double> &losses)
+{
+	TopologyQueryContext context (0);
+	losses.resize (from.size ());
+	for (uint32_t i = 0; i < from.size (); i++)
+		{
+			losses[i] = topology.GetObstructedLossBetween (from[i], to[i], g_radius, engine, context);
+		}
+}
+
+/**
+ * \brief The double engine against the exact engine (the original model)
+ */
+class ObstacleEngineTestCase : public TestCase
+{
+public:
+	ObstacleEngineTestCase ();
+	virtual ~ObstacleEngineTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleEngineTestCase::ObstacleEngineTestCase ()
+	: TestCase ("Obstructed loss of the double engine")
+{
+}
+
+ObstacleEngineTestCase::~ObstacleEngineTestCase ()
+{
+}
+
+void
+ObstacleEngineTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+
+	Topology topology;
+	topology.Load (filename);
+	NS_TEST_ASSERT_MSG_EQ (topology.GetNObstacles (), 128, "Wrong number of obstacles loaded");
+
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	MakeLinks (400, from, to);
+
+	// baseline: exact engine, range tree
+	std::vector<double> baseline;
+	ComputeLosses (topology, Topology::ENGINE_EXACT, from, to, baseline);
+	uint32_t nObstructed = 0;
+	for (uint32_t i = 0; i < baseline.size (); i++)
+		{
+			nObstructed += (baseline[i] > 0);
+		}
+	NS_TEST_ASSERT_MSG_GT (nObstructed, 100, "Too few obstructed links to test the engines");
+	NS_TEST_ASSERT_MSG_LT (nObstructed, baseline.size (), "Every link is obstructed");
+
+	// same candidates in the same order: the same losses, also for the
+	// links entering a building from the roof
+	std::vector<double> losses;
+	ComputeLosses (topology, Topology::ENGINE_DOUBLE, from, to, losses);
+	for (uint32_t i = 0; i < baseline.size (); i++)
+		{
+			NS_TEST_ASSERT_MSG_EQ_TOL (losses[i], baseline[i], 1e-6, "Double engine differs on link " << i);
+		}
+}
+
+/**
+ * \brief The vectorized wall kernel against its scalar reference
+ */
+class ObstacleWallKernelTestCase : public TestCase
+{
+public:
+	ObstacleWallKernelTestCase ();
+	virtual ~ObstacleWallKernelTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleWallKernelTestCase::ObstacleWallKernelTestCase ()
+	: TestCase ("Wall intersection kernel")
+{
+}
+
+ObstacleWallKernelTestCase::~ObstacleWallKernelTestCase ()
+{
+}
+
+void
+ObstacleWallKernelTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.Load (filename);
+
+	// every wall of the city, and one more so that the vectorized loops
+	// leave a tail to the scalar one
+	WallSoup walls;
+	for (uint32_t i = 0; i < topology.GetNObstacles (); i++)
+		{
+			const Obstacle &obstacle = topology.GetObstacle (i);
+			const VertexList &vertices = obstacle.GetVertices ();
+			uint32_t n = vertices.size ();
+			for (uint32_t v = 0; v < n; v++)
+				{
+					walls.Add (vertices[v].x, vertices[v].y, vertices[(v + 1) % n].x, vertices[(v + 1) % n].y,
+										 obstacle.GetHeight ());
+				}
+		}
+	if (walls.GetN () % 4 == 0)
+		{
+			walls.Add (0, 0, 1, 1, 10);
+		}
+
+	// the links of the city, and one from a wall (degenerate for the
+	// walls along the same line)
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	MakeLinks (100, from, to);
+	from.push_back (Vector (20, 29, 1.5));
+	to.push_back (Vector (100, 29, 1.5));
+
+	std::vector<double> distSq (walls.GetN ());
+	std::vector<uint8_t> hit (walls.GetN ());
+	uint32_t nHits = 0;
+	uint32_t nDegenerate = 0;
+	for (uint32_t l = 0; l < from.size (); l++)
+		{
+			IntersectWalls (walls, from[l], to[l], &distSq[0], &hit[0]);
+			for (uint32_t w = 0; w < walls.GetN (); w++)
+				{
+					double expectedDistSq = 0;
+					WallHit expected = IntersectWall (walls.m_x0[w], walls.m_y0[w], walls.m_x1[w], walls.m_y1[w], walls.m_h[w],
+																						from[l], to[l], expectedDistSq);
+					NS_TEST_ASSERT_MSG_EQ ((uint32_t) hit[w], (uint32_t) expected, "Outcome differs on link " << l << ", wall " << w);
+					if (expected == WALL_HIT)
+						{
+							NS_TEST_ASSERT_MSG_EQ (distSq[w], expectedDistSq, "Distance differs on link " << l << ", wall " << w);
+						}
+					nHits += (expected == WALL_HIT);
+					nDegenerate += (expected == WALL_DEGENERATE);
+				}
+		}
+	NS_TEST_ASSERT_MSG_GT (nHits, 100, "Too few walls hit to test the kernel");
+	NS_TEST_ASSERT_MSG_GT (nDegenerate, 0, "No degenerate case to test the kernel");
+}
+
+/**
+ * \brief The obstructed loss cache: hits, misses and CLOCK eviction
+ */
+class ObstacleCacheTestCase : public TestCase
+{
+public:
+	ObstacleCacheTestCase ();
+	virtual ~ObstacleCacheTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleCacheTestCase::ObstacleCacheTestCase ()
+	: TestCase ("Obstructed loss cache")
+{
+}
+
+ObstacleCacheTestCase::~ObstacleCacheTestCase ()
+{
+}
+
+void
+ObstacleCacheTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.SetIndexType (Topology::INDEX_GRID);
+	topology.Load (filename);
+
+	// a miss, then a hit with the same loss, also from the other end
+	Vector a (10, 29, 1.5);
+	Vector b (250, 31, 1.5);
+	TopologyQueryContext context (16);
+	double loss = topology.GetObstructedLossBetween (a, b, g_radius, Topology::ENGINE_DOUBLE, context);
+	NS_TEST_ASSERT_MSG_EQ (context.GetCache ().GetMisses (), 1, "First query not a miss");
+	NS_TEST_ASSERT_MSG_EQ (context.GetCache ().GetHits (), 0, "First query a hit");
+	NS_TEST_ASSERT_MSG_EQ (topology.GetObstructedLossBetween (a, b, g_radius, Topology::ENGINE_DOUBLE, context), loss,
+												 "Cached loss differs");
+	NS_TEST_ASSERT_MSG_EQ (topology.GetObstructedLossBetween (b, a, g_radius, Topology::ENGINE_DOUBLE, context), loss,
+												 "Cached loss differs from the other end");
+	NS_TEST_ASSERT_MSG_EQ (context.GetCache ().GetHits (), 2, "Repeated queries not hits");
+	NS_TEST_ASSERT_MSG_EQ (context.GetCache ().GetMisses (), 1, "Repeated queries missed");
+
+	// a disabled cache misses every time
+	TopologyQueryContext uncached (0);
+	topology.GetObstructedLossBetween (a, b, g_radius, Topology::ENGINE_DOUBLE, uncached);
+	topology.GetObstructedLossBetween (a, b, g_radius, Topology::ENGINE_DOUBLE, uncached);
+	NS_TEST_ASSERT_MSG_EQ (uncached.GetCache ().GetHits (), 0, "Disabled cache hit");
+
+	// a full cache evicts, but gives a second chance to the entries used
+	ObstructedLossCache cache (4);
+	double value = 0;
+	for (uint32_t i = 0; i < 8; i++)
+		{
+			cache.Insert (ObstructedLossKey (i, 0, 0, 0, 0, 0), i);
+		}
+	NS_TEST_ASSERT_MSG_EQ (cache.GetSize (), 4, "Cache above its capacity");
+	NS_TEST_ASSERT_MSG_EQ (cache.GetEvictions (), 4, "Wrong number of evictions");
+	NS_TEST_ASSERT_MSG_EQ (cache.Lookup (ObstructedLossKey (7, 0, 0, 0, 0, 0), value), true, "Last entry evicted");
+	NS_TEST_ASSERT_MSG_EQ (value, 7, "Wrong cached value");
+	cache.Insert (ObstructedLossKey (8, 0, 0, 0, 0, 0), 8);
+	NS_TEST_ASSERT_MSG_EQ (cache.Contains (ObstructedLossKey (7, 0, 0, 0, 0, 0)), true, "Referenced entry evicted");
+	NS_TEST_ASSERT_MSG_EQ (cache.GetSize (), 4, "Cache above its capacity");
+
+	// a new capacity drops the entries
+	cache.SetCapacity (8);
+	NS_TEST_ASSERT_MSG_EQ (cache.GetCapacity (), 8, "Capacity not changed");
+	NS_TEST_ASSERT_MSG_EQ (cache.GetSize (), 0, "Entries kept after a change of capacity");
+	NS_TEST_ASSERT_MSG_EQ (cache.Contains (ObstructedLossKey (7, 0, 0, 0, 0, 0)), false, "Entry kept after a change of capacity");
+}
+
+/**
+ * \brief The grid index against the range tree
+ */
+class ObstacleGridIndexTestCase : public TestCase
+{
+public:
+	ObstacleGridIndexTestCase ();
+	virtual ~ObstacleGridIndexTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleGridIndexTestCase::ObstacleGridIndexTestCase ()
+	: TestCase ("Obstructed loss with the grid index")
+{
+}
+
+ObstacleGridIndexTestCase::~ObstacleGridIndexTestCase ()
+{
+}
+
+void
+ObstacleGridIndexTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.Load (filename);
+
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	MakeLinks (400, from, to);
+	std::vector<double> baseline;
+	ComputeLosses (topology, Topology::ENGINE_EXACT, from, to, baseline);
+
+	// the grid finds the same obstacles, but the loss of a link obstructed
+	// by several of them is that of the last one found (see SetIndexType)
+	topology.SetIndexType (Topology::INDEX_GRID);
+	NS_TEST_ASSERT_MSG_EQ (topology.GetIndexType (), Topology::INDEX_GRID, "Grid not selected");
+	std::vector<double> grid;
+	ComputeLosses (topology, Topology::ENGINE_EXACT, from, to, grid);
+	for (uint32_t i = 0; i < baseline.size (); i++)
+		{
+			NS_TEST_ASSERT_MSG_EQ ((grid[i] > 0), (baseline[i] > 0), "Grid obstruction differs on link " << i);
+		}
+	std::vector<double> losses;
+	ComputeLosses (topology, Topology::ENGINE_DOUBLE, from, to, losses);
+	for (uint32_t i = 0; i < grid.size (); i++)
+		{
+			NS_TEST_ASSERT_MSG_EQ_TOL (losses[i], grid[i], 1e-6, "Double engine differs with the grid on link " << i);
+		}
+
+	// the size of the cells changes the candidates, not the losses
+	topology.SetGridCellSize (7);
+	ComputeLosses (topology, Topology::ENGINE_DOUBLE, from, to, losses);
+	for (uint32_t i = 0; i < grid.size (); i++)
+		{
+			NS_TEST_ASSERT_MSG_EQ_TOL (losses[i], grid[i], 1e-6, "Loss differs with small cells on link " << i);
+		}
+}
+
+/**
+ * \brief Concurrent queries, each thread with its own context
+ */
+class ObstacleConcurrentTestCase : public TestCase
+{
+public:
+	ObstacleConcurrentTestCase ();
+	virtual ~ObstacleConcurrentTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleConcurrentTestCase::ObstacleConcurrentTestCase ()
+	: TestCase ("Concurrent obstructed loss queries")
+{
+}
+
+ObstacleConcurrentTestCase::~ObstacleConcurrentTestCase ()
+{
+}
+
+void
+ObstacleConcurrentTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.Load (filename);
+
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	MakeLinks (400, from, to);
+
+	// the range tree with the exact engine takes the lock, the grid with
+	// the double engine does not: both give the losses of a single thread
+	for (uint32_t index = 0; index < 2; index++)
+		{
+			Topology::Engine engine = index ? Topology::ENGINE_DOUBLE : Topology::ENGINE_EXACT;
+			topology.SetIndexType (index ? Topology::INDEX_GRID : Topology::INDEX_RANGE_TREE);
+			NS_TEST_ASSERT_MSG_EQ (topology.IsLockFree (engine), (index == 1), "Wrong lock of engine " << engine);
+
+			std::vector<double> expected;
+			ComputeLosses (topology, engine, from, to, expected);
+
+			const uint32_t nThreads = 4;
+			std::vector<double> losses (from.size ());
+			std::vector<std::thread> threads;
+			for (uint32_t t = 0; t < nThreads; t++)
+				{
+					threads.push_back (std::thread ([&, t] ()
+						{
+							TopologyQueryContext context (64);
+							for (uint32_t i = t; i < from.size (); i += nThreads)
+								{
+									losses[i] = topology.GetObstructedLossBetween (from[i], to[i], g_radius, engine, context);
+								}
+						}));
+				}
+			for (uint32_t t = 0; t < nThreads; t++)
+				{
+					threads[t].join ();
+				}
+			for (uint32_t i = 0; i < from.size (); i++)
+				{
+					NS_TEST_ASSERT_MSG_EQ (losses[i], expected[i], "Concurrent loss differs on link " << i << " with engine " << engine);
+				}
+		}
+}
+
+/**
+ * \brief The static loss matrix, built, saved and mapped back
+ */
+class ObstacleStaticLossMatrixTestCase : public TestCase
+{
+public:
+	ObstacleStaticLossMatrixTestCase ();
+	virtual ~ObstacleStaticLossMatrixTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleStaticLossMatrixTestCase::ObstacleStaticLossMatrixTestCase ()
+	: TestCase ("Static loss matrix")
+{
+}
+
+ObstacleStaticLossMatrixTestCase::~ObstacleStaticLossMatrixTestCase ()
+{
+}
+
+void
+ObstacleStaticLossMatrixTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.SetIndexType (Topology::INDEX_GRID);
+	topology.Load (filename);
+
+	// the nodes are the ends of the links, one of them without a position
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	MakeLinks (60, from, to);
+	std::vector<Vector> positions (from);
+	positions.insert (positions.end (), to.begin (), to.end ());
+	std::vector<bool> valid (positions.size (), true);
+	valid[7] = false;
+
+	StaticLossMatrix matrix;
+	NS_TEST_ASSERT_MSG_EQ (matrix.IsBuilt (), false, "Empty matrix built");
+	matrix.Build (topology, positions, valid, g_radius, Topology::ENGINE_DOUBLE, 2);
+	NS_TEST_ASSERT_MSG_EQ (matrix.IsBuilt (), true, "Matrix not built");
+	NS_TEST_ASSERT_MSG_EQ (matrix.GetNNodes (), positions.size (), "Wrong number of nodes");
+	NS_TEST_ASSERT_MSG_GT (matrix.GetNEntries (), 0, "No obstructed pair");
+
+	// every pair, in both orders, has the loss of a direct query
+	TopologyQueryContext context (0);
+	for (uint32_t a = 0; a < positions.size (); a++)
+		{
+			for (uint32_t b = 0; b < positions.size (); b++)
+				{
+					double loss = -1;
+					bool found = matrix.Lookup (a, positions[a], b, positions[b], loss);
+					NS_TEST_ASSERT_MSG_EQ (found, valid[a] && valid[b], "Wrong lookup of pair " << a << ", " << b);
+					if (found && (a != b))
+						{
+							double expected = topology.GetObstructedLossBetween (positions[a], positions[b], g_radius,
+																																	 Topology::ENGINE_DOUBLE, context);
+							NS_TEST_ASSERT_MSG_EQ_TOL (loss, expected, 1e-9, "Wrong loss of pair " << a << ", " << b);
+						}
+				}
+		}
+
+	// a node that has moved is not found
+	double loss;
+	Vector moved (positions[3].x + 1, positions[3].y, positions[3].z);
+	NS_TEST_ASSERT_MSG_EQ (matrix.Lookup (3, moved, 4, positions[4], loss), false, "Moved node found");
+
+	// the file maps back the same matrix, only with the same key
+	uint64_t key = StaticLossMatrix::GetKey (topology.GetSourceHash (), positions, valid, g_radius, Topology::ENGINE_DOUBLE);
+	std::string matrixFilename = CreateTempDirFilename ("matrix.bin");
+	NS_TEST_ASSERT_MSG_EQ (matrix.Save (matrixFilename, key), true, "Matrix not saved");
+
+	StaticLossMatrix loaded;
+	NS_TEST_ASSERT_MSG_EQ (loaded.Load (matrixFilename, key + 1), false, "Matrix loaded with another key");
+	NS_TEST_ASSERT_MSG_EQ (loaded.IsBuilt (), false, "Matrix built with another key");
+	NS_TEST_ASSERT_MSG_EQ (loaded.Load (matrixFilename, key), true, "Matrix not loaded");
+	NS_TEST_ASSERT_MSG_EQ (loaded.GetNNodes (), matrix.GetNNodes (), "Wrong number of loaded nodes");
+	NS_TEST_ASSERT_MSG_EQ (loaded.GetNEntries (), matrix.GetNEntries (), "Wrong number of loaded entries");
+	for (uint32_t a = 0; a < positions.size (); a++)
+		{
+			for (uint32_t b = 0; b < positions.size (); b++)
+				{
+					double expected = -1;
+					double loss = -1;
+					bool found = matrix.Lookup (a, positions[a], b, positions[b], expected);
+					NS_TEST_ASSERT_MSG_EQ (loaded.Lookup (a, positions[a], b, positions[b], loss), found,
+																 "Wrong lookup of loaded pair " << a << ", " << b);
+					NS_TEST_ASSERT_MSG_EQ (loss, expected, "Wrong loaded loss of pair " << a << ", " << b);
+				}
+		}
+
+	// a truncated file is rejected
+	std::ifstream in (matrixFilename.c_str (), std::ios::binary);
+	std::string bytes ((std::istreambuf_iterator<char> (in)), std::istreambuf_iterator<char> ());
+	in.close ();
+	std::ofstream out (matrixFilename.c_str (), std::ios::binary | std::ios::trunc);
+	out.write (bytes.data (), bytes.size () - 8);
+	out.close ();
+	NS_TEST_ASSERT_MSG_EQ (loaded.Load (matrixFilename, key), false, "Truncated matrix loaded");
+}
+
+/**
+ * \brief Compiled buildings, loaded with their grid in place, and
+ * corrupted grids rejected
+ */
+class ObstacleCompiledTestCase : public TestCase
+{
+public:
+	ObstacleCompiledTestCase ();
+	virtual ~ObstacleCompiledTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleCompiledTestCase::ObstacleCompiledTestCase ()
+	: TestCase ("Compiled buildings")
+{
+}
+
+ObstacleCompiledTestCase::~ObstacleCompiledTestCase ()
+{
+}
+
+void
+ObstacleCompiledTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	std::string compiledFilename = CreateTempDirFilename ("city.obstacles");
+	WriteCity (filename);
+
+	NS_TEST_ASSERT_MSG_EQ (Topology::CompileBuildings (filename, compiledFilename), true, "Compilation failed");
+	NS_TEST_ASSERT_MSG_EQ (Topology::IsCompiled (compiledFilename), true, "Compiled file not recognized");
+	NS_TEST_ASSERT_MSG_EQ (Topology::IsCompiled (filename), false, "Polygon file taken as compiled");
+
+	Topology original;
+	original.SetIndexType (Topology::INDEX_GRID);
+	original.Load (filename);
+	Topology compiled;
+	compiled.SetIndexType (Topology::INDEX_GRID);
+	compiled.Load (compiledFilename);
+
+	NS_TEST_ASSERT_MSG_EQ (compiled.GetNObstacles (), original.GetNObstacles (), "Wrong number of obstacles");
+	NS_TEST_ASSERT_MSG_EQ (compiled.GetContentHash (), original.GetContentHash (), "Obstacles differ");
+	for (uint32_t i = 0; i < original.GetNObstacles (); i++)
+		{
+			NS_TEST_ASSERT_MSG_EQ (compiled.GetObstacle (i).GetHeight (), original.GetObstacle (i).GetHeight (),
+														 "Height differs on obstacle " << i);
+			NS_TEST_ASSERT_MSG_EQ (compiled.GetObstacle (i).GetVertices ().size (), original.GetObstacle (i).GetVertices ().size (),
+														 "Vertices differ on obstacle " << i);
+		}
+
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	MakeLinks (200, from, to);
+	std::vector<double> expected;
+	std::vector<double> losses;
+	ComputeLosses (original, Topology::ENGINE_DOUBLE, from, to, expected);
+	ComputeLosses (compiled, Topology::ENGINE_DOUBLE, from, to, losses);
+	for (uint32_t i = 0; i < expected.size (); i++)
+		{
+			NS_TEST_ASSERT_MSG_EQ_TOL (losses[i], expected[i], 1e-9, "Loss differs on link " << i);
+		}
+
+	// a truncated file is not taken as compiled
+	std::ofstream truncated (CreateTempDirFilename ("truncated.obstacles").c_str (), std::ios::binary);
+	truncated << "OBS";
+	truncated.close ();
+	NS_TEST_ASSERT_MSG_EQ (Topology::IsCompiled (CreateTempDirFilename ("truncated.obstacles")), false,
+												 "Truncated file taken as compiled");
+
+	// a written grid is attached only to as many obstacles as it refers to
+	std::vector<Obstacle> obstacles;
+	for (uint32_t i = 0; i < original.GetNObstacles (); i++)
+		{
+			obstacles.push_back (original.GetObstacle (i));
+		}
+	ObstacleGridIndex grid;
+	grid.Build (obstacles, 50);
+	std::ostringstream os;
+	grid.Write (os);
+	std::string bytes = os.str ();
+	std::vector<uint64_t> data (bytes.size () / 8);
+	std::memcpy (data.data (), bytes.data (), bytes.size ());
+
+	ObstacleGridIndex attached;
+	NS_TEST_ASSERT_MSG_EQ (attached.Attach ((const uint8_t *) data.data (), bytes.size (), obstacles.size ()),
+												 bytes.size (), "Grid not attached");
+	NS_TEST_ASSERT_MSG_EQ (attached.GetNCells (), grid.GetNCells (), "Wrong number of attached cells");
+	ObstacleGridIndex rejected;
+	NS_TEST_ASSERT_MSG_EQ (rejected.Attach ((const uint8_t *) data.data (), bytes.size (), obstacles.size () - 1),
+												 0, "Grid attached to fewer obstacles");
+
+	// the cell starts follow the header (40 bytes): the first out of order
+	uint32_t *cellStart = (uint32_t *) ((uint8_t *) data.data () + 40);
+	cellStart[1] = 0xffffffff;
+	NS_TEST_ASSERT_MSG_EQ (rejected.Attach ((const uint8_t *) data.data (), bytes.size (), obstacles.size ()),
+												 0, "Grid with cell starts out of order attached");
+	NS_TEST_ASSERT_MSG_EQ (rejected.Attach ((const uint8_t *) data.data (), 40, obstacles.size ()),
+												 0, "Truncated grid attached");
+}
+
+/**
+ * \brief The polygon file parsed by one thread and by several
+ */
+class ObstacleParallelLoadTestCase : public TestCase
+{
+public:
+	ObstacleParallelLoadTestCase ();
+	virtual ~ObstacleParallelLoadTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleParallelLoadTestCase::ObstacleParallelLoadTestCase ()
+	: TestCase ("Parallel load of the polygon file")
+{
+}
+
+ObstacleParallelLoadTestCase::~ObstacleParallelLoadTestCase ()
+{
+}
+
+void
+ObstacleParallelLoadTestCase::DoRun (void)
+{
+	// a file large enough to be split in several chunks
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename, 80);
+
+	Topology sequential;
+	sequential.SetLoadThreads (1);
+	sequential.Load (filename);
+	Topology parallel;
+	parallel.SetLoadThreads (4);
+	parallel.Load (filename);
+
+	// the same obstacles, in the order of the file
+	NS_TEST_ASSERT_MSG_EQ (sequential.GetNObstacles (), 2 * 80 * 80, "Wrong number of obstacles");
+	NS_TEST_ASSERT_MSG_EQ (parallel.GetNObstacles (), sequential.GetNObstacles (), "Wrong number of obstacles in parallel");
+	for (uint32_t i = 0; i < sequential.GetNObstacles (); i++)
+		{
+			Obstacle &expected = sequential.GetObstacle (i);
+			Obstacle &obstacle = parallel.GetObstacle (i);
+			NS_TEST_ASSERT_MSG_EQ (obstacle.GetId (), expected.GetId (), "Id differs on obstacle " << i);
+			NS_TEST_ASSERT_MSG_EQ (obstacle.GetHeight (), expected.GetHeight (), "Height differs on obstacle " << i);
+			NS_TEST_ASSERT_MSG_EQ (obstacle.GetVertices ().size (), expected.GetVertices ().size (),
+														 "Vertices differ on obstacle " << i);
+			for (uint32_t v = 0; v < expected.GetVertices ().size (); v++)
+				{
+					NS_TEST_ASSERT_MSG_EQ (obstacle.GetVertices ()[v].x, expected.GetVertices ()[v].x, "Vertex differs on obstacle " << i);
+					NS_TEST_ASSERT_MSG_EQ (obstacle.GetVertices ()[v].y, expected.GetVertices ()[v].y, "Vertex differs on obstacle " << i);
+				}
+		}
+	NS_TEST_ASSERT_MSG_EQ (parallel.GetSourceHash (), sequential.GetSourceHash (), "Source hash differs");
+}
+
+/**
+ * \brief The slab edge table of the footprints against the crossing
+ * number test, and the links entering a building from the roof
+ */
+class ObstacleFootprintTestCase : public TestCase
+{
+public:
+	ObstacleFootprintTestCase ();
+	virtual ~ObstacleFootprintTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleFootprintTestCase::ObstacleFootprintTestCase ()
+	: TestCase ("Footprints and roofs of the obstacles")
+{
+}
+
+ObstacleFootprintTestCase::~ObstacleFootprintTestCase ()
+{
+}
+
+void
+ObstacleFootprintTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.Load (filename);
+
+	// points on a grid around each footprint, also on its edges and
+	// vertices, with the outcome of PointInFootprint
+	uint32_t nHit = 0;
+	uint32_t nDegenerate = 0;
+	for (uint32_t i = 0; i < topology.GetNObstacles (); i++)
+		{
+			Obstacle &obstacle = topology.GetObstacle (i);
+			const VertexList &vertices = obstacle.GetVertices ();
+			double x0 = vertices[0].x - 5;
+			double y0 = vertices[0].y - 5;
+			for (double x = x0; x <= x0 + 50; x += 2.5)
+				{
+					for (double y = y0; y <= y0 + 30; y += 2.5)
+						{
+							WallHit expected = PointInFootprint (vertices, x, y);
+							NS_TEST_ASSERT_MSG_EQ (obstacle.GetFootprint ().Contains (x, y), expected,
+																		 "Footprint of obstacle " << i << " differs at " << x << ", " << y);
+							nHit += (expected == WALL_HIT);
+							nDegenerate += (expected == WALL_DEGENERATE);
+						}
+				}
+		}
+	NS_TEST_ASSERT_MSG_GT (nHit, 0, "No point inside a footprint");
+	NS_TEST_ASSERT_MSG_GT (nDegenerate, 0, "No point on a border");
+
+	// links from above the roof of b0_0a (x 20..60, y 20..38, 5 m) down
+	// to the street, through its roof and one of its walls
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	from.push_back (Vector (40, 29, 6));
+	to.push_back (Vector (40, 10, 1.5));
+	from.push_back (Vector (30, 25, 8));
+	to.push_back (Vector (70, 30, 1.5));
+	from.push_back (Vector (50, 35, 6));
+	to.push_back (Vector (10, 35, 1.5));
+	std::vector<double> expected;
+	std::vector<double> losses;
+	ComputeLosses (topology, Topology::ENGINE_EXACT, from, to, expected);
+	ComputeLosses (topology, Topology::ENGINE_DOUBLE, from, to, losses);
+	for (uint32_t i = 0; i < from.size (); i++)
+		{
+			NS_TEST_ASSERT_MSG_GT (expected[i], 0, "Roof entry not obstructed on link " << i);
+			NS_TEST_ASSERT_MSG_EQ_TOL (losses[i], expected[i], 1e-6, "Double engine differs on roof entry " << i);
+		}
+}
+
+/**
+ * \brief Simplification of the footprints
+ */
+class ObstacleSimplificationTestCase : public TestCase
+{
+public:
+	ObstacleSimplificationTestCase ();
+	virtual ~ObstacleSimplificationTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleSimplificationTestCase::ObstacleSimplificationTestCase ()
+	: TestCase ("Simplification of the footprints")
+{
+}
+
+ObstacleSimplificationTestCase::~ObstacleSimplificationTestCase ()
+{
+}
+
+void
+ObstacleSimplificationTestCase::DoRun (void)
+{
+	// a square closed by a copy of its first vertex, with a vertex in the
+	// middle of an edge
+	std::vector<Vector2D> square;
+	square.push_back (Vector2D (0, 0));
+	square.push_back (Vector2D (5, 0));
+	square.push_back (Vector2D (10, 0));
+	square.push_back (Vector2D (10, 10));
+	square.push_back (Vector2D (0, 10));
+	square.push_back (Vector2D (0, 0));
+
+	std::vector<Vector2D> out;
+	NS_TEST_ASSERT_MSG_EQ (SimplifyFootprint (VertexList (square), 0, out), true, "Square not simplified");
+	NS_TEST_ASSERT_MSG_EQ (out.size (), 4, "Collinear or closing vertex kept");
+	NS_TEST_ASSERT_MSG_EQ (IsSimpleFootprint (VertexList (out)), true, "Square not simple");
+	NS_TEST_ASSERT_MSG_EQ (out[0].x, 0, "Wrong first vertex");
+	NS_TEST_ASSERT_MSG_EQ (out[1].x, 10, "Collinear vertex kept");
+
+	// a bump of 10 cm on an edge: removed only within the tolerance
+	square.insert (square.begin () + 3, Vector2D (10.1, 5));
+	NS_TEST_ASSERT_MSG_EQ (SimplifyFootprint (VertexList (square), 0.05, out), true, "Bump not simplified");
+	NS_TEST_ASSERT_MSG_EQ (out.size (), 5, "Bump beyond the tolerance removed");
+	NS_TEST_ASSERT_MSG_EQ (SimplifyFootprint (VertexList (square), 0.5, out), true, "Bump not simplified");
+	NS_TEST_ASSERT_MSG_EQ (out.size (), 4, "Bump within the tolerance kept");
+
+	// a self-intersecting footprint is kept as it is
+	std::vector<Vector2D> bowtie;
+	bowtie.push_back (Vector2D (0, 0));
+	bowtie.push_back (Vector2D (10, 10));
+	bowtie.push_back (Vector2D (10, 0));
+	bowtie.push_back (Vector2D (0, 10));
+	NS_TEST_ASSERT_MSG_EQ (IsSimpleFootprint (VertexList (bowtie)), false, "Bow tie simple");
+	NS_TEST_ASSERT_MSG_EQ (SimplifyFootprint (VertexList (bowtie), 0.5, out), false, "Bow tie simplified");
+	NS_TEST_ASSERT_MSG_EQ (out.size (), bowtie.size (), "Bow tie changed");
+	for (uint32_t i = 0; i < bowtie.size (); i++)
+		{
+			NS_TEST_ASSERT_MSG_EQ (out[i].x, bowtie[i].x, "Bow tie changed at vertex " << i);
+			NS_TEST_ASSERT_MSG_EQ (out[i].y, bowtie[i].y, "Bow tie changed at vertex " << i);
+		}
+}
+
+/**
+ * \brief The rules of the obstacle types, read from a file and applied
+ * to a polygon file
+ */
+class ObstacleTypeRulesTestCase : public TestCase
+{
+public:
+	ObstacleTypeRulesTestCase ();
+	virtual ~ObstacleTypeRulesTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleTypeRulesTestCase::ObstacleTypeRulesTestCase ()
+	: TestCase ("Rules of the obstacle types")
+{
+}
+
+ObstacleTypeRulesTestCase::~ObstacleTypeRulesTestCase ()
+{
+}
+
+void
+ObstacleTypeRulesTestCase::DoRun (void)
+{
+	std::string rulesFilename = CreateTempDirFilename ("types.txt");
+	std::ofstream rulesFile (rulesFilename.c_str ());
+	rulesFile << "# type       action   beta  gamma  height" << std::endl
+						<< "building      include  12    0.5    10" << std::endl
+						<< "building:part merge" << std::endl
+						<< std::endl
+						<< "residential   exclude  # land use" << std::endl;
+	rulesFile.close ();
+
+	ObstacleTypeRules rules;
+	NS_TEST_ASSERT_MSG_EQ (rules.Load (rulesFilename), true, "Rules file not read");
+	NS_TEST_ASSERT_MSG_EQ (rules.GetNRules (), 4, "Wrong number of rules");
+
+	// the type itself, or the longest type it starts with, or the default
+	NS_TEST_ASSERT_MSG_EQ (rules.Lookup ("building").action, ObstacleTypeRules::INCLUDE, "Wrong rule of building");
+	NS_TEST_ASSERT_MSG_EQ (rules.Lookup ("building").beta, 12, "Wrong beta of building");
+	NS_TEST_ASSERT_MSG_EQ (rules.Lookup ("building").height, 10, "Wrong height of building");
+	NS_TEST_ASSERT_MSG_EQ (rules.Lookup ("building.yes").beta, 12, "Prefix of building.yes not matched");
+	NS_TEST_ASSERT_MSG_EQ (rules.Lookup ("building:part").action, ObstacleTypeRules::MERGE, "Wrong rule of building:part");
+	NS_TEST_ASSERT_MSG_EQ (rules.Lookup ("building:part").beta, 12, "Rule of building:part not based on building");
+	NS_TEST_ASSERT_MSG_EQ (rules.Lookup ("residential").action, ObstacleTypeRules::EXCLUDE, "Wrong rule of residential");
+	NS_TEST_ASSERT_MSG_EQ (rules.Lookup ("unknown").action, ObstacleTypeRules::INCLUDE, "Default rule of unknown lost");
+	NS_TEST_ASSERT_MSG_EQ (rules.Lookup ("water").action, ObstacleTypeRules::EXCLUDE, "Wrong default rule");
+
+	// malformed lines are rejected
+	ObstacleTypeRules rejected;
+	rulesFile.open (rulesFilename.c_str ());
+	rulesFile << "building  keep" << std::endl;
+	rulesFile.close ();
+	NS_TEST_ASSERT_MSG_EQ (rejected.Load (rulesFilename), false, "Unknown action accepted");
+	rulesFile.open (rulesFilename.c_str ());
+	rulesFile << "building  include  12  0.5  10  3" << std::endl;
+	rulesFile.close ();
+	NS_TEST_ASSERT_MSG_EQ (rejected.Load (rulesFilename), false, "Extra value accepted");
+	NS_TEST_ASSERT_MSG_EQ (rejected.Load (CreateTempDirFilename ("missing.txt")), false, "Missing file accepted");
+
+	// a building, a part over it and one alone, a residential area and a
+	// building without height
+	std::string filename = CreateTempDirFilename ("types.poly.xml");
+	std::ofstream file (filename.c_str ());
+	file << "<?xml version=\"1.0\"?>\n<additional>\n"
+			 << "\t<poly id=\"b1\" type=\"building\" height=\"10\" shape=\"0,0 20,0 20,20 0,20 0,0\"/>\n"
+			 << "\t<poly id=\"p1\" type=\"building:part\" height=\"25\" shape=\"5,5 15,5 15,15 5,15 5,5\"/>\n"
+			 << "\t<poly id=\"p2\" type=\"building:part\" height=\"7\" shape=\"100,0 110,0 110,10 100,10 100,0\"/>\n"
+			 << "\t<poly id=\"r1\" type=\"residential\" height=\"3\" shape=\"200,0 300,0 300,100 200,100 200,0\"/>\n"
+			 << "\t<poly id=\"u1\" type=\"building.yes\" shape=\"0,100 20,100 20,120 0,120 0,100\"/>\n"
+			 << "</additional>\n";
+	file.close ();
+
+	Topology topology;
+	topology.SetTypeRules (rules);
+	topology.Load (filename);
+	NS_TEST_ASSERT_MSG_EQ (topology.GetNObstacles (), 3, "Wrong number of obstacles");
+	for (uint32_t i = 0; i < topology.GetNObstacles (); i++)
+		{
+			Obstacle &obstacle = topology.GetObstacle (i);
+			NS_TEST_ASSERT_MSG_EQ (obstacle.GetBeta (), 12, "Wrong beta of " << obstacle.GetId ());
+			NS_TEST_ASSERT_MSG_EQ (obstacle.GetGamma (), 0.5, "Wrong gamma of " << obstacle.GetId ());
+			if (obstacle.GetId () == "b1")
+				{
+					NS_TEST_ASSERT_MSG_EQ (obstacle.GetHeight (), 25, "Part not merged into b1");
+				}
+			else if (obstacle.GetId () == "p2")
+				{
+					NS_TEST_ASSERT_MSG_EQ (obstacle.GetHeight (), 7, "Wrong height of p2");
+				}
+			else
+				{
+					NS_TEST_ASSERT_MSG_EQ (obstacle.GetId (), "u1", "Wrong obstacle");
+					NS_TEST_ASSERT_MSG_EQ (obstacle.GetHeight (), 10, "Default height not applied to u1");
+				}
+		}
+}
+
+/**
+ * \brief The losses of a transmitter to many receivers, in one query
+ */
+class ObstacleBatchTestCase : public TestCase
+{
+public:
+	ObstacleBatchTestCase ();
+	virtual ~ObstacleBatchTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleBatchTestCase::ObstacleBatchTestCase ()
+	: TestCase ("Obstructed loss of a batch of receivers")
+{
+}
+
+ObstacleBatchTestCase::~ObstacleBatchTestCase ()
+{
+}
+
+void
+ObstacleBatchTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.SetIndexType (Topology::INDEX_GRID);
+	topology.Load (filename);
+
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	MakeLinks (400, from, to);
+
+	// a few transmitters, with both engines: the losses of the queries
+	// of each pair, uncached, then from the cache of the first batch
+	for (uint32_t e = 0; e < 2; e++)
+		{
+			Topology::Engine engine = e ? Topology::ENGINE_DOUBLE : Topology::ENGINE_EXACT;
+			for (uint32_t t = 0; t < 4; t++)
+				{
+					TopologyQueryContext uncached (0);
+					TopologyQueryContext context (1024);
+					std::vector<double> batch;
+					std::vector<double> cached;
+					topology.GetObstructedLossBatch (from[t], to, g_radius, engine, batch, uncached);
+					topology.GetObstructedLossBatch (from[t], to, g_radius, engine, cached, context);
+					topology.GetObstructedLossBatch (from[t], to, g_radius, engine, cached, context);
+					NS_TEST_ASSERT_MSG_EQ (batch.size (), to.size (), "Wrong number of losses in a batch");
+					NS_TEST_ASSERT_MSG_EQ (cached.size (), to.size (), "Wrong number of cached losses in a batch");
+					for (uint32_t i = 0; i < to.size (); i++)
+						{
+							double loss = topology.GetObstructedLossBetween (from[t], to[i], g_radius, engine, uncached);
+							NS_TEST_ASSERT_MSG_EQ_TOL (batch[i], loss, 1e-9, "Batch of engine " << engine << " differs on receiver " << i);
+							NS_TEST_ASSERT_MSG_EQ (cached[i], batch[i], "Cached batch of engine " << engine << " differs on receiver " << i);
+						}
+				}
+		}
+}
+
+/**
+ * \brief The loss between two nodes, reused by the model while neither
+ * has moved farther than the movement threshold
+ */
+class ObstacleNodeCacheTestCase : public TestCase
+{
+public:
+	ObstacleNodeCacheTestCase ();
+	virtual ~ObstacleNodeCacheTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleNodeCacheTestCase::ObstacleNodeCacheTestCase ()
+	: TestCase ("Node pair loss cache")
+{
+}
+
+ObstacleNodeCacheTestCase::~ObstacleNodeCacheTestCase ()
+{
+}
+
+void
+ObstacleNodeCacheTestCase::DoRun (void)
+{
+	// the key of a pair does not depend on the order of the nodes
+	NS_TEST_ASSERT_MSG_EQ ((NodePairKey (3, 5) == NodePairKey (5, 3)), true, "Swapped key differs");
+	NS_TEST_ASSERT_MSG_EQ (NodePairKeyHash () (NodePairKey (3, 5)), NodePairKeyHash () (NodePairKey (5, 3)),
+												 "Swapped key hashed differently");
+
+	NodePairLoss entry;
+	entry.m_loss = 10;
+	entry.m_pa = Vector (0, 0, 0);
+	entry.m_pb = Vector (100, 0, 0);
+	NS_TEST_ASSERT_MSG_EQ (entry.IsValid (Vector (0.5, 0, 0), Vector (100, 0.5, 0), 1), true, "Entry not valid within the threshold");
+	NS_TEST_ASSERT_MSG_EQ (entry.IsValid (Vector (0, 0, 0), Vector (100, 0, 1.5), 1), false, "Entry valid beyond the threshold");
+	NS_TEST_ASSERT_MSG_EQ (entry.IsValid (Vector (100, 0, 0), Vector (0, 0, 0), 1), false, "Entry valid with the nodes swapped");
+
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology *topology = Topology::GetTopology ();
+	topology->Load (filename);
+
+	// a link through b0_0a (x 20..60, y 20..38) at an angle, so that the
+	// length within the building, and the loss, change as a node moves
+	Ptr<Node> nodeA = CreateObject<Node> ();
+	Ptr<Node> nodeB = CreateObject<Node> ();
+	Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+	Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+	nodeA->AggregateObject (a);
+	nodeB->AggregateObject (b);
+	Vector pa (10, 22, 1.5);
+	Vector pb (70, 30, 1.5);
+	a->SetPosition (pa);
+	b->SetPosition (pb);
+
+	Ptr<ObstacleShadowingPropagationLossModel> model = CreateObject<ObstacleShadowingPropagationLossModel> ();
+	model->SetAttribute ("Radius", DoubleValue (g_radius));
+	model->SetAttribute ("Engine", EnumValue (Topology::ENGINE_DOUBLE));
+	model->SetAttribute ("MovementThreshold", DoubleValue (1.0));
+	model->SetNodeCacheCapacity (16);
+
+	TopologyQueryContext context (0);
+	double loss = model->GetLoss (a, b);
+	NS_TEST_ASSERT_MSG_GT (loss, 0, "Link not obstructed");
+	NS_TEST_ASSERT_MSG_EQ_TOL (loss, topology->GetObstructedLossBetween (pa, pb, g_radius, Topology::ENGINE_DOUBLE, context),
+														 1e-9, "Wrong loss of the first evaluation");
+
+	// both nodes moved less than the threshold: the same loss, in both
+	// orders, although it has changed
+	b->SetPosition (Vector (pb.x, pb.y + 0.5, pb.z));
+	double moved = topology->GetObstructedLossBetween (pa, b->GetPosition (), g_radius, Topology::ENGINE_DOUBLE, context);
+	NS_TEST_ASSERT_MSG_GT (std::abs (moved - loss), 1e-6, "Loss not changed by the movement");
+	NS_TEST_ASSERT_MSG_EQ (model->GetLoss (a, b), loss, "Loss not reused below the threshold");
+	NS_TEST_ASSERT_MSG_EQ (model->GetLoss (b, a), loss, "Loss not reused with the nodes swapped");
+	a->SetPosition (Vector (pa.x + 0.5, pa.y, pa.z));
+	NS_TEST_ASSERT_MSG_EQ (model->GetLoss (b, a), loss, "Loss not reused with both nodes moved");
+
+	// a node moved beyond the threshold: computed again, then reused
+	// from the new positions
+	b->SetPosition (Vector (pb.x, pb.y + 2.5, pb.z));
+	moved = topology->GetObstructedLossBetween (b->GetPosition (), a->GetPosition (), g_radius, Topology::ENGINE_DOUBLE, context);
+	NS_TEST_ASSERT_MSG_GT (std::abs (moved - loss), 1e-6, "Loss not changed by the movement");
+	NS_TEST_ASSERT_MSG_EQ_TOL (model->GetLoss (b, a), moved, 1e-9, "Loss not computed again beyond the threshold");
+	b->SetPosition (Vector (pb.x, pb.y + 3, pb.z));
+	NS_TEST_ASSERT_MSG_EQ_TOL (model->GetLoss (a, b), moved, 1e-9, "Loss not reused from the new positions");
+
+	// without the cache every evaluation is computed
+	model->SetNodeCacheCapacity (0);
+	moved = topology->GetObstructedLossBetween (a->GetPosition (), b->GetPosition (), g_radius, Topology::ENGINE_DOUBLE, context);
+	NS_TEST_ASSERT_MSG_EQ_TOL (model->GetLoss (a, b), moved, 1e-9, "Loss reused without the cache");
+}
+
+/**
+ * \brief The raster engine against the exact engine
+ */
+class ObstacleRasterTestCase : public TestCase
+{
+public:
+	ObstacleRasterTestCase ();
+	virtual ~ObstacleRasterTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleRasterTestCase::ObstacleRasterTestCase ()
+	: TestCase ("Obstructed loss of the raster engine")
+{
+}
+
+ObstacleRasterTestCase::~ObstacleRasterTestCase ()
+{
+}
+
+void
+ObstacleRasterTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.Load (filename);
+
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	MakeLinks (400, from, to);
+	std::vector<double> baseline;
+	ComputeLosses (topology, Topology::ENGINE_EXACT, from, to, baseline);
+
+	NS_TEST_ASSERT_MSG_EQ (topology.HasRaster (), false, "Raster built before MakeRaster");
+	topology.MakeRaster (0.25);
+	NS_TEST_ASSERT_MSG_EQ (topology.HasRaster (), true, "Raster not built");
+
+	// approximate: a link may graze a corner on one raster cell and miss
+	// it on the other engine, but only a few of them
+	std::vector<double> losses;
+	ComputeLosses (topology, Topology::ENGINE_RASTER, from, to, losses);
+	uint32_t nDisagree = 0;
+	for (uint32_t i = 0; i < baseline.size (); i++)
+		{
+			nDisagree += ((losses[i] > 0) != (baseline[i] > 0));
+		}
+	NS_TEST_ASSERT_MSG_LT (nDisagree, baseline.size () / 50 + 1, "Raster obstruction differs on too many links");
+
+	RasterValidationReport report = topology.ValidateRaster (200, g_radius);
+	NS_TEST_ASSERT_MSG_EQ (report.nSamples, 200, "Wrong number of validation samples");
+	NS_TEST_ASSERT_MSG_LT (report.nDisagree, report.nSamples / 50 + 1, "Raster validation differs on too many segments");
+}
+
+/**
+ * \brief The cells of the grid skipped below the links that pass over
+ * their roofs
+ */
+class ObstacleGridHeightTestCase : public TestCase
+{
+public:
+	ObstacleGridHeightTestCase ();
+	virtual ~ObstacleGridHeightTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleGridHeightTestCase::ObstacleGridHeightTestCase ()
+	: TestCase ("Maximum height of the cells of the grid")
+{
+}
+
+ObstacleGridHeightTestCase::~ObstacleGridHeightTestCase ()
+{
+}
+
+void
+ObstacleGridHeightTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.SetIndexType (Topology::INDEX_GRID);
+	topology.Load (filename);
+
+	std::vector<Obstacle> obstacles;
+	for (uint32_t i = 0; i < topology.GetNObstacles (); i++)
+		{
+			obstacles.push_back (topology.GetObstacle (i));
+		}
+	ObstacleGridIndex grid;
+	grid.Build (obstacles, 50);
+
+	// a segment along a row of blocks: every obstacle taller than the
+	// lowest height is found, none above the tallest roof (37 m)
+	std::vector<uint32_t> all;
+	grid.Query (0, 29, 500, 29, all);
+	NS_TEST_ASSERT_MSG_GT (all.size (), 0, "No obstacle along the row");
+	for (double height = 0; height < 40; height += 4)
+		{
+			std::vector<uint32_t> found;
+			grid.Query (0, 29, 500, 29, found, height);
+			for (uint32_t i = 0; i < all.size (); i++)
+				{
+					if (obstacles[all[i]].GetHeight () > height)
+						{
+							NS_TEST_ASSERT_MSG_EQ (std::binary_search (found.begin (), found.end (), all[i]), true,
+																		 "Obstacle " << all[i] << " taller than " << height << " m skipped");
+						}
+				}
+			if (height > 37)
+				{
+					NS_TEST_ASSERT_MSG_EQ (found.size (), 0, "Obstacles found above the roofs");
+				}
+			else if (height > 30)
+				{
+					NS_TEST_ASSERT_MSG_LT (found.size (), all.size (), "No cell skipped at " << height << " m");
+				}
+		}
+
+	// the links above every roof are not obstructed
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	MakeLinks (100, from, to);
+	for (uint32_t i = 0; i < from.size (); i++)
+		{
+			from[i].z = 40;
+			to[i].z = 40;
+		}
+	std::vector<double> losses;
+	ComputeLosses (topology, Topology::ENGINE_DOUBLE, from, to, losses);
+	for (uint32_t i = 0; i < losses.size (); i++)
+		{
+			NS_TEST_ASSERT_MSG_EQ (losses[i], 0, "Link above the roofs obstructed " << i);
+		}
+}
+
+/**
+ * \brief The interned ids and the compact storage of the obstacles
+ */
+class ObstacleStorageTestCase : public TestCase
+{
+public:
+	ObstacleStorageTestCase ();
+	virtual ~ObstacleStorageTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleStorageTestCase::ObstacleStorageTestCase ()
+	: TestCase ("Storage of the obstacles")
+{
+}
+
+ObstacleStorageTestCase::~ObstacleStorageTestCase ()
+{
+}
+
+void
+ObstacleStorageTestCase::DoRun (void)
+{
+	// each id is stored once
+	NS_TEST_ASSERT_MSG_EQ (ObstacleIdPool::Intern (""), 0, "Wrong index of the empty id");
+	uint32_t index = ObstacleIdPool::Intern ("storage-test");
+	uint32_t nIds = ObstacleIdPool::GetN ();
+	NS_TEST_ASSERT_MSG_EQ (ObstacleIdPool::Intern ("storage-test"), index, "Id interned twice");
+	NS_TEST_ASSERT_MSG_EQ (ObstacleIdPool::GetN (), nIds, "Id added twice");
+	NS_TEST_ASSERT_MSG_EQ (ObstacleIdPool::Get (index), "storage-test", "Wrong id");
+
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.Load (filename);
+
+	// the obstacles of the file: their ids, and their vertices in the
+	// shared array
+	uint64_t nVertices = 0;
+	for (uint32_t i = 0; i < topology.GetNObstacles (); i++)
+		{
+			Obstacle &obstacle = topology.GetObstacle (i);
+			NS_TEST_ASSERT_MSG_EQ (ObstacleIdPool::Get (obstacle.GetIdIndex ()), obstacle.GetId (), "Wrong id of obstacle " << i);
+			nVertices += obstacle.GetVertices ().size ();
+		}
+	NS_TEST_ASSERT_MSG_EQ (topology.GetObstacle (0).GetId (), "b0_0a", "Wrong id of the first obstacle");
+
+	ObstacleMemoryReport report = topology.GetMemoryReport ();
+	NS_TEST_ASSERT_MSG_EQ (report.nObstacles, topology.GetNObstacles (), "Wrong number of obstacles in the report");
+	NS_TEST_ASSERT_MSG_EQ (report.nVertices, nVertices, "Wrong number of vertices in the report");
+	NS_TEST_ASSERT_MSG_EQ ((report.vertexBytes >= nVertices * sizeof (Vector2D)), true, "Vertices missing from the report");
+}
+
+/**
+ * \brief The obstacles loaded from tiles, within a memory budget
+ */
+class ObstacleTileStoreTestCase : public TestCase
+{
+public:
+	ObstacleTileStoreTestCase ();
+	virtual ~ObstacleTileStoreTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleTileStoreTestCase::ObstacleTileStoreTestCase ()
+	: TestCase ("Tile store of the obstacles")
+{
+}
+
+ObstacleTileStoreTestCase::~ObstacleTileStoreTestCase ()
+{
+}
+
+void
+ObstacleTileStoreTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	std::string directory = CreateTempDirFilename ("tiles");
+	WriteCity (filename);
+	NS_TEST_ASSERT_MSG_EQ (Topology::CompileTiles (filename, directory, 100), true, "Tiles not written");
+	std::string indexFilename = ObstacleTileStore::GetIndexFilename (directory);
+	NS_TEST_ASSERT_MSG_EQ (ObstacleTileStore::IsTileStore (indexFilename), true, "Index not recognized");
+
+	Topology original;
+	original.SetIndexType (Topology::INDEX_GRID);
+	original.Load (filename);
+	Topology tiled;
+	tiled.Load (indexFilename);
+	NS_TEST_ASSERT_MSG_EQ ((tiled.GetTileStore () != 0), true, "Tile store not opened");
+	NS_TEST_ASSERT_MSG_EQ (tiled.GetTileStore ()->GetNObstacles (), original.GetNObstacles (), "Wrong number of obstacles");
+	NS_TEST_ASSERT_MSG_EQ (tiled.GetTileStore ()->GetContentHash (), original.GetContentHash (), "Obstacles differ");
+
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	MakeLinks (300, from, to);
+	std::vector<double> expected;
+	std::vector<double> losses;
+	ComputeLosses (original, Topology::ENGINE_DOUBLE, from, to, expected);
+	ComputeLosses (tiled, Topology::ENGINE_DOUBLE, from, to, losses);
+	for (uint32_t i = 0; i < expected.size (); i++)
+		{
+			NS_TEST_ASSERT_MSG_EQ_TOL (losses[i], expected[i], 1e-9, "Tiled loss differs on link " << i);
+		}
+	uint32_t nTiles = tiled.GetTileStore ()->GetNTiles ();
+	NS_TEST_ASSERT_MSG_GT (nTiles, 4, "Too few tiles");
+	NS_TEST_ASSERT_MSG_EQ (tiled.GetTileStore ()->GetNLoaded (), nTiles, "Tiles dropped within the budget");
+
+	// a budget of a few bytes: the tiles of each query are dropped at
+	// the next one and loaded again, with the same losses (a smaller
+	// radius, so that a query needs only some of the tiles)
+	ObstacleTileStore store;
+	NS_TEST_ASSERT_MSG_EQ (store.Open (indexFilename, 1), true, "Index not read");
+	NS_TEST_ASSERT_MSG_EQ (store.GetNLoaded (), 0, "Tiles loaded by Open");
+	TopologyQueryContext context (0);
+	uint32_t nObstructed = 0;
+	for (uint32_t i = 0; i < from.size (); i++)
+		{
+			double radius = 60;
+			double loss = store.GetObstructedLossBetween (from[i], to[i], radius, Topology::ENGINE_DOUBLE, context);
+			double expectedLoss = original.GetObstructedLossBetween (from[i], to[i], radius, Topology::ENGINE_DOUBLE, context);
+			NS_TEST_ASSERT_MSG_EQ_TOL (loss, expectedLoss, 1e-9, "Loss within the budget differs on link " << i);
+			NS_TEST_ASSERT_MSG_LT (store.GetNLoaded (), nTiles, "No tile dropped beyond the budget");
+			nObstructed += (loss > 0);
+		}
+	NS_TEST_ASSERT_MSG_GT (nObstructed, 0, "No obstructed link within the budget");
+}
+
+/**
+ * \brief The queries from a fixed point, through the sectors around it
+ */
+class ObstacleFixedPointTestCase : public TestCase
+{
+public:
+	ObstacleFixedPointTestCase ();
+	virtual ~ObstacleFixedPointTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleFixedPointTestCase::ObstacleFixedPointTestCase ()
+	: TestCase ("Obstructed loss from a fixed point")
+{
+}
+
+ObstacleFixedPointTestCase::~ObstacleFixedPointTestCase ()
+{
+}
+
+void
+ObstacleFixedPointTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.SetIndexType (Topology::INDEX_GRID);
+	topology.Load (filename);
+
+	// a sensor in the middle of the city, at two heights, and the
+	// receivers of the links, in both directions
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	MakeLinks (300, from, to);
+	Vector sensor (250, 79, 1.5);
+	std::vector<Vector> sensors;
+	std::vector<Vector> receivers;
+	for (uint32_t i = 0; i < to.size (); i++)
+		{
+			sensors.push_back (Vector (sensor.x, sensor.y, (i % 3) ? sensor.z : 20));
+			receivers.push_back (to[i]);
+			sensors.push_back (to[i]);
+			receivers.push_back (Vector (sensor.x, sensor.y, (i % 3) ? sensor.z : 20));
+		}
+
+	for (uint32_t e = 0; e < 2; e++)
+		{
+			Topology::Engine engine = e ? Topology::ENGINE_DOUBLE : Topology::ENGINE_EXACT;
+			std::vector<double> expected;
+			ComputeLosses (topology, engine, sensors, receivers, expected);
+			TopologyQueryContext context (0);
+			double expectedOther = topology.GetObstructedLossBetween (sensor, to[0], 100, engine, context);
+
+			topology.AddFixedPoint (sensor, g_radius);
+			topology.AddFixedPoint (sensor, g_radius);
+			NS_TEST_ASSERT_MSG_EQ (topology.GetNFixedPoints (), 1, "Fixed point registered twice");
+
+			std::vector<double> losses;
+			ComputeLosses (topology, engine, sensors, receivers, losses);
+			uint32_t nObstructed = 0;
+			for (uint32_t i = 0; i < expected.size (); i++)
+				{
+					NS_TEST_ASSERT_MSG_EQ_TOL (losses[i], expected[i], 1e-6, "Loss of engine " << engine << " from the fixed point differs on link " << i);
+					nObstructed += (expected[i] > 0);
+				}
+			NS_TEST_ASSERT_MSG_GT (nObstructed, 0, "No link from the fixed point obstructed");
+
+			// another radius does not use the sectors
+			NS_TEST_ASSERT_MSG_EQ_TOL (topology.GetObstructedLossBetween (sensor, to[0], 100, engine, context),
+																 expectedOther, 1e-6, "Loss with another radius differs");
+
+			topology.ClearFixedPoints ();
+			NS_TEST_ASSERT_MSG_EQ (topology.GetNFixedPoints (), 0, "Fixed point not cleared");
+		}
+}
+
+/**
+ * \brief The batch query shared by the threads of a pool, against the
+ * batch of a single thread
+ */
+class ObstaclePoolBatchTestCase : public TestCase
+{
+public:
+	ObstaclePoolBatchTestCase ();
+	virtual ~ObstaclePoolBatchTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstaclePoolBatchTestCase::ObstaclePoolBatchTestCase ()
+	: TestCase ("Obstructed loss of a batch shared by threads")
+{
+}
+
+ObstaclePoolBatchTestCase::~ObstaclePoolBatchTestCase ()
+{
+}
+
+void
+ObstaclePoolBatchTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.SetIndexType (Topology::INDEX_GRID);
+	topology.Load (filename);
+
+	// the receivers, a few of them twice
+	std::vector<Vector> from;
+	std::vector<Vector> receivers;
+	MakeLinks (400, from, receivers);
+	for (uint32_t i = 0; i < 20; i++)
+		{
+			receivers.push_back (receivers[7 * i]);
+		}
+
+	ObstacleWorkerPool pool (4);
+	std::vector<TopologyQueryContext> contexts (pool.GetNThreads (), TopologyQueryContext (0));
+
+	// a cache that keeps every receiver, and one that evicts some of them
+	// during the batch, both already holding a few losses
+	for (uint32_t e = 0; e < 2; e++)
+		{
+			Topology::Engine engine = e ? Topology::ENGINE_DOUBLE : Topology::ENGINE_EXACT;
+			for (uint32_t capacity = 64; capacity <= 1024; capacity *= 16)
+				{
+					TopologyQueryContext sequential (capacity);
+					TopologyQueryContext shared (capacity);
+					for (uint32_t i = 0; i < 40; i += 3)
+						{
+							topology.GetObstructedLossBetween (from[0], receivers[i], g_radius, engine, sequential);
+							topology.GetObstructedLossBetween (from[0], receivers[i], g_radius, engine, shared);
+						}
+
+					std::vector<double> expected;
+					std::vector<double> losses;
+					topology.GetObstructedLossBatch (from[0], receivers, g_radius, engine, expected, sequential);
+					topology.GetObstructedLossBatch (from[0], receivers, g_radius, engine, losses, shared, pool, contexts);
+					NS_TEST_ASSERT_MSG_EQ (losses.size (), receivers.size (), "Wrong number of losses in a shared batch");
+
+					TopologyQueryContext uncached (0);
+					for (uint32_t i = 0; i < receivers.size (); i++)
+						{
+							NS_TEST_ASSERT_MSG_EQ (losses[i], expected[i], "Shared batch of engine " << engine << " differs on receiver " << i);
+							double loss = topology.GetObstructedLossBetween (from[0], receivers[i], g_radius, engine, uncached);
+							NS_TEST_ASSERT_MSG_EQ_TOL (losses[i], loss, 1e-9, "Shared batch of engine " << engine << " differs from the query of receiver " << i);
+						}
+
+					// the same entries are left in the cache
+					NS_TEST_ASSERT_MSG_EQ (shared.GetCache ().GetSize (), sequential.GetCache ().GetSize (), "Wrong size of the cache");
+					for (uint32_t i = 0; i < receivers.size (); i++)
+						{
+							ObstructedLossKey key (from[0].x, from[0].y, from[0].z, receivers[i].x, receivers[i].y, receivers[i].z);
+							double cached = -1;
+							double expectedCached = -1;
+							bool found = shared.GetCache ().Lookup (key, cached);
+							NS_TEST_ASSERT_MSG_EQ (found, sequential.GetCache ().Lookup (key, expectedCached),
+																		 "Wrong cache entry of receiver " << i << " with capacity " << capacity);
+							NS_TEST_ASSERT_MSG_EQ (cached, expectedCached, "Wrong cached loss of receiver " << i);
+						}
+				}
+		}
+}
+
+/**
+ * \brief The static loss matrix built by one thread and by several
+ */
+class ObstacleStaticLossBuildTestCase : public TestCase
+{
+public:
+	ObstacleStaticLossBuildTestCase ();
+	virtual ~ObstacleStaticLossBuildTestCase ();
+
+private:
+	virtual void DoRun (void);
+};
+
+ObstacleStaticLossBuildTestCase::ObstacleStaticLossBuildTestCase ()
+	: TestCase ("Static loss matrix built in parallel")
+{
+}
+
+ObstacleStaticLossBuildTestCase::~ObstacleStaticLossBuildTestCase ()
+{
+}
+
+void
+ObstacleStaticLossBuildTestCase::DoRun (void)
+{
+	std::string filename = CreateTempDirFilename ("city.poly.xml");
+	WriteCity (filename);
+	Topology topology;
+	topology.SetIndexType (Topology::INDEX_GRID);
+	topology.Load (filename);
+
+	std::vector<Vector> from;
+	std::vector<Vector> to;
+	MakeLinks (60, from, to);
+	std::vector<Vector> positions (from);
+	positions.insert (positions.end (), to.begin (), to.end ());
+	std::vector<bool> valid (positions.size (), true);
+
+	// a radius smaller than the city, so that some pairs are too far
+	// apart to be obstructed
+	double radius = 100;
+	StaticLossMatrix sequential;
+	sequential.Build (topology, positions, valid, radius, Topology::ENGINE_DOUBLE, 1);
+	StaticLossMatrix parallel;
+	parallel.Build (topology, positions, valid, radius, Topology::ENGINE_DOUBLE, 4);
+	NS_TEST_ASSERT_MSG_EQ (parallel.GetNEntries (), sequential.GetNEntries (), "Wrong number of entries in parallel");
+
+	uint32_t nFar = 0;
+	for (uint32_t a = 0; a < positions.size (); a++)
+		{
+			for (uint32_t b = a + 1; b < positions.size (); b++)
+				{
+					double expected = -1;
+					double loss = -1;
+					sequential.Lookup (a, positions[a], b, positions[b], expected);
+					parallel.Lookup (a, positions[a], b, positions[b], loss);
+					NS_TEST_ASSERT_MSG_EQ (loss, expected, "Parallel loss differs on pair " << a << ", " << b);
+
+					double dx = positions[b].x - positions[a].x;
+					double dy = positions[b].y - positions[a].y;
+					if (dx * dx + dy * dy >= 4 * radius * radius)
+						{
+							NS_TEST_ASSERT_MSG_EQ (expected, 0, "Loss of a pair farther than 2r");
+							nFar++;
+						}
+				}
+		}
+	NS_TEST_ASSERT_MSG_GT (nFar, 0, "No pair farther than 2r");
+}
+
+/**
+ * \brief The tests of the obstacle model
+ */
+class ObstacleTestSuite : public TestSuite
+{
+public:
+	ObstacleTestSuite ();
+};
+
+ObstacleTestSuite::ObstacleTestSuite ()
+	: TestSuite ("obstacle", UNIT)
+{
+	AddTestCase (new ObstacleEngineTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleWallKernelTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleCacheTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleGridIndexTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleConcurrentTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleStaticLossMatrixTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleCompiledTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleParallelLoadTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleFootprintTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleSimplificationTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleTypeRulesTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleBatchTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleNodeCacheTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleRasterTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleGridHeightTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleStorageTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleTileStoreTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleFixedPointTestCase, TestCase::QUICK);
+	AddTestCase (new ObstaclePoolBatchTestCase, TestCase::QUICK);
+	AddTestCase (new ObstacleStaticLossBuildTestCase, TestCase::QUICK);
+}
+
+static ObstacleTestSuite obstacleTestSuite;
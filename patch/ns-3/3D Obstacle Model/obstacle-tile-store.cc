@@ -0,0 +1,424 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ns3/log.h"
+#include "obstacle-tile-store.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("ObstacleTileStore");
+
+namespace {
+
+// header of the index file, followed by the first obstacle of each
+// tile (n + 1 uint64_t, row major) and the original index of the
+// obstacles of the tiles (uint32_t)
+struct IndexHeader
+{
+	char			magic[8];
+	uint32_t	version;
+	uint32_t	nColumns;
+	uint32_t	nRows;
+	uint32_t	reserved;
+	double		originX;
+	double		originY;
+	double		tileSize;
+	double		gridCellSize;
+	double		bounds[4];
+	uint64_t	contentHash;
+	uint64_t	nObstacles;
+};
+
+const char g_indexMagic[8] = { 'O', 'B', 'S', 'T', 'T', 'I', 'L', 'E' };
+const uint32_t g_indexVersion = 1;
+
+} // namespace
+
+ObstacleTileStore::ObstacleTileStore ()
+	:	m_originX (0),
+		m_originY (0),
+		m_tileSize (0),
+		m_nColumns (0),
+		m_nRows (0),
+		m_gridCellSize (0),
+		m_contentHash (0),
+		m_memoryBudget (0),
+		m_nTiles (0),
+		m_loadedBytes (0),
+		m_query (0),
+		m_loads (0),
+		m_evictions (0),
+		m_maxLoadedBytes (0)
+{
+	for (uint32_t k = 0; k < 4; k++)
+		m_bounds[k] = 0;
+}
+
+std::string
+ObstacleTileStore::GetIndexFilename (std::string directory)
+{
+	return directory + "/tiles.idx";
+}
+
+std::string
+ObstacleTileStore::GetTileFilename (std::string directory, uint32_t column, uint32_t row)
+{
+	std::ostringstream name;
+	name << directory << "/tile-" << column << "-" << row << ".bin";
+	return name.str ();
+}
+
+bool
+ObstacleTileStore::IsTileStore (std::string filename)
+{
+	char magic[sizeof (g_indexMagic)];
+	std::ifstream file (filename.c_str (), std::ios::in | std::ios::binary);
+
+	return file.read (magic, sizeof (magic))
+		&& (std::memcmp (magic, g_indexMagic, sizeof (magic)) == 0);
+}
+
+bool
+ObstacleTileStore::WriteIndex (std::string directory, double originX, double originY, double tileSize,
+															 uint32_t nColumns, uint32_t nRows, double gridCellSize, const double bounds[4],
+															 uint64_t contentHash, const std::vector<std::vector<uint32_t> > &obstacles)
+{
+	NS_LOG_FUNCTION (directory << tileSize << nColumns << nRows);
+	NS_ASSERT (obstacles.size () == (uint64_t) nColumns * nRows);
+
+	std::vector<uint64_t> tileStart (1, 0);
+	for (uint32_t k = 0; k < obstacles.size (); k++)
+	{
+		tileStart.push_back (tileStart.back () + obstacles[k].size ());
+	}
+
+	IndexHeader header;
+	std::memset (&header, 0, sizeof (header));
+	std::memcpy (header.magic, g_indexMagic, sizeof (g_indexMagic));
+	header.version = g_indexVersion;
+	header.nColumns = nColumns;
+	header.nRows = nRows;
+	header.originX = originX;
+	header.originY = originY;
+	header.tileSize = tileSize;
+	header.gridCellSize = gridCellSize;
+	for (uint32_t k = 0; k < 4; k++)
+		header.bounds[k] = bounds[k];
+	header.contentHash = contentHash;
+	header.nObstacles = tileStart.back ();
+
+	// unique temporary name, then rename
+	std::string filename = GetIndexFilename (directory);
+	std::ostringstream tmp;
+	tmp << filename << ".tmp." << getpid ();
+
+	std::ofstream file (tmp.str ().c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open ())
+	{
+		NS_LOG_WARN ("Could not open " << tmp.str () << " for writing, the tile store is not written.");
+		return false;
+	}
+
+	file.write ((const char *) &header, sizeof (header));
+	file.write ((const char *) tileStart.data (), sizeof (uint64_t) * tileStart.size ());
+	for (uint32_t k = 0; k < obstacles.size (); k++)
+	{
+		if (!obstacles[k].empty ())
+			file.write ((const char *) obstacles[k].data (), sizeof (uint32_t) * obstacles[k].size ());
+	}
+	file.close ();
+
+	if (file.fail () || std::rename (tmp.str ().c_str (), filename.c_str ()) != 0)
+	{
+		NS_LOG_WARN ("Could not write " << filename << ", the tile store is not written.");
+		std::remove (tmp.str ().c_str ());
+		return false;
+	}
+
+	return true;
+}
+
+bool
+ObstacleTileStore::Open (std::string indexFilename, uint64_t memoryBudget)
+{
+	NS_LOG_FUNCTION (this << indexFilename << memoryBudget);
+	NS_ASSERT (m_tiles.empty ());
+
+	std::ifstream file (indexFilename.c_str (), std::ios::in | std::ios::binary);
+	IndexHeader header;
+	if (!file.read ((char *) &header, sizeof (header))
+			|| std::memcmp (header.magic, g_indexMagic, sizeof (g_indexMagic)) != 0
+			|| header.version != g_indexVersion
+			|| !(header.tileSize > 0))
+	{
+		NS_LOG_WARN ("Tile store index " << indexFilename << " is not valid.");
+		return false;
+	}
+
+	uint64_t nTiles = (uint64_t) header.nColumns * header.nRows;
+	std::vector<uint64_t> tileStart (nTiles + 1);
+	m_obstacles.resize (header.nObstacles);
+	if (!file.read ((char *) tileStart.data (), sizeof (uint64_t) * tileStart.size ())
+			|| (header.nObstacles > 0 && !file.read ((char *) m_obstacles.data (), sizeof (uint32_t) * header.nObstacles))
+			|| tileStart.back () != header.nObstacles)
+	{
+		NS_LOG_WARN ("Tile store index " << indexFilename << " is not valid.");
+		m_obstacles.clear ();
+		return false;
+	}
+
+	size_t slash = indexFilename.rfind ('/');
+	m_directory = (slash == std::string::npos) ? "." : indexFilename.substr (0, slash);
+	m_originX = header.originX;
+	m_originY = header.originY;
+	m_tileSize = header.tileSize;
+	m_nColumns = header.nColumns;
+	m_nRows = header.nRows;
+	m_gridCellSize = header.gridCellSize;
+	for (uint32_t k = 0; k < 4; k++)
+		m_bounds[k] = header.bounds[k];
+	m_contentHash = header.contentHash;
+	m_memoryBudget = memoryBudget;
+
+	m_tiles.resize (nTiles);
+	m_nTiles = 0;
+	for (uint64_t k = 0; k < nTiles; k++)
+	{
+		Tile &tile = m_tiles[k];
+		tile.firstObstacle = tileStart[k];
+		tile.nObstacles = tileStart[k + 1] - tileStart[k];
+		tile.fileSize = 0;
+		tile.bytes = 0;
+		tile.lastUse = 0;
+		if (tile.nObstacles > 0)
+		{
+			struct stat st;
+			std::string filename = GetTileFilename (m_directory, k % m_nColumns, k / m_nColumns);
+			if (stat (filename.c_str (), &st) != 0)
+			{
+				NS_LOG_WARN ("Tile store " << indexFilename << " has no file " << filename << ".");
+				m_tiles.clear ();
+				m_obstacles.clear ();
+				return false;
+			}
+			tile.fileSize = st.st_size;
+			m_nTiles++;
+		}
+	}
+
+	NS_LOG_INFO ("Tile store " << indexFilename << ": " << header.nObstacles << " obstacles in "
+							 << m_nTiles << " tiles of " << m_tileSize << " m.");
+	return true;
+}
+
+void
+ObstacleTileStore::SetMemoryBudget (uint64_t memoryBudget)
+{
+	NS_LOG_FUNCTION (this << memoryBudget);
+
+	std::lock_guard<std::mutex> lock (m_mutex);
+	m_memoryBudget = memoryBudget;
+}
+
+uint64_t
+ObstacleTileStore::GetMemoryBudget () const
+{
+	return m_memoryBudget;
+}
+
+std::shared_ptr<const Topology>
+ObstacleTileStore::Acquire (uint32_t index) const
+{
+	Tile &tile = m_tiles[index];
+	if (!tile.topology)
+	{
+		// the queries of the store have their own context,
+		// the tile needs no cache
+		std::shared_ptr<Topology> topology (new Topology ());
+		topology->SetCacheCapacity (0);
+		topology->SetIndexType (Topology::INDEX_GRID);
+		topology->SetGridCellSize (m_gridCellSize);
+		topology->Load (GetTileFilename (m_directory, index % m_nColumns, index / m_nColumns));
+		NS_ASSERT_MSG (topology->GetNObstacles () == tile.nObstacles,
+									 "Tile " << index << " of the tile store in " << m_directory << " does not match its index");
+
+		// the id pool is shared by all the topologies, it is not counted
+		ObstacleMemoryReport report = topology->GetMemoryReport ();
+		tile.bytes = report.totalBytes - report.idBytes + tile.fileSize;
+		tile.topology = topology;
+		m_loaded.push_back (index);
+		m_loadedBytes += tile.bytes;
+		m_maxLoadedBytes = std::max (m_maxLoadedBytes, m_loadedBytes);
+		m_loads++;
+	}
+	tile.lastUse = m_query;
+
+	return tile.topology;
+}
+
+void
+ObstacleTileStore::Evict () const
+{
+	while (m_loadedBytes > m_memoryBudget)
+	{
+		// least recently used tile, among those not used by this query
+		uint32_t victim = m_loaded.size ();
+		for (uint32_t k = 0; k < m_loaded.size (); k++)
+		{
+			const Tile &tile = m_tiles[m_loaded[k]];
+			if (tile.lastUse != m_query
+					&& (victim == m_loaded.size () || tile.lastUse < m_tiles[m_loaded[victim]].lastUse))
+				victim = k;
+		}
+		if (victim == m_loaded.size ())
+			break;
+
+		// queries in progress keep their reference to the tile
+		Tile &tile = m_tiles[m_loaded[victim]];
+		tile.topology.reset ();
+		m_loadedBytes -= tile.bytes;
+		m_loaded[victim] = m_loaded.back ();
+		m_loaded.pop_back ();
+		m_evictions++;
+	}
+}
+
+double
+ObstacleTileStore::GetObstructedLossBetween (const Vector &p1, const Vector &p2, double r, Topology::Engine engine,
+																						 TopologyQueryContext &context) const
+{
+	NS_LOG_FUNCTION (this);
+
+	// the raster of a tile would not see the obstacles of the others
+	if (engine == Topology::ENGINE_RASTER)
+		engine = Topology::ENGINE_DOUBLE;
+
+	// the obstacles taken into account have their center within r of
+	// both points, in the intersection of the two boxes around them
+	double xmin = std::max (p1.x, p2.x) - r;
+	double xmax = std::min (p1.x, p2.x) + r;
+	double ymin = std::max (p1.y, p2.y) - r;
+	double ymax = std::min (p1.y, p2.y) + r;
+	if (xmin > xmax || ymin > ymax || m_nTiles == 0)
+		return 0.0;
+
+	double c0 = std::floor ((xmin - m_originX) / m_tileSize);
+	double c1 = std::floor ((xmax - m_originX) / m_tileSize);
+	double r0 = std::floor ((ymin - m_originY) / m_tileSize);
+	double r1 = std::floor ((ymax - m_originY) / m_tileSize);
+	if (c1 < 0 || r1 < 0 || c0 >= m_nColumns || r0 >= m_nRows)
+		return 0.0;
+	uint32_t column0 = (uint32_t) std::max (c0, 0.0);
+	uint32_t column1 = (uint32_t) std::min (c1, m_nColumns - 1.0);
+	uint32_t row0 = (uint32_t) std::max (r0, 0.0);
+	uint32_t row1 = (uint32_t) std::min (r1, m_nRows - 1.0);
+
+	// the tiles, loaded if needed
+	std::vector<std::pair<uint64_t, std::shared_ptr<const Topology> > > tiles;
+	{
+		std::lock_guard<std::mutex> lock (m_mutex);
+		m_query++;
+		for (uint32_t row = row0; row <= row1; row++)
+		{
+			for (uint32_t column = column0; column <= column1; column++)
+			{
+				uint32_t index = row * m_nColumns + column;
+				if (m_tiles[index].nObstacles > 0)
+					tiles.push_back (std::make_pair (m_tiles[index].firstObstacle, Acquire (index)));
+			}
+		}
+		Evict ();
+	}
+
+	// the loss of the last obstructing obstacle, in the original order
+	double loss = 0.0;
+	int64_t last = -1;
+	for (uint32_t k = 0; k < tiles.size (); k++)
+	{
+		int64_t obstacle;
+		double tileLoss = tiles[k].second->GetObstructedLossAndObstacle (p1, p2, r, engine, context, obstacle);
+		if (obstacle >= 0 && (int64_t) m_obstacles[tiles[k].first + obstacle] > last)
+		{
+			last = m_obstacles[tiles[k].first + obstacle];
+			loss = tileLoss;
+		}
+	}
+
+	return loss;
+}
+
+void
+ObstacleTileStore::GetBounds (double bounds[4]) const
+{
+	for (uint32_t k = 0; k < 4; k++)
+		bounds[k] = m_bounds[k];
+}
+
+uint64_t
+ObstacleTileStore::GetContentHash () const
+{
+	return m_contentHash;
+}
+
+uint64_t
+ObstacleTileStore::GetNObstacles () const
+{
+	return m_obstacles.size ();
+}
+
+uint32_t
+ObstacleTileStore::GetNTiles () const
+{
+	return m_nTiles;
+}
+
+uint32_t
+ObstacleTileStore::GetNLoaded () const
+{
+	std::lock_guard<std::mutex> lock (m_mutex);
+	return m_loaded.size ();
+}
+
+uint64_t
+ObstacleTileStore::GetLoadedBytes () const
+{
+	std::lock_guard<std::mutex> lock (m_mutex);
+	return m_loadedBytes;
+}
+
+void
+ObstacleTileStore::PrintStatistics (std::ostream &os) const
+{
+	std::lock_guard<std::mutex> lock (m_mutex);
+	os << "Tile store (" << m_tileSize << " m tiles): " << m_loaded.size () << " of " << m_nTiles
+		 << " tiles loaded, " << m_loadedBytes << " B (max " << m_maxLoadedBytes << " B, budget "
+		 << m_memoryBudget << " B), " << m_loads << " loads, " << m_evictions << " evictions" << std::endl;
+}
+
+} // namespace ns3
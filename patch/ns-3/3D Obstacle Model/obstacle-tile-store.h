@@ -0,0 +1,246 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#ifndef OBSTACLE_TILE_STORE_H
+#define OBSTACLE_TILE_STORE_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include "ns3/vector.h"
+#include "topology.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief The obstacles of a region split in square tiles, each one a
+ * compiled buildings file (see Topology::CompileBuildings) loaded when a
+ * query needs it, and dropped when the tiles loaded exceed a memory budget
+ * (least recently used first).
+ *
+ * An obstacle belongs to the tile of its center. The obstacles a query
+ * may take into account have their center within r of both points (see
+ * Topology::GetObstructedLossBetween), so only the tiles that overlap
+ * that area are loaded. Each tile knows the index its obstacles had in
+ * the whole region: the loss is that of the last obstructing obstacle
+ * in that order, as if the region were loaded in a single topology.
+ *
+ * The store is a directory: an index file (tiles.idx) with the layout
+ * of the tiles and the original index of their obstacles, and a file
+ * for each tile that has obstacles (tile-<column>-<row>.bin).
+ */
+class ObstacleTileStore
+{
+public:
+	/**
+	 * \brief Constructor, an empty store
+	 */
+	ObstacleTileStore ();
+
+	/**
+	 * \brief Write the index file of a store (the tiles are written by the caller)
+	 * \param directory the directory of the store
+	 * \param originX x of the lower left corner of the first tile
+	 * \param originY y of the lower left corner of the first tile
+	 * \param tileSize side of a tile, in meters
+	 * \param nColumns number of tiles along x
+	 * \param nRows number of tiles along y
+	 * \param gridCellSize side of the cells of the grid index of the tiles
+	 * \param bounds bounding box of the obstacles (xmin, ymin, xmax, ymax)
+	 * \param contentHash content hash of the region, see Topology::GetContentHash
+	 * \param obstacles original index of the obstacles of each tile (row major),
+	 * in the order they have in the tile
+	 * \return true on success
+	 */
+	static bool WriteIndex (std::string directory, double originX, double originY, double tileSize,
+													uint32_t nColumns, uint32_t nRows, double gridCellSize, const double bounds[4],
+													uint64_t contentHash, const std::vector<std::vector<uint32_t> > &obstacles);
+
+	/**
+	 * \brief Get the name of the index file of a store
+	 * \param directory the directory of the store
+	 * \return the name of the index file
+	 */
+	static std::string GetIndexFilename (std::string directory);
+
+	/**
+	 * \brief Get the name of the file of a tile
+	 * \param directory the directory of the store
+	 * \param column column of the tile
+	 * \param row row of the tile
+	 * \return the name of the file
+	 */
+	static std::string GetTileFilename (std::string directory, uint32_t column, uint32_t row);
+
+	/**
+	 * \brief Check if a file is the index file of a store
+	 * \param filename the name of the file
+	 * \return true if the file starts with the magic of the index
+	 */
+	static bool IsTileStore (std::string filename);
+
+	/**
+	 * \brief Open a store: read its index, no tile is loaded
+	 * \param indexFilename the index file of the store
+	 * \param memoryBudget bytes the loaded tiles should not exceed
+	 * \return false if the index cannot be read or is not valid
+	 */
+	bool Open (std::string indexFilename, uint64_t memoryBudget);
+
+	/**
+	 * \brief Set the bytes the loaded tiles should not exceed. The tiles
+	 * needed by a query are loaded anyway, the budget may be exceeded
+	 * until the next query
+	 * \param memoryBudget the budget in bytes
+	 * \return none
+	 */
+	void SetMemoryBudget (uint64_t memoryBudget);
+
+	/**
+	 * \brief Get the bytes the loaded tiles should not exceed
+	 * \return the budget in bytes
+	 */
+	uint64_t GetMemoryBudget () const;
+
+	/**
+	 * \brief Gets the obstructed loss between two points, see
+	 * Topology::GetObstructedLossBetween (the cache is not used). Tiles are
+	 * loaded as needed; concurrent calls with distinct contexts are safe
+	 * \param p1 point1
+	 * \param p2 point2
+	 * \param r limiting radius for obstacles between p1 and p2
+	 * \param engine the geometry engine (the raster engine is not supported)
+	 * \param context the scratch space of the caller
+	 * \return the obstructed loss in dB
+	 */
+	double GetObstructedLossBetween (const Vector &p1, const Vector &p2, double r, Topology::Engine engine,
+																	 TopologyQueryContext &context) const;
+
+	/**
+	 * \brief Get the bounding box of the obstacles of the region
+	 * \param bounds set to xmin, ymin, xmax, ymax
+	 * \return none
+	 */
+	void GetBounds (double bounds[4]) const;
+
+	/**
+	 * \brief Get the content hash of the region, see Topology::GetContentHash
+	 * \return the hash
+	 */
+	uint64_t GetContentHash () const;
+
+	/**
+	 * \brief Get the number of obstacles of the region
+	 * \return the number of obstacles
+	 */
+	uint64_t GetNObstacles () const;
+
+	/**
+	 * \brief Get the number of tiles with obstacles
+	 * \return the number of tiles
+	 */
+	uint32_t GetNTiles () const;
+
+	/**
+	 * \brief Get the number of tiles loaded
+	 * \return the number of tiles
+	 */
+	uint32_t GetNLoaded () const;
+
+	/**
+	 * \brief Get the bytes of the tiles loaded (memory of the obstacles,
+	 * see Topology::GetMemoryReport, and size of the mapped files)
+	 * \return the bytes
+	 */
+	uint64_t GetLoadedBytes () const;
+
+	/**
+	 * \brief Print tiles loaded, bytes, loads and evictions
+	 * \param os the output stream
+	 * \return none
+	 */
+	void PrintStatistics (std::ostream &os) const;
+
+private:
+	// not copyable, tiles are shared with the queries in progress
+	ObstacleTileStore (const ObstacleTileStore &);
+	ObstacleTileStore &operator= (const ObstacleTileStore &);
+
+	/**
+	 * \brief A tile of the store
+	 */
+	struct Tile
+	{
+		std::shared_ptr<const Topology>	topology;		// null if not loaded
+		uint64_t	firstObstacle;	// first original index of the tile in m_obstacles
+		uint32_t	nObstacles;
+		uint64_t	fileSize;
+		uint64_t	bytes;					// bytes while loaded
+		uint64_t	lastUse;				// query that used the tile last
+	};
+
+	/**
+	 * \brief Load a tile, if needed, and mark it as used. Called with m_mutex held
+	 * \param index index of the tile
+	 * \return the tile
+	 */
+	std::shared_ptr<const Topology> Acquire (uint32_t index) const;
+
+	/**
+	 * \brief Drop the least recently used tiles, but those of the current
+	 * query, while the budget is exceeded. Called with m_mutex held
+	 * \return none
+	 */
+	void Evict () const;
+
+	std::string	m_directory;
+	double	m_originX;
+	double	m_originY;
+	double	m_tileSize;
+	uint32_t	m_nColumns;
+	uint32_t	m_nRows;
+	double	m_gridCellSize;
+	double	m_bounds[4];
+	uint64_t	m_contentHash;
+	uint64_t	m_memoryBudget;
+
+	// tiles (row major), and original index of their obstacles
+	mutable std::vector<Tile>	m_tiles;
+	std::vector<uint32_t>	m_obstacles;
+	uint32_t	m_nTiles;
+
+	// tiles loaded, their bytes, and statistics
+	mutable std::mutex	m_mutex;
+	mutable std::vector<uint32_t>	m_loaded;
+	mutable uint64_t	m_loadedBytes;
+	mutable uint64_t	m_query;
+	mutable uint64_t	m_loads;
+	mutable uint64_t	m_evictions;
+	mutable uint64_t	m_maxLoadedBytes;
+};
+
+} // namespace ns3
+
+#endif /* OBSTACLE_TILE_STORE_H */
@@ -0,0 +1,182 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#include <fstream>
+#include <sstream>
+#include "ns3/log.h"
+#include "obstacle-type-rules.h"
+#include "obstructed-loss-cache.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("ObstacleTypeRules");
+
+ObstacleTypeRules::ObstacleTypeRules ()
+{
+	NS_LOG_FUNCTION (this);
+
+	// the types accepted by Topology::LoadBuildings before the rules,
+	// with the default attenuation of Obstacle
+	Clear ();
+	SetRule ("building", INCLUDE);
+	SetRule ("unknown", INCLUDE);
+}
+
+void
+ObstacleTypeRules::SetRule (std::string type, Action action, double beta, double gamma, double height)
+{
+	NS_LOG_FUNCTION (this << type << action << beta << gamma << height);
+
+	Rule rule;
+	rule.action = action;
+	rule.beta = beta;
+	rule.gamma = gamma;
+	rule.height = height;
+
+	if (type == "*")
+		m_default = rule;
+	else
+		m_rules[type] = rule;
+}
+
+void
+ObstacleTypeRules::Clear ()
+{
+	NS_LOG_FUNCTION (this);
+
+	m_rules.clear ();
+	m_default.action = EXCLUDE;
+	m_default.beta = 9.0;
+	m_default.gamma = 0.4;
+	m_default.height = 0.0;
+}
+
+bool
+ObstacleTypeRules::Load (std::string filename)
+{
+	NS_LOG_FUNCTION (this << filename);
+
+	std::ifstream file (filename.c_str (), std::ios::in);
+	if (!file.is_open ())
+	{
+		NS_LOG_WARN ("Could not open obstacle type rules file " << filename << ".");
+		return false;
+	}
+
+	std::string line;
+	uint32_t lineNumber = 0;
+	while (getline (file, line))
+	{
+		lineNumber++;
+		size_t comment = line.find ('#');
+		if (comment != std::string::npos)
+			line.erase (comment);
+
+		std::istringstream fields (line);
+		std::string type;
+		std::string action;
+		if (!(fields >> type))
+			continue;
+
+		Rule rule = Lookup (type);
+		fields >> action;
+		if (action == "include")
+			rule.action = INCLUDE;
+		else if (action == "exclude")
+			rule.action = EXCLUDE;
+		else if (action == "merge")
+			rule.action = MERGE;
+		else
+		{
+			NS_LOG_WARN ("Obstacle type rules file " << filename << ", line " << lineNumber
+									 << ": unknown action \"" << action << "\".");
+			return false;
+		}
+
+		// optional values, in order
+		double value;
+		if (fields >> value)
+		{
+			rule.beta = value;
+			if (fields >> value)
+			{
+				rule.gamma = value;
+				if (fields >> value)
+					rule.height = value;
+			}
+		}
+		std::string rest;
+		fields.clear ();
+		if (fields >> rest)
+		{
+			NS_LOG_WARN ("Obstacle type rules file " << filename << ", line " << lineNumber << " is not valid.");
+			return false;
+		}
+
+		SetRule (type, rule.action, rule.beta, rule.gamma, rule.height);
+	}
+
+	NS_LOG_INFO ("Obstacle type rules read from " << filename << ": " << m_rules.size () << " rules.");
+	return true;
+}
+
+const ObstacleTypeRules::Rule &
+ObstacleTypeRules::Lookup (const std::string &type) const
+{
+	if (m_rules.empty ())
+		return m_default;
+
+	// the type itself, then the longest type it starts with
+	for (size_t length = type.size (); length > 0; length--)
+	{
+		std::map<std::string, Rule>::const_iterator it = m_rules.find (type.substr (0, length));
+		if (it != m_rules.end ())
+			return it->second;
+	}
+
+	return m_default;
+}
+
+uint32_t
+ObstacleTypeRules::GetNRules () const
+{
+	return m_rules.size ();
+}
+
+uint64_t
+ObstacleTypeRules::GetHash () const
+{
+	// field by field, the padding of a Rule is not initialized
+	uint64_t hash = 14695981039346656037ULL;
+	std::map<std::string, Rule> rules (m_rules);
+	rules["*"] = m_default;
+	for (std::map<std::string, Rule>::const_iterator i = rules.begin (); i != rules.end (); ++i)
+	{
+		uint32_t action = i->second.action;
+		double parameters[3] = { i->second.beta, i->second.gamma, i->second.height };
+		hash = HashBytes (i->first.data (), i->first.size () + 1, hash);
+		hash = HashBytes (&action, sizeof (action), hash);
+		hash = HashBytes (parameters, sizeof (parameters), hash);
+	}
+	return hash;
+}
+
+} // namespace ns3
@@ -0,0 +1,133 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#ifndef OBSTACLE_TYPE_RULES_H
+#define OBSTACLE_TYPE_RULES_H
+
+#include <map>
+#include <string>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief Rules applied to the polygons of a poly file, by type: which
+ * ones become obstacles and with which attenuation and default height.
+ *
+ * The rule of a type is the rule of the type itself or, if there is
+ * none, of the longest type it starts with (the rule of "building"
+ * applies to "building.yes" too), or the default rule. By default
+ * "building" and "unknown" polygons are included and the others are
+ * excluded, with the default attenuation of Obstacle.
+ *
+ * A rules file has one rule per line: type, action (include, exclude
+ * or merge), then optionally beta, gamma and default height; a "*" type
+ * sets the default rule. Everything after a # is a comment, e.g.
+ *
+ *   # type       action   beta  gamma  height
+ *   building     include  9     0.4    10
+ *   building:part merge
+ *   residential  exclude
+ */
+class ObstacleTypeRules
+{
+public:
+	/**
+	 * \brief What is done with the polygons of a type
+	 */
+	enum Action
+	{
+		INCLUDE,	// each polygon is an obstacle
+		EXCLUDE,	// the polygons are dropped
+		MERGE			// a polygon overlapping an included obstacle is merged into it
+							// (the obstacle gets the greatest height), otherwise it is an obstacle
+	};
+
+	/**
+	 * \brief The rule of a type
+	 */
+	struct Rule
+	{
+		Action	action;
+		double	beta;			// per-wall attenuation (dB)
+		double	gamma;		// per-meter attenuation (dB/m)
+		double	height;		// height of the polygons without one (0 for none)
+	};
+
+	/**
+	 * \brief Constructor, the default rules
+	 */
+	ObstacleTypeRules ();
+
+	/**
+	 * \brief Set the rule of a type
+	 * \param type the type, "*" for the default rule
+	 * \param action what is done with the polygons of the type
+	 * \param beta per-wall attenuation (dB)
+	 * \param gamma per-meter attenuation (dB/m)
+	 * \param height height of the polygons without one (0 for none)
+	 * \return none
+	 */
+	void SetRule (std::string type, Action action, double beta = 9.0, double gamma = 0.4, double height = 0.0);
+
+	/**
+	 * \brief Remove all the rules, every type is excluded
+	 * \return none
+	 */
+	void Clear ();
+
+	/**
+	 * \brief Read rules from a file, in addition to (or in place of)
+	 * the current ones
+	 * \param filename the name of the rules file
+	 * \return false if the file cannot be read or a line is not valid
+	 */
+	bool Load (std::string filename);
+
+	/**
+	 * \brief Get the rule of a type
+	 * \param type the type
+	 * \return the rule
+	 */
+	const Rule &Lookup (const std::string &type) const;
+
+	/**
+	 * \brief Get the number of rules, the default one excluded
+	 * \return the number of rules
+	 */
+	uint32_t GetNRules () const;
+
+	/**
+	 * \brief Get a hash of the rules, to identify the obstacles built
+	 * with them
+	 * \return the hash
+	 */
+	uint64_t GetHash () const;
+
+private:
+	std::map<std::string, Rule>	m_rules;
+	Rule												m_default;
+};
+
+} // namespace ns3
+
+#endif /* OBSTACLE_TYPE_RULES_H */
@@ -0,0 +1,341 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include "ns3/log.h"
+#include "obstacle-visibility.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("ObstacleVisibility");
+
+namespace {
+
+// a point closer than this to the bounding box of an obstacle returns it
+// from every lookup: the angles would not be reliable (see Topology::GetObstructedLossBatch)
+const double g_aroundMargin = 1.0;
+// enlargement of the angular ranges, much larger than the tolerance
+// of the degenerate tests seen from g_aroundMargin
+const double g_anglePad = 1e-4;
+// reduction of the distances, against rounding
+const double g_depthMargin = 1e-3;
+
+// an obstacle within a range of angles
+struct AngularRange
+{
+	double start;
+	double end;
+	uint32_t index;
+};
+
+// an obstacle in a sector, at some distance from the point
+struct SectorEntry
+{
+	uint32_t sector;
+	double depth;
+	uint32_t index;
+
+	bool operator< (const SectorEntry &other) const
+	{
+		if (sector != other.sector)
+			return sector < other.sector;
+		if (depth != other.depth)
+			return depth < other.depth;
+		return index < other.index;
+	}
+};
+
+// restrict [t0, t1] to the part of the segment where f, linear from
+// fa (t = 0) to fb (t = 1), is not negative
+bool
+ClipHalfPlane (double fa, double fb, double &t0, double &t1)
+{
+	if (fa < 0 && fb < 0)
+		return false;
+	if (fa < 0)
+		t0 = std::max (t0, fa / (fa - fb));
+	else if (fb < 0)
+		t1 = std::min (t1, fa / (fa - fb));
+
+	return t0 <= t1;
+}
+
+// distance from the origin to the segment from (ax, ay) to (bx, by)
+double
+DistanceToSegment (double ax, double ay, double bx, double by)
+{
+	double ex = bx - ax;
+	double ey = by - ay;
+	double eLen2 = ex * ex + ey * ey;
+	double t = (eLen2 > 0) ? std::min (1.0, std::max (0.0, -(ax * ex + ay * ey) / eLen2)) : 0.0;
+	double px = ax + t * ex;
+	double py = ay + t * ey;
+	return std::sqrt (px * px + py * py);
+}
+
+// distance from (x, y) to the part of the border of a footprint between
+// the angles a0 and a1 (less than pi apart) as seen from (x, y), or to
+// the whole border if no edge is found there
+double
+DepthInSector (const VertexList &vertices, double x, double y, double a0, double a1)
+{
+	double u0x = std::cos (a0);
+	double u0y = std::sin (a0);
+	double u1x = std::cos (a1);
+	double u1y = std::sin (a1);
+
+	double inSector = std::numeric_limits<double>::infinity ();
+	double anywhere = std::numeric_limits<double>::infinity ();
+	uint32_t n = vertices.size ();
+	for (uint32_t i = 0, j = n - 1; i < n; j = i++)
+		{
+			double ax = vertices[j].x - x;
+			double ay = vertices[j].y - y;
+			double bx = vertices[i].x - x;
+			double by = vertices[i].y - y;
+			anywhere = std::min (anywhere, DistanceToSegment (ax, ay, bx, by));
+
+			// the part of the edge left of the direction a0 and right of a1
+			double t0 = 0.0;
+			double t1 = 1.0;
+			if (!ClipHalfPlane (u0x * ay - u0y * ax, u0x * by - u0y * bx, t0, t1)
+					|| !ClipHalfPlane (ax * u1y - ay * u1x, bx * u1y - by * u1x, t0, t1))
+				continue;
+
+			double ex = bx - ax;
+			double ey = by - ay;
+			inSector = std::min (inSector, DistanceToSegment (ax + t0 * ex, ay + t0 * ey, ax + t1 * ex, ay + t1 * ey));
+		}
+
+	return (inSector < std::numeric_limits<double>::infinity ()) ? inSector : anywhere;
+}
+
+} // namespace
+
+ObstacleVisibility::ObstacleVisibility ()
+	:	m_x (0),
+		m_y (0),
+		m_r (0)
+{
+	NS_LOG_FUNCTION (this);
+}
+
+void
+ObstacleVisibility::Build (const std::vector<Obstacle> &obstacles, const std::vector<uint32_t> &nearby,
+													 double x, double y, double r)
+{
+	NS_LOG_FUNCTION (this << x << y << r);
+
+	m_x = x;
+	m_y = y;
+	m_r = r;
+	m_around.clear ();
+	m_sectorStart.clear ();
+	m_sectorFirst.clear ();
+	m_depth.clear ();
+	m_obstacle.clear ();
+
+	// angular range of the obstacles within r, as in Topology::GetObstructedLossBatch
+	double rSq = r * r;
+	std::vector<AngularRange> ranges;
+	std::vector<double> cuts;
+	cuts.push_back (-M_PI);
+	cuts.push_back (M_PI);
+	for (uint32_t i = 0; i < nearby.size (); i++)
+		{
+			uint32_t index = nearby[i];
+			const Obstacle &obstacle = obstacles[index];
+			const Vector2D &center = obstacle.GetCenterVector ();
+			double dxc = center.x - x;
+			double dyc = center.y - y;
+			if (!((dxc * dxc + dyc * dyc - rSq) < 0))
+				continue;
+
+			const VertexList &vertices = obstacle.GetVertices ();
+			double xmin = std::numeric_limits<double>::max ();
+			double ymin = std::numeric_limits<double>::max ();
+			double xmax = -std::numeric_limits<double>::max ();
+			double ymax = -std::numeric_limits<double>::max ();
+			for (uint32_t v = 0; v < vertices.size (); v++)
+				{
+					xmin = std::min (xmin, vertices[v].x);
+					ymin = std::min (ymin, vertices[v].y);
+					xmax = std::max (xmax, vertices[v].x);
+					ymax = std::max (ymax, vertices[v].y);
+				}
+			if (x > xmin - g_aroundMargin && x < xmax + g_aroundMargin
+					&& y > ymin - g_aroundMargin && y < ymax + g_aroundMargin)
+				{
+					m_around.push_back (index);
+					continue;
+				}
+
+			// the footprint spans less than pi, measure the angles of its
+			// vertices from the direction of a point of its bounding box
+			double ref = std::atan2 (dyc, dxc);
+			double lo = 0.0;
+			double hi = 0.0;
+			for (uint32_t v = 0; v < vertices.size (); v++)
+				{
+					double a = std::atan2 (vertices[v].y - y, vertices[v].x - x) - ref;
+					if (a > M_PI)
+						a -= 2 * M_PI;
+					else if (a < -M_PI)
+						a += 2 * M_PI;
+					lo = std::min (lo, a);
+					hi = std::max (hi, a);
+				}
+
+			AngularRange range;
+			range.start = ref + lo - g_anglePad;
+			if (range.start < -M_PI)
+				range.start += 2 * M_PI;
+			range.end = range.start + (hi - lo) + 2 * g_anglePad;
+			range.index = index;
+			// a range across the -x direction is split in two
+			if (range.end > M_PI)
+				{
+					AngularRange wrapped = range;
+					wrapped.start = -M_PI;
+					wrapped.end = range.end - 2 * M_PI;
+					range.end = M_PI;
+					ranges.push_back (wrapped);
+					cuts.push_back (wrapped.end);
+				}
+			ranges.push_back (range);
+			cuts.push_back (range.start);
+			cuts.push_back (range.end);
+		}
+
+	// sectors between consecutive cuts: each one is either within a range or out of it
+	std::sort (cuts.begin (), cuts.end ());
+	cuts.erase (std::unique (cuts.begin (), cuts.end ()), cuts.end ());
+	uint32_t nSectors = cuts.size () - 1;
+
+	std::vector<SectorEntry> entries;
+	for (uint32_t k = 0; k < ranges.size (); k++)
+		{
+			const AngularRange &range = ranges[k];
+			const VertexList &vertices = obstacles[range.index].GetVertices ();
+			uint32_t s = std::lower_bound (cuts.begin (), cuts.end (), range.start) - cuts.begin ();
+			for (; s < nSectors && cuts[s] < range.end; s++)
+				{
+					// where the footprint begins within the sector, enlarged as the ranges
+					double depth = DepthInSector (vertices, x, y, cuts[s] - g_anglePad, cuts[s + 1] + g_anglePad);
+					SectorEntry entry;
+					entry.sector = s;
+					entry.depth = std::max (0.0, depth - g_depthMargin);
+					entry.index = range.index;
+					entries.push_back (entry);
+				}
+		}
+	std::sort (entries.begin (), entries.end ());
+
+	m_sectorStart.swap (cuts);
+	m_sectorFirst.assign (nSectors + 1, 0);
+	m_depth.resize (entries.size ());
+	m_obstacle.resize (entries.size ());
+	for (uint32_t e = 0; e < entries.size (); e++)
+		{
+			m_sectorFirst[entries[e].sector + 1]++;
+			m_depth[e] = entries[e].depth;
+			m_obstacle[e] = entries[e].index;
+		}
+	for (uint32_t s = 0; s < nSectors; s++)
+		{
+			m_sectorFirst[s + 1] += m_sectorFirst[s];
+		}
+
+	NS_LOG_INFO ("Point " << x << "," << y << ": " << m_around.size () << " obstacles around, "
+							 << entries.size () << " entries in " << nSectors << " sectors.");
+}
+
+double
+ObstacleVisibility::GetX () const
+{
+	return m_x;
+}
+
+double
+ObstacleVisibility::GetY () const
+{
+	return m_y;
+}
+
+double
+ObstacleVisibility::GetRadius () const
+{
+	return m_r;
+}
+
+void
+ObstacleVisibility::Lookup (double x, double y, std::vector<uint32_t> &out) const
+{
+	out.insert (out.end (), m_around.begin (), m_around.end ());
+
+	// a point right above or below sees only the obstacles around
+	double dx = x - m_x;
+	double dy = y - m_y;
+	if ((dx == 0 && dy == 0) || m_sectorStart.size () < 2)
+		return;
+
+	// the sector of the direction, then the obstacles beginning within the distance
+	double theta = std::atan2 (dy, dx);
+	uint32_t nSectors = m_sectorStart.size () - 1;
+	uint32_t s = std::upper_bound (m_sectorStart.begin () + 1, m_sectorStart.begin () + nSectors, theta)
+		- m_sectorStart.begin () - 1;
+	std::vector<double>::const_iterator first = m_depth.begin () + m_sectorFirst[s];
+	std::vector<double>::const_iterator last = std::upper_bound (first, m_depth.begin () + m_sectorFirst[s + 1],
+																															 std::sqrt (dx * dx + dy * dy));
+	for (std::vector<double>::const_iterator it = first; it != last; ++it)
+		{
+			out.push_back (m_obstacle[it - m_depth.begin ()]);
+		}
+}
+
+uint32_t
+ObstacleVisibility::GetNSectors () const
+{
+	return m_sectorStart.empty () ? 0 : m_sectorStart.size () - 1;
+}
+
+uint32_t
+ObstacleVisibility::GetNEntries () const
+{
+	return m_obstacle.size ();
+}
+
+uint32_t
+ObstacleVisibility::GetNAround () const
+{
+	return m_around.size ();
+}
+
+uint64_t
+ObstacleVisibility::GetHeapBytes () const
+{
+	return sizeof (uint32_t) * (m_around.capacity () + m_sectorFirst.capacity () + m_obstacle.capacity ())
+		+ sizeof (double) * (m_sectorStart.capacity () + m_depth.capacity ());
+}
+
+} // namespace ns3
@@ -0,0 +1,140 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#ifndef OBSTACLE_VISIBILITY_H
+#define OBSTACLE_VISIBILITY_H
+
+#include <vector>
+#include <stdint.h>
+#include "obstacle.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief What can be seen from a point that never moves (e.g. a fixed
+ * sensor), within the limiting radius of the obstacle queries.
+ *
+ * The obstacles whose center is within the radius are split by the angular
+ * range their footprint covers, as seen from the point: the directions
+ * around the point are cut at the boundaries of every range, and each of
+ * these sectors lists its obstacles sorted by how far from the point the
+ * footprint begins within the sector. The segment from the point to
+ * another one can cross only the obstacles of the sector of its direction
+ * that begin closer than the other point: two binary searches find them,
+ * and when there is none the other point is in sight.
+ * The obstacles too close to the point to measure their angles are
+ * returned by every lookup.
+ */
+class ObstacleVisibility
+{
+public:
+	/**
+	 * \brief Constructor, a point that sees no obstacle
+	 */
+	ObstacleVisibility ();
+
+	/**
+	 * \brief Build the sectors of a point
+	 * \param obstacles the obstacles, referred to by their index
+	 * \param nearby indices of the obstacles that may be within r of the
+	 * point (those whose center is farther are skipped)
+	 * \param x x coordinate of the point
+	 * \param y y coordinate of the point
+	 * \param r limiting radius for obstacles
+	 * \return none
+	 */
+	void Build (const std::vector<Obstacle> &obstacles, const std::vector<uint32_t> &nearby,
+							double x, double y, double r);
+
+	/**
+	 * \brief Get the x coordinate of the point
+	 * \return the x coordinate
+	 */
+	double GetX () const;
+
+	/**
+	 * \brief Get the y coordinate of the point
+	 * \return the y coordinate
+	 */
+	double GetY () const;
+
+	/**
+	 * \brief Get the limiting radius the sectors were built with
+	 * \return the radius in meters
+	 */
+	double GetRadius () const;
+
+	/**
+	 * \brief Find the obstacles the segment from the point to (x, y) may
+	 * cross, as seen from above (any other obstacle within r is not crossed)
+	 * \param x x coordinate of the other point
+	 * \param y y coordinate of the other point
+	 * \param out the indices of the obstacles are appended, without duplicates
+	 * but not sorted
+	 * \return none
+	 */
+	void Lookup (double x, double y, std::vector<uint32_t> &out) const;
+
+	/**
+	 * \brief Get the number of sectors around the point
+	 * \return the number of sectors
+	 */
+	uint32_t GetNSectors () const;
+
+	/**
+	 * \brief Get the number of obstacles listed by the sectors, each
+	 * obstacle once for every sector it spans
+	 * \return the number of entries
+	 */
+	uint32_t GetNEntries () const;
+
+	/**
+	 * \brief Get the number of obstacles returned by every lookup
+	 * \return the number of obstacles around the point
+	 */
+	uint32_t GetNAround () const;
+
+	/**
+	 * \brief Get the memory allocated by the sectors, besides the object
+	 * \return the capacity of the arrays, in bytes
+	 */
+	uint64_t GetHeapBytes () const;
+
+private:
+	double								m_x;
+	double								m_y;
+	double								m_r;
+	// obstacles too close to the point, in every lookup
+	std::vector<uint32_t>	m_around;
+	// sector i spans the angles from m_sectorStart[i] to m_sectorStart[i + 1]
+	// (-pi to pi overall), its obstacles are m_obstacle[m_sectorFirst[i]] ..
+	// m_obstacle[m_sectorFirst[i + 1] - 1], sorted by m_depth, the distance
+	// from the point within which they do not reach in the sector
+	std::vector<double>		m_sectorStart;
+	std::vector<uint32_t>	m_sectorFirst;
+	std::vector<double>		m_depth;
+	std::vector<uint32_t>	m_obstacle;
+};
+
+} // namespace ns3
+
+#endif /* OBSTACLE_VISIBILITY_H */
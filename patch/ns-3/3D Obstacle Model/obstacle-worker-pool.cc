@@ -0,0 +1,111 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#include <algorithm>
+#include "ns3/log.h"
+#include "obstacle-worker-pool.h"
+
+NS_LOG_COMPONENT_DEFINE ("ObstacleWorkerPool");
+
+namespace ns3 {
+
+ObstacleWorkerPool::ObstacleWorkerPool (uint32_t nThreads)
+	: m_job (0),
+		m_nTasks (0),
+		m_next (0),
+		m_busy (0),
+		m_generation (0),
+		m_stop (false)
+{
+	NS_LOG_FUNCTION (this << nThreads);
+
+	if (nThreads == 0)
+		nThreads = std::max (1u, std::thread::hardware_concurrency ());
+
+	for (uint32_t t = 0; t < nThreads; t++)
+		m_threads.push_back (std::thread (&ObstacleWorkerPool::Work, this, t));
+}
+
+ObstacleWorkerPool::~ObstacleWorkerPool ()
+{
+	NS_LOG_FUNCTION (this);
+
+	{
+		std::lock_guard<std::mutex> lock (m_mutex);
+		m_stop = true;
+	}
+	m_start.notify_all ();
+	for (uint32_t t = 0; t < m_threads.size (); t++)
+		m_threads[t].join ();
+}
+
+uint32_t
+ObstacleWorkerPool::GetNThreads () const
+{
+	return m_threads.size ();
+}
+
+void
+ObstacleWorkerPool::Run (uint32_t nTasks, const std::function<void (uint32_t, uint32_t)> &job)
+{
+	NS_LOG_FUNCTION (this << nTasks);
+
+	if (nTasks == 0)
+		return;
+
+	std::unique_lock<std::mutex> lock (m_mutex);
+	m_job = &job;
+	m_nTasks = nTasks;
+	m_next = 0;
+	m_busy = m_threads.size ();
+	m_generation++;
+	m_start.notify_all ();
+
+	// the lock also publishes the results of the threads to the caller
+	m_done.wait (lock, [this] () { return m_busy == 0; });
+	m_job = 0;
+}
+
+void
+ObstacleWorkerPool::Work (uint32_t thread)
+{
+	uint64_t generation = 0;
+	std::unique_lock<std::mutex> lock (m_mutex);
+	while (true)
+	{
+		m_start.wait (lock, [&] () { return m_stop || (m_generation != generation); });
+		if (m_stop)
+			return;
+		generation = m_generation;
+		const std::function<void (uint32_t, uint32_t)> &job = *m_job;
+		uint32_t nTasks = m_nTasks;
+		lock.unlock ();
+
+		for (uint32_t task = m_next++; task < nTasks; task = m_next++)
+			job (task, thread);
+
+		lock.lock ();
+		if (--m_busy == 0)
+			m_done.notify_one ();
+	}
+}
+
+} // namespace ns3
@@ -0,0 +1,102 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#ifndef OBSTACLE_WORKER_POOL_H
+#define OBSTACLE_WORKER_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief A fixed set of threads that run the tasks of a job, for
+ * queries repeated too often to start threads each time (e.g. the
+ * obstructed losses of every transmission).
+ *
+ * Run blocks until every task of the job is done; the tasks are taken
+ * in order by the first idle thread, so each must write only its own
+ * results. The pool is driven by one thread at a time.
+ */
+class ObstacleWorkerPool
+{
+public:
+	/**
+	 * \brief Constructor, starts the threads
+	 * \param nThreads number of threads (0 for one per core)
+	 */
+	ObstacleWorkerPool (uint32_t nThreads);
+
+	/**
+	 * \brief Destructor, stops the threads
+	 */
+	~ObstacleWorkerPool ();
+
+	/**
+	 * \brief Get the number of threads
+	 * \return the number of threads
+	 */
+	uint32_t GetNThreads () const;
+
+	/**
+	 * \brief Run a job and wait for it to finish
+	 * \param nTasks number of tasks
+	 * \param job called once for each task, with the index of the task
+	 * and the index of the thread that runs it (less than GetNThreads)
+	 * \return none
+	 */
+	void Run (uint32_t nTasks, const std::function<void (uint32_t, uint32_t)> &job);
+
+private:
+	// not copyable, it owns the threads
+	ObstacleWorkerPool (const ObstacleWorkerPool &);
+	ObstacleWorkerPool &operator= (const ObstacleWorkerPool &);
+
+	/**
+	 * \brief Body of a thread: run the tasks of each job until stopped
+	 * \param thread index of the thread
+	 * \return none
+	 */
+	void Work (uint32_t thread);
+
+	std::vector<std::thread>	m_threads;
+
+	// current job, its next task and the threads still running it
+	std::mutex	m_mutex;
+	std::condition_variable	m_start;
+	std::condition_variable	m_done;
+	const std::function<void (uint32_t, uint32_t)>	*m_job;
+	uint32_t	m_nTasks;
+	std::atomic<uint32_t>	m_next;
+	uint32_t	m_busy;
+	uint64_t	m_generation;
+	bool	m_stop;
+};
+
+} // namespace ns3
+
+#endif /* OBSTACLE_WORKER_POOL_H */
@@ -20,6 +20,7 @@
  * Modified by: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
  */
 
+#include <mutex>
 #include "obstacle.h"
 #include "ns3/core-module.h"
 
@@ -27,41 +28,313 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("obstacle");
 
+namespace {
+
+// the ids, one after the other, with an open addressing hash table
+// of their indexes (0 marks an empty slot, the empty id is not in it)
+struct IdPool
+{
+	IdPool () : start (2, 0), table (1024, 0) {}
+
+	std::mutex						mutex;
+	std::string						chars;
+	std::vector<uint32_t>	start;
+	std::vector<uint32_t>	table;
+};
+
+IdPool &
+GetIdPool ()
+{
+	static IdPool pool;
+	return pool;
+}
+
+uint64_t
+HashId (const char *id, size_t size)
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ (uint8_t) id[i]) * 1099511628211ULL;
+		}
+	return hash;
+}
+
+// a lazy exact point as allocated: reference count, virtual table,
+// interval approximation and pointer to the exact value (estimate)
+const uint64_t g_exactPointBytes = 64;
+
+} // namespace
+
+uint32_t
+ObstacleIdPool::Intern (const std::string &id)
+{
+	if (id.empty ())
+		{
+			return 0;
+		}
+
+	IdPool &pool = GetIdPool ();
+	std::lock_guard<std::mutex> lock (pool.mutex);
+
+	size_t mask = pool.table.size () - 1;
+	size_t slot = HashId (id.data (), id.size ()) & mask;
+	while (pool.table[slot] != 0)
+		{
+			uint32_t index = pool.table[slot];
+			if (pool.start[index + 1] - pool.start[index] == id.size ()
+					&& pool.chars.compare (pool.start[index], id.size (), id) == 0)
+				{
+					return index;
+				}
+			slot = (slot + 1) & mask;
+		}
+
+	uint32_t index = pool.start.size () - 1;
+	pool.chars += id;
+	pool.start.push_back (pool.chars.size ());
+	pool.table[slot] = index;
+
+	// keep the table at most half full
+	if (2 * index >= pool.table.size ())
+		{
+			std::vector<uint32_t> table (2 * pool.table.size (), 0);
+			mask = table.size () - 1;
+			for (uint32_t i = 1; i <= index; i++)
+				{
+					slot = HashId (pool.chars.data () + pool.start[i], pool.start[i + 1] - pool.start[i]) & mask;
+					while (table[slot] != 0)
+						{
+							slot = (slot + 1) & mask;
+						}
+					table[slot] = i;
+				}
+			pool.table.swap (table);
+		}
+
+	return index;
+}
+
+std::string
+ObstacleIdPool::Get (uint32_t index)
+{
+	if (index == 0)
+		{
+			return std::string ();
+		}
+
+	IdPool &pool = GetIdPool ();
+	std::lock_guard<std::mutex> lock (pool.mutex);
+	NS_ASSERT (index + 1 < pool.start.size ());
+
+	return pool.chars.substr (pool.start[index], pool.start[index + 1] - pool.start[index]);
+}
+
+uint32_t
+ObstacleIdPool::GetN ()
+{
+	IdPool &pool = GetIdPool ();
+	std::lock_guard<std::mutex> lock (pool.mutex);
+
+	return pool.start.size () - 1;
+}
+
+uint64_t
+ObstacleIdPool::GetBytes ()
+{
+	IdPool &pool = GetIdPool ();
+	std::lock_guard<std::mutex> lock (pool.mutex);
+
+	return pool.chars.capacity () + pool.start.capacity () * sizeof (uint32_t)
+		+ pool.table.capacity () * sizeof (uint32_t);
+}
+
+ObstacleMemoryReport::ObstacleMemoryReport ()
+	: nObstacles (0),
+		nVertices (0),
+		nIds (0),
+		nPolygons (0),
+		obstacleBytes (0),
+		vertexBytes (0),
+		mappedVertexBytes (0),
+		idBytes (0),
+		footprintBytes (0),
+		polygonBytes (0),
+		totalBytes (0),
+		legacyBytes (0)
+{
+}
+
+void
+ObstacleMemoryReport::Print (std::ostream &os) const
+{
+	os << "Obstacle storage: " << nObstacles << " obstacles, " << nVertices << " vertices, "
+		 << nIds << " ids in the pool" << std::endl;
+	os << "  obstacles " << obstacleBytes << " B, vertices " << vertexBytes << " B";
+	if (mappedVertexBytes > 0)
+		{
+			os << " (+" << mappedVertexBytes << " B mapped)";
+		}
+	os << ", ids " << idBytes << " B, footprint tables " << footprintBytes << " B, "
+		 << nPolygons << " exact polygons " << polygonBytes << " B: total " << totalBytes << " B" << std::endl;
+	os << "  with string ids, exact polygons and exact centers: " << legacyBytes << " B (estimate), "
+		 << ((totalBytes > 0) ? (double) legacyBytes / totalBytes : 0.0) << "x" << std::endl;
+}
+
+void
+ObstacleMemoryReport::Add (const Obstacle &obstacle)
+{
+	uint32_t n = obstacle.m_vertices.size ();
+	nObstacles++;
+	nVertices += n;
+	obstacleBytes += sizeof (Obstacle);
+	if (obstacle.OwnsVertices ())
+		{
+			vertexBytes += obstacle.m_ownVertices.capacity () * sizeof (Vector2D);
+		}
+	footprintBytes += obstacle.m_footprint.GetHeapBytes ();
+	if (obstacle.m_polygon)
+		{
+			nPolygons++;
+			polygonBytes += sizeof (Polygon_2) + n * (sizeof (Point) + g_exactPointBytes);
+		}
+
+	// a string id (out of the object if it does not fit in it), an exact
+	// polygon and an exact center, besides the double precision copies
+	std::string id = ObstacleIdPool::Get (obstacle.m_id);
+	legacyBytes += sizeof (Obstacle) - sizeof (uint32_t) - sizeof (VertexList) - sizeof (std::unique_ptr<Polygon_2>)
+		+ sizeof (std::string) + sizeof (Polygon_2) + sizeof (Point)
+		+ ((id.size () >= sizeof (std::string) / 2) ? id.size () + 1 : 0)
+		+ n * (sizeof (Vector2D) + sizeof (Point) + g_exactPointBytes) + g_exactPointBytes
+		+ obstacle.m_footprint.GetHeapBytes ();
+}
+
 Obstacle::Obstacle() :
   // default values for per-wall and per-meter attenuation,
   // (per Obstacle instance)
   // See C. Sommer et. al.:
   // A Computationally Inexpensive Empirical Model of IEEE 802.11p
   // Radio Shadowing in Urban Environments;
+  m_id (0),
+	m_radiusSq (0),
   m_beta(9.0),
   m_gamma(0.4),
-	m_height (0)
+	m_height (0),
+	m_roofPlane (false)
 {
   NS_LOG_FUNCTION (this);
 }
 
+Obstacle::Obstacle (const Obstacle &other)
+{
+	*this = other;
+}
+
+Obstacle::Obstacle (Obstacle &&other) noexcept
+{
+	*this = std::move (other);
+}
+
+Obstacle &
+Obstacle::operator= (const Obstacle &other)
+{
+	if (this != &other)
+		{
+			bool owned = other.OwnsVertices ();
+			m_id = other.m_id;
+			m_ownVertices = other.m_ownVertices;
+			m_vertices = owned ? VertexList (m_ownVertices) : other.m_vertices;
+			m_polygon.reset ();
+			m_centerVector = other.m_centerVector;
+			m_radiusSq = other.m_radiusSq;
+			m_beta = other.m_beta;
+			m_gamma = other.m_gamma;
+			m_height = other.m_height;
+			m_footprint = other.m_footprint;
+			m_roofPlane = other.m_roofPlane;
+		}
+	return *this;
+}
+
+Obstacle &
+Obstacle::operator= (Obstacle &&other) noexcept
+{
+	if (this != &other)
+		{
+			bool owned = other.OwnsVertices ();
+			m_id = other.m_id;
+			m_ownVertices = std::move (other.m_ownVertices);
+			m_vertices = owned ? VertexList (m_ownVertices) : other.m_vertices;
+			m_polygon = std::move (other.m_polygon);
+			m_centerVector = other.m_centerVector;
+			m_radiusSq = other.m_radiusSq;
+			m_beta = other.m_beta;
+			m_gamma = other.m_gamma;
+			m_height = other.m_height;
+			m_footprint = std::move (other.m_footprint);
+			m_roofPlane = other.m_roofPlane;
+			other.m_ownVertices.clear ();
+			other.m_vertices = VertexList ();
+		}
+	return *this;
+}
+
 void
 Obstacle::SetId(std::string id)
 {
   NS_LOG_FUNCTION (this);
 
-  this->m_id = id;
+  this->m_id = ObstacleIdPool::Intern (id);
 }
 
 const std::string
-Obstacle::GetId()
+Obstacle::GetId() const
 {
   NS_LOG_FUNCTION (this);
 
-  return m_id;
+  return ObstacleIdPool::Get (m_id);
+}
+
+uint32_t
+Obstacle::GetIdIndex() const
+{
+	NS_LOG_FUNCTION (this);
+
+	return m_id;
+}
+
+const Polygon_2 &
+Obstacle::GetPolygon() const
+{
+	NS_LOG_FUNCTION (this);
+
+	if (!m_polygon)
+		{
+			m_polygon.reset (new Polygon_2 ());
+			for (uint32_t i = 0; i < m_vertices.size (); i++)
+				{
+					m_polygon->push_back (Point (m_vertices[i].x, m_vertices[i].y));
+				}
+		}
+
+	return *m_polygon;
 }
 
-Polygon_2 &
-Obstacle::GetPolygon()
+bool
+Obstacle::HasPolygon() const
+{
+	NS_LOG_FUNCTION (this);
+
+	return (bool) m_polygon;
+}
+
+const VertexList &
+Obstacle::GetVertices() const
 {
   NS_LOG_FUNCTION (this);
 
-  return m_obstacle;
+  return m_vertices;
 }
 
 void
@@ -69,8 +342,38 @@ Obstacle::AddVertex(Point p)
 {
   NS_LOG_FUNCTION (this);
 
-  // add vertex to internal CGAL Polygon_2 object
-  m_obstacle.push_back(p);
+	AddVertex (CGAL::to_double (p.x ()), CGAL::to_double (p.y ()));
+}
+
+void
+Obstacle::AddVertex(double x, double y)
+{
+	NS_LOG_FUNCTION (this << x << y);
+
+	if (!OwnsVertices ())
+		{
+			m_ownVertices.assign (m_vertices.begin (), m_vertices.end ());
+		}
+	m_ownVertices.push_back (Vector2D (x, y));
+	m_vertices = VertexList (m_ownVertices);
+	m_polygon.reset ();
+}
+
+void
+Obstacle::UseVertices(const Vector2D *vertices, uint32_t n)
+{
+	NS_LOG_FUNCTION (this << n);
+
+	std::vector<Vector2D> ().swap (m_ownVertices);
+	m_vertices = VertexList (vertices, n);
+}
+
+bool
+Obstacle::OwnsVertices() const
+{
+	NS_LOG_FUNCTION (this);
+
+	return m_vertices.begin () == VertexList (m_ownVertices).begin ();
 }
 
 void
@@ -79,29 +382,90 @@ Obstacle::Locate()
   NS_LOG_FUNCTION (this);
 
   // get the bounding box of the Obstacle
-  Bbox_2 bbox = m_obstacle.bbox();
+	if (m_vertices.empty ())
+		{
+			Locate (0, 0, 0, 0);
+			return;
+		}
+	double xmin = m_vertices[0].x;
+	double ymin = m_vertices[0].y;
+	double xmax = m_vertices[0].x;
+	double ymax = m_vertices[0].y;
+	for (uint32_t i = 1; i < m_vertices.size (); i++)
+		{
+			xmin = std::min (xmin, m_vertices[i].x);
+			ymin = std::min (ymin, m_vertices[i].y);
+			xmax = std::max (xmax, m_vertices[i].x);
+			ymax = std::max (ymax, m_vertices[i].y);
+		}
+
+	Locate (xmin, ymin, xmax, ymax);
+}
 
-  double bx = (double)bbox.xmin();
-  double by = (double)bbox.ymin();
+void
+Obstacle::Locate(double xmin, double ymin, double xmax, double ymax)
+{
+  NS_LOG_FUNCTION (this);
+
+  double bx = xmin;
+  double by = ymin;
   // get the centerpoint
-  double cx = (double)(bx + (bbox.xmax() - bx));
-  double cy = (double)(by + (bbox.ymax() - by));
+  double cx = (double)(bx + (xmax - bx));
+  double cy = (double)(by + (ymax - by));
 
-  m_center = Point(cx, cy);
+	m_centerVector = Vector2D (cx, cy);
 
   m_radiusSq = (cx - bx) * (cx - bx) + (cy - by) * (cy - by);
+
+	// the roof is the plane through the first three vertices at the
+	// height of the obstacle, if they are not collinear
+	m_roofPlane = false;
+	if (m_vertices.size () >= 3)
+		{
+			double ux = m_vertices[1].x - m_vertices[0].x;
+			double uy = m_vertices[1].y - m_vertices[0].y;
+			double vx = m_vertices[2].x - m_vertices[0].x;
+			double vy = m_vertices[2].y - m_vertices[0].y;
+			m_roofPlane = (ux * vy - uy * vx != 0);
+		}
+
+	m_footprint.Build (m_vertices);
 }
 
-const Point &
-Obstacle::GetCenter()
+Point
+Obstacle::GetCenter() const
 {
   NS_LOG_FUNCTION (this);
 
-  return m_center;
+  return Point (m_centerVector.x, m_centerVector.y);
+}
+
+const Vector2D &
+Obstacle::GetCenterVector() const
+{
+	NS_LOG_FUNCTION (this);
+
+	return m_centerVector;
+}
+
+const FootprintEdgeTable &
+Obstacle::GetFootprint() const
+{
+	NS_LOG_FUNCTION (this);
+
+	return m_footprint;
+}
+
+bool
+Obstacle::HasRoofPlane() const
+{
+	NS_LOG_FUNCTION (this);
+
+	return m_roofPlane;
 }
 
 double
-Obstacle::GetRadiusSq()
+Obstacle::GetRadiusSq() const
 {
   NS_LOG_FUNCTION (this);
 
@@ -109,7 +473,7 @@ Obstacle::GetRadiusSq()
 }
 
 double
-Obstacle::GetBeta()
+Obstacle::GetBeta() const
 {
   NS_LOG_FUNCTION (this);
 
@@ -117,7 +481,7 @@ Obstacle::GetBeta()
 }
 
 double
-Obstacle::GetGamma()
+Obstacle::GetGamma() const
 {
   NS_LOG_FUNCTION (this);
 
@@ -125,7 +489,7 @@ Obstacle::GetGamma()
 }
 
 double
-Obstacle::GetHeight()
+Obstacle::GetHeight() const
 {
   NS_LOG_FUNCTION (this);
 
@@ -25,6 +25,9 @@
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <string>
+#include <vector>
 #include "ns3/core-module.h"
 
 // CGAL includes
@@ -41,6 +44,8 @@
 #include <CGAL/Range_tree_k.h>
 #include <CGAL/Plane_3.h>
 
+#include "wall-intersection-kernel.h"
+
 // CGAL types
 typedef CGAL::Exact_predicates_exact_constructions_kernel K;
 typedef K::FT Coord_type;
@@ -55,6 +60,90 @@ typedef CGAL::Plane_3<K> Plane_3;
 typedef CGAL::Polygon_2<K>::Edge_const_iterator EdgeIterator;
 
 namespace ns3 {
+
+class Obstacle;
+
+/**
+ * \ingroup obstacle
+ * \brief The ids of the obstacles, each one stored once: an obstacle
+ * holds the index of its id. The pool is shared by all the topologies,
+ * and can be used by concurrent threads (e.g. the parsers of a poly file)
+ */
+class ObstacleIdPool
+{
+public:
+	/**
+	 * \brief Add an id to the pool, if it is not there yet
+	 * \param id the id
+	 * \return the index of the id (0 for the empty id)
+	 */
+	static uint32_t Intern (const std::string &id);
+
+	/**
+	 * \brief Get an id of the pool
+	 * \param index the index returned by Intern
+	 * \return the id
+	 */
+	static std::string Get (uint32_t index);
+
+	/**
+	 * \brief Get the number of ids in the pool
+	 * \return the number of ids, including the empty one
+	 */
+	static uint32_t GetN ();
+
+	/**
+	 * \brief Get the memory used by the pool
+	 * \return the size of the characters, offsets and hash table, in bytes
+	 */
+	static uint64_t GetBytes ();
+};
+
+/**
+ * \ingroup obstacle
+ * \brief Memory used by the obstacles of a topology, see
+ * Topology::GetMemoryReport. The legacy layout is the one with a string
+ * id, an exact CGAL polygon and an exact center in every obstacle: it is
+ * an estimate, each exact point is counted as a handle plus the
+ * reference counted representation it points to
+ */
+struct ObstacleMemoryReport
+{
+	ObstacleMemoryReport ();
+
+	/**
+	 * \brief Print the report
+	 * \param os the output stream
+	 * \return none
+	 */
+	void Print (std::ostream &os) const;
+
+	/**
+	 * \brief Count an obstacle: the object, its vertices if it holds them,
+	 * its footprint table and exact polygon, and its legacy layout
+	 * \param obstacle the obstacle
+	 * \return none
+	 */
+	void Add (const Obstacle &obstacle);
+
+	uint32_t	nObstacles;
+	uint64_t	nVertices;
+	uint32_t	nIds;								// ids in the pool, of all the topologies
+	uint32_t	nPolygons;					// exact polygons built (by the exact engine)
+
+	// bytes of the current layout
+	uint64_t	obstacleBytes;			// Obstacle objects
+	uint64_t	vertexBytes;				// vertices in memory (shared array and obstacles)
+	uint64_t	mappedVertexBytes;	// vertices used in place in a mapped compiled file
+	uint64_t	idBytes;						// id pool
+	uint64_t	footprintBytes;			// footprint edge tables
+	uint64_t	polygonBytes;				// exact polygons built
+	uint64_t	totalBytes;					// in memory, mapped vertices excluded
+
+	// bytes of the legacy layout (estimate)
+	uint64_t	legacyBytes;
+};
+
 /**
  * \ingroup Obstacle
  * \brief The Obstacle class maintains the information for a
@@ -70,6 +159,33 @@ public:
    */
   Obstacle ();
 
+	/**
+	 * \brief Copy constructor: vertices of the obstacle are copied,
+	 * vertices it refers to (see UseVertices) are shared
+	 * \param other the obstacle to copy
+	 */
+	Obstacle (const Obstacle &other);
+
+	/**
+	 * \brief Move constructor
+	 * \param other the obstacle to move
+	 */
+	Obstacle (Obstacle &&other) noexcept;
+
+	/**
+	 * \brief Copy assignment, see the copy constructor
+	 * \param other the obstacle to copy
+	 * \return this obstacle
+	 */
+	Obstacle &operator= (const Obstacle &other);
+
+	/**
+	 * \brief Move assignment
+	 * \param other the obstacle to move
+	 * \return this obstacle
+	 */
+	Obstacle &operator= (Obstacle &&other) noexcept;
+
   /**
    * \brief Sets the id (i.e., name) of the Obstacle
    * \param id the identifier (i.e., name) of the Obstacle
@@ -81,7 +197,14 @@ public:
    * \brief Gets the id (i.e., name) of the Obstacle
    * \return the id (i.e., name) of the Obstacle
    */
-  const std::string GetId();
+  const std::string GetId() const;
+
+	/**
+	 * \brief Gets the index of the id in the ObstacleIdPool: obstacles
+	 * with the same id have the same index
+	 * \return the index of the id
+	 */
+	uint32_t GetIdIndex() const;
 
   /**
    * \brief Adds a vertex to the Obstacle
@@ -90,6 +213,32 @@ public:
    */
   void AddVertex(Point p);
 
+	/**
+	 * \brief Adds a vertex to the Obstacle
+	 * \param x x coordinate of the vertex
+	 * \param y y coordinate of the vertex
+	 * \return none
+	 */
+	void AddVertex(double x, double y);
+
+	/**
+	 * \brief Refer to vertices stored elsewhere (e.g. in an array shared
+	 * by the obstacles of a topology) instead of holding them: the
+	 * vertices of the obstacle are released. The array must not change
+	 * while the obstacle, or a copy of it, refers to it. Adding a
+	 * vertex makes the obstacle hold its vertices again
+	 * \param vertices the first vertex
+	 * \param n the number of vertices
+	 * \return none
+	 */
+	void UseVertices(const Vector2D *vertices, uint32_t n);
+
+	/**
+	 * \brief Tests if the obstacle holds its vertices (see UseVertices)
+	 * \return true if the vertices are stored in the obstacle
+	 */
+	bool OwnsVertices() const;
+
   /**
    * \brief Calculates the location of the centerpoint
    * of the bounding box of the polygon, used for
@@ -100,12 +249,23 @@ public:
    */
   void Locate();
 
+	/**
+	 * \brief Same as Locate, from a bounding box already known
+	 * (e.g. read from a compiled buildings file)
+	 * \param xmin minimum x of the vertices
+	 * \param ymin minimum y of the vertices
+	 * \param xmax maximum x of the vertices
+	 * \param ymax maximum y of the vertices
+	 * \return none
+	 */
+	void Locate(double xmin, double ymin, double xmax, double ymax);
+
   /**
    * \brief Get the centerpoint of the Obstacle
    * \return the centerpoint (i.e., midpoint of longest
    * ray between vertices that traverses the interior)
    */
-  const Point &GetCenter();
+  Point GetCenter() const;
 
   /**
    * \brief Gets the radius of the Obstacle3Ds region
@@ -113,34 +273,69 @@ public:
    * \return the radius (squared) =
    * (1/2 of longest interior ray) ^ 2
    */
-  double GetRadiusSq();
+  double GetRadiusSq() const;
 
-  /**
-   * \brief Gets the polygonal region that defines the Obstacle
-   * \return The polygonal region defining the Obstacle
-   * (i.e., a CGAL Polygon_2)
-   */
-  Polygon_2 &GetPolygon();
+	/**
+	 * \brief Gets the polygonal region that defines the Obstacle. It is
+	 * built from the vertices the first time it is needed (only the exact
+	 * engine does), so it must not be called by concurrent threads
+	 * \return The polygonal region defining the Obstacle (read only)
+	 */
+	const Polygon_2 &GetPolygon() const;
+
+	/**
+	 * \brief Tests if the polygon has been built, see GetPolygon
+	 * \return true if the polygon has been built
+	 */
+	bool HasPolygon() const;
+
+	/**
+	 * \brief Gets the vertices of the Obstacle in double precision,
+	 * in the same order of the polygon
+	 * \return the vertices of the Obstacle
+	 */
+	const VertexList &GetVertices() const;
+
+	/**
+	 * \brief Gets the edge table of the footprint, for fast containment
+	 * tests (e.g. of the point where a segment crosses the roof)
+	 * \return the edge table, built by Locate
+	 */
+	const FootprintEdgeTable &GetFootprint() const;
+
+	/**
+	 * \brief Tests if the roof is a plane: the first three vertices,
+	 * the roof is built on, are not collinear
+	 * \return true if the roof is the plane z = height
+	 */
+	bool HasRoofPlane() const;
+
+	/**
+	 * \brief Get the centerpoint of the Obstacle in double precision,
+	 * same value of GetCenter. Reading it does not touch any CGAL object
+	 * \return the centerpoint
+	 */
+	const Vector2D &GetCenterVector() const;
 
   /**
    * \brief Gets the value of beta, the per-wall
    * attenuation parameter
    * \return beta, the per-wall attenuation parameter
    */
-  double GetBeta();
+  double GetBeta() const;
 
   /**
    * \brief Gets the value of gamma, the per-meter
    * attenuation parameter
    * \return gamma, the per-meter attenuation parameter
    */
-  double GetGamma();
+  double GetGamma() const;
 
 	/**
    * \brief Gets the height of the obstacle in meters
    * \return the height
    */
-	double GetHeight();
+	double GetHeight() const;
 
   /**
    * \brief Sets the value of beta, the per-wall
@@ -166,17 +361,23 @@ public:
 	void SetHeight(double height);
 
 private:
+	friend struct ObstacleMemoryReport;
 
-  // the Obstacle identifier (i.e., name)
-  std::string m_id;
+	// the Obstacle identifier (i.e., name), index in the ObstacleIdPool
+	uint32_t m_id;
 
-  // 2D polygonal represenation of the obsstacle (i.e., a CGAL Polygon_2)
-  Polygon_2 m_obstacle;
+	// the vertices, in m_ownVertices or elsewhere (see UseVertices)
+	VertexList m_vertices;
+	std::vector<Vector2D> m_ownVertices;
+
+  // 2D polygonal represenation of the obsstacle (i.e., a CGAL Polygon_2),
+	// built from m_vertices when needed, see GetPolygon
+	mutable std::unique_ptr<Polygon_2> m_polygon;
 
   // centerpoint of Obstacle bounding box
   // i.e., the midpoint of the longest ray between vertices that
   // traverses the interior of the polygon.  used for search optimizations)
-  Point m_center;
+	Vector2D m_centerVector;
 
   // radius squared from centerpoint to bounding box vertex
   double m_radiusSq;
@@ -189,6 +390,12 @@ private:
   double m_gamma; // per-meter attenuation parameter
 
 	double m_height; // height of the obstacle [in meters]
+
+	// edges of the footprint in horizontal slabs, see FootprintEdgeTable
+	FootprintEdgeTable m_footprint;
+
+	// the first three vertices are not collinear
+	bool m_roofPlane;
 };
 
 }
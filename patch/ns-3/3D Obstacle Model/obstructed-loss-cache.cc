@@ -0,0 +1,120 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "obstructed-loss-cache.h"
+
+namespace ns3 {
+
+ObstructedLossKey::ObstructedLossKey ()
+{
+	for (uint32_t i = 0; i < 6; i++)
+		m_c[i] = 0;
+}
+
+ObstructedLossKey::ObstructedLossKey (double p1x, double p1y, double p1z,
+																			double p2x, double p2y, double p2z)
+{
+	// to the nearest 0.1m
+	int64_t a[3] = { std::llround (p1x * 10), std::llround (p1y * 10), std::llround (p1z * 10) };
+	int64_t b[3] = { std::llround (p2x * 10), std::llround (p2y * 10), std::llround (p2z * 10) };
+
+	// canonical order, lexicographically smaller point first
+	bool swap = (a[0] > b[0])
+		|| (a[0] == b[0] && a[1] > b[1])
+		|| (a[0] == b[0] && a[1] == b[1] && a[2] > b[2]);
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		m_c[i] = swap ? b[i] : a[i];
+		m_c[i + 3] = swap ? a[i] : b[i];
+	}
+}
+
+bool
+ObstructedLossKey::operator== (const ObstructedLossKey &other) const
+{
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		if (m_c[i] != other.m_c[i])
+			return false;
+	}
+	return true;
+}
+
+uint64_t
+ObstructedLossKeyHash::operator() (const ObstructedLossKey &key) const
+{
+	// combine the coordinates with the splitmix64 finalizer
+	uint64_t h = 0x9e3779b97f4a7c15ULL;
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		uint64_t z = h ^ (uint64_t) key.m_c[i];
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		h = z ^ (z >> 31);
+	}
+	return h;
+}
+
+NodePairKey::NodePairKey ()
+	:	m_a (0),
+		m_b (0)
+{
+}
+
+NodePairKey::NodePairKey (uint32_t a, uint32_t b)
+	:	m_a (std::min (a, b)),
+		m_b (std::max (a, b))
+{
+}
+
+bool
+NodePairKey::operator== (const NodePairKey &other) const
+{
+	return (m_a == other.m_a) && (m_b == other.m_b);
+}
+
+uint64_t
+NodePairKeyHash::operator() (const NodePairKey &key) const
+{
+	// splitmix64 finalizer of the two ids
+	uint64_t z = ((uint64_t) key.m_a << 32) | key.m_b;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+bool
+NodePairLoss::IsValid (const Vector &pa, const Vector &pb, double thresholdSq) const
+{
+	double ax = pa.x - m_pa.x;
+	double ay = pa.y - m_pa.y;
+	double az = pa.z - m_pa.z;
+	double bx = pb.x - m_pb.x;
+	double by = pb.y - m_pb.y;
+	double bz = pb.z - m_pb.z;
+	return (ax * ax + ay * ay + az * az <= thresholdSq)
+		&& (bx * bx + by * by + bz * bz <= thresholdSq);
+}
+
+} // namespace ns3
@@ -0,0 +1,515 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#ifndef OBSTRUCTED_LOSS_CACHE_H
+#define OBSTRUCTED_LOSS_CACHE_H
+
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+#include "ns3/vector.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief A fixed capacity cache, stored in an open-addressing hash table
+ * (linear probing) with CLOCK (second chance) eviction.
+ *
+ * Hash must provide uint64_t operator() (const Key &) const, Key
+ * must be comparable with ==. A capacity of 0 disables the cache.
+ */
+template <typename Key, typename Value, typename Hash>
+class ClockCache
+{
+public:
+	/**
+	 * \brief Constructor
+	 * \param capacity maximum number of entries
+	 */
+	ClockCache (uint32_t capacity = 0);
+
+	/**
+	 * \brief Change the capacity of the cache (entries are dropped
+	 * if the capacity actually changes)
+	 * \param capacity maximum number of entries, at most GetMaxCapacity ()
+	 * (larger values are clamped)
+	 * \return none
+	 */
+	void SetCapacity (uint32_t capacity);
+
+	/**
+	 * \brief Get the largest capacity of a cache, the table having twice
+	 * as many slots (a power of 2 that must fit in 32 bits)
+	 * \return maximum number of entries
+	 */
+	static uint32_t GetMaxCapacity ();
+
+	/**
+	 * \brief Get the capacity of the cache
+	 * \return maximum number of entries
+	 */
+	uint32_t GetCapacity () const;
+
+	/**
+	 * \brief Get the number of entries in the cache
+	 * \return number of entries
+	 */
+	uint32_t GetSize () const;
+
+	/**
+	 * \brief Search for an entry
+	 * \param key the key
+	 * \param value set to the cached value, if found
+	 * \return true if found
+	 */
+	bool Lookup (const Key &key, Value &value);
+
+	/**
+	 * \brief Check if there is an entry, without counting a lookup
+	 * nor marking the entry as recently used
+	 * \param key the key
+	 * \return true if found
+	 */
+	bool Contains (const Key &key) const;
+
+	/**
+	 * \brief Insert (or replace) an entry, evicting another one if full
+	 * \param key the key
+	 * \param value the value
+	 * \return none
+	 */
+	void Insert (const Key &key, const Value &value);
+
+	/**
+	 * \brief Drop every entry (statistics are kept)
+	 * \return none
+	 */
+	void Clear ();
+
+	/**
+	 * \brief Get the number of successful lookups
+	 * \return the number of hits
+	 */
+	uint64_t GetHits () const;
+
+	/**
+	 * \brief Get the number of failed lookups
+	 * \return the number of misses
+	 */
+	uint64_t GetMisses () const;
+
+	/**
+	 * \brief Get the number of entries evicted to make room for new ones
+	 * \return the number of evictions
+	 */
+	uint64_t GetEvictions () const;
+
+private:
+	struct Slot
+	{
+		Key			m_key;
+		Value		m_value;
+		bool		m_used;
+		bool		m_referenced;	// CLOCK bit
+	};
+
+	/**
+	 * \brief Find the slot of a key, or the empty slot where it should go
+	 * \param key the key
+	 * \return index of the slot
+	 */
+	uint32_t Find (const Key &key) const;
+
+	/**
+	 * \brief Evict one entry, according to the CLOCK policy
+	 * \return none
+	 */
+	void Evict ();
+
+	/**
+	 * \brief Remove the entry in a slot, shifting back the following
+	 * ones so that no tombstone is needed
+	 * \param i index of the slot
+	 * \return none
+	 */
+	void Erase (uint32_t i);
+
+	std::vector<Slot>	m_slots;
+	uint32_t					m_mask;
+	uint32_t					m_capacity;
+	uint32_t					m_size;
+	uint32_t					m_hand;
+	uint32_t					m_stride;
+	Hash							m_hash;
+	uint64_t					m_hits;
+	uint64_t					m_misses;
+	uint64_t					m_evictions;
+};
+
+template <typename Key, typename Value, typename Hash>
+ClockCache<Key, Value, Hash>::ClockCache (uint32_t capacity)
+	:	m_mask (0),
+		m_capacity (0),
+		m_size (0),
+		m_hand (0),
+		m_stride (1),
+		m_hits (0),
+		m_misses (0),
+		m_evictions (0)
+{
+	SetCapacity (capacity);
+}
+
+template <typename Key, typename Value, typename Hash>
+void
+ClockCache<Key, Value, Hash>::SetCapacity (uint32_t capacity)
+{
+	capacity = std::min (capacity, GetMaxCapacity ());
+	if (capacity == m_capacity && !m_slots.empty ())
+		return;
+
+	m_capacity = capacity;
+	std::vector<Slot> ().swap (m_slots);
+	m_size = 0;
+	m_hand = 0;
+	m_mask = 0;
+
+	if (capacity == 0)
+		return;
+
+	// keep the load factor below 1/2, so that probe sequences stay short
+	uint32_t n = 2;
+	while (n < 2 * capacity)
+		n <<= 1;
+
+	Slot empty;
+	empty.m_key = Key ();
+	empty.m_value = Value ();
+	empty.m_used = false;
+	empty.m_referenced = false;
+	m_slots.assign (n, empty);
+	m_mask = n - 1;
+
+	// the hand steps by an odd stride, so that it still visits every
+	// slot once per sweep but the slots swept last are spread over the
+	// table: a sweep in slot order leaves the entries inserted since the
+	// last sweep packed ahead of the hand, in clusters that make the
+	// probe sequences and the backward shifts very long
+	m_stride = ((uint32_t) (n * 0.6180339887) | 1) & m_mask;
+}
+
+template <typename Key, typename Value, typename Hash>
+uint32_t
+ClockCache<Key, Value, Hash>::GetMaxCapacity ()
+{
+	return (uint32_t) 1 << 30;
+}
+
+template <typename Key, typename Value, typename Hash>
+uint32_t
+ClockCache<Key, Value, Hash>::GetCapacity () const
+{
+	return m_capacity;
+}
+
+template <typename Key, typename Value, typename Hash>
+uint32_t
+ClockCache<Key, Value, Hash>::GetSize () const
+{
+	return m_size;
+}
+
+template <typename Key, typename Value, typename Hash>
+uint32_t
+ClockCache<Key, Value, Hash>::Find (const Key &key) const
+{
+	uint32_t i = (uint32_t) m_hash (key) & m_mask;
+	while (m_slots[i].m_used && !(m_slots[i].m_key == key))
+		i = (i + 1) & m_mask;
+	return i;
+}
+
+template <typename Key, typename Value, typename Hash>
+bool
+ClockCache<Key, Value, Hash>::Lookup (const Key &key, Value &value)
+{
+	if (m_capacity == 0)
+	{
+		m_misses++;
+		return false;
+	}
+
+	uint32_t i = Find (key);
+	if (!m_slots[i].m_used)
+	{
+		m_misses++;
+		return false;
+	}
+
+	m_hits++;
+	m_slots[i].m_referenced = true;
+	value = m_slots[i].m_value;
+	return true;
+}
+
+template <typename Key, typename Value, typename Hash>
+bool
+ClockCache<Key, Value, Hash>::Contains (const Key &key) const
+{
+	return (m_capacity > 0) && m_slots[Find (key)].m_used;
+}
+
+template <typename Key, typename Value, typename Hash>
+void
+ClockCache<Key, Value, Hash>::Insert (const Key &key, const Value &value)
+{
+	if (m_capacity == 0)
+		return;
+
+	uint32_t i = Find (key);
+	if (!m_slots[i].m_used)
+	{
+		if (m_size >= m_capacity)
+		{
+			Evict ();
+			// the table changed, look for the place again
+			i = Find (key);
+		}
+		m_slots[i].m_used = true;
+		m_slots[i].m_key = key;
+		m_size++;
+	}
+
+	m_slots[i].m_value = value;
+	m_slots[i].m_referenced = false;
+}
+
+template <typename Key, typename Value, typename Hash>
+void
+ClockCache<Key, Value, Hash>::Evict ()
+{
+	// sweep the hand over the table (see SetCapacity): referenced entries
+	// get a second chance, the first one that was not used since the
+	// last sweep goes
+	while (true)
+	{
+		Slot &slot = m_slots[m_hand];
+		if (slot.m_used)
+		{
+			if (slot.m_referenced)
+			{
+				slot.m_referenced = false;
+			}
+			else
+			{
+				Erase (m_hand);
+				m_evictions++;
+				return;
+			}
+		}
+		m_hand = (m_hand + m_stride) & m_mask;
+	}
+}
+
+template <typename Key, typename Value, typename Hash>
+void
+ClockCache<Key, Value, Hash>::Erase (uint32_t i)
+{
+	m_slots[i].m_used = false;
+	m_size--;
+
+	// backward shift: move back every entry of the cluster that
+	// would not be reachable anymore from its home slot
+	uint32_t j = i;
+	while (true)
+	{
+		j = (j + 1) & m_mask;
+		if (!m_slots[j].m_used)
+			return;
+
+		uint32_t home = (uint32_t) m_hash (m_slots[j].m_key) & m_mask;
+		if (((j - home) & m_mask) >= ((j - i) & m_mask))
+		{
+			m_slots[i] = m_slots[j];
+			m_slots[j].m_used = false;
+			i = j;
+		}
+	}
+}
+
+template <typename Key, typename Value, typename Hash>
+void
+ClockCache<Key, Value, Hash>::Clear ()
+{
+	for (uint32_t i = 0; i < m_slots.size (); i++)
+	{
+		m_slots[i].m_used = false;
+		m_slots[i].m_referenced = false;
+	}
+	m_size = 0;
+	m_hand = 0;
+}
+
+template <typename Key, typename Value, typename Hash>
+uint64_t
+ClockCache<Key, Value, Hash>::GetHits () const
+{
+	return m_hits;
+}
+
+template <typename Key, typename Value, typename Hash>
+uint64_t
+ClockCache<Key, Value, Hash>::GetMisses () const
+{
+	return m_misses;
+}
+
+template <typename Key, typename Value, typename Hash>
+uint64_t
+ClockCache<Key, Value, Hash>::GetEvictions () const
+{
+	return m_evictions;
+}
+
+/**
+ * \ingroup obstacle
+ * \brief Key of the obstructed loss between two points: coordinates
+ * quantized to 0.1 m, the two points in canonical order (so that the
+ * loss from A to B and from B to A share the entry)
+ */
+struct ObstructedLossKey
+{
+	/**
+	 * \brief Constructor, an all-zero key
+	 */
+	ObstructedLossKey ();
+
+	/**
+	 * \brief Constructor
+	 * \param p1x x of the first point
+	 * \param p1y y of the first point
+	 * \param p1z z of the first point
+	 * \param p2x x of the second point
+	 * \param p2y y of the second point
+	 * \param p2z z of the second point
+	 */
+	ObstructedLossKey (double p1x, double p1y, double p1z,
+										 double p2x, double p2y, double p2z);
+
+	bool operator== (const ObstructedLossKey &other) const;
+
+	int64_t	m_c[6];
+};
+
+/**
+ * \ingroup obstacle
+ * \brief Hash function for ObstructedLossKey
+ */
+struct ObstructedLossKeyHash
+{
+	uint64_t operator() (const ObstructedLossKey &key) const;
+};
+
+typedef ClockCache<ObstructedLossKey, double, ObstructedLossKeyHash> ObstructedLossCache;
+
+/**
+ * \ingroup obstacle
+ * \brief Key of the obstructed loss between two nodes: their ids, the
+ * smaller first (so that the loss from A to B and from B to A share
+ * the entry)
+ */
+struct NodePairKey
+{
+	/**
+	 * \brief Constructor, an all-zero key
+	 */
+	NodePairKey ();
+
+	/**
+	 * \brief Constructor
+	 * \param a id of the first node
+	 * \param b id of the second node
+	 */
+	NodePairKey (uint32_t a, uint32_t b);
+
+	bool operator== (const NodePairKey &other) const;
+
+	uint32_t	m_a;
+	uint32_t	m_b;
+};
+
+/**
+ * \ingroup obstacle
+ * \brief Hash function for NodePairKey
+ */
+struct NodePairKeyHash
+{
+	uint64_t operator() (const NodePairKey &key) const;
+};
+
+/**
+ * \ingroup obstacle
+ * \brief The obstructed loss between two nodes, with the positions of
+ * the nodes it was computed at (in the order of the key)
+ */
+struct NodePairLoss
+{
+	/**
+	 * \brief Check if both nodes are still close to where they were
+	 * \param pa current position of the node m_a of the key
+	 * \param pb current position of the node m_b of the key
+	 * \param thresholdSq square of the maximum displacement of each node
+	 * \return true if neither node has moved more than the threshold
+	 */
+	bool IsValid (const Vector &pa, const Vector &pb, double thresholdSq) const;
+
+	double	m_loss;
+	Vector	m_pa;
+	Vector	m_pb;
+};
+
+typedef ClockCache<NodePairKey, NodePairLoss, NodePairKeyHash> NodePairLossCache;
+
+/**
+ * \ingroup obstacle
+ * \brief FNV-1a hash of a buffer, used to identify the content of
+ * precomputed data. Calls can be chained passing the previous hash
+ * \param data the buffer
+ * \param size size of the buffer in bytes
+ * \param hash hash of the previous buffers
+ * \return the hash
+ */
+inline uint64_t
+HashBytes (const void *data, uint64_t size, uint64_t hash = 14695981039346656037ULL)
+{
+	const uint8_t *bytes = (const uint8_t *) data;
+	for (uint64_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+} // namespace ns3
+
+#endif /* OBSTRUCTED_LOSS_CACHE_H */
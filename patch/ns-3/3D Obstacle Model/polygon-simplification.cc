@@ -0,0 +1,251 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "polygon-simplification.h"
+
+namespace ns3 {
+
+namespace {
+
+// distance of p from the segment from a to b
+double
+DistanceFromSegment (const Vector2D &p, const Vector2D &a, const Vector2D &b)
+{
+	double ex = b.x - a.x;
+	double ey = b.y - a.y;
+	double len2 = ex * ex + ey * ey;
+	double t = (len2 > 0) ? ((p.x - a.x) * ex + (p.y - a.y) * ey) / len2 : 0.0;
+	t = std::min (1.0, std::max (0.0, t));
+	double dx = a.x + t * ex - p.x;
+	double dy = a.y + t * ey - p.y;
+	return std::sqrt (dx * dx + dy * dy);
+}
+
+// Douglas-Peucker on the open chain ring[first] .. ring[last] (indices
+// modulo the size of the ring), marks the vertices to keep
+void
+SimplifyChain (const std::vector<Vector2D> &ring, uint32_t first, uint32_t last, double tolerance, std::vector<bool> &keep)
+{
+	uint32_t n = ring.size ();
+	std::vector<std::pair<uint32_t, uint32_t> > stack (1, std::make_pair (first, last));
+
+	while (!stack.empty ())
+	{
+		uint32_t a = stack.back ().first;
+		uint32_t b = stack.back ().second;
+		stack.pop_back ();
+
+		// farthest vertex from the segment a-b
+		double maxDistance = -1;
+		uint32_t farthest = a;
+		for (uint32_t i = (a + 1) % n; i != b; i = (i + 1) % n)
+		{
+			double d = DistanceFromSegment (ring[i], ring[a], ring[b]);
+			if (d > maxDistance)
+			{
+				maxDistance = d;
+				farthest = i;
+			}
+		}
+
+		if (maxDistance > tolerance)
+		{
+			keep[farthest] = true;
+			stack.push_back (std::make_pair (a, farthest));
+			stack.push_back (std::make_pair (farthest, b));
+		}
+	}
+}
+
+// sign of the orientation of a, b, c
+int
+Orientation (const Vector2D &a, const Vector2D &b, const Vector2D &c)
+{
+	double d = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	return (d > 0) - (d < 0);
+}
+
+// c lies within the bounding box of a-b (a, b and c collinear)
+bool
+OnSegment (const Vector2D &a, const Vector2D &b, const Vector2D &c)
+{
+	return c.x >= std::min (a.x, b.x) && c.x <= std::max (a.x, b.x)
+		&& c.y >= std::min (a.y, b.y) && c.y <= std::max (a.y, b.y);
+}
+
+// segments a-b and c-d intersect (touching included)
+bool
+SegmentsIntersect (const Vector2D &a, const Vector2D &b, const Vector2D &c, const Vector2D &d)
+{
+	int o1 = Orientation (a, b, c);
+	int o2 = Orientation (a, b, d);
+	int o3 = Orientation (c, d, a);
+	int o4 = Orientation (c, d, b);
+
+	if (o1 != o2 && o3 != o4)
+		return true;
+
+	return (o1 == 0 && OnSegment (a, b, c)) || (o2 == 0 && OnSegment (a, b, d))
+		|| (o3 == 0 && OnSegment (c, d, a)) || (o4 == 0 && OnSegment (c, d, b));
+}
+
+} // namespace
+
+bool
+IsSimpleFootprint (const VertexList &vertices)
+{
+	uint32_t n = vertices.size ();
+	if (n < 3)
+		return false;
+
+	for (uint32_t i = 0; i < n; i++)
+	{
+		const Vector2D &a = vertices[i];
+		const Vector2D &b = vertices[(i + 1) % n];
+		// edges sharing a vertex with edge i are skipped
+		for (uint32_t j = i + 2; j < n; j++)
+		{
+			if (i == 0 && j == n - 1)
+				continue;
+			if (SegmentsIntersect (a, b, vertices[j], vertices[(j + 1) % n]))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+SimplifyFootprint (const VertexList &vertices, double tolerance, std::vector<Vector2D> &out)
+{
+	// repeated vertices (e.g. a closing vertex equal to the first one)
+	std::vector<Vector2D> ring;
+	ring.reserve (vertices.size ());
+	for (uint32_t i = 0; i < vertices.size (); i++)
+	{
+		const Vector2D &v = vertices[i];
+		if (ring.empty () || v.x != ring.back ().x || v.y != ring.back ().y)
+			ring.push_back (v);
+	}
+	while (ring.size () > 1 && ring.front ().x == ring.back ().x && ring.front ().y == ring.back ().y)
+		ring.pop_back ();
+
+	uint32_t n = ring.size ();
+	if (n > 3)
+	{
+		// the vertex with the least x is on the convex hull, and so is the
+		// farthest vertex from it: both are kept, the two chains between
+		// them are simplified
+		uint32_t a = 0;
+		for (uint32_t i = 1; i < n; i++)
+		{
+			if (ring[i].x < ring[a].x || (ring[i].x == ring[a].x && ring[i].y < ring[a].y))
+				a = i;
+		}
+		uint32_t b = a;
+		double maxDistance = -1;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			double dx = ring[i].x - ring[a].x;
+			double dy = ring[i].y - ring[a].y;
+			if (dx * dx + dy * dy > maxDistance)
+			{
+				maxDistance = dx * dx + dy * dy;
+				b = i;
+			}
+		}
+
+		std::vector<bool> keep (n, false);
+		keep[a] = true;
+		keep[b] = true;
+		SimplifyChain (ring, a, b, tolerance, keep);
+		SimplifyChain (ring, b, a, tolerance, keep);
+
+		std::vector<Vector2D> simplified;
+		for (uint32_t i = 0; i < n; i++)
+		{
+			if (keep[i])
+				simplified.push_back (ring[i]);
+		}
+		ring.swap (simplified);
+	}
+
+	// collinear vertices (exactly, the others are left to Douglas-Peucker)
+	bool removed = true;
+	while (removed && ring.size () > 3)
+	{
+		removed = false;
+		for (uint32_t i = 0; i < ring.size () && ring.size () > 3; i++)
+		{
+			uint32_t m = ring.size ();
+			if (Orientation (ring[(i + m - 1) % m], ring[i], ring[(i + 1) % m]) == 0)
+			{
+				ring.erase (ring.begin () + i);
+				removed = true;
+			}
+		}
+	}
+
+	if (!IsSimpleFootprint (ring))
+	{
+		out.assign (vertices.begin (), vertices.end ());
+		return false;
+	}
+
+	out.swap (ring);
+	return true;
+}
+
+SimplificationReport::SimplificationReport ()
+	:	tolerance (0),
+		nObstacles (0),
+		nKept (0),
+		edgesBefore (0),
+		edgesAfter (0),
+		maxEdgesBefore (0),
+		maxEdgesAfter (0),
+		nSamples (0),
+		nObstructed (0),
+		nChanged (0),
+		meanError (0),
+		p50Error (0),
+		p95Error (0),
+		p99Error (0),
+		maxError (0)
+{
+}
+
+void
+SimplificationReport::Print (std::ostream &os) const
+{
+	os << "Obstacle simplification (tolerance " << tolerance << " m): "
+		 << nObstacles << " obstacles (" << nKept << " kept as they were), edges "
+		 << edgesBefore << " -> " << edgesAfter << " ("
+		 << ((edgesBefore > 0) ? 100.0 * (1.0 - (double) edgesAfter / edgesBefore) : 0.0) << "% less), "
+		 << "largest " << maxEdgesBefore << " -> " << maxEdgesAfter << std::endl;
+	os << "Loss error on " << nObstructed << " obstructed of " << nSamples << " random segments ("
+		 << nChanged << " changed): mean " << meanError << " dB, median " << p50Error
+		 << " dB, 95% " << p95Error << " dB, 99% " << p99Error << " dB, max " << maxError << " dB" << std::endl;
+}
+
+} // namespace ns3
@@ -0,0 +1,96 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#ifndef POLYGON_SIMPLIFICATION_H
+#define POLYGON_SIMPLIFICATION_H
+
+#include <vector>
+#include <ostream>
+#include <stdint.h>
+#include "ns3/vector.h"
+#include "wall-intersection-kernel.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief Simplify the footprint of an obstacle: repeated vertices are
+ * removed, then the ring is simplified with Douglas-Peucker (no removed
+ * vertex is farther than the tolerance from the simplified border), then
+ * collinear vertices are removed. If the result is not a simple polygon
+ * with at least three vertices, the footprint is kept as it is
+ * \param vertices the vertices of the footprint
+ * \param tolerance the tolerance in meters
+ * \param out the vertices of the simplified footprint, a subset of
+ * vertices in the same order
+ * \return false if the footprint has been kept as it is because the
+ * simplified one is not valid, true otherwise
+ */
+bool SimplifyFootprint (const VertexList &vertices, double tolerance, std::vector<Vector2D> &out);
+
+/**
+ * \ingroup obstacle
+ * \brief Test if a footprint is a simple polygon: no two edges
+ * intersect, except consecutive edges at their common vertex
+ * \param vertices the vertices of the footprint
+ * \return true if the footprint is simple
+ */
+bool IsSimpleFootprint (const VertexList &vertices);
+
+/**
+ * \ingroup obstacle
+ * \brief Outcome of the simplification of the obstacles of a topology,
+ * see Topology::SimplifyObstacles
+ */
+struct SimplificationReport
+{
+	SimplificationReport ();
+
+	/**
+	 * \brief Print the report
+	 * \param os the output stream
+	 * \return none
+	 */
+	void Print (std::ostream &os) const;
+
+	double		tolerance;			// tolerance in meters
+	uint32_t	nObstacles;			// obstacles simplified
+	uint32_t	nKept;					// obstacles kept as they were (not valid once simplified)
+	uint64_t	edgesBefore;		// edges before the simplification
+	uint64_t	edgesAfter;			// edges after the simplification
+	uint32_t	maxEdgesBefore;	// edges of the largest obstacle, before
+	uint32_t	maxEdgesAfter;	// edges of the largest obstacle, after
+
+	// absolute difference of the obstructed loss (dB) with and without
+	// the simplification, on random segments obstructed in either case
+	uint32_t	nSamples;				// segments evaluated
+	uint32_t	nObstructed;		// segments obstructed in either case
+	uint32_t	nChanged;				// segments whose loss changed
+	double		meanError;
+	double		p50Error;
+	double		p95Error;
+	double		p99Error;
+	double		maxError;
+};
+
+} // namespace ns3
+
+#endif /* POLYGON_SIMPLIFICATION_H */
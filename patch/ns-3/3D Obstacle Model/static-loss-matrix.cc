@@ -0,0 +1,483 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "static-loss-matrix.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("StaticLossMatrix");
+
+namespace {
+
+// a pair with some obstructed loss, i < j
+struct PairLoss
+{
+	uint32_t	i;
+	uint32_t	j;
+	double		loss;
+
+	bool operator< (const PairLoss &other) const
+	{
+		return (i < other.i) || (i == other.i && j < other.j);
+	}
+};
+
+// compare node ids by x coordinate
+struct ByX
+{
+	const std::vector<Vector> *positions;
+
+	bool operator() (uint32_t a, uint32_t b) const
+	{
+		return (*positions)[a].x < (*positions)[b].x;
+	}
+};
+
+// header of the binary file, followed by the sections (each one
+// padded to 8 bytes): positions, valid flags, row starts, columns, losses
+struct FileHeader
+{
+	char			magic[8];
+	uint32_t	version;
+	uint32_t	nNodes;
+	uint64_t	nEntries;
+	uint64_t	key;
+};
+
+const char g_magic[8] = { 'O', 'B', 'S', 'T', 'L', 'O', 'S', 'S' };
+const uint32_t g_version = 1;
+
+uint64_t
+Pad (uint64_t size)
+{
+	return (size + 7) & ~((uint64_t) 7);
+}
+
+// offsets of the sections in the file, and its size
+struct FileLayout
+{
+	FileLayout (uint32_t nNodes, uint64_t nEntries)
+	{
+		positions = sizeof (FileHeader);
+		valid = positions + Pad (3 * sizeof (double) * nNodes);
+		rowStart = valid + Pad (nNodes);
+		col = rowStart + Pad (sizeof (uint64_t) * ((uint64_t) nNodes + 1));
+		loss = col + Pad (sizeof (uint32_t) * nEntries);
+		size = loss + Pad (sizeof (double) * nEntries);
+	}
+
+	uint64_t	positions;
+	uint64_t	valid;
+	uint64_t	rowStart;
+	uint64_t	col;
+	uint64_t	loss;
+	uint64_t	size;
+};
+
+// write a section padded to 8 bytes
+void
+WriteSection (std::ofstream &file, const void *data, uint64_t size)
+{
+	static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	if (size > 0)
+		file.write ((const char *) data, size);
+	file.write (zeros, Pad (size) - size);
+}
+
+} // namespace
+
+StaticLossMatrix::StaticLossMatrix ()
+	:	m_built (false),
+		m_nNodes (0),
+		m_nEntries (0),
+		m_positions (0),
+		m_valid (0),
+		m_rowStart (0),
+		m_col (0),
+		m_loss (0),
+		m_map (0),
+		m_mapSize (0)
+{
+	NS_LOG_FUNCTION (this);
+}
+
+StaticLossMatrix::~StaticLossMatrix ()
+{
+	NS_LOG_FUNCTION (this);
+
+	Clear ();
+}
+
+void
+StaticLossMatrix::Build (const Topology &topology, const std::vector<Vector> &positions,
+												 const std::vector<bool> &valid, double r, Topology::Engine engine, uint32_t nThreads)
+{
+	NS_LOG_FUNCTION (this << r << nThreads);
+	NS_ASSERT (positions.size () == valid.size ());
+
+	Clear ();
+
+	// nodes sorted by x: the pairs closer than 2r are found with a sweep
+	std::vector<uint32_t> sorted;
+	for (uint32_t id = 0; id < positions.size (); id++)
+	{
+		if (valid[id])
+			sorted.push_back (id);
+	}
+	ByX byX;
+	byX.positions = &positions;
+	std::sort (sorted.begin (), sorted.end (), byX);
+
+	if (nThreads == 0)
+		nThreads = std::max (1u, std::thread::hardware_concurrency ());
+
+	// each thread takes the next chunk of nodes and pairs them with
+	// the following ones in x order
+	const uint32_t chunk = 16;
+	const double x4rSq = 4.0 * r * r;
+	const double x2r = 2.0 * r;
+	std::atomic<uint32_t> next (0);
+	std::vector<std::vector<PairLoss> > found (nThreads);
+	std::vector<std::thread> threads;
+
+	for (uint32_t t = 0; t < nThreads; t++)
+	{
+		threads.push_back (std::thread ([&, t] ()
+		{
+			TopologyQueryContext context (0);	// every pair is evaluated once, no cache
+			while (true)
+			{
+				uint32_t begin = next.fetch_add (chunk);
+				if (begin >= sorted.size ())
+					break;
+				uint32_t end = std::min (begin + chunk, (uint32_t) sorted.size ());
+				for (uint32_t k = begin; k < end; k++)
+				{
+					const Vector &p1 = positions[sorted[k]];
+					for (uint32_t m = k + 1; m < sorted.size (); m++)
+					{
+						const Vector &p2 = positions[sorted[m]];
+						double dx = p2.x - p1.x;
+						if (dx >= x2r)
+							break;
+						double dy = p2.y - p1.y;
+						if (dx * dx + dy * dy >= x4rSq)
+							continue;
+
+						// the loss from i to j serves both directions,
+						// as in the obstructed loss cache
+						uint32_t i = std::min (sorted[k], sorted[m]);
+						uint32_t j = std::max (sorted[k], sorted[m]);
+						double loss = topology.GetObstructedLossBetween (positions[i], positions[j], r, engine, context);
+						if (loss != 0.0)
+						{
+							PairLoss pair;
+							pair.i = i;
+							pair.j = j;
+							pair.loss = loss;
+							found[t].push_back (pair);
+						}
+					}
+				}
+			}
+		}));
+	}
+	for (uint32_t t = 0; t < nThreads; t++)
+		threads[t].join ();
+
+	// merge the results in CSR layout
+	std::vector<PairLoss> pairs;
+	for (uint32_t t = 0; t < nThreads; t++)
+		pairs.insert (pairs.end (), found[t].begin (), found[t].end ());
+	std::sort (pairs.begin (), pairs.end ());
+
+	m_positionsStorage.resize (3 * positions.size ());
+	m_validStorage.resize (positions.size ());
+	for (uint32_t id = 0; id < positions.size (); id++)
+	{
+		m_positionsStorage[3 * id] = positions[id].x;
+		m_positionsStorage[3 * id + 1] = positions[id].y;
+		m_positionsStorage[3 * id + 2] = positions[id].z;
+		m_validStorage[id] = valid[id] ? 1 : 0;
+	}
+
+	m_rowStartStorage.assign (positions.size () + 1, 0);
+	m_colStorage.resize (pairs.size ());
+	m_lossStorage.resize (pairs.size ());
+	for (uint64_t e = 0; e < pairs.size (); e++)
+	{
+		m_rowStartStorage[pairs[e].i + 1]++;
+		m_colStorage[e] = pairs[e].j;
+		m_lossStorage[e] = pairs[e].loss;
+	}
+	for (uint32_t i = 0; i < positions.size (); i++)
+		m_rowStartStorage[i + 1] += m_rowStartStorage[i];
+
+	m_nNodes = positions.size ();
+	m_nEntries = pairs.size ();
+	UseStorage ();
+	m_built = true;
+
+	NS_LOG_INFO ("Static loss matrix: " << sorted.size () << " nodes, " << pairs.size ()
+							 << " obstructed pairs, " << nThreads << " threads.");
+}
+
+void
+StaticLossMatrix::UseStorage ()
+{
+	m_positions = m_positionsStorage.data ();
+	m_valid = m_validStorage.data ();
+	m_rowStart = m_rowStartStorage.data ();
+	m_col = m_colStorage.data ();
+	m_loss = m_lossStorage.data ();
+}
+
+bool
+StaticLossMatrix::Save (std::string filename, uint64_t key) const
+{
+	NS_LOG_FUNCTION (this << filename << key);
+	NS_ASSERT (m_built);
+
+	// unique temporary name, then rename: processes saving the same
+	// matrix at the same time do not corrupt the file
+	std::ostringstream tmp;
+	tmp << filename << ".tmp." << getpid ();
+
+	std::ofstream file (tmp.str ().c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open ())
+	{
+		NS_LOG_WARN ("Could not open " << tmp.str () << " for writing, the static loss matrix is not saved.");
+		return false;
+	}
+
+	FileHeader header;
+	std::memset (&header, 0, sizeof (header));
+	std::memcpy (header.magic, g_magic, sizeof (g_magic));
+	header.version = g_version;
+	header.nNodes = m_nNodes;
+	header.nEntries = m_nEntries;
+	header.key = key;
+
+	file.write ((const char *) &header, sizeof (header));
+	WriteSection (file, m_positions, 3 * sizeof (double) * m_nNodes);
+	WriteSection (file, m_valid, m_nNodes);
+	WriteSection (file, m_rowStart, sizeof (uint64_t) * ((uint64_t) m_nNodes + 1));
+	WriteSection (file, m_col, sizeof (uint32_t) * m_nEntries);
+	WriteSection (file, m_loss, sizeof (double) * m_nEntries);
+	file.close ();
+
+	if (file.fail () || std::rename (tmp.str ().c_str (), filename.c_str ()) != 0)
+	{
+		NS_LOG_WARN ("Could not write " << filename << ", the static loss matrix is not saved.");
+		std::remove (tmp.str ().c_str ());
+		return false;
+	}
+
+	NS_LOG_INFO ("Static loss matrix saved to " << filename << ".");
+	return true;
+}
+
+bool
+StaticLossMatrix::Load (std::string filename, uint64_t key)
+{
+	NS_LOG_FUNCTION (this << filename << key);
+
+	Clear ();
+
+	int fd = open (filename.c_str (), O_RDONLY);
+	if (fd < 0)
+	{
+		NS_LOG_INFO ("No static loss matrix in " << filename << ".");
+		return false;
+	}
+
+	struct stat st;
+	if (fstat (fd, &st) != 0 || (uint64_t) st.st_size < sizeof (FileHeader))
+	{
+		NS_LOG_WARN ("Static loss matrix " << filename << " is not valid, ignored.");
+		close (fd);
+		return false;
+	}
+
+	void *map = mmap (0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (map == MAP_FAILED)
+	{
+		NS_LOG_WARN ("Could not map " << filename << ", ignored.");
+		return false;
+	}
+
+	// the number of entries must fit in the file before the layout is
+	// computed from it (its size could overflow)
+	const FileHeader *header = (const FileHeader *) map;
+	uint64_t fileSize = st.st_size;
+	if (std::memcmp (header->magic, g_magic, sizeof (g_magic)) != 0
+			|| header->version != g_version
+			|| header->nEntries > fileSize / (sizeof (uint32_t) + sizeof (double))
+			|| FileLayout (header->nNodes, header->nEntries).size != fileSize)
+	{
+		NS_LOG_WARN ("Static loss matrix " << filename << " is not valid, ignored.");
+		munmap (map, st.st_size);
+		return false;
+	}
+	if (header->key != key)
+	{
+		NS_LOG_INFO ("Static loss matrix " << filename << " was computed for other inputs, ignored.");
+		munmap (map, st.st_size);
+		return false;
+	}
+
+	// the rows follow each other and end with the entries, the columns
+	// are nodes of the matrix
+	const char *base = (const char *) map;
+	FileLayout layout (header->nNodes, header->nEntries);
+	const uint64_t *rowStart = (const uint64_t *) (base + layout.rowStart);
+	const uint32_t *col = (const uint32_t *) (base + layout.col);
+	bool valid = (rowStart[0] == 0) && (rowStart[header->nNodes] == header->nEntries);
+	for (uint32_t i = 0; valid && (i < header->nNodes); i++)
+	{
+		valid = (rowStart[i] <= rowStart[i + 1]);
+	}
+	for (uint64_t e = 0; valid && (e < header->nEntries); e++)
+	{
+		valid = (col[e] < header->nNodes);
+	}
+	if (!valid)
+	{
+		NS_LOG_WARN ("Static loss matrix " << filename << " is not valid, ignored.");
+		munmap (map, st.st_size);
+		return false;
+	}
+
+	m_map = map;
+	m_mapSize = st.st_size;
+	m_nNodes = header->nNodes;
+	m_nEntries = header->nEntries;
+	m_positions = (const double *) (base + layout.positions);
+	m_valid = (const uint8_t *) (base + layout.valid);
+	m_rowStart = rowStart;
+	m_col = col;
+	m_loss = (const double *) (base + layout.loss);
+	m_built = true;
+
+	NS_LOG_INFO ("Static loss matrix loaded from " << filename << ": "
+							 << m_nNodes << " nodes, " << m_nEntries << " obstructed pairs.");
+	return true;
+}
+
+uint64_t
+StaticLossMatrix::GetKey (uint64_t sourceHash, const std::vector<Vector> &positions,
+													const std::vector<bool> &valid, double r, Topology::Engine engine)
+{
+	uint64_t hash = HashBytes (&sourceHash, sizeof (sourceHash));
+	uint64_t n = positions.size ();
+	hash = HashBytes (&n, sizeof (n), hash);
+	for (uint32_t id = 0; id < positions.size (); id++)
+	{
+		double p[3] = { positions[id].x, positions[id].y, positions[id].z };
+		uint8_t v = valid[id] ? 1 : 0;
+		hash = HashBytes (p, sizeof (p), hash);
+		hash = HashBytes (&v, sizeof (v), hash);
+	}
+	uint32_t e = engine;
+	hash = HashBytes (&r, sizeof (r), hash);
+	hash = HashBytes (&e, sizeof (e), hash);
+	hash = HashBytes (&g_version, sizeof (g_version), hash);
+	return hash;
+}
+
+bool
+StaticLossMatrix::IsBuilt () const
+{
+	return m_built;
+}
+
+bool
+StaticLossMatrix::Lookup (uint32_t a, const Vector &pa, uint32_t b, const Vector &pb, double &loss) const
+{
+	if (!m_built || a >= m_nNodes || b >= m_nNodes || !m_valid[a] || !m_valid[b])
+		return false;
+
+	// a node that has moved, the loss must be computed again
+	const double *qa = m_positions + 3 * a;
+	const double *qb = m_positions + 3 * b;
+	if (qa[0] != pa.x || qa[1] != pa.y || qa[2] != pa.z
+			|| qb[0] != pb.x || qb[1] != pb.y || qb[2] != pb.z)
+		return false;
+
+	uint32_t i = std::min (a, b);
+	uint32_t j = std::max (a, b);
+	const uint32_t *first = m_col + m_rowStart[i];
+	const uint32_t *last = m_col + m_rowStart[i + 1];
+	const uint32_t *it = std::lower_bound (first, last, j);
+
+	// pairs not stored have no loss
+	loss = ((it != last) && (*it == j)) ? m_loss[it - m_col] : 0.0;
+	return true;
+}
+
+uint32_t
+StaticLossMatrix::GetNNodes () const
+{
+	return m_nNodes;
+}
+
+uint64_t
+StaticLossMatrix::GetNEntries () const
+{
+	return m_nEntries;
+}
+
+void
+StaticLossMatrix::Clear ()
+{
+	NS_LOG_FUNCTION (this);
+
+	if (m_map != 0)
+	{
+		munmap (m_map, m_mapSize);
+		m_map = 0;
+		m_mapSize = 0;
+	}
+
+	m_built = false;
+	m_nNodes = 0;
+	m_nEntries = 0;
+	m_positionsStorage.clear ();
+	m_validStorage.clear ();
+	m_rowStartStorage.clear ();
+	m_colStorage.clear ();
+	m_lossStorage.clear ();
+	UseStorage ();
+}
+
+} // namespace ns3
@@ -0,0 +1,178 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#ifndef STATIC_LOSS_MATRIX_H
+#define STATIC_LOSS_MATRIX_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "ns3/vector.h"
+#include "topology.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief The obstructed loss between every pair of nodes, for
+ * scenarios where nodes do not move.
+ *
+ * The matrix is symmetric and sparse: row i holds the nodes j > i
+ * whose loss from i is not zero (CSR layout, columns sorted), every
+ * other pair has no obstructed loss. The positions used to compute it
+ * are kept, so that a lookup for a node that has moved fails.
+ *
+ * The matrix can be saved to a binary file and mapped back in memory
+ * (mmap) by later runs, or other processes, with the same inputs.
+ */
+class StaticLossMatrix
+{
+public:
+	/**
+	 * \brief Constructor, an empty matrix
+	 */
+	StaticLossMatrix ();
+
+	/**
+	 * \brief Destructor, unmaps the file if the matrix was loaded
+	 */
+	~StaticLossMatrix ();
+
+	/**
+	 * \brief Compute the obstructed loss of every pair of nodes closer
+	 * than 2r (farther pairs have no obstructed loss), in parallel
+	 * \param topology the obstacles
+	 * \param positions position of each node, indexed by node id
+	 * \param valid false for the nodes without a position
+	 * \param r limiting radius for obstacles, see Topology::GetObstructedLossBetween
+	 * \param engine the geometry engine
+	 * \param nThreads number of threads (0 for one per core)
+	 * \return none
+	 */
+	void Build (const Topology &topology, const std::vector<Vector> &positions,
+							const std::vector<bool> &valid, double r, Topology::Engine engine, uint32_t nThreads);
+
+	/**
+	 * \brief Save the matrix to a binary file. The file is written
+	 * under a temporary name and then renamed, so that a concurrent
+	 * Load never sees it partially written
+	 * \param filename the name of the file
+	 * \param key identifies the inputs of the matrix, see Load
+	 * \return true on success
+	 */
+	bool Save (std::string filename, uint64_t key) const;
+
+	/**
+	 * \brief Map a matrix saved by Save in memory
+	 * \param filename the name of the file
+	 * \param key the key the file must have been saved with
+	 * \return false if the file is missing, not valid, or has another key
+	 */
+	bool Load (std::string filename, uint64_t key);
+
+	/**
+	 * \brief Compute the key of a matrix from its inputs
+	 * \param sourceHash the hash of the inputs of the obstacles, see
+	 * Topology::GetSourceHash, and of any other parameter of the engine
+	 * \param positions position of each node, indexed by node id
+	 * \param valid false for the nodes without a position
+	 * \param r limiting radius for obstacles
+	 * \param engine the geometry engine
+	 * \return the key
+	 */
+	static uint64_t GetKey (uint64_t sourceHash, const std::vector<Vector> &positions,
+													const std::vector<bool> &valid, double r, Topology::Engine engine);
+
+	/**
+	 * \brief Check if the matrix has been built (or loaded)
+	 * \return true if Build or Load have been called successfully
+	 */
+	bool IsBuilt () const;
+
+	/**
+	 * \brief Search for the loss between two nodes
+	 * \param a id of the first node
+	 * \param pa current position of the first node
+	 * \param b id of the second node
+	 * \param pb current position of the second node
+	 * \param loss set to the obstructed loss, if found
+	 * \return false if a node is unknown, or is not where it was when
+	 * the matrix was built, true otherwise
+	 */
+	bool Lookup (uint32_t a, const Vector &pa, uint32_t b, const Vector &pb, double &loss) const;
+
+	/**
+	 * \brief Get the number of nodes of the matrix
+	 * \return the number of nodes
+	 */
+	uint32_t GetNNodes () const;
+
+	/**
+	 * \brief Get the number of pairs stored (those with some loss)
+	 * \return the number of pairs
+	 */
+	uint64_t GetNEntries () const;
+
+	/**
+	 * \brief Drop the matrix
+	 * \return none
+	 */
+	void Clear ();
+
+private:
+	// not copyable, it may own a mapping
+	StaticLossMatrix (const StaticLossMatrix &);
+	StaticLossMatrix &operator= (const StaticLossMatrix &);
+
+	/**
+	 * \brief Point the data to the storage vectors
+	 * \return none
+	 */
+	void UseStorage ();
+
+	bool										m_built;
+	uint32_t								m_nNodes;
+	uint64_t								m_nEntries;
+
+	// data of the matrix, in the storage vectors or in the mapped file
+	// (positions are x, y, z triplets). Columns of row i are
+	// m_col[m_rowStart[i]] .. m_col[m_rowStart[i + 1] - 1]
+	const double						*m_positions;
+	const uint8_t						*m_valid;
+	const uint64_t					*m_rowStart;
+	const uint32_t					*m_col;
+	const double						*m_loss;
+
+	// storage of a matrix built in memory
+	std::vector<double>			m_positionsStorage;
+	std::vector<uint8_t>		m_validStorage;
+	std::vector<uint64_t>		m_rowStartStorage;
+	std::vector<uint32_t>		m_colStorage;
+	std::vector<double>			m_lossStorage;
+
+	// mapping of a loaded matrix
+	void										*m_map;
+	uint64_t								m_mapSize;
+};
+
+} // namespace ns3
+
+#endif /* STATIC_LOSS_MATRIX_H */
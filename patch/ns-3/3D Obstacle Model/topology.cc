@@ -19,10 +19,25 @@
  *
  */
 
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <limits>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 // CGAL includes
 #include <CGAL/intersections.h>
 
 #include "topology.h"
+#include "obstacle-tile-store.h"
 
 using namespace ns3;
 
@@ -31,6 +46,101 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("topology");
 
+namespace {
+
+// header of a compiled buildings file, followed by the sections (each
+// one padded to 8 bytes): first vertex of each obstacle (n + 1), vertices
+// (x, y pairs), heights, betas, gammas, bounding boxes (xmin, ymin, xmax,
+// ymax), first character of each id (n + 1), ids, grid index
+struct CompiledHeader
+{
+	char			magic[8];
+	uint32_t	version;
+	uint32_t	nObstacles;
+	uint64_t	nVertices;
+	uint64_t	idBytes;
+	uint64_t	gridBytes;
+	double		minX;
+	double		minY;
+	double		maxX;
+	double		maxY;
+};
+
+const char g_compiledMagic[8] = { 'O', 'B', 'S', 'T', 'B', 'L', 'D', 'G' };
+const uint32_t g_compiledVersion = 2;
+
+uint64_t
+Pad (uint64_t size)
+{
+	return (size + 7) & ~((uint64_t) 7);
+}
+
+// offsets of the sections in a compiled buildings file, and its size
+struct CompiledLayout
+{
+	CompiledLayout (const CompiledHeader &header)
+	{
+		uint64_t n = header.nObstacles;
+		vertexStart = sizeof (CompiledHeader);
+		vertices = vertexStart + Pad (sizeof (uint64_t) * (n + 1));
+		height = vertices + Pad (2 * sizeof (double) * header.nVertices);
+		beta = height + Pad (sizeof (double) * n);
+		gamma = beta + Pad (sizeof (double) * n);
+		box = gamma + Pad (sizeof (double) * n);
+		idStart = box + Pad (4 * sizeof (double) * n);
+		ids = idStart + Pad (sizeof (uint64_t) * (n + 1));
+		grid = ids + Pad (header.idBytes);
+		size = grid + header.gridBytes;
+	}
+
+	uint64_t	vertexStart;
+	uint64_t	vertices;
+	uint64_t	height;
+	uint64_t	beta;
+	uint64_t	gamma;
+	uint64_t	box;
+	uint64_t	idStart;
+	uint64_t	ids;
+	uint64_t	grid;
+	uint64_t	size;
+};
+
+// write a section padded to 8 bytes
+void
+WriteSection (std::ofstream &file, const void *data, uint64_t size)
+{
+	static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	if (size > 0)
+		file.write ((const char *) data, size);
+	file.write (zeros, Pad (size) - size);
+}
+
+} // namespace
+
+TopologyQueryContext::TopologyQueryContext (uint32_t cacheCapacity)
+	:	m_maxSectorWidth (0.0),
+		m_cache (cacheCapacity)
+{
+}
+
+ObstructedLossCache &
+TopologyQueryContext::GetCache ()
+{
+	return m_cache;
+}
+
+void
+TopologyQueryContext::PrintCacheStatistics (std::ostream &os)
+{
+	uint64_t lookups = m_cache.GetHits () + m_cache.GetMisses ();
+	os << "Obstructed loss cache: "
+		 << m_cache.GetSize () << "/" << m_cache.GetCapacity () << " entries, "
+		 << m_cache.GetHits () << " hits, "
+		 << m_cache.GetMisses () << " misses ("
+		 << ((lookups > 0) ? 100.0 * m_cache.GetHits () / lookups : 0.0) << "% hit rate), "
+		 << m_cache.GetEvictions () << " evictions" << std::endl;
+}
+
 Topology::Topology () :
   // initially very large values
   // so that obstacle bounding box
@@ -38,11 +148,30 @@ Topology::Topology () :
   m_minX(999999999.0),
   m_minY(999999999.0),
   m_maxX(-999999999.0),
-  m_maxY(-999999999.0)
+  m_maxY(-999999999.0),
+	m_indexType (INDEX_RANGE_TREE),
+	m_indexBuilt (INDEX_NONE),
+	m_gridCellSize (50.0),
+	m_loadThreads (0),
+	m_simplifyTolerance (0),
+	m_simplifySamples (10000),
+	m_sourceHash (0),
+	m_tileMemoryBudget (512 * 1024 * 1024),
+	m_map (0),
+	m_mapSize (0),
+	m_context (65536)
 {
   NS_LOG_FUNCTION (this);
 }
 
+Topology::~Topology ()
+{
+	if (m_map != 0)
+		{
+			munmap (m_map, m_mapSize);
+		}
+}
+
 void Topology::CommandSetup (int argc, char **argv)
 {
   NS_LOG_FUNCTION (this);
@@ -84,12 +213,21 @@ Topology::GetTopology (void)
   return *ptopo;
 }
 
-void
-Topology::
-CreateVertex(Obstacle &obstacle, std::string vertex)
+namespace {
+
+// bounding box of the vertices parsed so far
+struct Bounds
 {
-  NS_LOG_FUNCTION (this);
+	double minX;
+	double minY;
+	double maxX;
+	double maxY;
+};
 
+// parse a vertex, add it to the obstacle and update the bounding box
+void
+ParseVertex(Obstacle &obstacle, const std::string &vertex, Bounds &bounds)
+{
   // x, y valus are comma-separated
   size_t pos = vertex.find(",");
   std::string x = vertex.substr(0, pos);
@@ -99,36 +237,32 @@ CreateVertex(Obstacle &obstacle, std::string vertex)
   double dx = atof(x.c_str ());
   double dy = atof(y.c_str ());
 
-  // create a 2D x,y point
-  Point p(dx, dy);
   // add the point as a vertex to an obstacle
-  obstacle.AddVertex(p);
+  obstacle.AddVertex(dx, dy);
 
   // if possible, update topology bounding box values
-  if (dx < m_minX)
+  if (dx < bounds.minX)
     {
-      m_minX = dx;
+      bounds.minX = dx;
     }
-  if (dx > m_maxX)
+  if (dx > bounds.maxX)
     {
-      m_maxX = dx;
+      bounds.maxX = dx;
     }
-  if (dy < m_minY)
+  if (dy < bounds.minY)
     {
-      m_minY = dy;
+      bounds.minY = dy;
     }
-  if (dy > m_maxY)
+  if (dy > bounds.maxY)
     {
-      m_maxY = dy;
+      bounds.maxY = dy;
     }
 }
 
+// parse the shape of an obstacle, update the bounding box
 void
-Topology::
-CreateShape(std::string id, std::string vertices, std::string height)
+ParseShape(Obstacle &obstacle, const std::string &id, const std::string &vertices, const std::string &height, Bounds &bounds)
 {
-  // create an obstacle
-  Obstacle obstacle;
   // name the obstacle
   obstacle.SetId(id);
 
@@ -147,7 +281,7 @@ CreateShape(std::string id, std::string vertices, std::string height)
     {
       vertex = vertices.substr(pos1, pos2-pos1);
 
-      CreateVertex(obstacle, vertex);
+      ParseVertex(obstacle, vertex, bounds);
       pos1 = pos2 + 1;
       pos2 = vertices.find(" ", pos1);
     }
@@ -158,387 +292,2143 @@ CreateShape(std::string id, std::string vertices, std::string height)
   // calculate the obstacle center of
   // bounding box and radius(squared).
   obstacle.Locate();
-
-  // load centerpoint into Range Tree
-  Point c = obstacle.GetCenter();
-  Key k = Key(c, obstacle);
-
-  // add the obstacle to the topolgoy
-  m_obstacles.push_back(k);
 }
 
-// range tree (binary space partition, BSP)
-// for quickly searching for obstacles within a range
-static Range_tree_2_type m_rangeTree;
-
-void
-Topology::LoadBuildings(std::string bldgFilename)
+// parse a line of a poly file: a poly with an id and a shape, whose
+// type is not excluded by the rules (the height is optional)
+bool
+ParseBuildingLine(const std::string &line, const ObstacleTypeRules &rules, std::string &polyid, std::string &shape, std::string &height,
+                  const ObstacleTypeRules::Rule *&rule)
 {
-  NS_LOG_INFO ("Load buildings.");
-
-	uint32_t nBuildings = 0;
-
-  std::ifstream file (bldgFilename.c_str (), std::ios::in);
-  if (!(file.is_open ()))
+  size_t posT = line.find("type=\"");
+  size_t posT2 = (posT != std::string::npos) ? line.find("\"", posT + 6) : std::string::npos;
+  if (posT2 != std::string::npos)
     {
-      NS_FATAL_ERROR("Could not open buildings file " << bldgFilename.c_str() << " for reading, aborting here \n");
+      rule = &rules.Lookup (line.substr(posT + 6, posT2 - (posT + 6)));
     }
-  else
+  if ((posT2 != std::string::npos) && (rule->action != ObstacleTypeRules::EXCLUDE))
     {
-      Topology * topology = Topology::GetTopology();
-      NS_ASSERT(topology != 0);
-
-      NS_LOG_DEBUG ("Reading file: " << bldgFilename);
-      while (!file.eof () )
+      // could *possibly* use XML-DOM here, but
+      // seems faster to just read through the file
+
+      // found a building
+      // get the building id (name) and shape (vertices)
+      size_t posP = line.find("<poly");
+			size_t pos = line.find("id=\"");
+			if ((posP != std::string::npos) || (pos != std::string::npos))
         {
-          std::string line;
-
-          getline (file, line);
-
-          NS_LOG_DEBUG (line);
-
-          size_t posB = line.find("type=\"building");
-          size_t posU = line.find("type=\"unknown");
-          if ((posB != std::string::npos) || (posU != std::string::npos))
+          size_t pos2 = line.find("\"", pos + 4);
+          if (pos2 != std::string::npos)
             {
-              // could *possibly* use XML-DOM here, but
-              // seems faster to just read through the file
-
-              // found a building
-              // get the building id (name) and shape (vertices)
-              std::string polyid;
-              std::string shape;
-							std::string height;
-              size_t posP = line.find("<poly");
-							size_t pos = line.find("id=\"");
-							if ((posP != std::string::npos) || (pos != std::string::npos))
+              polyid = line.substr(pos + 4, pos2 - (pos + 4));
+              pos = line.find("shape=\"");
+              if (pos != std::string::npos)
+              {
+                size_t pos2 = line.find("\"", pos + 8);
+                if (pos2 != std::string::npos)
                 {
-                  size_t pos2 = line.find("\"", pos + 4);
-                  if (pos2 != std::string::npos)
-                    {
-                      polyid = line.substr(pos + 4, pos2 - (pos + 4));
-                      pos = line.find("shape=\"");
-                      if (pos != std::string::npos)
+                  shape = line.substr(pos + 7, pos2 - pos - 7);
+
+									// Search for the height value
+									height.clear ();
+									pos = line.find("height=\"");
+                  if (pos != std::string::npos)
+										{
+											size_t pos2 = line.find("\"", pos + 8);
+                      if (pos2 != std::string::npos)
                       {
-                        size_t pos2 = line.find("\"", pos + 8);
-                        if (pos2 != std::string::npos)
-                        {
-                          shape = line.substr(pos + 7, pos2 - pos - 7);
-
-													// Search for the height value
-													pos = line.find("height=\"");
-		                      if (pos != std::string::npos)
-														{
-															size_t pos2 = line.find("\"", pos + 8);
-			                        if (pos2 != std::string::npos)
-			                        {
-			                          height = line.substr(pos + 8, pos2 - (pos + 8));
-															}
-														}
-
-													topology->CreateShape(polyid, shape, height);
-													nBuildings++;
-                        }
-                      }
-                    }
+                        height = line.substr(pos + 8, pos2 - (pos + 8));
+											}
+										}
+
+									return true;
                 }
+              }
             }
         }
-			NS_LOG_INFO ("Number of buildings found: " << nBuildings << ".");
-      NS_LOG_INFO ("Topology buildings bounded by x:" << topology->GetMinX() << "," << topology->GetMaxX() << " y:" << topology->GetMinY() << "," << topology->GetMaxY() << ".");
-      // all obstacles have been loaded
-      // so now create a searchable range tree based on those obstacles
-      topology->MakeRangeTree();
     }
+  return false;
 }
 
+// obstacles of a chunk of a poly file, in file order
+struct ParsedChunk
+{
+	ParsedChunk () : nExcluded (0) {}
+
+	std::vector<Obstacle> obstacles;
+	// polygons to be merged into the obstacles
+	std::vector<Obstacle> parts;
+	// polygons excluded because of the rules
+	uint32_t nExcluded;
+	Bounds bounds;
+};
+
+// parse the lines of buffer[begin, end)
 void
-Topology::MakeRangeTree()
+ParseChunk(const std::string &buffer, size_t begin, size_t end, const ObstacleTypeRules &rules, ParsedChunk &chunk)
 {
-  NS_LOG_FUNCTION (this);
+	std::string line;
+	std::string polyid;
+	std::string shape;
+	std::string height;
 
-  m_rangeTree.make_tree(m_obstacles.begin(), m_obstacles.end());
+	while (begin < end)
+		{
+			size_t eol = buffer.find('\n', begin);
+			if (eol == std::string::npos || eol > end)
+				{
+					eol = end;
+				}
+			line.assign (buffer, begin, eol - begin);
+			begin = eol + 1;
+
+			const ObstacleTypeRules::Rule *rule = 0;
+			if (ParseBuildingLine (line, rules, polyid, shape, height, rule))
+				{
+					// an obstacle that does not attenuate is useless
+					if ((rule->beta == 0) && (rule->gamma == 0))
+						{
+							chunk.nExcluded++;
+							continue;
+						}
+
+					std::vector<Obstacle> &obstacles = (rule->action == ObstacleTypeRules::MERGE) ? chunk.parts : chunk.obstacles;
+					obstacles.push_back (Obstacle ());
+					Obstacle &obstacle = obstacles.back ();
+					obstacle.SetBeta (rule->beta);
+					obstacle.SetGamma (rule->gamma);
+					if (height.empty () && (rule->height > 0))
+						{
+							obstacle.SetHeight (rule->height);
+						}
+					ParseShape (obstacle, polyid, shape, height, chunk.bounds);
+				}
+			else if (rule != 0)
+				{
+					chunk.nExcluded++;
+				}
+		}
 }
 
+} // namespace
+
 void
-Topology::GetObstructedDistance(const Point_3 &p1, const Point_3 &p2, Obstacle &obs, double & obstructedDistance, int &intersections)
+Topology::
+CreateVertex(Obstacle &obstacle, std::string vertex)
 {
   NS_LOG_FUNCTION (this);
 
-  // initialize values as if no intersections found
-  obstructedDistance = 0.0;
-  intersections = 0;
-
-  // construct a segment, r, from p1 to p2
-  // test r for intersection with each edge of obs
-  // calculate distance from p1 to nearest (d_min)  and farthest (d_max) intersecting edge
-  // obstruction distance is then estimated by d_max - d_min
-
-  double d_min = 999999999.0;
-  double d_max = -999999999.0;
+	Bounds bounds = { m_minX, m_minY, m_maxX, m_maxY };
+	ParseVertex (obstacle, vertex, bounds);
+	m_minX = bounds.minX;
+	m_minY = bounds.minY;
+	m_maxX = bounds.maxX;
+	m_maxY = bounds.maxY;
+}
 
-  Segment_3 r(p1, p2);
+void
+Topology::
+CreateShape(std::string id, std::string vertices, std::string height)
+{
+  // create an obstacle
+  Obstacle obstacle;
 
-  Polygon_2 &poly = obs.GetPolygon();
+	Bounds bounds = { m_minX, m_minY, m_maxX, m_maxY };
+	ParseShape (obstacle, id, vertices, height, bounds);
+	m_minX = bounds.minX;
+	m_minY = bounds.minY;
+	m_maxX = bounds.maxX;
+	m_maxY = bounds.maxY;
 
-  for (EdgeIterator iterEdge = poly.edges_begin(); iterEdge != poly.edges_end(); ++iterEdge)
-    {
-      Segment_2 s = (Segment_2) (*iterEdge);
+  // add the obstacle to the topolgoy, the range tree
+  // will refer to it by its index
+  m_obstacles.push_back(obstacle);
+}
 
-			// Create a plane from the edge:
-			// first, extract vertices from the segment,
-			// then create a plane with the two vertices and a third
-			// point made of x and y coordinates of one vertex and the z value
-			// as the height of the obstacle
-			Point_3 a(s.vertex(0).x (), s.vertex(0).y (), 0.0);
-			Point_3 b(s.vertex(1).x (), s.vertex(1).y (), 0.0);
-			Point_3 c(b.x (), b.y (), (obs.GetHeight () != 0) ? obs.GetHeight () : 1);	// if height is not provided, take 1 meter
-			Plane_3 plane(a, b, c);
+void
+Topology::LoadBuildings(std::string bldgFilename)
+{
+	Topology * topology = Topology::GetTopology();
+	NS_ASSERT(topology != 0);
 
-			CGAL::Object result = CGAL::intersection(plane, r);
+	topology->Load (bldgFilename);
+}
 
-      if (const CGAL::Point_3<K> *ipoint = CGAL::object_cast<CGAL::Point_3<K> >(&result))
-        {
-					// Check if the intersection is caused only by the generated plane,
-					// and not for the obstacle
-					Point_3 ip(CGAL::to_double(ipoint->x()), CGAL::to_double(ipoint->y()), CGAL::to_double(ipoint->z()));
-					if (!IsInRegion(s.vertex(0), s.vertex(1), obs.GetHeight (), ip))
-						continue;
+void
+Topology::Load(std::string bldgFilename)
+{
+  NS_LOG_INFO ("Load buildings.");
 
-          intersections++;
+	if (std::find (m_loadedFiles.begin (), m_loadedFiles.end (), bldgFilename) != m_loadedFiles.end ())
+		{
+			NS_LOG_INFO ("Buildings file " << bldgFilename << " already loaded.");
+			return;
+		}
+	m_loadedFiles.push_back (bldgFilename);
 
-          // handle the point intersection case with *ipoint.
-          double dx = CGAL::to_double(ipoint->x()) - CGAL::to_double(p1.x());
-          double dy = CGAL::to_double(ipoint->y()) - CGAL::to_double(p1.y());
-					double dz = CGAL::to_double(ipoint->z()) - CGAL::to_double(p1.z());
-          // square it, for performance optimization
-          // (there will be many compares to this vaule)
-          double distP1toIPsq = dx * dx + dy * dy + dz * dz;
+	if (ObstacleTileStore::IsTileStore (bldgFilename))
+		{
+			NS_ASSERT_MSG (m_obstacles.empty () && !m_tiles, "A tile store is the only source of obstacles of a topology");
+			m_tiles.reset (new ObstacleTileStore ());
+			if (!m_tiles->Open (bldgFilename, m_tileMemoryBudget))
+				{
+					NS_FATAL_ERROR("Could not open tile store " << bldgFilename.c_str() << ", aborting here \n");
+				}
+			uint64_t contentHash = m_tiles->GetContentHash ();
+			m_sourceHash = HashBytes (&contentHash, sizeof (contentHash), m_sourceHash);
+			double bounds[4];
+			m_tiles->GetBounds (bounds);
+			m_minX = bounds[0];
+			m_minY = bounds[1];
+			m_maxX = bounds[2];
+			m_maxY = bounds[3];
+			return;
+		}
 
-          if (distP1toIPsq < d_min)
-            {
-              d_min = distP1toIPsq;
-            }
-          if (distP1toIPsq > d_max)
-            {
-              d_max = distP1toIPsq;
-            }
-        }
-      /*
-      else if (const CGAL::Segment_2<K> *iseg = CGAL::object_cast<
-		CGAL::Segment_2<K> >(&result))
-        {
-          // handle the segment intersection case with *iseg.
-          //cout << "s and rho intersect at a segment " << *iseg << endl;
-        }
-      else
-        {
-          // handle the no intersection case.
-          //NS_LOG_UNCOND ("s and rho do not intersect");
-          //cout << "s and rho do not intersect." << endl;
-        }
-      */
+	if (IsCompiled (bldgFilename))
+		{
+			if (m_simplifyTolerance > 0)
+				{
+					NS_LOG_WARN ("Compiled buildings file " << bldgFilename << " is loaded as it was compiled, without simplification.");
+				}
+			if (!LoadCompiled (bldgFilename))
+				{
+					NS_FATAL_ERROR("Could not load compiled buildings file " << bldgFilename.c_str() << ", aborting here \n");
+				}
+			return;
+		}
 
+  std::ifstream file (bldgFilename.c_str (), std::ios::in | std::ios::binary);
+  if (!(file.is_open ()))
+    {
+      NS_FATAL_ERROR("Could not open buildings file " << bldgFilename.c_str() << " for reading, aborting here \n");
     }
 
-	// Handle the case in which one intersection is with the top of the obstacle (roof of the building)
-	double p1z = CGAL::to_double(p1.z());
-	double p2z = CGAL::to_double(p2.z());
-	double highestz = (p1z > p2z) ? CGAL::to_double(p1.z()) : CGAL::to_double(p2.z());
+	NS_LOG_DEBUG ("Reading file: " << bldgFilename);
+	std::string buffer;
+	file.seekg (0, std::ios::end);
+	std::streampos size = file.tellg ();
+	if (size == std::streampos (-1))
+		{
+			NS_FATAL_ERROR("Could not read buildings file " << bldgFilename.c_str() << ", aborting here \n");
+		}
+	buffer.resize (size);
+	file.seekg (0, std::ios::beg);
+	file.read (&buffer[0], buffer.size ());
+	if (file.fail ())
+		{
+			NS_FATAL_ERROR("Could not read buildings file " << bldgFilename.c_str() << ", aborting here \n");
+		}
+	file.close ();
+
+	// the obstacles depend on the file, the rules and the simplification
+	uint64_t rulesHash = m_typeRules.GetHash ();
+	m_sourceHash = HashBytes (buffer.data (), buffer.size (), m_sourceHash);
+	m_sourceHash = HashBytes (&rulesHash, sizeof (rulesHash), m_sourceHash);
+	m_sourceHash = HashBytes (&m_simplifyTolerance, sizeof (m_simplifyTolerance), m_sourceHash);
+	m_sourceHash = HashBytes (&m_simplifySamples, sizeof (m_simplifySamples), m_sourceHash);
+
+	// split the file in chunks starting at the line of a <poly, a few
+	// per thread so that the threads stay busy, but not too small
+	uint32_t nThreads = m_loadThreads;
+	if (nThreads == 0)
+		{
+			nThreads = std::max (1u, std::thread::hardware_concurrency ());
+		}
+	const size_t minChunkSize = 256 * 1024;
+	size_t nChunks = std::max ((size_t) 1, std::min ((size_t) 4 * nThreads, buffer.size () / minChunkSize));
+	std::vector<size_t> chunkStart (1, 0);
+	for (size_t k = 1; k < nChunks; k++)
+		{
+			size_t pos = buffer.find ("<poly", std::max (chunkStart.back (), k * (buffer.size () / nChunks)));
+			if (pos == std::string::npos)
+				{
+					break;
+				}
+			pos = buffer.rfind ('\n', pos);
+			pos = (pos == std::string::npos) ? 0 : pos + 1;
+			if (pos > chunkStart.back ())
+				{
+					chunkStart.push_back (pos);
+				}
+		}
+	chunkStart.push_back (buffer.size ());
+	nChunks = chunkStart.size () - 1;
+	nThreads = std::min ((size_t) nThreads, nChunks);
+
+	// parse the chunks: each one has its own obstacles and bounding box,
+	// CGAL objects built by a thread are not touched by the others
+	Bounds empty = { 999999999.0, 999999999.0, -999999999.0, -999999999.0 };
+	std::vector<ParsedChunk> chunks (nChunks);
+	std::atomic<size_t> nextChunk (0);
+	std::vector<std::thread> workers;
+	for (uint32_t t = 0; t < nThreads; t++)
+		{
+			workers.push_back (std::thread ([&] () {
+				size_t k;
+				while ((k = nextChunk++) < nChunks)
+					{
+						chunks[k].bounds = empty;
+						ParseChunk (buffer, chunkStart[k], chunkStart[k + 1], m_typeRules, chunks[k]);
+					}
+			}));
+		}
+	for (uint32_t t = 0; t < workers.size (); t++)
+		{
+			workers[t].join ();
+		}
 
-	if ((obs.GetHeight () != 0) && (highestz >= obs.GetHeight ()))
-	{
-		// Simulate the top of the obstacle with a plane in the 3d space
-		Point_3 a(poly.vertex (0).x (), poly.vertex (0).y (), obs.GetHeight ());
-		Point_3 b(poly.vertex (1).x (), poly.vertex (1).y (), obs.GetHeight ());
-		Point_3 c(poly.vertex (2).x (), poly.vertex (2).y (), (obs.GetHeight () > 0) ? obs.GetHeight () : 1);
-		Plane_3 roof(a, b, c);
+	// merge in file order, the obstacles get the same index
+	// they would have with a sequential parse
+	uint32_t nBuildings = 0;
+	uint32_t nExcluded = 0;
+	for (size_t k = 0; k < nChunks; k++)
+		{
+			nBuildings += chunks[k].obstacles.size ();
+			nExcluded += chunks[k].nExcluded;
+		}
+	uint32_t first = m_obstacles.size ();
+	m_obstacles.reserve (m_obstacles.size () + nBuildings);
+	std::vector<Obstacle> parts;
+	for (size_t k = 0; k < nChunks; k++)
+		{
+			m_obstacles.insert (m_obstacles.end (), std::make_move_iterator (chunks[k].obstacles.begin ()),
+			                    std::make_move_iterator (chunks[k].obstacles.end ()));
+			parts.insert (parts.end (), std::make_move_iterator (chunks[k].parts.begin ()),
+			              std::make_move_iterator (chunks[k].parts.end ()));
+			std::vector<Obstacle> ().swap (chunks[k].obstacles);
+			std::vector<Obstacle> ().swap (chunks[k].parts);
+			m_minX = std::min (m_minX, chunks[k].bounds.minX);
+			m_minY = std::min (m_minY, chunks[k].bounds.minY);
+			m_maxX = std::max (m_maxX, chunks[k].bounds.maxX);
+			m_maxY = std::max (m_maxY, chunks[k].bounds.maxY);
+		}
 
-		CGAL::Object result = CGAL::intersection(roof, r);
+	NS_LOG_INFO ("Number of buildings found: " << nBuildings << " (" << nChunks << " chunks, " << nThreads << " threads), "
+							 << nExcluded << " polygons excluded by type.");
 
-		// Check intersection
-		if (const CGAL::Point_3<K> *ipoint = CGAL::object_cast<CGAL::Point_3<K> >(&result))
+	if (!parts.empty ())
 		{
-			// Check bounds
-			if (PointIsInPolygon (poly, ipoint))
-			{
-				intersections++;
-
-				double dx = CGAL::to_double(ipoint->x()) - CGAL::to_double(p1.x());
-				double dy = CGAL::to_double(ipoint->y()) - CGAL::to_double(p1.y());
-				double dz = CGAL::to_double(ipoint->z()) - CGAL::to_double(p1.z());
-				double distP1toIPsq = dx * dx + dy * dy + dz * dz;
+			MergeObstacles (first, parts);
+		}
+	CompactObstacles ();
+  NS_LOG_INFO ("Topology buildings bounded by x:" << GetMinX() << "," << GetMaxX() << " y:" << GetMinY() << "," << GetMaxY() << ".");
+  // all obstacles have been loaded
+  // so now create a searchable index based on those obstacles
+	// (after simplifying them, if requested)
+	if (m_simplifyTolerance > 0)
+		{
+			SimplifyObstacles (m_simplifyTolerance, m_simplifySamples);
+		}
+	else
+		{
+			MakeIndex();
+		}
+}
 
-				if (distP1toIPsq < d_min)
-					{
-						d_min = distP1toIPsq;
-					}
-				if (distP1toIPsq > d_max)
-					{
-						d_max = distP1toIPsq;
-					}
-			}
+void
+Topology::MergeObstacles(uint32_t first, std::vector<Obstacle> &parts)
+{
+	NS_LOG_FUNCTION (this << first << parts.size ());
+
+	// bounding boxes of the obstacles parts can be merged into, and a grid
+	// of them to find the candidates of each part (all the obstacles are in
+	// the grid, those before first are skipped)
+	uint32_t n = m_obstacles.size ();
+	std::vector<double> box (4 * (n - first));
+	for (uint32_t i = first; i < n; i++)
+		{
+			const VertexList &vertices = m_obstacles[i].GetVertices ();
+			double *b = &box[4 * (i - first)];
+			b[0] = b[1] = std::numeric_limits<double>::max ();
+			b[2] = b[3] = -std::numeric_limits<double>::max ();
+			for (uint32_t v = 0; v < vertices.size (); v++)
+				{
+					b[0] = std::min (b[0], vertices[v].x);
+					b[1] = std::min (b[1], vertices[v].y);
+					b[2] = std::max (b[2], vertices[v].x);
+					b[3] = std::max (b[3], vertices[v].y);
+				}
+		}
+	ObstacleGridIndex grid;
+	grid.Build (m_obstacles, m_gridCellSize);
+	std::vector<uint32_t> candidates;
+
+	// a part overlaps an obstacle if a vertex of either one is within
+	// (or on the border of) the other one; it is merged into the first
+	// obstacle it overlaps, otherwise it becomes an obstacle
+	uint32_t nMerged = 0;
+	for (uint32_t p = 0; p < parts.size (); p++)
+		{
+			Obstacle &part = parts[p];
+			const VertexList &partVertices = part.GetVertices ();
+			double partBox[4] = { std::numeric_limits<double>::max (), std::numeric_limits<double>::max (),
+			                      -std::numeric_limits<double>::max (), -std::numeric_limits<double>::max () };
+			for (uint32_t v = 0; v < partVertices.size (); v++)
+				{
+					partBox[0] = std::min (partBox[0], partVertices[v].x);
+					partBox[1] = std::min (partBox[1], partVertices[v].y);
+					partBox[2] = std::max (partBox[2], partVertices[v].x);
+					partBox[3] = std::max (partBox[3], partVertices[v].y);
+				}
+
+			// the candidates are sorted, so the first one overlapped is kept
+			bool merged = false;
+			grid.QueryBox (partBox[0], partBox[1], partBox[2], partBox[3], candidates);
+			std::vector<uint32_t>::const_iterator it = std::lower_bound (candidates.begin (), candidates.end (), first);
+			for (; (it != candidates.end ()) && !merged; ++it)
+				{
+					uint32_t i = *it;
+					const double *b = &box[4 * (i - first)];
+					const Obstacle &obstacle = m_obstacles[i];
+					const VertexList &vertices = obstacle.GetVertices ();
+					if (partBox[0] > b[2] || partBox[2] < b[0] || partBox[1] > b[3] || partBox[3] < b[1])
+						{
+							continue;
+						}
+
+					for (uint32_t v = 0; (v < partVertices.size ()) && !merged; v++)
+						{
+							const Vector2D &q = partVertices[v];
+							merged = (q.x >= b[0] && q.x <= b[2] && q.y >= b[1] && q.y <= b[3]
+												&& obstacle.GetFootprint ().Contains (q.x, q.y) != WALL_MISS);
+						}
+					for (uint32_t v = 0; (v < vertices.size ()) && !merged; v++)
+						{
+							merged = (part.GetFootprint ().Contains (vertices[v].x, vertices[v].y) != WALL_MISS);
+						}
+
+					if (merged)
+						{
+							m_obstacles[i].SetHeight (std::max (obstacle.GetHeight (), part.GetHeight ()));
+							nMerged++;
+						}
+				}
+
+			if (!merged)
+				{
+					m_obstacles.push_back (part);
+				}
 		}
-	}
 
-  if ((d_min < 999999999.0) && (d_max > 0))
-    {
-      // if d_min == d_max, then intersection was at a vertex of an edge
-      if (d_min == d_max)
-        {
-          // intersection was at a vertex
-        }
-      else
-        {
-          double d1 = sqrt(d_min);
-          double d2 = sqrt(d_max);
-          obstructedDistance = d2 - d1;
-        }
-    }
+	NS_LOG_INFO ("Merged " << nMerged << " of " << parts.size () << " polygons into the overlapping obstacles.");
 }
 
-double
-Topology::GetObstructedLossBetween(const Point_3 &p1, const Point_3 &p2, double r)
+const ObstacleTypeRules &
+Topology::GetTypeRules() const
 {
-  NS_LOG_FUNCTION (this);
+	return m_typeRules;
+}
 
-  // initially assume no loss
-  double obstructedLoss = 0.0;
+void
+Topology::SetTypeRules(const ObstacleTypeRules &rules)
+{
+	NS_LOG_FUNCTION (this);
 
-  double rSq = r * r;
+	m_typeRules = rules;
+}
 
-  double p1x = CGAL::to_double(p1.x());
-  double p1y = CGAL::to_double(p1.y());
-	double p1z = CGAL::to_double(p1.z());
-  double p2x = CGAL::to_double(p2.x());
-  double p2y = CGAL::to_double(p2.y());
-	double p2z = CGAL::to_double(p2.z());
+void
+Topology::SetLoadThreads(uint32_t nThreads)
+{
+	NS_LOG_FUNCTION (this << nThreads);
 
-  // test first to see if we have a cached value
-  // for loss between these two points
-  // using their positions to the nearest 0.1m
+	m_loadThreads = nThreads;
+}
 
-  char buff[100];
-  sprintf(buff, "%010.1f %010.1f %010.1f", p1x, p1y, p1z);
-  std::string p1Pos = buff;
-  sprintf(buff, "%010.1f %010.1f %010.1f", p2x, p2y, p2z);
-  std::string p2Pos = buff;
-  sprintf(buff, "%s %s", p1Pos.c_str(), p2Pos.c_str());
-  std::string key = buff;
+void
+Topology::SetSimplifyTolerance(double tolerance, uint32_t nSamples)
+{
+	NS_LOG_FUNCTION (this << tolerance << nSamples);
+	NS_ASSERT (tolerance >= 0);
 
-  // check if cached
-  if (m_obstructedDistanceMap.count(key) > 0)
-    {
-      // found it
-      TStrDblMap::iterator it;
-      it = m_obstructedDistanceMap.find(key);
-      obstructedLoss = it->second;
-      return obstructedLoss;
-    }
-  else
+	m_simplifyTolerance = tolerance;
+	m_simplifySamples = nSamples;
+}
+
+void
+Topology::SimplifyObstacles(double tolerance, uint32_t nSamples)
+{
+	NS_LOG_FUNCTION (this << tolerance << nSamples);
+
+	SimplificationReport &report = m_simplificationReport;
+	report = SimplificationReport ();
+	report.tolerance = tolerance;
+	report.nObstacles = m_obstacles.size ();
+
+	// the obstacles as they are, for the error report
+	Topology original;
+	if (nSamples > 0)
+		{
+			original.m_obstacles = m_obstacles;
+			original.m_indexType = INDEX_GRID;
+			original.m_gridCellSize = m_gridCellSize;
+			original.MakeIndex ();
+		}
+
+	std::vector<Vector2D> vertices;
+	for (uint32_t i = 0; i < m_obstacles.size (); i++)
+		{
+			Obstacle &obstacle = m_obstacles[i];
+			uint32_t nBefore = obstacle.GetVertices ().size ();
+			if (!SimplifyFootprint (obstacle.GetVertices (), tolerance, vertices))
+				{
+					report.nKept++;
+				}
+			report.edgesBefore += nBefore;
+			report.edgesAfter += vertices.size ();
+			report.maxEdgesBefore = std::max (report.maxEdgesBefore, nBefore);
+			report.maxEdgesAfter = std::max (report.maxEdgesAfter, (uint32_t) vertices.size ());
+			if (vertices.size () == nBefore)
+				{
+					continue;
+				}
+
+			Obstacle simplified;
+			simplified.SetId (obstacle.GetId ());
+			simplified.SetHeight (obstacle.GetHeight ());
+			simplified.SetBeta (obstacle.GetBeta ());
+			simplified.SetGamma (obstacle.GetGamma ());
+			for (uint32_t v = 0; v < vertices.size (); v++)
+				{
+					simplified.AddVertex (vertices[v].x, vertices[v].y);
+				}
+			simplified.Locate ();
+			obstacle = std::move (simplified);
+		}
+
+	MakeIndex ();
+
+	// obstructed loss of random segments, up to 500 m long, at vehicle
+	// height on one side and up to above the roofs on the other (the
+	// generator has its own seed, the simulation streams are not touched)
+	const double maxLength = 500.0;
+	std::mt19937 rng (1);
+	std::uniform_real_distribution<double> uniform (0.0, 1.0);
+	std::vector<double> errors;
+	TopologyQueryContext context (0);
+	TopologyQueryContext originalContext (0);
+	report.nSamples = (nSamples > 0 && !m_obstacles.empty ()) ? nSamples : 0;
+	for (uint32_t k = 0; k < report.nSamples; k++)
+		{
+			double angle = 2 * M_PI * uniform (rng);
+			double length = maxLength * uniform (rng);
+			Vector p1 (m_minX + (m_maxX - m_minX) * uniform (rng), m_minY + (m_maxY - m_minY) * uniform (rng), 1.5);
+			Vector p2 (p1.x + length * std::cos (angle), p1.y + length * std::sin (angle), 1.5 + 30.0 * uniform (rng));
+
+			double loss = GetObstructedLossBetween (p1, p2, maxLength, ENGINE_DOUBLE, context);
+			double originalLoss = original.GetObstructedLossBetween (p1, p2, maxLength, ENGINE_DOUBLE, originalContext);
+			if (loss != 0 || originalLoss != 0)
+				{
+					errors.push_back (std::abs (loss - originalLoss));
+				}
+		}
+
+	report.nObstructed = errors.size ();
+	if (!errors.empty ())
+		{
+			std::sort (errors.begin (), errors.end ());
+			double sum = 0;
+			for (uint32_t k = 0; k < errors.size (); k++)
+				{
+					sum += errors[k];
+					report.nChanged += (errors[k] != 0);
+				}
+			report.meanError = sum / errors.size ();
+			report.p50Error = errors[(errors.size () - 1) / 2];
+			report.p95Error = errors[(uint32_t) (0.95 * (errors.size () - 1))];
+			report.p99Error = errors[(uint32_t) (0.99 * (errors.size () - 1))];
+			report.maxError = errors.back ();
+		}
+
+	NS_LOG_INFO ("Simplified " << report.nObstacles << " obstacles with tolerance " << tolerance << " m: "
+							 << report.edgesBefore << " -> " << report.edgesAfter << " edges, loss error mean "
+							 << report.meanError << " dB, 99% " << report.p99Error << " dB, max " << report.maxError << " dB.");
+
+	// the simplified obstacles join the others in the vertex array, now
+	// that the original obstacles (which may point to it) are not used
+	CompactObstacles ();
+}
+
+const SimplificationReport &
+Topology::GetSimplificationReport() const
+{
+	return m_simplificationReport;
+}
+
+ObstacleMemoryReport
+Topology::GetMemoryReport() const
+{
+	NS_LOG_FUNCTION (this);
+
+	ObstacleMemoryReport report;
+	const Vector2D *poolBegin = m_vertexPool.empty () ? 0 : &m_vertexPool[0];
+	const Vector2D *poolEnd = poolBegin + m_vertexPool.size ();
+	for (uint32_t i = 0; i < m_obstacles.size (); i++)
+		{
+			const Obstacle &obstacle = m_obstacles[i];
+			report.Add (obstacle);
+			const VertexList &vertices = obstacle.GetVertices ();
+			if (!obstacle.OwnsVertices () && (vertices.begin () < poolBegin || vertices.begin () >= poolEnd))
+				{
+					report.mappedVertexBytes += vertices.size () * sizeof (Vector2D);
+				}
+		}
+	report.vertexBytes += m_vertexPool.capacity () * sizeof (Vector2D);
+	report.nIds = ObstacleIdPool::GetN ();
+	report.idBytes = ObstacleIdPool::GetBytes ();
+	report.totalBytes = report.obstacleBytes + report.vertexBytes + report.idBytes
+		+ report.footprintBytes + report.polygonBytes;
+
+	return report;
+}
+
+void
+Topology::CompactObstacles()
+{
+	NS_LOG_FUNCTION (this);
+
+	// the vertices held by the obstacles, and those already in the
+	// array, are copied to a new array
+	const Vector2D *poolBegin = m_vertexPool.empty () ? 0 : &m_vertexPool[0];
+	const Vector2D *poolEnd = poolBegin + m_vertexPool.size ();
+	uint32_t n = m_obstacles.size ();
+	const uint64_t none = std::numeric_limits<uint64_t>::max ();
+	std::vector<uint64_t> start (n, none);
+	uint64_t nVertices = 0;
+	for (uint32_t i = 0; i < n; i++)
+		{
+			const VertexList &vertices = m_obstacles[i].GetVertices ();
+			if (m_obstacles[i].OwnsVertices () || (vertices.begin () >= poolBegin && vertices.begin () < poolEnd))
+				{
+					start[i] = nVertices;
+					nVertices += vertices.size ();
+				}
+		}
+
+	std::vector<Vector2D> pool;
+	pool.reserve (nVertices);
+	for (uint32_t i = 0; i < n; i++)
+		{
+			if (start[i] != none)
+				{
+					const VertexList &vertices = m_obstacles[i].GetVertices ();
+					pool.insert (pool.end (), vertices.begin (), vertices.end ());
+				}
+		}
+	for (uint32_t i = 0; i < n; i++)
+		{
+			if (start[i] != none)
+				{
+					m_obstacles[i].UseVertices (pool.data () + start[i], m_obstacles[i].GetVertices ().size ());
+				}
+		}
+
+	// the obstacles now point to the buffer of pool, which is kept
+	m_vertexPool.swap (pool);
+}
+
+bool
+Topology::CompileBuildings(std::string bldgFilename, std::string compiledFilename, double gridCellSize, double simplifyTolerance)
+{
+	NS_LOG_FUNCTION (bldgFilename << compiledFilename << gridCellSize << simplifyTolerance);
+
+	// a private topology, with the grid only (the range tree is not needed)
+	Topology topology;
+	topology.m_indexType = INDEX_GRID;
+	topology.m_gridCellSize = gridCellSize;
+	topology.m_simplifyTolerance = simplifyTolerance;
+	topology.Load (bldgFilename);
+
+	return topology.SaveCompiled (compiledFilename);
+}
+
+bool
+Topology::IsCompiled(std::string filename)
+{
+	char magic[sizeof (g_compiledMagic)];
+	std::ifstream file (filename.c_str (), std::ios::in | std::ios::binary);
+
+	return file.read (magic, sizeof (magic))
+		&& (std::memcmp (magic, g_compiledMagic, sizeof (magic)) == 0);
+}
+
+bool
+Topology::CompileTiles(std::string bldgFilename, std::string directory, double tileSize, double gridCellSize, double simplifyTolerance)
+{
+	NS_LOG_FUNCTION (bldgFilename << directory << tileSize << gridCellSize << simplifyTolerance);
+	NS_ASSERT (tileSize > 0);
+
+	Topology topology;
+	topology.m_indexType = INDEX_GRID;
+	topology.m_gridCellSize = gridCellSize;
+	topology.m_simplifyTolerance = simplifyTolerance;
+	topology.Load (bldgFilename);
+
+	if (mkdir (directory.c_str (), 0755) != 0 && errno != EEXIST)
+		{
+			NS_LOG_WARN ("Could not create the directory " << directory << ", the tile store is not written.");
+			return false;
+		}
+
+	// each obstacle goes to the tile of its center, in the original order
+	double originX = topology.m_minX;
+	double originY = topology.m_minY;
+	uint32_t nColumns = 1;
+	uint32_t nRows = 1;
+	if (topology.HasObstacles ())
+		{
+			nColumns = std::max (1.0, std::ceil ((topology.m_maxX - originX) / tileSize));
+			nRows = std::max (1.0, std::ceil ((topology.m_maxY - originY) / tileSize));
+		}
+	else
+		{
+			originX = originY = 0;
+		}
+	std::vector<std::vector<uint32_t> > tiles ((uint64_t) nColumns * nRows);
+	for (uint32_t i = 0; i < topology.m_obstacles.size (); i++)
+		{
+			const Vector2D &center = topology.m_obstacles[i].GetCenterVector ();
+			uint32_t column = std::min (nColumns - 1.0, std::max (0.0, std::floor ((center.x - originX) / tileSize)));
+			uint32_t row = std::min (nRows - 1.0, std::max (0.0, std::floor ((center.y - originY) / tileSize)));
+			tiles[row * nColumns + column].push_back (i);
+		}
+
+	for (uint32_t k = 0; k < tiles.size (); k++)
+		{
+			if (tiles[k].empty ())
+				{
+					continue;
+				}
+
+			Topology tile;
+			tile.m_indexType = INDEX_GRID;
+			tile.m_gridCellSize = gridCellSize;
+			tile.m_obstacles.reserve (tiles[k].size ());
+			for (uint32_t j = 0; j < tiles[k].size (); j++)
+				{
+					const Obstacle &obstacle = topology.m_obstacles[tiles[k][j]];
+					const VertexList &vertices = obstacle.GetVertices ();
+					for (uint32_t v = 0; v < vertices.size (); v++)
+						{
+							tile.m_minX = std::min (tile.m_minX, vertices[v].x);
+							tile.m_minY = std::min (tile.m_minY, vertices[v].y);
+							tile.m_maxX = std::max (tile.m_maxX, vertices[v].x);
+							tile.m_maxY = std::max (tile.m_maxY, vertices[v].y);
+						}
+					tile.m_obstacles.push_back (obstacle);
+				}
+			if (!tile.SaveCompiled (ObstacleTileStore::GetTileFilename (directory, k % nColumns, k / nColumns)))
+				{
+					return false;
+				}
+		}
+
+	double bounds[4] = { topology.m_minX, topology.m_minY, topology.m_maxX, topology.m_maxY };
+	if (!ObstacleTileStore::WriteIndex (directory, originX, originY, tileSize, nColumns, nRows, gridCellSize,
+																			bounds, topology.GetContentHash (), tiles))
+		{
+			return false;
+		}
+
+	NS_LOG_INFO ("Buildings split in " << nColumns << "x" << nRows << " tiles of " << tileSize << " m in " << directory << ".");
+	return true;
+}
+
+void
+Topology::SetTileMemoryBudget(uint64_t bytes)
+{
+	NS_LOG_FUNCTION (this << bytes);
+
+	m_tileMemoryBudget = bytes;
+	if (m_tiles)
+		{
+			m_tiles->SetMemoryBudget (bytes);
+		}
+}
+
+const ObstacleTileStore *
+Topology::GetTileStore() const
+{
+	return m_tiles.get ();
+}
+
+bool
+Topology::SaveCompiled(std::string compiledFilename)
+{
+	NS_LOG_FUNCTION (this << compiledFilename);
+
+	if (!m_obstacles.empty () && !m_grid.IsBuilt ())
+		{
+			MakeGrid ();
+		}
+
+	// flatten the obstacles
+	uint32_t n = m_obstacles.size ();
+	std::vector<uint64_t> vertexStart (n + 1, 0);
+	std::vector<double> vertices;
+	std::vector<double> height (n);
+	std::vector<double> beta (n);
+	std::vector<double> gamma (n);
+	std::vector<double> box (4 * n);
+	std::vector<uint64_t> idStart (n + 1, 0);
+	std::string ids;
+	for (uint32_t i = 0; i < n; i++)
+		{
+			Obstacle &obstacle = m_obstacles[i];
+			const VertexList &v = obstacle.GetVertices ();
+			double *b = &box[4 * i];
+			b[0] = b[1] = std::numeric_limits<double>::max ();
+			b[2] = b[3] = -std::numeric_limits<double>::max ();
+			for (uint32_t j = 0; j < v.size (); j++)
+				{
+					vertices.push_back (v[j].x);
+					vertices.push_back (v[j].y);
+					b[0] = std::min (b[0], v[j].x);
+					b[1] = std::min (b[1], v[j].y);
+					b[2] = std::max (b[2], v[j].x);
+					b[3] = std::max (b[3], v[j].y);
+				}
+			vertexStart[i + 1] = vertices.size () / 2;
+			height[i] = obstacle.GetHeight ();
+			beta[i] = obstacle.GetBeta ();
+			gamma[i] = obstacle.GetGamma ();
+			ids += obstacle.GetId ();
+			idStart[i + 1] = ids.size ();
+		}
+
+	std::ostringstream grid;
+	m_grid.Write (grid);
+
+	CompiledHeader header;
+	std::memset (&header, 0, sizeof (header));
+	std::memcpy (header.magic, g_compiledMagic, sizeof (g_compiledMagic));
+	header.version = g_compiledVersion;
+	header.nObstacles = n;
+	header.nVertices = vertexStart[n];
+	header.idBytes = ids.size ();
+	header.gridBytes = grid.str ().size ();
+	header.minX = m_minX;
+	header.minY = m_minY;
+	header.maxX = m_maxX;
+	header.maxY = m_maxY;
+
+	// unique temporary name, then rename
+	std::ostringstream tmp;
+	tmp << compiledFilename << ".tmp." << getpid ();
+
+	std::ofstream file (tmp.str ().c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open ())
+		{
+			NS_LOG_WARN ("Could not open " << tmp.str () << " for writing, the buildings are not compiled.");
+			return false;
+		}
+
+	file.write ((const char *) &header, sizeof (header));
+	WriteSection (file, vertexStart.data (), sizeof (uint64_t) * (n + 1));
+	WriteSection (file, vertices.data (), sizeof (double) * vertices.size ());
+	WriteSection (file, height.data (), sizeof (double) * n);
+	WriteSection (file, beta.data (), sizeof (double) * n);
+	WriteSection (file, gamma.data (), sizeof (double) * n);
+	WriteSection (file, box.data (), sizeof (double) * box.size ());
+	WriteSection (file, idStart.data (), sizeof (uint64_t) * (n + 1));
+	WriteSection (file, ids.data (), ids.size ());
+	WriteSection (file, grid.str ().data (), grid.str ().size ());
+	file.close ();
+
+	if (file.fail () || std::rename (tmp.str ().c_str (), compiledFilename.c_str ()) != 0)
+		{
+			NS_LOG_WARN ("Could not write " << compiledFilename << ", the buildings are not compiled.");
+			std::remove (tmp.str ().c_str ());
+			return false;
+		}
+
+	NS_LOG_INFO ("Buildings compiled to " << compiledFilename << ": " << n << " obstacles, "
+							 << header.nVertices << " vertices.");
+	return true;
+}
+
+bool
+Topology::LoadCompiled(std::string compiledFilename)
+{
+	NS_LOG_FUNCTION (this << compiledFilename);
+
+	int fd = open (compiledFilename.c_str (), O_RDONLY);
+	if (fd < 0)
+		{
+			NS_LOG_WARN ("Could not open " << compiledFilename << ".");
+			return false;
+		}
+
+	struct stat st;
+	if (fstat (fd, &st) != 0 || (uint64_t) st.st_size < sizeof (CompiledHeader))
+		{
+			NS_LOG_WARN ("Compiled buildings file " << compiledFilename << " is not valid.");
+			close (fd);
+			return false;
+		}
+
+	void *map = mmap (0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (map == MAP_FAILED)
+		{
+			NS_LOG_WARN ("Could not map " << compiledFilename << ".");
+			return false;
+		}
+
+	// the sizes of the sections must fit in the file before the layout
+	// is computed from them (their sum could overflow)
+	const CompiledHeader *header = (const CompiledHeader *) map;
+	uint64_t fileSize = st.st_size;
+	if (std::memcmp (header->magic, g_compiledMagic, sizeof (g_compiledMagic)) != 0
+			|| header->version != g_compiledVersion
+			|| header->nVertices > fileSize / (2 * sizeof (double))
+			|| header->idBytes > fileSize || header->gridBytes > fileSize
+			|| CompiledLayout (*header).size != fileSize)
+		{
+			NS_LOG_WARN ("Compiled buildings file " << compiledFilename << " is not valid (version "
+									 << header->version << ", expected " << g_compiledVersion << ").");
+			munmap (map, st.st_size);
+			return false;
+		}
+
+	const char *base = (const char *) map;
+	CompiledLayout layout (*header);
+	uint32_t n = header->nObstacles;
+	const uint64_t *vertexStart = (const uint64_t *) (base + layout.vertexStart);
+	const double *vertices = (const double *) (base + layout.vertices);
+	const double *height = (const double *) (base + layout.height);
+	const double *beta = (const double *) (base + layout.beta);
+	const double *gamma = (const double *) (base + layout.gamma);
+	const double *box = (const double *) (base + layout.box);
+	const uint64_t *idStart = (const uint64_t *) (base + layout.idStart);
+	const char *ids = base + layout.ids;
+
+	// the vertices and the id of each obstacle follow those of the previous
+	// one, and the last end with their sections
+	bool valid = (vertexStart[0] == 0) && (idStart[0] == 0)
+		&& (vertexStart[n] == header->nVertices) && (idStart[n] == header->idBytes);
+	for (uint32_t i = 0; valid && (i < n); i++)
+		{
+			valid = (vertexStart[i] <= vertexStart[i + 1]) && (idStart[i] <= idStart[i + 1]);
+		}
+	if (!valid)
+		{
+			NS_LOG_WARN ("Compiled buildings file " << compiledFilename << " is not valid.");
+			munmap (map, st.st_size);
+			return false;
+		}
+
+	m_sourceHash = HashBytes (map, st.st_size, m_sourceHash);
+
+	// the grid refers to the obstacles by index, it can be used
+	// only if they are the first obstacles of the topology
+	bool empty = m_obstacles.empty ();
+
+	// the obstacles use the vertices in place (x, y pairs are laid out
+	// as Vector2D), while the file stays mapped: only one file can be,
+	// the obstacles of the others get a copy
+	bool keepMap = (m_map == 0);
+	NS_ASSERT (sizeof (Vector2D) == 2 * sizeof (double));
+
+	m_obstacles.reserve (m_obstacles.size () + n);
+	for (uint32_t i = 0; i < n; i++)
+		{
+			Obstacle obstacle;
+			obstacle.SetId (std::string (ids + idStart[i], idStart[i + 1] - idStart[i]));
+			obstacle.SetHeight (height[i]);
+			obstacle.SetBeta (beta[i]);
+			obstacle.SetGamma (gamma[i]);
+			if (keepMap)
+				{
+					obstacle.UseVertices ((const Vector2D *) (vertices + 2 * vertexStart[i]), vertexStart[i + 1] - vertexStart[i]);
+				}
+			else
+				{
+					for (uint64_t v = vertexStart[i]; v < vertexStart[i + 1]; v++)
+						{
+							obstacle.AddVertex (vertices[2 * v], vertices[2 * v + 1]);
+						}
+				}
+			obstacle.Locate (box[4 * i], box[4 * i + 1], box[4 * i + 2], box[4 * i + 3]);
+			m_obstacles.push_back (std::move (obstacle));
+		}
+	if (!keepMap)
+		{
+			CompactObstacles ();
+		}
+
+	m_minX = std::min (m_minX, header->minX);
+	m_minY = std::min (m_minY, header->minY);
+	m_maxX = std::max (m_maxX, header->maxX);
+	m_maxY = std::max (m_maxY, header->maxY);
+
+	NS_LOG_INFO ("Number of buildings found: " << n << ".");
+	NS_LOG_INFO ("Topology buildings bounded by x:" << GetMinX() << "," << GetMaxX() << " y:" << GetMinY() << "," << GetMaxY() << ".");
+
+	// use the grid of the file in place, or build the index
+	if (keepMap && empty && (m_indexType == INDEX_GRID)
+			&& m_grid.Attach ((const uint8_t *) (base + layout.grid), header->gridBytes, n) > 0
+			&& m_grid.GetCellSize () == m_gridCellSize)
+		{
+			m_indexBuilt = INDEX_GRID;
+			if (!m_fixedPoints.empty ())
+				{
+					MakeFixedPoints ();
+				}
+		}
+	else
+		{
+			MakeIndex ();
+		}
+
+	if (keepMap)
+		{
+			m_map = map;
+			m_mapSize = st.st_size;
+		}
+	else
+		{
+			munmap (map, st.st_size);
+		}
+
+	return true;
+}
+
+void
+Topology::MakeRangeTree()
+{
+  NS_LOG_FUNCTION (this);
+
+	// load centerpoints into Range Tree
+	std::vector<Key> keys;
+	keys.reserve (m_obstacles.size ());
+	for (uint32_t i = 0; i < m_obstacles.size (); i++)
+		{
+			keys.push_back (Key (m_obstacles[i].GetCenter (), i));
+		}
+
+  m_rangeTree.make_tree(keys.begin(), keys.end());
+}
+
+void
+Topology::MakeGrid()
+{
+	NS_LOG_FUNCTION (this);
+
+	m_grid.Build (m_obstacles, m_gridCellSize);
+}
+
+void
+Topology::MakeIndex()
+{
+	NS_LOG_FUNCTION (this);
+
+	if (m_indexType == INDEX_GRID)
+		{
+			MakeGrid ();
+		}
+	else
+		{
+			MakeRangeTree ();
+		}
+	m_indexBuilt = m_indexType;
+
+	if (m_raster.IsBuilt ())
+		{
+			MakeRaster (m_raster.GetResolution ());
+		}
+
+	if (!m_fixedPoints.empty ())
+		{
+			MakeFixedPoints ();
+		}
+}
+
+void
+Topology::SetIndexType(IndexType type)
+{
+	NS_LOG_FUNCTION (this << type);
+
+	m_indexType = type;
+
+	// obstacles already loaded, (re)build the index
+	if (!m_obstacles.empty () && (m_indexBuilt != type))
+		{
+			MakeIndex ();
+		}
+}
+
+Topology::IndexType
+Topology::GetIndexType()
+{
+	NS_LOG_FUNCTION (this);
+
+	return m_indexType;
+}
+
+bool
+Topology::IsLockFree(Engine engine) const
+{
+	NS_LOG_FUNCTION (this << engine);
+
+	if ((engine == ENGINE_RASTER) || m_tiles)
+		{
+			// the raster has no CGAL objects, the tiles use the grid (and
+			// lock only to find them); both fall back to the double engine
+			return (engine != ENGINE_EXACT);
+		}
+	return (engine == ENGINE_DOUBLE) && (m_indexType == INDEX_GRID);
+}
+
+void
+Topology::SetGridCellSize(double size)
+{
+	NS_LOG_FUNCTION (this << size);
+	NS_ASSERT (size > 0);
+
+	m_gridCellSize = size;
+
+	if (!m_obstacles.empty () && (m_indexType == INDEX_GRID))
+		{
+			MakeGrid ();
+		}
+}
+
+void
+Topology::MakeRaster(double resolution)
+{
+	NS_LOG_FUNCTION (this << resolution);
+	NS_ASSERT (resolution > 0);
+
+	if (m_tiles)
+		{
+			NS_LOG_WARN ("The obstacles of a tile store are not rasterized, the double engine is used instead.");
+			return;
+		}
+
+	m_raster.Build (m_obstacles, resolution);
+}
+
+bool
+Topology::HasRaster() const
+{
+	return m_raster.IsBuilt ();
+}
+
+double
+Topology::GetRasterResolution() const
+{
+	return m_raster.IsBuilt () ? m_raster.GetResolution () : 0.0;
+}
+
+RasterValidationReport
+Topology::ValidateRaster(uint32_t nSamples, double r, Engine reference) const
+{
+	NS_LOG_FUNCTION (this << nSamples << r);
+	NS_ASSERT (m_raster.IsBuilt ());
+
+	RasterValidationReport report;
+	report.resolution = m_raster.GetResolution ();
+	report.nCells = m_raster.GetNCells ();
+	report.nSamples = nSamples;
+
+	// random segments, as for the simplification report: up to 2r long,
+	// at vehicle height on one side and up to above the roofs on the other
+	std::mt19937 rng (1);
+	std::uniform_real_distribution<double> uniform (0.0, 1.0);
+	std::vector<Vector> p1 (nSamples);
+	std::vector<Vector> p2 (nSamples);
+	for (uint32_t k = 0; k < nSamples; k++)
+		{
+			double angle = 2 * M_PI * uniform (rng);
+			double length = 2 * r * uniform (rng);
+			p1[k] = Vector (m_minX + (m_maxX - m_minX) * uniform (rng), m_minY + (m_maxY - m_minY) * uniform (rng), 1.5);
+			p2[k] = Vector (p1[k].x + length * std::cos (angle), p1[k].y + length * std::sin (angle), 1.5 + 30.0 * uniform (rng));
+		}
+
+	// each engine on all the segments, for the timing
+	std::vector<double> referenceLoss (nSamples);
+	std::vector<double> rasterLoss (nSamples);
+	TopologyQueryContext context (0);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+	for (uint32_t k = 0; k < nSamples; k++)
+		{
+			referenceLoss[k] = GetObstructedLossBetween (p1[k], p2[k], r, reference, context);
+		}
+	std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now ();
+	for (uint32_t k = 0; k < nSamples; k++)
+		{
+			rasterLoss[k] = GetObstructedLossBetween (p1[k], p2[k], r, ENGINE_RASTER, context);
+		}
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now ();
+	report.referenceTime = std::chrono::duration<double> (middle - start).count ();
+	report.rasterTime = std::chrono::duration<double> (end - middle).count ();
+
+	std::vector<double> errors;
+	for (uint32_t k = 0; k < nSamples; k++)
+		{
+			if (referenceLoss[k] != 0 || rasterLoss[k] != 0)
+				{
+					errors.push_back (std::abs (rasterLoss[k] - referenceLoss[k]));
+					report.nDisagree += ((referenceLoss[k] == 0) != (rasterLoss[k] == 0));
+				}
+		}
+
+	report.nObstructed = errors.size ();
+	if (!errors.empty ())
+		{
+			std::sort (errors.begin (), errors.end ());
+			double sum = 0;
+			for (uint32_t k = 0; k < errors.size (); k++)
+				{
+					sum += errors[k];
+				}
+			report.meanError = sum / errors.size ();
+			report.p50Error = errors[(errors.size () - 1) / 2];
+			report.p95Error = errors[(uint32_t) (0.95 * (errors.size () - 1))];
+			report.p99Error = errors[(uint32_t) (0.99 * (errors.size () - 1))];
+			report.maxError = errors.back ();
+		}
+
+	return report;
+}
+
+void
+Topology::GetObstructedDistance(const Point_3 &p1, const Point_3 &p2, const Obstacle &obs, double & obstructedDistance, int &intersections) const
+{
+  NS_LOG_FUNCTION (this);
+
+  // initialize values as if no intersections found
+  obstructedDistance = 0.0;
+  intersections = 0;
+
+  // construct a segment, r, from p1 to p2
+  // test r for intersection with each edge of obs
+  // calculate distance from p1 to nearest (d_min)  and farthest (d_max) intersecting edge
+  // obstruction distance is then estimated by d_max - d_min
+
+  double d_min = 999999999.0;
+  double d_max = -999999999.0;
+
+  Segment_3 r(p1, p2);
+
+  const Polygon_2 &poly = obs.GetPolygon();
+
+  for (EdgeIterator iterEdge = poly.edges_begin(); iterEdge != poly.edges_end(); ++iterEdge)
     {
-      // B to A is same as A to B
-      sprintf(buff, "%s %s", p2Pos.c_str(), p1Pos.c_str());
-      std::string key = buff;
-      if (m_obstructedDistanceMap.count(key) > 0)
+      Segment_2 s = (Segment_2) (*iterEdge);
+
+			// Create a plane from the edge:
+			// first, extract vertices from the segment,
+			// then create a plane with the two vertices and a third
+			// point made of x and y coordinates of one vertex and the z value
+			// as the height of the obstacle
+			Point_3 a(s.vertex(0).x (), s.vertex(0).y (), 0.0);
+			Point_3 b(s.vertex(1).x (), s.vertex(1).y (), 0.0);
+			Point_3 c(b.x (), b.y (), (obs.GetHeight () != 0) ? obs.GetHeight () : 1);	// if height is not provided, take 1 meter
+			Plane_3 plane(a, b, c);
+
+			CGAL::Object result = CGAL::intersection(plane, r);
+
+      if (const CGAL::Point_3<K> *ipoint = CGAL::object_cast<CGAL::Point_3<K> >(&result))
+        {
+					// Check if the intersection is caused only by the generated plane,
+					// and not for the obstacle
+					Point_3 ip(CGAL::to_double(ipoint->x()), CGAL::to_double(ipoint->y()), CGAL::to_double(ipoint->z()));
+					if (!IsInRegion(s.vertex(0), s.vertex(1), obs.GetHeight (), ip))
+						continue;
+
+          intersections++;
+
+          // handle the point intersection case with *ipoint.
+          double dx = CGAL::to_double(ipoint->x()) - CGAL::to_double(p1.x());
+          double dy = CGAL::to_double(ipoint->y()) - CGAL::to_double(p1.y());
+					double dz = CGAL::to_double(ipoint->z()) - CGAL::to_double(p1.z());
+          // square it, for performance optimization
+          // (there will be many compares to this vaule)
+          double distP1toIPsq = dx * dx + dy * dy + dz * dz;
+
+          if (distP1toIPsq < d_min)
+            {
+              d_min = distP1toIPsq;
+            }
+          if (distP1toIPsq > d_max)
+            {
+              d_max = distP1toIPsq;
+            }
+        }
+      /*
+      else if (const CGAL::Segment_2<K> *iseg = CGAL::object_cast<
+		CGAL::Segment_2<K> >(&result))
+        {
+          // handle the segment intersection case with *iseg.
+          //cout << "s and rho intersect at a segment " << *iseg << endl;
+        }
+      else
         {
-          // found it
-          TStrDblMap::iterator it;
-          it = m_obstructedDistanceMap.find(key);
-          obstructedLoss = it->second;
-          return obstructedLoss;
+          // handle the no intersection case.
+          //NS_LOG_UNCOND ("s and rho do not intersect");
+          //cout << "s and rho do not intersect." << endl;
         }
+      */
+
     }
 
+	// Handle the case in which one intersection is with the top of the obstacle (roof of the building)
+	double p1z = CGAL::to_double(p1.z());
+	double p2z = CGAL::to_double(p2.z());
+	double highestz = (p1z > p2z) ? CGAL::to_double(p1.z()) : CGAL::to_double(p2.z());
+
+	if ((obs.GetHeight () != 0) && (highestz >= obs.GetHeight ()) && obs.HasRoofPlane ())
+	{
+		// The top of the obstacle is the plane z = height: intersect it
+		// with the segment (a segment lying on the roof is not a point
+		// intersection), in exact arithmetic
+		K::FT h (obs.GetHeight ());
+		K::FT rz = p2.z () - p1.z ();
+		K::FT t = (rz != 0) ? (h - p1.z ()) / rz : K::FT (-1);
+
+		// Check intersection
+		if ((t >= 0) && (t <= 1))
+		{
+			Point_3 roofPoint (p1.x () + t * (p2.x () - p1.x ()), p1.y () + t * (p2.y () - p1.y ()), h);
+			const Point_3 *ipoint = &roofPoint;
+
+			// Check bounds, the edge table tells inside from outside
+			// unless the point is on the border
+			WallHit inside = obs.GetFootprint ().Contains (CGAL::to_double (ipoint->x ()), CGAL::to_double (ipoint->y ()));
+			if ((inside == WALL_HIT) || ((inside == WALL_DEGENERATE) && PointIsInPolygon (poly, ipoint)))
+			{
+				intersections++;
+
+				double dx = CGAL::to_double(ipoint->x()) - CGAL::to_double(p1.x());
+				double dy = CGAL::to_double(ipoint->y()) - CGAL::to_double(p1.y());
+				double dz = CGAL::to_double(ipoint->z()) - CGAL::to_double(p1.z());
+				double distP1toIPsq = dx * dx + dy * dy + dz * dz;
+
+				if (distP1toIPsq < d_min)
+					{
+						d_min = distP1toIPsq;
+					}
+				if (distP1toIPsq > d_max)
+					{
+						d_max = distP1toIPsq;
+					}
+			}
+		}
+	}
+	else if ((obs.GetHeight () != 0) && (highestz >= obs.GetHeight ()))
+	{
+		// Simulate the top of the obstacle with a plane in the 3d space
+		// (collinear vertices: the plane is not the roof)
+		Point_3 a(poly.vertex (0).x (), poly.vertex (0).y (), obs.GetHeight ());
+		Point_3 b(poly.vertex (1).x (), poly.vertex (1).y (), obs.GetHeight ());
+		Point_3 c(poly.vertex (2).x (), poly.vertex (2).y (), (obs.GetHeight () > 0) ? obs.GetHeight () : 1);
+		Plane_3 roof(a, b, c);
+
+		CGAL::Object result = CGAL::intersection(roof, r);
+
+		// Check intersection
+		if (const CGAL::Point_3<K> *ipoint = CGAL::object_cast<CGAL::Point_3<K> >(&result))
+		{
+			// Check bounds
+			if (PointIsInPolygon (poly, ipoint))
+			{
+				intersections++;
+
+				double dx = CGAL::to_double(ipoint->x()) - CGAL::to_double(p1.x());
+				double dy = CGAL::to_double(ipoint->y()) - CGAL::to_double(p1.y());
+				double dz = CGAL::to_double(ipoint->z()) - CGAL::to_double(p1.z());
+				double distP1toIPsq = dx * dx + dy * dy + dz * dz;
+
+				if (distP1toIPsq < d_min)
+					{
+						d_min = distP1toIPsq;
+					}
+				if (distP1toIPsq > d_max)
+					{
+						d_max = distP1toIPsq;
+					}
+			}
+		}
+	}
+
+  if ((d_min < 999999999.0) && (d_max > 0))
+    {
+      // if d_min == d_max, then intersection was at a vertex of an edge
+      if (d_min == d_max)
+        {
+          // intersection was at a vertex
+        }
+      else
+        {
+          double d1 = sqrt(d_min);
+          double d2 = sqrt(d_max);
+          obstructedDistance = d2 - d1;
+        }
+    }
+}
+
+// keep track of the nearest and farthest intersection
+static void
+UpdateDistanceRange (double distSq, double &d_min, double &d_max)
+{
+	if (distSq < d_min)
+		{
+			d_min = distSq;
+		}
+	if (distSq > d_max)
+		{
+			d_max = distSq;
+		}
+}
+
+// obstruction distance estimated as d_max - d_min (squared values in input)
+static double
+DistanceFromRange (double d_min, double d_max)
+{
+	if ((d_min < 999999999.0) && (d_max > 0) && (d_min != d_max))
+		{
+			return std::sqrt (d_max) - std::sqrt (d_min);
+		}
+	return 0.0;
+}
+
+WallHit
+Topology::IntersectRoofDouble(const Vector &p1, const Vector &p2, const Obstacle &obs, double &distSq) const
+{
+	NS_LOG_FUNCTION (this);
+
+	double h = obs.GetHeight ();
+	double highestz = std::max (p1.z, p2.z);
+
+	if ((h == 0) || (highestz < h))
+		return WALL_MISS;
+
+	// the roof plane is built on the first three vertices,
+	// if they are collinear let the exact engine deal with it
+	if (!obs.HasRoofPlane ())
+		return WALL_DEGENERATE;
+
+	// a segment lying on the roof is not a point intersection
+	double rz = p2.z - p1.z;
+	if (rz == 0)
+		return WALL_MISS;
+
+	double t = (h - p1.z) / rz;
+	if (t < 0 || t > 1)
+		return WALL_MISS;
+
+	double dx = t * (p2.x - p1.x);
+	double dy = t * (p2.y - p1.y);
+	double dz = h - p1.z;
+	WallHit inside = obs.GetFootprint ().Contains (p1.x + dx, p1.y + dy);
+	if (inside != WALL_HIT)
+		return inside;
+
+	distSq = dx * dx + dy * dy + dz * dz;
+	return WALL_HIT;
+}
+
+bool
+Topology::GetObstructedDistanceDouble(const Vector &p1, const Vector &p2, const Obstacle &obs, double &obstructedDistance, int &intersections) const
+{
+	NS_LOG_FUNCTION (this);
+
+	// initialize values as if no intersections found
+	obstructedDistance = 0.0;
+	intersections = 0;
+
+	// same construction of GetObstructedDistance: each edge of obs is
+	// extruded to a vertical wall [0, height] and intersected with the
+	// segment from p1 to p2, see IntersectWall
+
+	double d_min = 999999999.0;
+	double d_max = -999999999.0;
+	double distSq = 0.0;
+
+	const VertexList &vertices = obs.GetVertices ();
+	uint32_t n = vertices.size ();
+
+	for (uint32_t i = 0; i < n; i++)
+	{
+		const Vector2D &s0 = vertices[i];
+		const Vector2D &s1 = vertices[(i + 1) % n];
+
+		WallHit hit = IntersectWall (s0.x, s0.y, s1.x, s1.y, obs.GetHeight (), p1, p2, distSq);
+		if (hit == WALL_DEGENERATE)
+			return false;
+		if (hit == WALL_HIT)
+		{
+			intersections++;
+			UpdateDistanceRange (distSq, d_min, d_max);
+		}
+	}
+
+	// Handle the case in which one intersection is with the roof
+	WallHit hit = IntersectRoofDouble (p1, p2, obs, distSq);
+	if (hit == WALL_DEGENERATE)
+		return false;
+	if (hit == WALL_HIT)
+	{
+		intersections++;
+		UpdateDistanceRange (distSq, d_min, d_max);
+	}
+
+	obstructedDistance = DistanceFromRange (d_min, d_max);
+	return true;
+}
+
+void
+Topology::GetObstructedDistanceBatch(const Vector &p1, const Vector &p2, TopologyQueryContext &context) const
+{
+	NS_LOG_FUNCTION (this);
+
+	// flatten the walls of all the candidates
+	context.m_walls.Clear ();
+	for (uint32_t c = 0; c < context.m_candidates.size (); c++)
+	{
+		const Obstacle &obs = m_obstacles[context.m_candidates[c]];
+		const VertexList &vertices = obs.GetVertices ();
+		uint32_t n = vertices.size ();
+		for (uint32_t i = 0; i < n; i++)
+		{
+			const Vector2D &s0 = vertices[i];
+			const Vector2D &s1 = vertices[(i + 1) % n];
+			context.m_walls.Add (s0.x, s0.y, s1.x, s1.y, obs.GetHeight ());
+		}
+	}
+
+	context.m_wallDistSq.resize (context.m_walls.GetN ());
+	context.m_wallHit.resize (context.m_walls.GetN ());
+	IntersectWalls (context.m_walls, p1, p2, context.m_wallDistSq.data (), context.m_wallHit.data ());
+
+	// reduce the results of each candidate
+	uint32_t wall = 0;
+	for (uint32_t c = 0; c < context.m_candidates.size (); c++)
+	{
+		const Obstacle &obs = m_obstacles[context.m_candidates[c]];
+		uint32_t n = obs.GetVertices ().size ();
+
+		double d_min = 999999999.0;
+		double d_max = -999999999.0;
+		int intersections = 0;
+		bool degenerate = false;
+
+		for (uint32_t i = wall; i < wall + n; i++)
+		{
+			if (context.m_wallHit[i] == WALL_DEGENERATE)
+			{
+				degenerate = true;
+			}
+			else if (context.m_wallHit[i] == WALL_HIT)
+			{
+				intersections++;
+				UpdateDistanceRange (context.m_wallDistSq[i], d_min, d_max);
+			}
+		}
+		wall += n;
+
+		double distSq = 0.0;
+		if (!degenerate)
+		{
+			WallHit hit = IntersectRoofDouble (p1, p2, obs, distSq);
+			if (hit == WALL_DEGENERATE)
+			{
+				degenerate = true;
+			}
+			else if (hit == WALL_HIT)
+			{
+				intersections++;
+				UpdateDistanceRange (distSq, d_min, d_max);
+			}
+		}
+
+		if (degenerate)
+		{
+			// exact kernel for this obstacle only
+			std::lock_guard<std::mutex> lock (m_cgalMutex);
+			Point_3 p1e (p1.x, p1.y, p1.z);
+			Point_3 p2e (p2.x, p2.y, p2.z);
+			GetObstructedDistance (p1e, p2e, obs, context.m_candidateDistance[c], context.m_candidateIntersections[c]);
+		}
+		else
+		{
+			context.m_candidateDistance[c] = DistanceFromRange (d_min, d_max);
+			context.m_candidateIntersections[c] = intersections;
+		}
+	}
+}
+
+double
+Topology::GetObstructedLossBetween(const Point_3 &p1, const Point_3 &p2, double r, Engine engine)
+{
+  NS_LOG_FUNCTION (this);
+
+	Vector p1v (CGAL::to_double (p1.x ()), CGAL::to_double (p1.y ()), CGAL::to_double (p1.z ()));
+	Vector p2v (CGAL::to_double (p2.x ()), CGAL::to_double (p2.y ()), CGAL::to_double (p2.z ()));
+
+	return GetObstructedLossBetween (p1v, p2v, r, engine, m_context);
+}
+
+double
+Topology::GetObstructedLossBetween(const Vector &p1, const Vector &p2, double r, Engine engine, TopologyQueryContext &context) const
+{
+  NS_LOG_FUNCTION (this);
+
+  // initially assume no loss
+  double obstructedLoss = 0.0;
+
+  double p1x = p1.x;
+  double p1y = p1.y;
+	double p1z = p1.z;
+  double p2x = p2.x;
+  double p2y = p2.y;
+	double p2z = p2.z;
+
+  // test first to see if we have a cached value
+  // for loss between these two points
+  // using their positions to the nearest 0.1m
+	ObstructedLossKey key (p1x, p1y, p1z, p2x, p2y, p2z);
+	if (context.m_cache.Lookup (key, obstructedLoss))
+		{
+			// found it (A to B is the same as B to A)
+			return obstructedLoss;
+		}
+
+	obstructedLoss = ComputeObstructedLoss (p1, p2, r, engine, context);
+
+  // cache results, the least recently used ones are evicted
+	context.m_cache.Insert (key, obstructedLoss);
+
+  return obstructedLoss;
+}
+
+double
+Topology::ComputeObstructedLoss(const Vector &p1, const Vector &p2, double r, Engine engine, TopologyQueryContext &context) const
+{
+  double obstructedLoss = 0.0;
+  double rSq = r * r;
+
   // optimization
   // only if dist between p1 and p2 < 2r
-  double dx = p2x - p1x;
-  double dy = p2y - p1y;
+  double dx = p2.x - p1.x;
+  double dy = p2.y - p1.y;
   double distP1toP2sq = dx * dx + dy * dy;
   // distance must be less then (2r)^2 = 4r^2
   double x4rSq = 4.0 * rSq;
-  if (distP1toP2sq < x4rSq)
+	if (distP1toP2sq >= x4rSq)
+		{
+			noop;	// too far apart, no loss
+		}
+	else if (m_tiles)
+		{
+			obstructedLoss = m_tiles->GetObstructedLossBetween (p1, p2, r, engine, context);
+		}
+	else if (engine == ENGINE_RASTER)
+		{
+			NS_ASSERT_MSG (m_raster.IsBuilt (), "The raster engine needs Topology::MakeRaster");
+			obstructedLoss = m_raster.GetLoss (m_obstacles, p1, p2, r, context.m_rasterCrossings);
+		}
+	else if (const ObstacleVisibility *visibility = FindFixedPoint (p1, p2, r))
+		{
+			int64_t obstacle;
+			obstructedLoss = GetFixedPointLoss (*visibility, p1, p2, r, engine, context, obstacle);
+		}
+  else
     {
-      // now search by range tree search
-      // get bounding box, and extend by r is all directions
-      double xmin = std::min(p1x, p2x) - r;
-      double xmax = std::max(p1x, p2x) + r;
-      double ymin = std::min(p1y, p2y) - r;
-      double ymax = std::max(p1y, p2y) + r;
-      Point pLow(xmin, ymin);
-      Point pHigh(xmax, ymax);
-      Interval win(Interval(pLow, pHigh));
-      m_outputList.clear();
-      m_rangeTree.window_query(win, std::back_inserter(m_outputList));
-      std::vector<Key>::iterator current = m_outputList.begin();
-			uint32_t index = 0;	// another check
-			uint32_t limit = m_outputList.size ();
-      while (current != m_outputList.end() && index < limit)
-			// don't know why, but without the second condition it goes SIGSEGV
-			// because <current> goes off limits
-        {
-          Obstacle obstacle = (*current).second;
-          std::string id = obstacle.GetId();
-          Point center = obstacle.GetCenter();
+			int64_t obstacle;
+			obstructedLoss = GetObstructedLossAndObstacle (p1, p2, r, engine, context, obstacle);
+    }
 
-          double dx1 = CGAL::to_double(center.x()) - p1x;
-          double dy1 = CGAL::to_double(center.y()) - p1y;
-          double distCtoP1sq = dx1 * dx1 + dy1 * dy1;
+  return obstructedLoss;
+}
+
+double
+Topology::GetObstructedLossAndObstacle(const Vector &p1, const Vector &p2, double r, Engine engine,
+																			 TopologyQueryContext &context, int64_t &obstacle) const
+{
+	NS_LOG_FUNCTION (this);
+	NS_ASSERT (engine != ENGINE_RASTER);
+
+	double rSq = r * r;
+	double p1x = p1.x;
+	double p1y = p1.y;
+	double p1z = p1.z;
+	double p2x = p2.x;
+	double p2y = p2.y;
+	double p2z = p2.z;
+
+	context.m_outputList.clear ();
+	context.m_candidates.clear ();
+	if (m_indexType == INDEX_GRID)
+		{
+			// obstacles in the cells crossed by the segment, but for the
+			// cells whose roofs are all below the segment: their obstacles
+			// would be skipped anyway (see AddCandidate)
+			m_grid.Query (p1x, p1y, p2x, p2y, context.m_outputList, std::min (p1z, p2z));
+		}
+	else
+		{
+			std::lock_guard<std::mutex> lock (m_cgalMutex);
+			// now search by range tree search
+			// get bounding box, and extend by r is all directions
+			double xmin = std::min(p1x, p2x) - r;
+			double xmax = std::max(p1x, p2x) + r;
+			double ymin = std::min(p1y, p2y) - r;
+			double ymax = std::max(p1y, p2y) + r;
+			Point pLow(xmin, ymin);
+			Point pHigh(xmax, ymax);
+			Interval win(Interval(pLow, pHigh));
+			m_rangeTree.window_query(win, ObstacleIndexInserter (context.m_outputList));
+		}
+	for (uint32_t i = 0; i < context.m_outputList.size (); i++)
+		{
+			AddCandidate (context.m_outputList[i], p1, p2, rSq, context);
+		}
 
-          double dx2 = CGAL::to_double(center.x()) - p2x;
-          double dy2 = CGAL::to_double(center.y()) - p2y;
-          double distCtoP2sq = dx2 * dx2 + dy2 * dy2;
+	return EvaluateCandidates (p1, p2, engine, context, obstacle);
+}
 
-          if (((distCtoP1sq - rSq) < 0)
-              && ((distCtoP2sq - rSq) < 0))
-            {
-              // obtstacle is within range
-
-              double obstructedDistanceBetween = 0.0;
-              int intersections = 0;
-
-							// if both points are over the top of the building, no loss
-							double minz = std::min(p1z, p2z);
-							if ((obstacle.GetHeight () > 0) && (minz >= obstacle.GetHeight ()))
-								{
-									noop;	// pass, do nothing
-								}
-							else
-								{
-									GetObstructedDistance(p1, p2, obstacle, obstructedDistanceBetween, intersections);
-								}
-              // From C. Sommer et. al.:
-              // A Computationally Inexpensive Empirical Model of IEEE 802.11p
-              // Radio Shadowing in Urban Environments, 2011.
-              // Additional loss due to propagation through obstacles:
-              // Lobs = beta x n + gamma x d_m
-              // Where
-              // Lobs is the additional loss
-              // beta is a (constant) factor for the obstacle type
-              // n is the number of intersections through the obstacle
-              // gamma is a (constant) factor for the obstacle type
-              // d_m is the distance in meters of propagation through the obstacle
-              if ((obstructedDistanceBetween > 0.0) && (intersections > 1))
-                {
-                  double beta = obstacle.GetBeta();
-                  double gamma = obstacle.GetGamma();
-                  obstructedLoss = beta * (double) intersections + gamma * obstructedDistanceBetween;
-                }
-            }
-          current++;
-					index++;
-        }
-    }
+void
+Topology::GetObstructedLossBatch(const Vector &tx, const std::vector<Vector> &receivers, double r, Engine engine,
+																 std::vector<double> &losses, TopologyQueryContext &context) const
+{
+	NS_LOG_FUNCTION (this << receivers.size ());
 
-  // cache results
-  if (m_obstructedDistanceMap.size() > 1000)
-    {
-      // clear it every once in a while, to avoid bloat.
-      m_obstructedDistanceMap.clear();
-    }
-  m_obstructedDistanceMap.insert(TStrDblPair(key, obstructedLoss));
+	losses.resize (receivers.size ());
+	bool sectors = PrepareBatch (tx, r, engine, context);
+	for (uint32_t k = 0; k < receivers.size (); k++)
+	{
+		const Vector &rx = receivers[k];
+		ObstructedLossKey key (tx.x, tx.y, tx.z, rx.x, rx.y, rx.z);
+		if (context.m_cache.Lookup (key, losses[k]))
+			continue;
+
+		losses[k] = sectors ? GetBatchLoss (tx, rx, r, engine, context, context)
+			: ComputeObstructedLoss (tx, rx, r, engine, context);
+		context.m_cache.Insert (key, losses[k]);
+	}
+}
 
-  return obstructedLoss;
+void
+Topology::GetObstructedLossBatch(const Vector &tx, const std::vector<Vector> &receivers, double r, Engine engine,
+																 std::vector<double> &losses, TopologyQueryContext &context,
+																 ObstacleWorkerPool &pool, std::vector<TopologyQueryContext> &contexts) const
+{
+	NS_LOG_FUNCTION (this << receivers.size () << pool.GetNThreads ());
+	NS_ASSERT (contexts.size () >= pool.GetNThreads ());
+
+	// chunks small enough to balance the threads, large enough
+	// that taking one costs little compared to its queries
+	const uint32_t minChunk = 8;
+	uint32_t chunk = std::max (minChunk, (uint32_t) (receivers.size () / (4 * pool.GetNThreads ()) + 1));
+
+	// the receivers not in the cache now are computed by the threads
+	std::vector<uint32_t> missing;
+	for (uint32_t k = 0; k < receivers.size (); k++)
+	{
+		const Vector &rx = receivers[k];
+		if (!context.m_cache.Contains (ObstructedLossKey (tx.x, tx.y, tx.z, rx.x, rx.y, rx.z)))
+			missing.push_back (k);
+	}
+
+	losses.resize (receivers.size ());
+	bool sectors = PrepareBatch (tx, r, engine, context);
+	uint32_t nChunks = (missing.size () + chunk - 1) / chunk;
+	std::vector<double> computed (receivers.size ());
+	pool.Run (nChunks, [&] (uint32_t task, uint32_t thread)
+	{
+		uint32_t end = std::min ((uint32_t) missing.size (), (task + 1) * chunk);
+		for (uint32_t i = task * chunk; i < end; i++)
+		{
+			uint32_t k = missing[i];
+			computed[k] = sectors ? GetBatchLoss (tx, receivers[k], r, engine, context, contexts[thread])
+				: ComputeObstructedLoss (tx, receivers[k], r, engine, contexts[thread]);
+		}
+	});
+
+	// then the cache is used as by the single thread batch, in the same
+	// order: the losses it returns (a loss of the reverse link, or of
+	// points within 0.1m) and the entries it keeps are the same
+	std::vector<uint32_t>::const_iterator next = missing.begin ();
+	for (uint32_t k = 0; k < receivers.size (); k++)
+	{
+		const Vector &rx = receivers[k];
+		bool wasMissing = (next != missing.end ()) && (*next == k);
+		if (wasMissing)
+			++next;
+
+		ObstructedLossKey key (tx.x, tx.y, tx.z, rx.x, rx.y, rx.z);
+		if (context.m_cache.Lookup (key, losses[k]))
+			continue;
+
+		// evicted since, or computed by a thread
+		losses[k] = !wasMissing ? (sectors ? GetBatchLoss (tx, rx, r, engine, context, context)
+															 : ComputeObstructedLoss (tx, rx, r, engine, context))
+			: computed[k];
+		context.m_cache.Insert (key, losses[k]);
+	}
+}
+
+bool
+Topology::PrepareBatch(const Vector &tx, double r, Engine engine, TopologyQueryContext &context) const
+{
+	// a transmitter closer than this to the bounding box of an obstacle
+	// tests it for every receiver: the angles would not be reliable
+	const double aroundMargin = 1.0;
+	// enlargement of the angular ranges, much larger than the tolerance
+	// of the degenerate tests seen from aroundMargin
+	const double anglePad = 1e-4;
+
+	// the raster walk has no broad phase to share, the obstacles
+	// of a tile store are found by tile, and those around a fixed
+	// point are already sorted by direction
+	if ((engine == ENGINE_RASTER) || m_tiles || FindFixedPoint (tx, tx, r))
+		return false;
+
+	double rSq = r * r;
+
+	// obstacles whose center is within r of the transmitter,
+	// the only ones that can be candidates of its links
+	FindObstaclesAround (tx.x, tx.y, r, context.m_outputList);
+
+	// angular range of each of them, seen from the transmitter
+	context.m_sectors.clear ();
+	context.m_around.clear ();
+	double maxWidth = 0.0;
+	for (uint32_t i = 0; i < context.m_outputList.size (); i++)
+	{
+		uint32_t index = context.m_outputList[i];
+		const Obstacle &obstacle = m_obstacles[index];
+		const Vector2D &center = obstacle.GetCenterVector ();
+		double dxc = center.x - tx.x;
+		double dyc = center.y - tx.y;
+		if (!((dxc * dxc + dyc * dyc - rSq) < 0))
+			continue;
+
+		const VertexList &vertices = obstacle.GetVertices ();
+		double xmin = std::numeric_limits<double>::max ();
+		double ymin = std::numeric_limits<double>::max ();
+		double xmax = -std::numeric_limits<double>::max ();
+		double ymax = -std::numeric_limits<double>::max ();
+		for (uint32_t v = 0; v < vertices.size (); v++)
+		{
+			xmin = std::min (xmin, vertices[v].x);
+			ymin = std::min (ymin, vertices[v].y);
+			xmax = std::max (xmax, vertices[v].x);
+			ymax = std::max (ymax, vertices[v].y);
+		}
+		if (tx.x > xmin - aroundMargin && tx.x < xmax + aroundMargin
+				&& tx.y > ymin - aroundMargin && tx.y < ymax + aroundMargin)
+		{
+			context.m_around.push_back (index);
+			continue;
+		}
+
+		// the footprint spans less than pi, measure the angles of its
+		// vertices from the direction of a point of its bounding box
+		double ref = std::atan2 (dyc, dxc);
+		double lo = 0.0;
+		double hi = 0.0;
+		for (uint32_t v = 0; v < vertices.size (); v++)
+		{
+			double a = std::atan2 (vertices[v].y - tx.y, vertices[v].x - tx.x) - ref;
+			if (a > M_PI)
+				a -= 2 * M_PI;
+			else if (a < -M_PI)
+				a += 2 * M_PI;
+			lo = std::min (lo, a);
+			hi = std::max (hi, a);
+		}
+
+		ObstacleSector sector;
+		sector.start = ref + lo - anglePad;
+		if (sector.start < -M_PI)
+			sector.start += 2 * M_PI;
+		sector.end = sector.start + (hi - lo) + 2 * anglePad;
+		sector.index = index;
+		context.m_sectors.push_back (sector);
+		// a range across the +x/-x direction is also added turned back
+		if (sector.end > M_PI)
+		{
+			sector.start -= 2 * M_PI;
+			sector.end -= 2 * M_PI;
+			context.m_sectors.push_back (sector);
+		}
+		maxWidth = std::max (maxWidth, sector.end - sector.start);
+	}
+	std::sort (context.m_sectors.begin (), context.m_sectors.end ());
+	context.m_maxSectorWidth = maxWidth;
+	return true;
+}
+
+double
+Topology::GetBatchLoss(const Vector &tx, const Vector &rx, double r, Engine engine,
+											 const TopologyQueryContext &batch, TopologyQueryContext &context) const
+{
+	double loss = 0.0;
+	double rSq = r * r;
+	double dx = rx.x - tx.x;
+	double dy = rx.y - tx.y;
+	if ((dx * dx + dy * dy) < 4.0 * rSq)
+	{
+		// obstacles whose range covers the direction of the receiver
+		// (none for a receiver above the transmitter: then only the
+		// obstacles around the transmitter can be crossed)
+		context.m_sectorHits.assign (batch.m_around.begin (), batch.m_around.end ());
+		if (dx != 0 || dy != 0)
+		{
+			double theta = std::atan2 (dy, dx);
+			ObstacleSector first;
+			first.start = theta - batch.m_maxSectorWidth;
+			std::vector<ObstacleSector>::const_iterator it =
+				std::lower_bound (batch.m_sectors.begin (), batch.m_sectors.end (), first);
+			for (; it != batch.m_sectors.end () && it->start <= theta; ++it)
+			{
+				if (it->end >= theta)
+					context.m_sectorHits.push_back (it->index);
+			}
+		}
+
+		// same candidates of GetObstructedLossBetween, by index as with the grid
+		std::sort (context.m_sectorHits.begin (), context.m_sectorHits.end ());
+		context.m_sectorHits.erase (std::unique (context.m_sectorHits.begin (), context.m_sectorHits.end ()),
+																context.m_sectorHits.end ());
+		context.m_candidates.clear ();
+		for (uint32_t i = 0; i < context.m_sectorHits.size (); i++)
+		{
+			AddCandidate (context.m_sectorHits[i], tx, rx, rSq, context);
+		}
+
+		int64_t obstacle;
+		loss = EvaluateCandidates (tx, rx, engine, context, obstacle);
+	}
+
+	return loss;
+}
+
+void
+Topology::FindObstaclesAround(double x, double y, double r, std::vector<uint32_t> &out) const
+{
+	out.clear ();
+	if (m_indexType == INDEX_GRID)
+	{
+		m_grid.QueryBox (x - r, y - r, x + r, y + r, out);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock (m_cgalMutex);
+		Interval win (Point (x - r, y - r), Point (x + r, y + r));
+		m_rangeTree.window_query (win, ObstacleIndexInserter (out));
+	}
+}
+
+void
+Topology::AddFixedPoint(const Vector &position, double r)
+{
+	NS_LOG_FUNCTION (this << position << r);
+	NS_ASSERT (r > 0);
+
+	if (m_tiles)
+		{
+			NS_LOG_WARN ("Fixed points are not available on a tile store, the point is not registered.");
+			return;
+		}
+
+	std::pair<double, double> key (position.x, position.y);
+	std::map<std::pair<double, double>, uint32_t>::const_iterator it = m_fixedPointIndex.find (key);
+	uint32_t index = (it != m_fixedPointIndex.end ()) ? it->second : m_fixedPoints.size ();
+	if ((index < m_fixedPoints.size ()) && (m_fixedPoints[index].GetRadius () == r))
+		{
+			// already registered, its sectors follow the obstacles
+			return;
+		}
+	if (index == m_fixedPoints.size ())
+		{
+			m_fixedPoints.push_back (ObstacleVisibility ());
+			m_fixedPointIndex[key] = index;
+		}
+
+	std::vector<uint32_t> nearby;
+	if (!m_obstacles.empty ())
+		{
+			FindObstaclesAround (position.x, position.y, r, nearby);
+		}
+	m_fixedPoints[index].Build (m_obstacles, nearby, position.x, position.y, r);
+}
+
+uint32_t
+Topology::GetNFixedPoints() const
+{
+	return m_fixedPoints.size ();
+}
+
+const ObstacleVisibility &
+Topology::GetFixedPoint(uint32_t index) const
+{
+	NS_ASSERT (index < m_fixedPoints.size ());
+
+	return m_fixedPoints[index];
+}
+
+void
+Topology::ClearFixedPoints()
+{
+	NS_LOG_FUNCTION (this);
+
+	m_fixedPoints.clear ();
+	m_fixedPointIndex.clear ();
+}
+
+void
+Topology::MakeFixedPoints()
+{
+	NS_LOG_FUNCTION (this << m_fixedPoints.size ());
+
+	std::vector<uint32_t> nearby;
+	for (uint32_t i = 0; i < m_fixedPoints.size (); i++)
+		{
+			ObstacleVisibility &visibility = m_fixedPoints[i];
+			FindObstaclesAround (visibility.GetX (), visibility.GetY (), visibility.GetRadius (), nearby);
+			visibility.Build (m_obstacles, nearby, visibility.GetX (), visibility.GetY (), visibility.GetRadius ());
+		}
+}
+
+const ObstacleVisibility *
+Topology::FindFixedPoint(const Vector &p1, const Vector &p2, double r) const
+{
+	if (m_fixedPoints.empty ())
+		return 0;
+
+	std::map<std::pair<double, double>, uint32_t>::const_iterator it =
+		m_fixedPointIndex.find (std::make_pair (p1.x, p1.y));
+	if (it == m_fixedPointIndex.end ())
+		it = m_fixedPointIndex.find (std::make_pair (p2.x, p2.y));
+	if (it == m_fixedPointIndex.end () || m_fixedPoints[it->second].GetRadius () != r)
+		return 0;
+
+	return &m_fixedPoints[it->second];
+}
+
+double
+Topology::GetFixedPointLoss(const ObstacleVisibility &visibility, const Vector &p1, const Vector &p2, double r,
+														Engine engine, TopologyQueryContext &context, int64_t &obstacle) const
+{
+	NS_LOG_FUNCTION (this);
+	NS_ASSERT (engine != ENGINE_RASTER);
+
+	// the obstacles that may lie between the fixed point and the other one
+	bool fromP1 = (p1.x == visibility.GetX ()) && (p1.y == visibility.GetY ());
+	const Vector &other = fromP1 ? p2 : p1;
+	context.m_sectorHits.clear ();
+	visibility.Lookup (other.x, other.y, context.m_sectorHits);
+
+	// none: the other point is in sight
+	context.m_candidates.clear ();
+	if (context.m_sectorHits.empty ())
+	{
+		obstacle = -1;
+		return 0.0;
+	}
+
+	// same candidates of GetObstructedLossBetween, by index as with the grid
+	// (those out of the sectors cross no wall and no roof)
+	std::sort (context.m_sectorHits.begin (), context.m_sectorHits.end ());
+	double rSq = r * r;
+	for (uint32_t i = 0; i < context.m_sectorHits.size (); i++)
+	{
+		AddCandidate (context.m_sectorHits[i], p1, p2, rSq, context);
+	}
+
+	return EvaluateCandidates (p1, p2, engine, context, obstacle);
+}
+
+void
+Topology::AddCandidate(uint32_t index, const Vector &p1, const Vector &p2, double rSq, TopologyQueryContext &context) const
+{
+	const Obstacle &obstacle = m_obstacles[index];
+	const Vector2D &center = obstacle.GetCenterVector();
+
+	double dx1 = center.x - p1.x;
+	double dy1 = center.y - p1.y;
+	double distCtoP1sq = dx1 * dx1 + dy1 * dy1;
+
+	double dx2 = center.x - p2.x;
+	double dy2 = center.y - p2.y;
+	double distCtoP2sq = dx2 * dx2 + dy2 * dy2;
+
+	if (((distCtoP1sq - rSq) < 0)
+			&& ((distCtoP2sq - rSq) < 0))
+	{
+		// obtstacle is within range
+
+		// if both points are over the top of the building, no loss
+		double minz = std::min(p1.z, p2.z);
+		if ((obstacle.GetHeight () > 0) && (minz >= obstacle.GetHeight ()))
+		{
+			noop;	// pass, do nothing
+		}
+		else
+		{
+			context.m_candidates.push_back (index);
+		}
+	}
+}
+
+double
+Topology::EvaluateCandidates(const Vector &p1, const Vector &p2, Engine engine, TopologyQueryContext &context,
+															int64_t &obstacle) const
+{
+	double obstructedLoss = 0.0;
+	obstacle = -1;
+
+	// evaluate all the candidates, in the order of the query
+	context.m_candidateDistance.assign (context.m_candidates.size (), 0.0);
+	context.m_candidateIntersections.assign (context.m_candidates.size (), 0);
+	if (engine == ENGINE_DOUBLE)
+	{
+		GetObstructedDistanceBatch (p1, p2, context);
+	}
+	else if (!context.m_candidates.empty ())
+	{
+		std::lock_guard<std::mutex> lock (m_cgalMutex);
+		Point_3 p1e (p1.x, p1.y, p1.z);
+		Point_3 p2e (p2.x, p2.y, p2.z);
+		for (uint32_t c = 0; c < context.m_candidates.size (); c++)
+		{
+			GetObstructedDistance (p1e, p2e, m_obstacles[context.m_candidates[c]], context.m_candidateDistance[c], context.m_candidateIntersections[c]);
+		}
+	}
+
+	for (uint32_t c = 0; c < context.m_candidates.size (); c++)
+	{
+		double obstructedDistanceBetween = context.m_candidateDistance[c];
+		int intersections = context.m_candidateIntersections[c];
+
+		// From C. Sommer et. al.:
+		// A Computationally Inexpensive Empirical Model of IEEE 802.11p
+		// Radio Shadowing in Urban Environments, 2011.
+		// Additional loss due to propagation through obstacles:
+		// Lobs = beta x n + gamma x d_m
+		// Where
+		// Lobs is the additional loss
+		// beta is a (constant) factor for the obstacle type
+		// n is the number of intersections through the obstacle
+		// gamma is a (constant) factor for the obstacle type
+		// d_m is the distance in meters of propagation through the obstacle
+		if ((obstructedDistanceBetween > 0.0) && (intersections > 1))
+		{
+			const Obstacle &candidate = m_obstacles[context.m_candidates[c]];
+			double beta = candidate.GetBeta();
+			double gamma = candidate.GetGamma();
+			obstructedLoss = beta * (double) intersections + gamma * obstructedDistanceBetween;
+			obstacle = context.m_candidates[c];
+		}
+	}
+
+	return obstructedLoss;
 }
 
 double
@@ -573,6 +2463,100 @@ Topology::GetMaxY()
   return m_maxY;
 }
 
+void
+Topology::SetCacheCapacity(uint32_t capacity)
+{
+	NS_LOG_FUNCTION (this << capacity);
+
+	m_context.m_cache.SetCapacity (capacity);
+}
+
+uint32_t
+Topology::GetCacheCapacity()
+{
+	NS_LOG_FUNCTION (this);
+
+	return m_context.m_cache.GetCapacity ();
+}
+
+uint64_t
+Topology::GetCacheHits()
+{
+	NS_LOG_FUNCTION (this);
+
+	return m_context.m_cache.GetHits ();
+}
+
+uint64_t
+Topology::GetCacheMisses()
+{
+	NS_LOG_FUNCTION (this);
+
+	return m_context.m_cache.GetMisses ();
+}
+
+void
+Topology::PrintCacheStatistics(std::ostream &os)
+{
+	NS_LOG_FUNCTION (this);
+
+	m_context.PrintCacheStatistics (os);
+}
+
+uint32_t
+Topology::GetNObstacles()
+{
+	NS_LOG_FUNCTION (this);
+
+	return m_obstacles.size ();
+}
+
+Obstacle &
+Topology::GetObstacle(uint32_t index)
+{
+	NS_LOG_FUNCTION (this << index);
+
+	return m_obstacles[index];
+}
+
+uint64_t
+Topology::GetContentHash() const
+{
+	NS_LOG_FUNCTION (this);
+
+	// the hash of the region the tiles were split from
+	if (m_tiles)
+		{
+			return m_tiles->GetContentHash ();
+		}
+
+	uint64_t n = m_obstacles.size ();
+	uint64_t hash = HashBytes (&n, sizeof (n));
+	for (uint32_t i = 0; i < m_obstacles.size (); i++)
+		{
+			const Obstacle &obstacle = m_obstacles[i];
+			const VertexList &vertices = obstacle.GetVertices ();
+			uint64_t nVertices = vertices.size ();
+			hash = HashBytes (&nVertices, sizeof (nVertices), hash);
+			for (uint32_t v = 0; v < vertices.size (); v++)
+				{
+					hash = HashBytes (&vertices[v].x, sizeof (double), hash);
+					hash = HashBytes (&vertices[v].y, sizeof (double), hash);
+				}
+			double parameters[3] = { obstacle.GetHeight (), obstacle.GetBeta (), obstacle.GetGamma () };
+			hash = HashBytes (parameters, sizeof (parameters), hash);
+		}
+	return hash;
+}
+
+uint64_t
+Topology::GetSourceHash() const
+{
+	NS_LOG_FUNCTION (this);
+
+	return m_sourceHash;
+}
+
 bool
 Topology::HasObstacles()
 {
@@ -580,7 +2564,7 @@ Topology::HasObstacles()
 
   bool HasObstacles = false;
 
-  if (m_obstacles.size() > 0)
+  if ((m_obstacles.size() > 0) || m_tiles)
     {
       HasObstacles = true;
     }
@@ -589,7 +2573,7 @@ Topology::HasObstacles()
 }
 
 bool
-Topology::PointIsInPolygon(const Polygon_2 &polygon, const Point_3 *ipoint)
+Topology::PointIsInPolygon(const Polygon_2 &polygon, const Point_3 *ipoint) const
 {
 	NS_LOG_FUNCTION (this);
 
@@ -611,7 +2595,7 @@ Topology::PointIsInPolygon(const Polygon_2 &polygon, const Point_3 *ipoint)
 }
 
 bool
-Topology::IsInRegion(const Point &s1, const Point &s2, double h, const Point_3 &ip)
+Topology::IsInRegion(const Point &s1, const Point &s2, double h, const Point_3 &ip) const
 {
 	NS_LOG_FUNCTION (this);
 
@@ -22,17 +22,132 @@
 #ifndef TOPOLOGY_H
 #define TOPOLOGY_H
 
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
 #include "obstacle.h"
+#include "wall-intersection-kernel.h"
+#include "obstructed-loss-cache.h"
+#include "obstacle-grid-index.h"
+#include "obstacle-height-raster.h"
+#include "polygon-simplification.h"
+#include "obstacle-type-rules.h"
+#include "obstacle-visibility.h"
+#include "obstacle-worker-pool.h"
 
 namespace ns3 {
 
+class ObstacleTileStore;
+
 // CGAL types
-typedef CGAL::Range_tree_map_traits_2<K, Obstacle> Traits;
+// the range tree stores only the index of each obstacle
+typedef CGAL::Range_tree_map_traits_2<K, uint32_t> Traits;
 typedef CGAL::Range_tree_2<Traits> Range_tree_2_type;
 typedef Traits::Key Key;
 typedef Traits::Interval Interval;
-typedef std::map<std::string, double> TStrDblMap;
-typedef std::pair<std::string, double> TStrDblPair;
+
+/**
+ * \ingroup obstacle
+ * \brief Output iterator for range tree queries: it appends
+ * the index of each obstacle found, so that no key is copied
+ */
+class ObstacleIndexInserter
+{
+public:
+	typedef std::output_iterator_tag iterator_category;
+	typedef void value_type;
+	typedef void difference_type;
+	typedef void pointer;
+	typedef void reference;
+
+	explicit ObstacleIndexInserter (std::vector<uint32_t> &out) : m_out (&out) {}
+	ObstacleIndexInserter &operator= (const Key &key) { m_out->push_back (key.second); return *this; }
+	ObstacleIndexInserter &operator* () { return *this; }
+	ObstacleIndexInserter &operator++ () { return *this; }
+	ObstacleIndexInserter operator++ (int) { return *this; }
+
+private:
+	std::vector<uint32_t> *m_out;
+};
+
+/**
+ * \ingroup obstacle
+ * \brief The angular range, seen from a transmitter, covered by the
+ * footprint of an obstacle (angles in radians, start <= end)
+ */
+struct ObstacleSector
+{
+	double start;
+	double end;
+	uint32_t index;
+
+	bool operator< (const ObstacleSector &other) const { return start < other.start; }
+};
+
+/**
+ * \ingroup obstacle
+ * \brief Scratch space and cache of the obstacle queries of one caller.
+ *
+ * Given a context, Topology::GetObstructedLossBetween does not modify
+ * the topology: the obstacles and their index can be shared, while each
+ * thread (or each propagation loss model) owns its context.
+ */
+class TopologyQueryContext
+{
+public:
+	/**
+	 * \brief Constructor
+	 * \param cacheCapacity maximum number of entries of the
+	 * obstructed loss cache (0 disables the cache)
+	 */
+	TopologyQueryContext (uint32_t cacheCapacity = 65536);
+
+	/**
+	 * \brief Get the obstructed loss cache of this context
+	 * \return the cache
+	 */
+	ObstructedLossCache &GetCache ();
+
+	/**
+	 * \brief Print size, hits, misses and evictions of the obstructed loss cache
+	 * \param os the output stream
+	 * \return none
+	 */
+	void PrintCacheStatistics (std::ostream &os);
+
+private:
+	friend class Topology;
+
+	// indices of the obstacles found by the index
+	std::vector<uint32_t> m_outputList;
+
+	// obstacles within range of the current query
+	std::vector<uint32_t> m_candidates;
+
+	// obstructed distance and intersections of each candidate
+	std::vector<double> m_candidateDistance;
+	std::vector<int> m_candidateIntersections;
+
+	// batch queries: angular ranges of the obstacles around the
+	// transmitter (sorted by start), obstacles around the transmitter
+	// itself, and the obstacles found in the direction of a receiver
+	std::vector<ObstacleSector> m_sectors;
+	std::vector<uint32_t> m_around;
+	std::vector<uint32_t> m_sectorHits;
+	double m_maxSectorWidth;
+
+	// crossings of the segment of a raster query
+	std::vector<RasterCrossing> m_rasterCrossings;
+
+	// walls of the candidates, with the outcome of the kernel
+	WallSoup m_walls;
+	std::vector<double> m_wallDistSq;
+	std::vector<uint8_t> m_wallHit;
+
+	// a cache of obstructed losses between two points, see Topology
+	ObstructedLossCache m_cache;
+};
 
 /**
  * \ingroup obstacle
@@ -42,12 +157,37 @@ typedef std::pair<std::string, double> TStrDblPair;
 class Topology
 {
 public:
+	/**
+	 * \brief Geometry engine used to evaluate the obstructed distance
+	 */
+	enum Engine
+	{
+		ENGINE_EXACT,		// CGAL exact constructions kernel
+		ENGINE_DOUBLE,	// plain doubles, exact kernel only for degenerate cases
+		ENGINE_RASTER		// approximate, walk of a 2.5D raster of the obstacles (see MakeRaster)
+	};
+
+	/**
+	 * \brief Spatial index used to find the obstacles near a segment
+	 */
+	enum IndexType
+	{
+		INDEX_RANGE_TREE,	// CGAL range tree on obstacle centers, window around the segment
+		INDEX_GRID,				// uniform grid on obstacle footprints, walked along the segment
+		INDEX_NONE				// no index built yet
+	};
+
   /**
    * \brief Constructor
    * \return none
    */
   Topology ();
 
+	/**
+	 * \brief Destructor, unmaps the compiled buildings file, if any
+	 */
+	~Topology ();
+
   /**
    * \brief Run
    * \return none
@@ -75,6 +215,149 @@ public:
    */
   static void LoadBuildings(std::string bldgFilename);
 
+	/**
+	 * \brief Load buildings into this topology (LoadBuildings loads them
+	 * into the topology instance), then build the index. The file is
+	 * either a poly XML file or a compiled buildings file, see CompileBuildings.
+	 * A file already loaded is not loaded again, so that the runs of a
+	 * simulation can call it each time
+	 * \param bldgFilename the filename that contains buildings data
+	 * \return none
+	 */
+	void Load(std::string bldgFilename);
+
+	/**
+	 * \brief Set the number of threads that parse a poly XML file.
+	 * The file is split in chunks at poly boundaries and the chunks are
+	 * parsed in parallel, the obstacles are the same and in the same order
+	 * of a sequential parse
+	 * \param nThreads number of threads (0, the default, for one per core)
+	 * \return none
+	 */
+	void SetLoadThreads(uint32_t nThreads);
+
+	/**
+	 * \brief Set the rules applied to the polygons of the poly XML files
+	 * loaded from now on: which types are obstacles, and with which
+	 * attenuation and default height
+	 * \param rules the rules
+	 * \return none
+	 */
+	void SetTypeRules(const ObstacleTypeRules &rules);
+
+	/**
+	 * \brief Get the rules applied to the polygons of poly XML files
+	 * \return the rules
+	 */
+	const ObstacleTypeRules &GetTypeRules() const;
+
+	/**
+	 * \brief Merge polygons into the overlapping obstacles (see
+	 * ObstacleTypeRules::MERGE); the polygons that overlap no obstacle
+	 * are added as obstacles
+	 * \param first index of the first obstacle polygons can be merged into
+	 * \param parts the polygons
+	 * \return none
+	 */
+	void MergeObstacles(uint32_t first, std::vector<Obstacle> &parts);
+
+	/**
+	 * \brief Simplify the obstacles of the poly XML files loaded from now
+	 * on, see SimplifyObstacles. Compiled files are loaded as they were
+	 * compiled (see CompileBuildings)
+	 * \param tolerance tolerance in meters (0, the default, to keep the
+	 * obstacles as they are)
+	 * \param nSamples number of random segments of the error report
+	 * \return none
+	 */
+	void SetSimplifyTolerance(double tolerance, uint32_t nSamples = 10000);
+
+	/**
+	 * \brief Simplify the footprint of every obstacle (see SimplifyFootprint)
+	 * and build the index. The obstructed loss of random segments is
+	 * evaluated with and without the simplification, see GetSimplificationReport
+	 * \param tolerance tolerance in meters
+	 * \param nSamples number of random segments of the error report
+	 * \return none
+	 */
+	void SimplifyObstacles(double tolerance, uint32_t nSamples);
+
+	/**
+	 * \brief Get the report of the last simplification of the obstacles
+	 * \return the report
+	 */
+	const SimplificationReport &GetSimplificationReport() const;
+
+	/**
+	 * \brief Get the memory used by the obstacles, and an estimate of the
+	 * memory they would use with a string id, an exact polygon and an
+	 * exact center each
+	 * \return the report
+	 */
+	ObstacleMemoryReport GetMemoryReport() const;
+
+	/**
+	 * \brief Compile a poly XML file into a binary file that Load maps in
+	 * memory instead of parsing it: flattened vertices, height and attenuation
+	 * parameters, bounding box and id of each obstacle, and the grid index
+	 * \param bldgFilename the poly XML file
+	 * \param compiledFilename the binary file to write
+	 * \param gridCellSize side of the cells of the grid index, in meters
+	 * \param simplifyTolerance tolerance of the simplification of the
+	 * obstacles, in meters (0 to keep them as they are), see SetSimplifyTolerance
+	 * \return true on success
+	 */
+	static bool CompileBuildings(std::string bldgFilename, std::string compiledFilename, double gridCellSize = 50.0, double simplifyTolerance = 0.0);
+
+	/**
+	 * \brief Save the obstacles of this topology to a compiled buildings
+	 * file (the grid index is built, if needed). The file is written under
+	 * a temporary name and then renamed
+	 * \param compiledFilename the binary file to write
+	 * \return true on success
+	 */
+	bool SaveCompiled(std::string compiledFilename);
+
+	/**
+	 * \brief Check if a file is a compiled buildings file
+	 * \param filename the name of the file
+	 * \return true if the file starts with the compiled buildings magic
+	 */
+	static bool IsCompiled(std::string filename);
+
+	/**
+	 * \brief Split the obstacles of a poly XML file (or of a compiled
+	 * buildings file) in square tiles, and write them as a tile store
+	 * that Load opens instead of loading the whole region, see
+	 * ObstacleTileStore. Each tile is a compiled buildings file
+	 * \param bldgFilename the buildings file
+	 * \param directory the directory of the store (created if needed)
+	 * \param tileSize side of a tile, in meters
+	 * \param gridCellSize side of the cells of the grid index of the tiles, in meters
+	 * \param simplifyTolerance tolerance of the simplification of the
+	 * obstacles, in meters (0 to keep them as they are), see SetSimplifyTolerance
+	 * \return true on success
+	 */
+	static bool CompileTiles(std::string bldgFilename, std::string directory, double tileSize = 500.0,
+													 double gridCellSize = 50.0, double simplifyTolerance = 0.0);
+
+	/**
+	 * \brief Set the bytes the tiles loaded from a tile store should not
+	 * exceed: the least recently used tiles are dropped, and loaded again
+	 * when needed (default 512 MB)
+	 * \param bytes the memory budget
+	 * \return none
+	 */
+	void SetTileMemoryBudget(uint64_t bytes);
+
+	/**
+	 * \brief Get the tile store the obstacles are loaded from, if any: Load
+	 * opens it when given its index file, then the obstacles are not in the
+	 * topology (GetNObstacles is 0), the queries load the tiles they need
+	 * \return the tile store, or 0
+	 */
+	const ObstacleTileStore *GetTileStore() const;
+
   /**
    * \brief Gets the minimum X value of buildings in the topology
    * \return minimum X value of buildings in the topology
@@ -104,9 +387,185 @@ public:
    * \param p1 point1
    * \param p2 point2
    * \param r limiting radius for obstacles between p1 and p2
+   * \param engine the geometry engine used for the intersection tests
    * \return tbd
    */
-  double GetObstructedLossBetween(const Point_3 &p1, const Point_3 &p2, double r);
+  double GetObstructedLossBetween(const Point_3 &p1, const Point_3 &p2, double r, Engine engine = ENGINE_EXACT);
+
+	/**
+	 * \brief Gets the obstructed propagation loss between two points,
+	 * using the scratch space and the cache of a caller-owned context.
+	 * The topology is not modified, so concurrent calls with distinct
+	 * contexts are safe, but not all concurrent: CGAL objects are not
+	 * thread safe, so the range tree and the exact kernel (also the
+	 * fallback for degenerate cases) are serialized (see IsLockFree)
+	 * \param p1 point1
+	 * \param p2 point2
+	 * \param r limiting radius for obstacles between p1 and p2
+	 * \param engine the geometry engine used for the intersection tests
+	 * \param context the scratch space and cache of the caller
+	 * \return the obstructed loss in dB
+	 */
+	double GetObstructedLossBetween(const Vector &p1, const Vector &p2, double r, Engine engine, TopologyQueryContext &context) const;
+
+	/**
+	 * \brief Gets the obstructed propagation loss between two points, as
+	 * GetObstructedLossBetween but without the cache and the test on the
+	 * distance of the points, and the obstacle the loss is due to (the
+	 * last obstructing one). Not for the raster engine
+	 * \param p1 point1
+	 * \param p2 point2
+	 * \param r limiting radius for obstacles between p1 and p2
+	 * \param engine the geometry engine used for the intersection tests
+	 * \param context the scratch space of the caller
+	 * \param obstacle set to the index of the obstacle, -1 if there is no loss
+	 * \return the obstructed loss in dB
+	 */
+	double GetObstructedLossAndObstacle(const Vector &p1, const Vector &p2, double r, Engine engine,
+																			TopologyQueryContext &context, int64_t &obstacle) const;
+
+	/**
+	 * \brief Gets the obstructed propagation loss between a transmitter
+	 * and many receivers. The obstacles around the transmitter are
+	 * searched once and sorted by the angle they cover as seen from it;
+	 * each receiver is then evaluated only against the obstacles in its
+	 * direction. The losses are those of GetObstructedLossBetween (tx,
+	 * receivers[i], ...) with the grid index, and are cached in the same
+	 * way; the candidates are taken by index, so with the range tree the
+	 * loss of a link obstructed by several obstacles may differ (see
+	 * SetIndexType)
+	 * \param tx position of the transmitter
+	 * \param receivers positions of the receivers
+	 * \param r limiting radius for obstacles between tx and a receiver
+	 * \param engine the geometry engine used for the intersection tests
+	 * \param losses set to the obstructed loss of each receiver, in dB
+	 * \param context the scratch space and cache of the caller
+	 * \return none
+	 */
+	void GetObstructedLossBatch(const Vector &tx, const std::vector<Vector> &receivers, double r, Engine engine,
+															std::vector<double> &losses, TopologyQueryContext &context) const;
+
+	/**
+	 * \brief Gets the obstructed propagation loss between a transmitter
+	 * and many receivers, as the other GetObstructedLossBatch, with the
+	 * receivers split among the threads of a pool. The obstacles around
+	 * the transmitter are sorted once by the caller; the threads evaluate
+	 * the receivers missing from the cache of the caller, each with its
+	 * own scratch space, and the cache is then used in the receiver order,
+	 * so the losses are the same, bit for bit
+	 * \param tx position of the transmitter
+	 * \param receivers positions of the receivers
+	 * \param r limiting radius for obstacles between tx and a receiver
+	 * \param engine the geometry engine used for the intersection tests
+	 * \param losses set to the obstructed loss of each receiver, in dB
+	 * \param context the scratch space of the caller
+	 * \param pool the threads
+	 * \param contexts the scratch space of each thread of the pool (their
+	 * caches are not used)
+	 * \return none
+	 */
+	void GetObstructedLossBatch(const Vector &tx, const std::vector<Vector> &receivers, double r, Engine engine,
+															std::vector<double> &losses, TopologyQueryContext &context,
+															ObstacleWorkerPool &pool, std::vector<TopologyQueryContext> &contexts) const;
+
+	/**
+	 * \brief Register a point that never moves (e.g. a fixed sensor). The
+	 * obstacles around it are sorted by the directions they cover and by how
+	 * far they begin in each direction (see ObstacleVisibility), so that a
+	 * query between the point and any other tests only the obstacles that
+	 * may lie between them. GetObstructedLossBetween uses it whenever an
+	 * endpoint has the x and y of the point and the limiting radius is r
+	 * (not with the raster engine); the losses are those of the grid index
+	 * (see SetIndexType). The sectors
+	 * are rebuilt when the obstacles change, so registering the point
+	 * again with the same radius does nothing. Not available on a tile store,
+	 * and not to be called while other threads query the topology
+	 * \param position the position of the point
+	 * \param r limiting radius for obstacles, as given to the queries
+	 * \return none
+	 */
+	void AddFixedPoint(const Vector &position, double r);
+
+	/**
+	 * \brief Get the number of points registered with AddFixedPoint
+	 * \return the number of fixed points
+	 */
+	uint32_t GetNFixedPoints() const;
+
+	/**
+	 * \brief Get the sectors around a point registered with AddFixedPoint
+	 * \param index index of the point, less than GetNFixedPoints ()
+	 * \return the sectors
+	 */
+	const ObstacleVisibility &GetFixedPoint(uint32_t index) const;
+
+	/**
+	 * \brief Forget the points registered with AddFixedPoint
+	 * \return none
+	 */
+	void ClearFixedPoints();
+
+	/**
+	 * \brief Set the maximum number of entries of the obstructed loss cache
+	 * (0 disables the cache)
+	 * \param capacity the number of entries
+	 * \return none
+	 */
+	void SetCacheCapacity(uint32_t capacity);
+
+	/**
+	 * \brief Get the maximum number of entries of the obstructed loss cache
+	 * \return the number of entries
+	 */
+	uint32_t GetCacheCapacity();
+
+	/**
+	 * \brief Get the number of obstructed loss values found in the cache
+	 * \return the number of hits
+	 */
+	uint64_t GetCacheHits();
+
+	/**
+	 * \brief Get the number of obstructed loss values not found in the cache
+	 * \return the number of misses
+	 */
+	uint64_t GetCacheMisses();
+
+	/**
+	 * \brief Print size, hits, misses and evictions of the obstructed loss cache
+	 * \param os the output stream
+	 * \return none
+	 */
+	void PrintCacheStatistics(std::ostream &os);
+
+	/**
+	 * \brief Gets the number of obstacles in the topology
+	 * \return the number of obstacles
+	 */
+	uint32_t GetNObstacles();
+
+	/**
+	 * \brief Gets an obstacle of the topology
+	 * \param index index of the obstacle, less than GetNObstacles ()
+	 * \return the obstacle
+	 */
+	Obstacle &GetObstacle(uint32_t index);
+
+	/**
+	 * \brief Gets a hash of the obstacles (vertices, height and attenuation
+	 * parameters), to identify data precomputed on this topology
+	 * \return the hash
+	 */
+	uint64_t GetContentHash() const;
+
+	/**
+	 * \brief Gets a hash of the inputs of the obstacles: the bytes of the
+	 * files loaded, with the type rules and the simplification applied to
+	 * the poly XML files. Unlike GetContentHash it does not depend on the
+	 * obstacles in memory, and is computed while loading
+	 * \return the hash (0 if nothing has been loaded)
+	 */
+	uint64_t GetSourceHash() const;
 
   /**
    * \brief Tests if the topology has any obstacles (loaded within it)
@@ -121,6 +580,87 @@ public:
    */
   void MakeRangeTree();
 
+	/**
+	 * \brief Make a uniform grid of obstacles, for searching.
+	 * Called after all obstacle have been loaded into the topology
+	 * \return none
+	 */
+	void MakeGrid();
+
+	/**
+	 * \brief Make the index of the selected type (see SetIndexType).
+	 * Called after all obstacle have been loaded into the topology
+	 * \return none
+	 */
+	void MakeIndex();
+
+	/**
+	 * \brief Select the spatial index used by the queries. If obstacles
+	 * are already loaded, the index is built. The loss of a link is that
+	 * of the last obstacle found to obstruct it: the grid finds them by
+	 * index, the range tree in the order of its query, so the loss of a
+	 * link obstructed by several obstacles may differ between the two
+	 * \param type INDEX_RANGE_TREE (default) or INDEX_GRID
+	 * \return none
+	 */
+	void SetIndexType(IndexType type);
+
+	/**
+	 * \brief Get the spatial index used by the queries
+	 * \return the type of index
+	 */
+	IndexType GetIndexType();
+
+	/**
+	 * \brief Tell whether the queries of an engine run concurrently. The
+	 * CGAL objects of the obstacles and of the range tree are shared and
+	 * not thread safe, so the queries that use them take one lock: the
+	 * exact engine, and the range tree with any engine but the raster.
+	 * With the grid index and the double engine (the exact kernel only
+	 * for the rare degenerate cases), or with the raster engine, the
+	 * threads do not wait for each other
+	 * \param engine the geometry engine of the queries
+	 * \return true if concurrent queries do not take the lock
+	 */
+	bool IsLockFree(Engine engine) const;
+
+	/**
+	 * \brief Set the side of the cells of the uniform grid index
+	 * \param size side of a cell in meters (default 50)
+	 * \return none
+	 */
+	void SetGridCellSize(double size);
+
+	/**
+	 * \brief Rasterize the obstacles, for the raster engine (ENGINE_RASTER).
+	 * The raster is rebuilt when the obstacles change
+	 * \param resolution side of a cell of the raster in meters
+	 * \return none
+	 */
+	void MakeRaster(double resolution);
+
+	/**
+	 * \brief Check if the obstacles have been rasterized
+	 * \return true if the raster engine can be used
+	 */
+	bool HasRaster() const;
+
+	/**
+	 * \brief Get the side of a cell of the raster
+	 * \return the side of a cell in meters (0 if there is no raster)
+	 */
+	double GetRasterResolution() const;
+
+	/**
+	 * \brief Compare the raster engine with a reference engine on random
+	 * segments, as SimplifyObstacles does (the raster must have been built)
+	 * \param nSamples number of random segments
+	 * \param r limiting radius for obstacles
+	 * \param reference the engine to compare with
+	 * \return the deviation and the time of the two engines
+	 */
+	RasterValidationReport ValidateRaster(uint32_t nSamples, double r, Engine reference = ENGINE_EXACT) const;
+
   /**
    * \brief Get the topology instance (create if necessary)
    * \return the topology instance
@@ -156,7 +696,153 @@ public:
    * a line between p1 and p2
    * \return tbd
    */
-  void GetObstructedDistance(const Point_3 &p1b, const Point_3 &p2b, Obstacle &obs, double &obstructedDistanceBetween, int &intersections);
+  void GetObstructedDistance(const Point_3 &p1b, const Point_3 &p2b, const Obstacle &obs, double &obstructedDistanceBetween, int &intersections) const;
+
+	/**
+	 * \brief Get the obstructed distance between two points, using
+	 * double precision arithmetic only. Same semantic of GetObstructedDistance
+	 * \param p1 point1
+	 * \param p2 point2
+	 * \param obs obstacle that may lie between p1 and p2
+	 * \param obstructedDistanceBetween the total length within obs
+	 * traversed by a line between p1 and p2
+	 * \param intersections the number of intersections of the obstacle for
+	 * a line between p1 and p2
+	 * \return false if the configuration is degenerate (e.g. an endpoint lies
+	 * on a wall) and the exact engine must be used instead, true otherwise
+	 */
+	bool GetObstructedDistanceDouble(const Vector &p1, const Vector &p2, const Obstacle &obs, double &obstructedDistanceBetween, int &intersections) const;
+
+	/**
+	 * \brief Intersect the segment between two points with the roof of
+	 * an obstacle, in double precision
+	 * \param p1 point1
+	 * \param p2 point2
+	 * \param obs the obstacle
+	 * \param distSq squared distance from p1 to the intersection (set only on WALL_HIT)
+	 * \return the outcome of the test
+	 */
+	WallHit IntersectRoofDouble(const Vector &p1, const Vector &p2, const Obstacle &obs, double &distSq) const;
+
+	/**
+	 * \brief Get the obstructed distance between two points for all the
+	 * candidates of a context at once: their walls are packed and tested
+	 * with the vectorized kernel. Results are stored in the
+	 * m_candidateDistance and m_candidateIntersections of the context
+	 * \param p1 point1
+	 * \param p2 point2
+	 * \param context the context of the query
+	 * \return none
+	 */
+	void GetObstructedDistanceBatch(const Vector &p1, const Vector &p2, TopologyQueryContext &context) const;
+
+	/**
+	 * \brief Add an obstacle found by the index to the candidates of a
+	 * query, if its center is within r of both points and it is not
+	 * below both of them
+	 * \param index the index of the obstacle
+	 * \param p1 point1
+	 * \param p2 point2
+	 * \param rSq square of the limiting radius
+	 * \param context the context of the query
+	 * \return none
+	 */
+	void AddCandidate(uint32_t index, const Vector &p1, const Vector &p2, double rSq, TopologyQueryContext &context) const;
+
+	/**
+	 * \brief Find the obstacles that may have their center within a square
+	 * (from the index: obstacles out of it may be returned as well)
+	 * \param x x coordinate of the center of the square
+	 * \param y y coordinate of the center of the square
+	 * \param r half the side of the square
+	 * \param out the indices of the obstacles, replaced
+	 * \return none
+	 */
+	void FindObstaclesAround(double x, double y, double r, std::vector<uint32_t> &out) const;
+
+	/**
+	 * \brief Sort the obstacles around the transmitter of a batch query by
+	 * the angular range they cover, see GetObstructedLossBatch
+	 * \param tx position of the transmitter
+	 * \param r limiting radius for obstacles
+	 * \param engine the geometry engine
+	 * \param context the context of the batch, receives the ranges
+	 * \return false if the receivers are to be evaluated one by one instead
+	 */
+	bool PrepareBatch(const Vector &tx, double r, Engine engine, TopologyQueryContext &context) const;
+
+	/**
+	 * \brief Gets the obstructed propagation loss between two points, as
+	 * GetObstructedLossBetween but without the cache
+	 * \param p1 point1
+	 * \param p2 point2
+	 * \param r limiting radius for obstacles between p1 and p2
+	 * \param engine the geometry engine used for the intersection tests
+	 * \param context the scratch space of the caller
+	 * \return the obstructed loss in dB
+	 */
+	double ComputeObstructedLoss(const Vector &p1, const Vector &p2, double r, Engine engine,
+															 TopologyQueryContext &context) const;
+
+	/**
+	 * \brief Gets the obstructed propagation loss between the transmitter
+	 * of a batch query and one receiver, from the obstacles in its
+	 * direction (no cache)
+	 * \param tx position of the transmitter
+	 * \param rx position of the receiver
+	 * \param r limiting radius for obstacles
+	 * \param engine the geometry engine
+	 * \param batch the context the batch was prepared in, see PrepareBatch
+	 * \param context the scratch space of the query (may be batch)
+	 * \return the obstructed loss in dB
+	 */
+	double GetBatchLoss(const Vector &tx, const Vector &rx, double r, Engine engine,
+											const TopologyQueryContext &batch, TopologyQueryContext &context) const;
+
+	/**
+	 * \brief Find the fixed point at an endpoint of a query, see AddFixedPoint
+	 * \param p1 point1
+	 * \param p2 point2
+	 * \param r limiting radius for obstacles
+	 * \return the sectors of the fixed point, or 0 if neither point is one
+	 */
+	const ObstacleVisibility *FindFixedPoint(const Vector &p1, const Vector &p2, double r) const;
+
+	/**
+	 * \brief Gets the obstructed propagation loss between two points, one
+	 * of which is a fixed point: as GetObstructedLossAndObstacle, with the
+	 * candidates found in its sectors
+	 * \param visibility the sectors of the fixed point
+	 * \param p1 point1
+	 * \param p2 point2
+	 * \param r limiting radius for obstacles
+	 * \param engine the geometry engine
+	 * \param context the scratch space of the caller
+	 * \param obstacle set to the index of the obstacle, -1 if there is no loss
+	 * \return the obstructed loss in dB
+	 */
+	double GetFixedPointLoss(const ObstacleVisibility &visibility, const Vector &p1, const Vector &p2, double r,
+													 Engine engine, TopologyQueryContext &context, int64_t &obstacle) const;
+
+	/**
+	 * \brief Build the sectors of the fixed points again, for the obstacles
+	 * as they are now
+	 * \return none
+	 */
+	void MakeFixedPoints();
+
+	/**
+	 * \brief Evaluate the candidates of a query, in their order, with
+	 * the given engine
+	 * \param p1 point1
+	 * \param p2 point2
+	 * \param engine the geometry engine
+	 * \param context the context of the query
+	 * \param obstacle set to the index of the last obstructing candidate, -1 if none
+	 * \return the obstructed loss of the last obstructing candidate, in dB
+	 */
+	double EvaluateCandidates(const Vector &p1, const Vector &p2, Engine engine, TopologyQueryContext &context,
+														int64_t &obstacle) const;
 
 	/**
 	 * \brief Check if a point is inside a special region
@@ -166,7 +852,7 @@ public:
 	 * \param p point to test
 	 * \return bool true if the point is inside the region
 	 */
-	bool IsInRegion(const Point &s1, const Point &s2, double h, const Point_3 &ip);
+	bool IsInRegion(const Point &s1, const Point &s2, double h, const Point_3 &ip) const;
 
 	/**
 	 * \brief Check if a point is inside a polygon
@@ -176,16 +862,38 @@ public:
 	 * \param ipoint, the point to be checked
 	 * \return bool true if the point is inside the polygon
 	 */
-	bool PointIsInPolygon(const Polygon_2 &polygon, const Point_3 *ipoint);
+	bool PointIsInPolygon(const Polygon_2 &polygon, const Point_3 *ipoint) const;
+
+	/**
+	 * \brief Load the obstacles of a compiled buildings file: the file is
+	 * mapped, and the grid index is used in place when it matches the
+	 * index selected, otherwise the index is built
+	 * \param compiledFilename the binary file
+	 * \return false if the file cannot be read or is not valid
+	 */
+	bool LoadCompiled(std::string compiledFilename);
+
+	/**
+	 * \brief Move the vertices of the obstacles to one array shared by all
+	 * of them (the vertices used in place in a mapped compiled file stay there)
+	 * \return none
+	 */
+	void CompactObstacles();
 
-  // list of obstacles in the topology
-  std::vector<Key> m_obstacles;
+  // list of obstacles in the topology, contiguous
+	// (the range tree and the queries refer to them by index)
+  std::vector<Obstacle> m_obstacles;
 
-  // output list, used for sorting
-  std::vector<Key> m_outputList;
+	// vertices of the obstacles, one after the other (see CompactObstacles)
+	std::vector<Vector2D> m_vertexPool;
 
   // BSP, for searching for obstacles
-  Range_tree_2_type m_rangeTree;
+	// (mutable: window_query is not declared const, but does not modify the tree)
+  mutable Range_tree_2_type m_rangeTree;
+
+	// serializes the queries that use CGAL objects shared among threads
+	// (range tree and exact kernel, see IsLockFree)
+	mutable std::mutex m_cgalMutex;
 
   // minimum x value of obstacles in the topology
   double m_minX;
@@ -199,6 +907,48 @@ public:
   // maximum y value of obstacles in the topology
   double m_maxY;
 
+	// uniform grid, alternative to the range tree
+	ObstacleGridIndex m_grid;
+
+	// index used by the queries, and last index built
+	IndexType m_indexType;
+	IndexType m_indexBuilt;
+
+	// side of a cell of m_grid, in meters
+	double m_gridCellSize;
+
+	// 2.5D raster of the obstacles, for the raster engine
+	ObstacleHeightRaster m_raster;
+
+	// threads parsing a poly XML file (0 for one per core)
+	uint32_t m_loadThreads;
+
+	// rules applied to the polygons of poly XML files
+	ObstacleTypeRules m_typeRules;
+
+	// simplification of the obstacles loaded from poly XML files
+	double m_simplifyTolerance;
+	uint32_t m_simplifySamples;
+	SimplificationReport m_simplificationReport;
+
+	// the files loaded, each one is loaded once, and the hash of their
+	// bytes and of the parameters of the load (see GetSourceHash)
+	std::vector<std::string> m_loadedFiles;
+	uint64_t m_sourceHash;
+
+	// tile store the obstacles are loaded from (instead of m_obstacles),
+	// and the budget of the tiles loaded
+	std::unique_ptr<ObstacleTileStore> m_tiles;
+	uint64_t m_tileMemoryBudget;
+
+	// points that never move, and their index by x and y (see AddFixedPoint)
+	std::vector<ObstacleVisibility> m_fixedPoints;
+	std::map<std::pair<double, double>, uint32_t> m_fixedPointIndex;
+
+	// mapping of the compiled buildings file m_grid and the obstacles may point to
+	void *m_map;
+	uint64_t m_mapSize;
+
   // a cache of obstructed distances between two points
   // (used for performance optimization).
   // Assume that two points that have not moved more than
@@ -208,7 +958,11 @@ public:
   // recalculated deterministically at every evaluation,
   // e.g., when nodes are stationary (obstacle are, too) so
   // there is no change to previously calculated results.
-  TStrDblMap m_obstructedDistanceMap;
+	// Keys are the quantized coordinates of the two points,
+	// when full the cache evicts entries with the CLOCK policy.
+	// The context holds the cache and the scratch space of the
+	// queries that do not provide their own context.
+	TopologyQueryContext m_context;
 };
 
 } // namespace ns3
@@ -0,0 +1,361 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#include "wall-intersection-kernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WALL_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace ns3 {
+
+void
+WallSoup::Clear ()
+{
+	m_x0.clear ();
+	m_y0.clear ();
+	m_x1.clear ();
+	m_y1.clear ();
+	m_h.clear ();
+}
+
+void
+WallSoup::Add (double x0, double y0, double x1, double y1, double h)
+{
+	m_x0.push_back (x0);
+	m_y0.push_back (y0);
+	m_x1.push_back (x1);
+	m_y1.push_back (y1);
+	m_h.push_back (h);
+}
+
+uint32_t
+WallSoup::GetN () const
+{
+	return m_x0.size ();
+}
+
+FootprintEdgeTable::FootprintEdgeTable ()
+	:	m_minX (0),
+		m_minY (0),
+		m_maxX (0),
+		m_maxY (0),
+		m_slabHeight (1),
+		m_nSlabs (0)
+{
+}
+
+void
+FootprintEdgeTable::Build (const VertexList &vertices)
+{
+	uint32_t n = vertices.size ();
+
+	m_nSlabs = 0;
+	m_slabStart.clear ();
+	m_edges.clear ();
+	if (n == 0)
+		return;
+
+	double minX = vertices[0].x;
+	double minY = vertices[0].y;
+	double maxX = vertices[0].x;
+	double maxY = vertices[0].y;
+	for (uint32_t i = 1; i < n; i++)
+	{
+		minX = std::min (minX, vertices[i].x);
+		minY = std::min (minY, vertices[i].y);
+		maxX = std::max (maxX, vertices[i].x);
+		maxY = std::max (maxY, vertices[i].y);
+	}
+
+	// bound of the tolerance of FootprintEdgeStep for a point within the
+	// tolerance of an edge (no edge is longer than l), plus some room
+	// for the rounding of the coordinates
+	double l = (maxX - minX) + (maxY - minY);
+	double margin = 1e-9 * l * (4.0 * l + 2.0)
+		+ 1e-9 * (std::abs (minX) + std::abs (minY) + std::abs (maxX) + std::abs (maxY));
+	m_minX = minX - margin;
+	m_minY = minY - margin;
+	m_maxX = maxX + margin;
+	m_maxY = maxY + margin;
+
+	// a few edges per slab
+	m_nSlabs = std::min (64u, std::max (1u, n / 4));
+	m_slabHeight = (m_maxY - m_minY) / m_nSlabs;
+	if (!(m_slabHeight > 0))
+	{
+		m_nSlabs = 1;
+		m_slabHeight = 1;
+	}
+
+	// two passes: count the edges of each slab, then fill
+	m_slabStart.assign (m_nSlabs + 1, 0);
+	for (uint32_t pass = 0; pass < 2; pass++)
+	{
+		std::vector<uint32_t> next;
+		if (pass == 1)
+		{
+			for (uint32_t k = 0; k < m_nSlabs; k++)
+				m_slabStart[k + 1] += m_slabStart[k];
+			m_edges.resize (4 * m_slabStart.back ());
+			next.assign (m_slabStart.begin (), m_slabStart.end () - 1);
+		}
+
+		for (uint32_t i = 0, j = n - 1; i < n; j = i++)
+		{
+			const Vector2D &a = vertices[j];
+			const Vector2D &b = vertices[i];
+			double y0 = std::max (std::min (a.y, b.y) - margin, m_minY);
+			double y1 = std::min (std::max (a.y, b.y) + margin, m_maxY);
+			uint32_t k0 = std::min ((uint32_t) ((y0 - m_minY) / m_slabHeight), m_nSlabs - 1);
+			uint32_t k1 = std::min ((uint32_t) ((y1 - m_minY) / m_slabHeight), m_nSlabs - 1);
+			for (uint32_t k = k0; k <= k1; k++)
+			{
+				if (pass == 0)
+				{
+					m_slabStart[k + 1]++;
+				}
+				else
+				{
+					double *e = &m_edges[4 * next[k]++];
+					e[0] = a.x;
+					e[1] = a.y;
+					e[2] = b.x;
+					e[3] = b.y;
+				}
+			}
+		}
+	}
+}
+
+uint64_t
+FootprintEdgeTable::GetHeapBytes () const
+{
+	return m_slabStart.capacity () * sizeof (uint32_t) + m_edges.capacity () * sizeof (double);
+}
+
+#ifdef WALL_KERNEL_X86
+
+/*
+ * The vectorized kernels below are a lane-wise transcription of IntersectWall:
+ * same operations, same order and no fused multiply-add, so every lane is
+ * rounded exactly like the scalar code. They return the number of walls
+ * processed, the tail is left to the scalar code.
+ */
+
+__attribute__((target("avx2")))
+static uint32_t
+IntersectWallsAvx2 (const WallSoup &walls, const Vector &p1, const Vector &p2,
+										double *distSq, uint8_t *hit)
+{
+	uint32_t n = walls.GetN () & ~3u;
+
+	const __m256d zero = _mm256_setzero_pd ();
+	const __m256d one = _mm256_set1_pd (1.0);
+	const __m256d eps = _mm256_set1_pd (1e-9);
+	const __m256d absMask = _mm256_castsi256_pd (_mm256_set1_epi64x (0x7fffffffffffffffLL));
+	const __m256d p1x = _mm256_set1_pd (p1.x);
+	const __m256d p1y = _mm256_set1_pd (p1.y);
+	const __m256d p1z = _mm256_set1_pd (p1.z);
+	const __m256d p2x = _mm256_set1_pd (p2.x);
+	const __m256d p2y = _mm256_set1_pd (p2.y);
+	const __m256d rx = _mm256_set1_pd (p2.x - p1.x);
+	const __m256d ry = _mm256_set1_pd (p2.y - p1.y);
+	const __m256d rz = _mm256_set1_pd (p2.z - p1.z);
+
+	for (uint32_t i = 0; i < n; i += 4)
+	{
+		__m256d x0 = _mm256_loadu_pd (&walls.m_x0[i]);
+		__m256d y0 = _mm256_loadu_pd (&walls.m_y0[i]);
+		__m256d ex = _mm256_sub_pd (_mm256_loadu_pd (&walls.m_x1[i]), x0);
+		__m256d ey = _mm256_sub_pd (_mm256_loadu_pd (&walls.m_y1[i]), y0);
+		__m256d h = _mm256_loadu_pd (&walls.m_h[i]);
+
+		__m256d eLen2 = _mm256_add_pd (_mm256_mul_pd (ex, ex), _mm256_mul_pd (ey, ey));
+		__m256d eLen = _mm256_sqrt_pd (eLen2);
+
+		__m256d ax = _mm256_sub_pd (p1x, x0);
+		__m256d ay = _mm256_sub_pd (p1y, y0);
+		__m256d bx = _mm256_sub_pd (p2x, x0);
+		__m256d by = _mm256_sub_pd (p2y, y0);
+
+		__m256d d1 = _mm256_sub_pd (_mm256_mul_pd (ex, ay), _mm256_mul_pd (ey, ax));
+		__m256d d2 = _mm256_sub_pd (_mm256_mul_pd (ex, by), _mm256_mul_pd (ey, bx));
+
+		__m256d sum = _mm256_add_pd (_mm256_and_pd (ax, absMask), _mm256_and_pd (ay, absMask));
+		sum = _mm256_add_pd (sum, _mm256_and_pd (bx, absMask));
+		sum = _mm256_add_pd (sum, _mm256_and_pd (by, absMask));
+		sum = _mm256_add_pd (sum, one);
+		__m256d tol = _mm256_mul_pd (_mm256_mul_pd (eps, eLen), sum);
+
+		__m256d degenerate = _mm256_or_pd (_mm256_cmp_pd (eLen, zero, _CMP_EQ_OQ),
+									_mm256_or_pd (_mm256_cmp_pd (_mm256_and_pd (d1, absMask), tol, _CMP_LE_OQ),
+																_mm256_cmp_pd (_mm256_and_pd (d2, absMask), tol, _CMP_LE_OQ)));
+		__m256d crossing = _mm256_xor_pd (_mm256_cmp_pd (d1, zero, _CMP_GT_OQ),
+																			_mm256_cmp_pd (d2, zero, _CMP_GT_OQ));
+
+		__m256d t = _mm256_div_pd (d1, _mm256_sub_pd (d1, d2));
+		__m256d dx = _mm256_mul_pd (t, rx);
+		__m256d dy = _mm256_mul_pd (t, ry);
+		__m256d dz = _mm256_mul_pd (t, rz);
+		__m256d ipz = _mm256_add_pd (p1z, dz);
+
+		__m256d u = _mm256_div_pd (_mm256_add_pd (_mm256_mul_pd (_mm256_add_pd (ax, dx), ex),
+																							_mm256_mul_pd (_mm256_add_pd (ay, dy), ey)), eLen2);
+		__m256d inside = _mm256_and_pd (_mm256_and_pd (_mm256_cmp_pd (u, zero, _CMP_GE_OQ),
+																									 _mm256_cmp_pd (u, one, _CMP_LE_OQ)),
+																		_mm256_and_pd (_mm256_cmp_pd (ipz, zero, _CMP_GE_OQ),
+																									 _mm256_cmp_pd (ipz, h, _CMP_LE_OQ)));
+
+		__m256d d = _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (dx, dx), _mm256_mul_pd (dy, dy)),
+															 _mm256_mul_pd (dz, dz));
+		_mm256_storeu_pd (&distSq[i], d);
+
+		int degenerateBits = _mm256_movemask_pd (degenerate);
+		int hitBits = _mm256_movemask_pd (_mm256_and_pd (crossing, inside));
+		for (uint32_t k = 0; k < 4; k++)
+		{
+			if (degenerateBits & (1 << k))
+				hit[i + k] = WALL_DEGENERATE;
+			else if (hitBits & (1 << k))
+				hit[i + k] = WALL_HIT;
+			else
+				hit[i + k] = WALL_MISS;
+		}
+	}
+
+	return n;
+}
+
+#ifdef __SSE2__
+static uint32_t
+IntersectWallsSse2 (const WallSoup &walls, const Vector &p1, const Vector &p2,
+										double *distSq, uint8_t *hit)
+{
+	uint32_t n = walls.GetN () & ~1u;
+
+	const __m128d zero = _mm_setzero_pd ();
+	const __m128d one = _mm_set1_pd (1.0);
+	const __m128d eps = _mm_set1_pd (1e-9);
+	const __m128d absMask = _mm_castsi128_pd (_mm_set1_epi64x (0x7fffffffffffffffLL));
+	const __m128d p1x = _mm_set1_pd (p1.x);
+	const __m128d p1y = _mm_set1_pd (p1.y);
+	const __m128d p1z = _mm_set1_pd (p1.z);
+	const __m128d p2x = _mm_set1_pd (p2.x);
+	const __m128d p2y = _mm_set1_pd (p2.y);
+	const __m128d rx = _mm_set1_pd (p2.x - p1.x);
+	const __m128d ry = _mm_set1_pd (p2.y - p1.y);
+	const __m128d rz = _mm_set1_pd (p2.z - p1.z);
+
+	for (uint32_t i = 0; i < n; i += 2)
+	{
+		__m128d x0 = _mm_loadu_pd (&walls.m_x0[i]);
+		__m128d y0 = _mm_loadu_pd (&walls.m_y0[i]);
+		__m128d ex = _mm_sub_pd (_mm_loadu_pd (&walls.m_x1[i]), x0);
+		__m128d ey = _mm_sub_pd (_mm_loadu_pd (&walls.m_y1[i]), y0);
+		__m128d h = _mm_loadu_pd (&walls.m_h[i]);
+
+		__m128d eLen2 = _mm_add_pd (_mm_mul_pd (ex, ex), _mm_mul_pd (ey, ey));
+		__m128d eLen = _mm_sqrt_pd (eLen2);
+
+		__m128d ax = _mm_sub_pd (p1x, x0);
+		__m128d ay = _mm_sub_pd (p1y, y0);
+		__m128d bx = _mm_sub_pd (p2x, x0);
+		__m128d by = _mm_sub_pd (p2y, y0);
+
+		__m128d d1 = _mm_sub_pd (_mm_mul_pd (ex, ay), _mm_mul_pd (ey, ax));
+		__m128d d2 = _mm_sub_pd (_mm_mul_pd (ex, by), _mm_mul_pd (ey, bx));
+
+		__m128d sum = _mm_add_pd (_mm_and_pd (ax, absMask), _mm_and_pd (ay, absMask));
+		sum = _mm_add_pd (sum, _mm_and_pd (bx, absMask));
+		sum = _mm_add_pd (sum, _mm_and_pd (by, absMask));
+		sum = _mm_add_pd (sum, one);
+		__m128d tol = _mm_mul_pd (_mm_mul_pd (eps, eLen), sum);
+
+		__m128d degenerate = _mm_or_pd (_mm_cmpeq_pd (eLen, zero),
+																		_mm_or_pd (_mm_cmple_pd (_mm_and_pd (d1, absMask), tol),
+																							 _mm_cmple_pd (_mm_and_pd (d2, absMask), tol)));
+		__m128d crossing = _mm_xor_pd (_mm_cmpgt_pd (d1, zero), _mm_cmpgt_pd (d2, zero));
+
+		__m128d t = _mm_div_pd (d1, _mm_sub_pd (d1, d2));
+		__m128d dx = _mm_mul_pd (t, rx);
+		__m128d dy = _mm_mul_pd (t, ry);
+		__m128d dz = _mm_mul_pd (t, rz);
+		__m128d ipz = _mm_add_pd (p1z, dz);
+
+		__m128d u = _mm_div_pd (_mm_add_pd (_mm_mul_pd (_mm_add_pd (ax, dx), ex),
+																				_mm_mul_pd (_mm_add_pd (ay, dy), ey)), eLen2);
+		__m128d inside = _mm_and_pd (_mm_and_pd (_mm_cmpge_pd (u, zero), _mm_cmple_pd (u, one)),
+																 _mm_and_pd (_mm_cmpge_pd (ipz, zero), _mm_cmple_pd (ipz, h)));
+
+		__m128d d = _mm_add_pd (_mm_add_pd (_mm_mul_pd (dx, dx), _mm_mul_pd (dy, dy)),
+														_mm_mul_pd (dz, dz));
+		_mm_storeu_pd (&distSq[i], d);
+
+		int degenerateBits = _mm_movemask_pd (degenerate);
+		int hitBits = _mm_movemask_pd (_mm_and_pd (crossing, inside));
+		for (uint32_t k = 0; k < 2; k++)
+		{
+			if (degenerateBits & (1 << k))
+				hit[i + k] = WALL_DEGENERATE;
+			else if (hitBits & (1 << k))
+				hit[i + k] = WALL_HIT;
+			else
+				hit[i + k] = WALL_MISS;
+		}
+	}
+
+	return n;
+}
+#endif /* __SSE2__ */
+
+#endif /* WALL_KERNEL_X86 */
+
+void
+IntersectWalls (const WallSoup &walls, const Vector &p1, const Vector &p2,
+								double *distSq, uint8_t *hit)
+{
+	uint32_t done = 0;
+
+#ifdef WALL_KERNEL_X86
+	static const bool hasAvx2 = __builtin_cpu_supports ("avx2");
+	if (hasAvx2)
+	{
+		done = IntersectWallsAvx2 (walls, p1, p2, distSq, hit);
+	}
+#ifdef __SSE2__
+	else
+	{
+		done = IntersectWallsSse2 (walls, p1, p2, distSq, hit);
+	}
+#endif
+#endif
+
+	// tail (or the whole soup, without vector extensions)
+	for (uint32_t i = done; i < walls.GetN (); i++)
+	{
+		hit[i] = IntersectWall (walls.m_x0[i], walls.m_y0[i], walls.m_x1[i], walls.m_y1[i], walls.m_h[i],
+														p1, p2, distSq[i]);
+	}
+}
+
+} // namespace ns3
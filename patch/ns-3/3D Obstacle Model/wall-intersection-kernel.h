@@ -0,0 +1,321 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2017 University of Padova
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Marco Romanelli <marco.romanelli.1@studenti.unipd.it>
+ *
+ */
+
+#ifndef WALL_INTERSECTION_KERNEL_H
+#define WALL_INTERSECTION_KERNEL_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include "ns3/vector.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief Outcome of the intersection between a segment and a wall
+ */
+enum WallHit
+{
+	WALL_MISS = 0,				// no intersection
+	WALL_HIT = 1,					// one point intersection
+	WALL_DEGENERATE = 2		// double precision is not enough, use the exact kernel
+};
+
+/**
+ * \ingroup obstacle
+ * \brief A flattened list of walls in structure-of-arrays layout.
+ * Each wall is an edge (x0,y0)-(x1,y1) of an obstacle, extruded
+ * from the ground up to the height h of the obstacle
+ */
+class WallSoup
+{
+public:
+	/**
+	 * \brief Remove all the walls (capacity is kept)
+	 * \return none
+	 */
+	void Clear ();
+
+	/**
+	 * \brief Append a wall
+	 * \param x0 x coordinate of the first vertex
+	 * \param y0 y coordinate of the first vertex
+	 * \param x1 x coordinate of the second vertex
+	 * \param y1 y coordinate of the second vertex
+	 * \param h height of the wall
+	 * \return none
+	 */
+	void Add (double x0, double y0, double x1, double y1, double h);
+
+	/**
+	 * \brief Get the number of walls
+	 * \return the number of walls
+	 */
+	uint32_t GetN () const;
+
+	std::vector<double>	m_x0;
+	std::vector<double>	m_y0;
+	std::vector<double>	m_x1;
+	std::vector<double>	m_y1;
+	std::vector<double>	m_h;
+};
+
+/**
+ * \ingroup obstacle
+ * \brief A read only view of the vertices of a footprint, stored
+ * contiguously elsewhere: in the obstacle itself, in an array shared
+ * by all the obstacles of a topology, or in a mapped compiled file
+ */
+class VertexList
+{
+public:
+	VertexList () : m_data (0), m_size (0) {}
+	VertexList (const Vector2D *data, uint32_t size) : m_data (data), m_size (size) {}
+	VertexList (const std::vector<Vector2D> &vertices)
+		: m_data (vertices.empty () ? 0 : &vertices[0]), m_size (vertices.size ()) {}
+
+	uint32_t size () const { return m_size; }
+	bool empty () const { return m_size == 0; }
+	const Vector2D &operator[] (uint32_t i) const { return m_data[i]; }
+	const Vector2D &back () const { return m_data[m_size - 1]; }
+	const Vector2D *begin () const { return m_data; }
+	const Vector2D *end () const { return m_data + m_size; }
+
+private:
+	const Vector2D	*m_data;
+	uint32_t				m_size;
+};
+
+/**
+ * \ingroup obstacle
+ * \brief Intersect a segment with a single wall, in double precision.
+ * It is the reference for the vectorized kernel: both perform the same
+ * operations in the same order, so they give the same results
+ * \param x0 x coordinate of the first vertex of the wall
+ * \param y0 y coordinate of the first vertex of the wall
+ * \param x1 x coordinate of the second vertex of the wall
+ * \param y1 y coordinate of the second vertex of the wall
+ * \param h height of the wall
+ * \param p1 first point of the segment
+ * \param p2 second point of the segment
+ * \param distSq squared distance from p1 to the intersection (set only on WALL_HIT)
+ * \return the outcome of the test
+ */
+inline WallHit
+IntersectWall (double x0, double y0, double x1, double y1, double h,
+							 const Vector &p1, const Vector &p2, double &distSq)
+{
+	double ex = x1 - x0;
+	double ey = y1 - y0;
+	double eLen2 = ex * ex + ey * ey;
+	double eLen = std::sqrt (eLen2);
+
+	double ax = p1.x - x0;
+	double ay = p1.y - y0;
+	double bx = p2.x - x0;
+	double by = p2.y - y0;
+
+	// signed (scaled) distances of the endpoints from the wall line
+	double d1 = ex * ay - ey * ax;
+	double d2 = ex * by - ey * bx;
+
+	// a vanishing edge, or an endpoint (almost) on the wall:
+	// the sign of d1 and d2 cannot be trusted
+	double tol = 1e-9 * eLen * (std::abs (ax) + std::abs (ay) + std::abs (bx) + std::abs (by) + 1.0);
+	if (eLen == 0 || std::abs (d1) <= tol || std::abs (d2) <= tol)
+		return WALL_DEGENERATE;
+
+	// both endpoints on the same side
+	if ((d1 > 0) == (d2 > 0))
+		return WALL_MISS;
+
+	double t = d1 / (d1 - d2);
+	double dx = t * (p2.x - p1.x);
+	double dy = t * (p2.y - p1.y);
+	double dz = t * (p2.z - p1.z);
+	double ipz = p1.z + dz;
+
+	// position of the intersection along the edge, replaces
+	// the bounding box test of Topology::IsInRegion
+	double u = ((ax + dx) * ex + (ay + dy) * ey) / eLen2;
+	if (u < 0 || u > 1 || ipz < 0 || ipz > h)
+		return WALL_MISS;
+
+	distSq = dx * dx + dy * dy + dz * dz;
+	return WALL_HIT;
+}
+
+/**
+ * \ingroup obstacle
+ * \brief One step of the crossing number test of PointInFootprint: the
+ * edge from (ax,ay) to (bx,by) against the point (x,y)
+ * \param ax x coordinate of the first vertex of the edge
+ * \param ay y coordinate of the first vertex of the edge
+ * \param bx x coordinate of the second vertex of the edge
+ * \param by y coordinate of the second vertex of the edge
+ * \param x x coordinate of the point
+ * \param y y coordinate of the point
+ * \param inside toggled if the edge crosses the ray from the point towards +x
+ * \return false if the point is too close to the edge to tell
+ */
+inline bool
+FootprintEdgeStep (double ax, double ay, double bx, double by, double x, double y, bool &inside)
+{
+	double ex = bx - ax;
+	double ey = by - ay;
+	double px = x - ax;
+	double py = y - ay;
+
+	// (almost) on the edge: the border belongs to the polygon,
+	// but double precision cannot tell which side the point is on
+	double eLen = std::abs (ex) + std::abs (ey);
+	double tol = 1e-9 * eLen * (std::abs (px) + std::abs (py) + eLen + 1.0);
+	if (std::abs (ex * py - ey * px) <= tol
+			&& x >= std::min (ax, bx) - tol && x <= std::max (ax, bx) + tol
+			&& y >= std::min (ay, by) - tol && y <= std::max (ay, by) + tol)
+		return false;
+
+	// edge crossing the horizontal ray from the point towards +x
+	if ((ay > y) != (by > y) && (x < ax + (y - ay) * ex / ey))
+		inside = !inside;
+
+	return true;
+}
+
+/**
+ * \ingroup obstacle
+ * \brief Test if a point lies within the footprint of an obstacle, in
+ * double precision (crossing number). Same semantic of
+ * Topology::PointIsInPolygon: a point on the border is inside
+ * \param vertices the vertices of the footprint
+ * \param x x coordinate of the point
+ * \param y y coordinate of the point
+ * \return WALL_HIT if inside, WALL_MISS if outside, WALL_DEGENERATE if
+ * the point is too close to the border to tell
+ */
+inline WallHit
+PointInFootprint (const VertexList &vertices, double x, double y)
+{
+	uint32_t n = vertices.size ();
+	bool inside = false;
+
+	for (uint32_t i = 0, j = n - 1; i < n; j = i++)
+	{
+		if (!FootprintEdgeStep (vertices[j].x, vertices[j].y, vertices[i].x, vertices[i].y, x, y, inside))
+			return WALL_DEGENERATE;
+	}
+
+	return inside ? WALL_HIT : WALL_MISS;
+}
+
+/**
+ * \ingroup obstacle
+ * \brief The edges of a footprint sorted in horizontal slabs, for fast
+ * containment tests.
+ *
+ * The y range of the footprint is split in slabs of the same height and
+ * each slab lists the edges that overlap it. A point is tested only
+ * against the edges of its slab, with the same arithmetic of
+ * PointInFootprint, so the outcome is the same. The edge and the
+ * bounding box ranges are enlarged by the tolerance of the degenerate
+ * test, so that no point close to an edge can miss it.
+ */
+class FootprintEdgeTable
+{
+public:
+	FootprintEdgeTable ();
+
+	/**
+	 * \brief Build the table
+	 * \param vertices the vertices of the footprint
+	 * \return none
+	 */
+	void Build (const VertexList &vertices);
+
+	/**
+	 * \brief Test if a point lies within the footprint, see PointInFootprint
+	 * \param x x coordinate of the point
+	 * \param y y coordinate of the point
+	 * \return WALL_HIT if inside, WALL_MISS if outside, WALL_DEGENERATE if
+	 * the point is too close to the border to tell
+	 */
+	WallHit Contains (double x, double y) const;
+
+	/**
+	 * \brief Get the memory allocated by the table, besides the object
+	 * \return the capacity of the slab and edge arrays, in bytes
+	 */
+	uint64_t GetHeapBytes () const;
+
+private:
+	// bounding box of the footprint, enlarged by m_margin
+	double								m_minX;
+	double								m_minY;
+	double								m_maxX;
+	double								m_maxY;
+	double								m_slabHeight;
+	uint32_t							m_nSlabs;
+	// edges of slab i are m_edges[4 * m_slabStart[i]] .. m_edges[4 * m_slabStart[i + 1] - 1],
+	// as ax, ay, bx, by (same orientation of PointInFootprint)
+	std::vector<uint32_t>	m_slabStart;
+	std::vector<double>		m_edges;
+};
+
+inline WallHit
+FootprintEdgeTable::Contains (double x, double y) const
+{
+	// outside the (enlarged) bounding box: no edge is crossed or too close
+	if (m_nSlabs == 0 || x < m_minX || x > m_maxX || y < m_minY || y > m_maxY)
+		return WALL_MISS;
+
+	uint32_t slab = std::min ((uint32_t) ((y - m_minY) / m_slabHeight), m_nSlabs - 1);
+	bool inside = false;
+	for (uint32_t k = m_slabStart[slab]; k < m_slabStart[slab + 1]; k++)
+	{
+		const double *e = &m_edges[4 * k];
+		if (!FootprintEdgeStep (e[0], e[1], e[2], e[3], x, y, inside))
+			return WALL_DEGENERATE;
+	}
+
+	return inside ? WALL_HIT : WALL_MISS;
+}
+
+/**
+ * \ingroup obstacle
+ * \brief Intersect a segment with every wall of a soup.
+ * Uses AVX2 (4 walls at once) when the cpu supports it, SSE2 (2 walls)
+ * otherwise, and falls back to IntersectWall on other architectures.
+ * \param walls the walls
+ * \param p1 first point of the segment
+ * \param p2 second point of the segment
+ * \param distSq output, squared distance from p1 of each intersection
+ * (meaningful only where hit is WALL_HIT), walls.GetN () elements
+ * \param hit output, a WallHit value for each wall, walls.GetN () elements
+ * \return none
+ */
+void IntersectWalls (const WallSoup &walls, const Vector &p1, const Vector &p2,
+										 double *distSq, uint8_t *hit);
+
+} // namespace ns3
+
+#endif /* WALL_INTERSECTION_KERNEL_H */